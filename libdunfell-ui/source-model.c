@@ -118,6 +118,8 @@ static const struct {
   { G_TYPE_INT64, "min-dispatch-duration" },
   { G_TYPE_INT64, "median-dispatch-duration" },
   { G_TYPE_INT64, "max-dispatch-duration" },
+  { G_TYPE_INT64, "p90-dispatch-duration" },
+  { G_TYPE_INT64, "p99-dispatch-duration" },
 };
 
 G_DEFINE_TYPE_WITH_CODE (DwlSourceModel, dwl_source_model, G_TYPE_OBJECT,
@@ -56,7 +56,16 @@ static void dwl_statistics_pane_dispose      (GObject      *object);
 static void add_default_css                  (GtkWidget *widget);
 
 static void dwl_statistics_pane_update_overall_statistics (DwlStatisticsPane *self);
-
+static void dwl_statistics_pane_update_n_long_dispatches (DwlStatisticsPane *self);
+static void model_updated_cb (DflModel *model,
+                              gpointer  user_data);
+static void long_dispatch_threshold_value_changed_cb (GtkRange *range,
+                                                     gpointer  user_data);
+static gboolean dispatch_histogram_draw_cb (GtkWidget *widget,
+                                            cairo_t   *cr,
+                                            gpointer   user_data);
+
+/* Default for #DwlStatisticsPane.long_dispatch_threshold. */
 #define LONG_DISPATCH_DURATION (1 * G_USEC_PER_SEC / 60)  /* microseconds */
 
 struct _DwlStatisticsPane
@@ -72,7 +81,9 @@ struct _DwlStatisticsPane
   GtkLabel *n_sources;
   GtkLabel *n_tasks;
   GtkLabel *n_long_dispatches;
+  GtkRange *long_dispatch_threshold;  /* milliseconds */
   GtkLabel *n_thread_switches;
+  GtkDrawingArea *dispatch_histogram;
 };
 
 G_DEFINE_TYPE (DwlStatisticsPane, dwl_statistics_pane, GTK_TYPE_BIN)
@@ -101,8 +112,13 @@ dwl_statistics_pane_class_init (DwlStatisticsPaneClass *klass)
                                         DwlStatisticsPane, n_tasks);
   gtk_widget_class_bind_template_child (widget_class,
                                         DwlStatisticsPane, n_long_dispatches);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        DwlStatisticsPane,
+                                        long_dispatch_threshold);
   gtk_widget_class_bind_template_child (widget_class,
                                         DwlStatisticsPane, n_thread_switches);
+  gtk_widget_class_bind_template_child (widget_class,
+                                        DwlStatisticsPane, dispatch_histogram);
 
   object_class->get_property = dwl_statistics_pane_get_property;
   object_class->set_property = dwl_statistics_pane_set_property;
@@ -160,6 +176,15 @@ dwl_statistics_pane_init (DwlStatisticsPane *self)
   gtk_widget_init_template (GTK_WIDGET (self));
 
   add_default_css (GTK_WIDGET (self));
+
+  g_signal_connect (self->dispatch_histogram, "draw",
+                    (GCallback) dispatch_histogram_draw_cb, self);
+
+  gtk_range_set_value (self->long_dispatch_threshold,
+                       (gdouble) LONG_DISPATCH_DURATION / 1000.0);
+  g_signal_connect (self->long_dispatch_threshold, "value-changed",
+                    (GCallback) long_dispatch_threshold_value_changed_cb,
+                    self);
 }
 
 static void
@@ -221,6 +246,9 @@ dwl_statistics_pane_constructed (GObject *object)
   /* Set the initial stack page. */
   dwl_statistics_pane_update_overall_statistics (self);
   gtk_stack_set_visible_child_name (self->stack, "overall");
+
+  g_signal_connect (self->model, "updated", (GCallback) model_updated_cb,
+                    self);
 }
 
 static void
@@ -229,6 +257,10 @@ dwl_statistics_pane_dispose (GObject *object)
   DwlStatisticsPane *self = DWL_STATISTICS_PANE (object);
 
   g_clear_object (&self->selected_object);
+
+  if (self->model != NULL)
+    g_signal_handlers_disconnect_by_func (self->model, model_updated_cb, self);
+
   g_clear_object (&self->model);
 
   G_OBJECT_CLASS (dwl_statistics_pane_parent_class)->dispose (object);
@@ -297,7 +329,10 @@ dwl_statistics_pane_set_selected_object (DwlStatisticsPane *self,
     gtk_stack_set_visible_child_name (self->stack, "overall");
 
   if (changed)
-    g_object_notify (G_OBJECT (self), "selected-object");
+    {
+      gtk_widget_queue_draw (GTK_WIDGET (self->dispatch_histogram));
+      g_object_notify (G_OBJECT (self), "selected-object");
+    }
 }
 
 static void
@@ -306,21 +341,184 @@ dwl_statistics_pane_update_overall_statistics (DwlStatisticsPane *self)
   g_autoptr (GPtrArray) sources = NULL;  /* (element-type DflSource) */
   g_autoptr (GPtrArray) tasks = NULL;  /* (element-type DflTask) */
   g_autofree gchar *n_sources = NULL, *n_tasks = NULL;
-  g_autofree gchar *n_long_dispatches = NULL, *n_thread_switches = NULL;
+  g_autofree gchar *n_thread_switches = NULL;
 
   sources = dfl_model_dup_sources (self->model);
   tasks = dfl_model_dup_tasks (self->model);
 
   n_sources = g_strdup_printf ("%u", sources->len);
   n_tasks = g_strdup_printf ("%u", tasks->len);
-  n_long_dispatches = g_strdup_printf ("%" G_GSIZE_FORMAT,
-                                       dfl_model_get_n_long_dispatches (self->model,
-                                                                        LONG_DISPATCH_DURATION));
   n_thread_switches = g_strdup_printf ("%" G_GSIZE_FORMAT,
                                        dfl_model_get_n_main_context_thread_switches (self->model));
 
   gtk_label_set_text (self->n_sources, n_sources);
   gtk_label_set_text (self->n_tasks, n_tasks);
-  gtk_label_set_text (self->n_long_dispatches, n_long_dispatches);
   gtk_label_set_text (self->n_thread_switches, n_thread_switches);
+
+  dwl_statistics_pane_update_n_long_dispatches (self);
+}
+
+/* This is cheap enough to be called for every change of the threshold while
+ * its slider is being dragged, as the model indexes dispatches by duration. */
+static void
+dwl_statistics_pane_update_n_long_dispatches (DwlStatisticsPane *self)
+{
+  g_autofree gchar *n_long_dispatches = NULL;
+  DflDuration threshold;
+
+  threshold = gtk_range_get_value (self->long_dispatch_threshold) * 1000.0;
+  n_long_dispatches = g_strdup_printf ("%" G_GSIZE_FORMAT,
+                                       dfl_model_get_n_long_dispatches (self->model,
+                                                                        threshold));
+
+  gtk_label_set_text (self->n_long_dispatches, n_long_dispatches);
+}
+
+static void
+long_dispatch_threshold_value_changed_cb (GtkRange *range,
+                                          gpointer  user_data)
+{
+  DwlStatisticsPane *self = DWL_STATISTICS_PANE (user_data);
+
+  dwl_statistics_pane_update_n_long_dispatches (self);
+}
+
+static void
+model_updated_cb (DflModel *model,
+                  gpointer  user_data)
+{
+  DwlStatisticsPane *self = DWL_STATISTICS_PANE (user_data);
+
+  dwl_statistics_pane_update_overall_statistics (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self->dispatch_histogram));
+}
+
+/* Get the histogram to display: that of the selected source or main context,
+ * or that of the whole model otherwise. */
+static DflHistogram *
+dwl_statistics_pane_dup_dispatch_histogram (DwlStatisticsPane *self)
+{
+  if (DFL_IS_SOURCE (self->selected_object))
+    return dfl_source_dup_dispatch_histogram (DFL_SOURCE (self->selected_object));
+  else if (DFL_IS_MAIN_CONTEXT (self->selected_object))
+    return dfl_main_context_dup_dispatch_histogram (DFL_MAIN_CONTEXT (self->selected_object));
+  else
+    return dfl_model_dup_dispatch_histogram (self->model);
+}
+
+static void
+draw_histogram_label (GtkWidget       *widget,
+                      GtkStyleContext *context,
+                      cairo_t         *cr,
+                      gdouble          x,
+                      gdouble          y,
+                      gdouble          xalign,
+                      const gchar     *text)
+{
+  PangoLayout *layout = NULL;
+  PangoRectangle layout_rect;
+
+  layout = gtk_widget_create_pango_layout (widget, text);
+  pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+
+  gtk_render_layout (context, cr, x - layout_rect.width * xalign, y, layout);
+  g_object_unref (layout);
+}
+
+/* Draw the dispatch duration histogram with one bar per power of two of
+ * microseconds, so that the x axis is logarithmic. The histogram’s finer
+ * buckets are summed into the bars. */
+static gboolean
+dispatch_histogram_draw_cb (GtkWidget *widget,
+                            cairo_t   *cr,
+                            gpointer   user_data)
+{
+  DwlStatisticsPane *self = DWL_STATISTICS_PANE (user_data);
+  g_autoptr (DflHistogram) histogram = NULL;
+  guint64 bar_counts[64] = { 0, };
+  guint64 max_count = 0;
+  guint i, n_buckets, first_bar, last_bar, n_bars;
+  GtkStyleContext *context;
+  GdkRGBA color;
+  gint widget_width, widget_height;
+  gdouble bar_width, plot_height;
+  PangoLayout *layout = NULL;
+  PangoRectangle layout_rect;
+  g_autofree gchar *min_text = NULL, *max_text = NULL;
+
+  context = gtk_widget_get_style_context (widget);
+  widget_width = gtk_widget_get_allocated_width (widget);
+  widget_height = gtk_widget_get_allocated_height (widget);
+
+  gtk_render_background (context, cr, 0, 0, widget_width, widget_height);
+
+  histogram = dwl_statistics_pane_dup_dispatch_histogram (self);
+  n_buckets = dfl_histogram_get_n_buckets (histogram);
+
+  if (dfl_histogram_get_n_durations (histogram) == 0)
+    {
+      draw_histogram_label (widget, context, cr, widget_width / 2.0, 0.0, 0.5,
+                            _("No dispatches"));
+      return FALSE;
+    }
+
+  for (i = 0; i < n_buckets; i++)
+    {
+      DflDuration lower;
+      guint64 count;
+      guint bar;
+
+      dfl_histogram_get_bucket (histogram, i, &lower, NULL, &count);
+
+      bar = g_bit_storage (lower);
+      bar_counts[bar] += count;
+    }
+
+  first_bar = g_bit_storage (dfl_histogram_get_min (histogram));
+  last_bar = g_bit_storage (dfl_histogram_get_max (histogram));
+  n_bars = last_bar - first_bar + 1;
+
+  for (i = first_bar; i <= last_bar; i++)
+    max_count = MAX (max_count, bar_counts[i]);
+
+  /* Leave space for the axis labels below the bars. */
+  layout = gtk_widget_create_pango_layout (widget, "0");
+  pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+  g_object_unref (layout);
+
+  plot_height = MAX (widget_height - layout_rect.height, 0);
+  bar_width = (gdouble) widget_width / n_bars;
+
+  gtk_style_context_get_color (context, gtk_widget_get_state_flags (widget),
+                               &color);
+  gdk_cairo_set_source_rgba (cr, &color);
+
+  for (i = first_bar; i <= last_bar; i++)
+    {
+      gdouble bar_height;
+
+      bar_height = plot_height * bar_counts[i] / max_count;
+
+      /* Make sure non-empty bars are always visible. */
+      if (bar_counts[i] > 0)
+        bar_height = MAX (bar_height, 1.0);
+
+      cairo_rectangle (cr, (i - first_bar) * bar_width + 1.0,
+                       plot_height - bar_height,
+                       MAX (bar_width - 2.0, 1.0), bar_height);
+    }
+
+  cairo_fill (cr);
+
+  /* Label the extent of the axis. */
+  min_text = g_strdup_printf ("%" G_GINT64_FORMAT " µs",
+                              dfl_histogram_get_min (histogram));
+  max_text = g_strdup_printf ("%" G_GINT64_FORMAT " µs",
+                              dfl_histogram_get_max (histogram));
+
+  draw_histogram_label (widget, context, cr, 0.0, plot_height, 0.0, min_text);
+  draw_histogram_label (widget, context, cr, widget_width, plot_height, 1.0,
+                        max_text);
+
+  return FALSE;
 }
@@ -35,6 +35,7 @@
 #include <gio/gio.h>
 #include <gtk/gtk.h>
 #include <math.h>
+#include <pango/pangocairo.h>
 #include <string.h>
 
 #include "libdunfell/main-context.h"
@@ -57,6 +58,7 @@ static void dwl_timeline_set_property (GObject      *object,
                                        const GValue *value,
                                        GParamSpec   *pspec);
 static void dwl_timeline_dispose (GObject *object);
+static void dwl_timeline_finalize (GObject *object);
 static void dwl_timeline_realize (GtkWidget *widget);
 static void dwl_timeline_unrealize (GtkWidget *widget);
 static void dwl_timeline_map (GtkWidget *widget);
@@ -65,6 +67,7 @@ static void dwl_timeline_size_allocate (GtkWidget     *widget,
                                         GtkAllocation *allocation);
 static gboolean dwl_timeline_draw (GtkWidget *widget,
                                    cairo_t   *cr);
+static void dwl_timeline_style_updated (GtkWidget *widget);
 static void dwl_timeline_get_preferred_width (GtkWidget *widget,
                                               gint      *minimum_width,
                                               gint      *natural_width);
@@ -83,9 +86,25 @@ static gboolean dwl_timeline_move_selected (DwlTimeline              *timeline,
 
 static void add_default_css (GtkStyleContext *context);
 static void update_cache    (DwlTimeline     *self);
+static DflTimestamp get_changed_timestamp (DwlTimeline *self);
+static void track_model_changes (DwlTimeline *self);
+static gint timestamp_to_y (DwlTimeline  *self,
+                            DflTimestamp  timestamp);
+static void invalidate_tiles (DwlTimeline    *self);
+static void invalidate_tiles_from (DwlTimeline *self,
+                                   guint        first_tile);
+static void cancel_pending_tiles (DwlTimeline *self);
+static void render_tile_cb (gpointer data,
+                            gpointer user_data);
+static guint thread_id_to_index (DwlTimeline *self,
+                                 DflThreadId  thread_id);
+static void model_updated_cb (DflModel *model,
+                              gpointer  user_data);
 
 #define ZOOM_MIN 0.001
 #define ZOOM_MAX 1000.0
+#define TILE_HEIGHT 512 /* pixels */
+#define TILE_MARGIN 20 /* pixels */
 
 typedef enum
 {
@@ -95,6 +114,83 @@ typedef enum
   ELEMENT_TASK,
 } DwlTimelineElement;
 
+typedef struct
+{
+  DflTimestamp timestamp;
+  guint index;  /* into #DwlTimeline.sources or #DwlTimeline.tasks */
+} DwlTimelineColumnEntry;
+
+typedef struct
+{
+  gdouble x, y, width, height;
+  guint shade;  /* 1 to LOD_N_SHADES, lightest first */
+} DwlTimelineDensityBar;
+
+/* The properties of a combination of style classes which are needed to draw
+ * elements without going through the #GtkStyleContext. */
+typedef struct
+{
+  GdkRGBA color;
+  GdkRGBA background_color;
+  GdkRGBA border_color;
+  gint border_width;  /* pixels */
+} DwlTimelineClassStyle;
+
+typedef enum
+{
+  SHAPE_LINE,
+  SHAPE_RECTANGLE,
+  SHAPE_CIRCLE,
+  SHAPE_TEXT,
+} DwlTimelineShapeType;
+
+/* A primitive in a #DwlTimelineDisplayList. Its colours are resolved from the
+ * style context when it is added, so it can be drawn without the widget. */
+typedef struct
+{
+  DwlTimelineShapeType type;
+
+  /* Lines go from (@x, @y) to (@x + @width, @y + @height). Circles are centred
+   * on (@x, @y), with diameter @width. Text is positioned so that the point
+   * (@x_align, @y_align) of its extents, as fractions of its size, is at
+   * (@x, @y). */
+  gdouble x, y, width, height;
+  gdouble x_align, y_align;
+
+  GdkRGBA fill;  /* rectangles, circles and text */
+  GdkRGBA stroke;  /* lines, and borders of rectangles and circles */
+  gdouble line_width;  /* 0 for no border */
+  cairo_line_cap_t line_cap;
+
+  gchar *text;  /* owned; text only */
+  PangoAlignment alignment;  /* text only */
+} DwlTimelineShape;
+
+/* A list of shapes to draw, which does not reference the model or the widget,
+ * so can be rendered in a worker thread. */
+typedef struct
+{
+  GArray/*<DwlTimelineShape>*/ *shapes;  /* owned */
+  PangoFontDescription *font;  /* owned */
+  cairo_font_options_t *font_options;  /* owned; nullable */
+  gdouble resolution;  /* dots per inch */
+} DwlTimelineDisplayList;
+
+/* A tile being rendered by the worker pool. @cancelled is set from the main
+ * thread if the tile is no longer needed, and checked by the worker before it
+ * starts. @surface is set by the worker, and the job is then returned to the
+ * main thread in an idle callback. */
+typedef struct
+{
+  DwlTimeline *timeline;  /* owned */
+  guint tile;
+  gint width;  /* pixels */
+  gint scale_factor;
+  DwlTimelineDisplayList *display_list;  /* owned */
+  cairo_surface_t *surface;  /* owned; nullable */
+  gint cancelled;  /* atomic boolean */
+} DwlTimelineTileJob;
+
 struct _DwlTimeline
 {
   GtkWidget parent;
@@ -115,6 +211,46 @@ struct _DwlTimeline
   DflTimestamp max_timestamp;
   DflDuration duration;
 
+  /* Index of the sources and tasks drawn in each thread’s column, for hit
+   * testing. Element i of each is the column for thread i in @threads, sorted
+   * by timestamp. Since they are indexed by timestamp, they do not depend on
+   * the zoom level; they are extended as the model is updated. */
+  GPtrArray/*<owned GArray<DwlTimelineColumnEntry>>*/ *source_columns;  /* owned */
+  GPtrArray/*<owned GArray<DwlTimelineColumnEntry>>*/ *task_columns;  /* owned */
+  guint n_indexed_sources;
+  guint n_indexed_tasks;
+
+  /* The parts of the model which can change the static layers before the end
+   * of the log, as of the last update, so the next update only invalidates
+   * the tiles it changes: the free timestamp of each thread, the earliest
+   * start of a main context ownership period or dispatch which had not
+   * finished, and the sources (indices into @sources, out of the first
+   * @n_tracked_sources) which had not been attached. */
+  GArray/*<DflTimestamp>*/ *thread_free_timestamps;  /* owned */
+  DflTimestamp first_unfinished_timestamp;
+  GArray/*<guint>*/ *unattached_sources;  /* owned */
+  guint n_tracked_sources;
+
+  /* Cached renderings of the static layers of the timeline, in tiles of
+   * TILE_HEIGHT rows, indexed by tile number. They are rendered by
+   * @tile_pool from display lists built on the main thread, and are
+   * invalidated when the zoom level, width or style change, or from the
+   * earliest point the model changed when it is updated. The invalidated
+   * tiles are kept in @stale_tiles, to be drawn as placeholders until their
+   * replacements are ready. */
+  GHashTable/*<guint, owned cairo_surface_t>*/ *tiles;  /* owned */
+  GHashTable/*<guint, owned cairo_surface_t>*/ *stale_tiles;  /* owned */
+  GHashTable/*<guint, unowned DwlTimelineTileJob>*/ *pending_tiles;  /* owned */
+  GThreadPool *tile_pool;  /* owned */
+  gfloat tiles_zoom;
+  gint tiles_width;
+  gfloat stale_tiles_zoom;
+  gint stale_tiles_width;
+
+  /* Styles resolved from the style context, indexed by space-separated
+   * class names. Cleared when the style changes. */
+  GHashTable/*<owned utf8, owned DwlTimelineClassStyle>*/ *class_styles;  /* owned */
+
   /* Current hover item. */
   struct {
     DwlTimelineElement type;
@@ -147,6 +283,7 @@ dwl_timeline_class_init (DwlTimelineClass *klass)
   object_class->get_property = dwl_timeline_get_property;
   object_class->set_property = dwl_timeline_set_property;
   object_class->dispose = dwl_timeline_dispose;
+  object_class->finalize = dwl_timeline_finalize;
 
   widget_class->realize = dwl_timeline_realize;
   widget_class->unrealize = dwl_timeline_unrealize;
@@ -154,6 +291,7 @@ dwl_timeline_class_init (DwlTimelineClass *klass)
   widget_class->unmap = dwl_timeline_unmap;
   widget_class->size_allocate = dwl_timeline_size_allocate;
   widget_class->draw = dwl_timeline_draw;
+  widget_class->style_updated = dwl_timeline_style_updated;
   widget_class->get_preferred_width = dwl_timeline_get_preferred_width;
   widget_class->get_preferred_height = dwl_timeline_get_preferred_height;
   widget_class->scroll_event = dwl_timeline_scroll_event;
@@ -227,6 +365,24 @@ dwl_timeline_init (DwlTimeline *self)
 {
   self->zoom = 1.0;
 
+  self->source_columns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+  self->task_columns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+  self->thread_free_timestamps = g_array_new (FALSE, FALSE,
+                                              sizeof (DflTimestamp));
+  self->unattached_sources = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->tiles = g_hash_table_new_full (NULL, NULL, NULL,
+                                       (GDestroyNotify) cairo_surface_destroy);
+  self->stale_tiles = g_hash_table_new_full (NULL, NULL, NULL,
+                                             (GDestroyNotify) cairo_surface_destroy);
+  self->pending_tiles = g_hash_table_new (NULL, NULL);
+  self->class_styles = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, g_free);
+
+  /* Tiles are rendered in parallel, using threads shared with the rest of the
+   * process. This cannot fail, as the pool is not exclusive. */
+  self->tile_pool = g_thread_pool_new (render_tile_cb, NULL,
+                                       g_get_num_processors (), FALSE, NULL);
+
   add_default_css (gtk_widget_get_style_context (GTK_WIDGET (self)));
 
   gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
@@ -277,11 +433,26 @@ dwl_timeline_dispose (GObject *object)
 {
   DwlTimeline *self = DWL_TIMELINE (object);
 
+  if (self->model != NULL)
+    g_signal_handlers_disconnect_by_func (self->model, model_updated_cb, self);
+
+  /* Wait for any tiles being rendered. The cancelled jobs are skipped. */
+  if (self->tile_pool != NULL)
+    {
+      cancel_pending_tiles (self);
+      g_thread_pool_free (self->tile_pool, FALSE, TRUE);
+      self->tile_pool = NULL;
+    }
+
   g_clear_object (&self->model);
   g_clear_pointer (&self->sources, g_ptr_array_unref);
   g_clear_pointer (&self->main_contexts, g_ptr_array_unref);
   g_clear_pointer (&self->threads, g_ptr_array_unref);
   g_clear_pointer (&self->tasks, g_ptr_array_unref);
+  g_clear_pointer (&self->source_columns, g_ptr_array_unref);
+  g_clear_pointer (&self->task_columns, g_ptr_array_unref);
+  g_clear_pointer (&self->thread_free_timestamps, g_array_unref);
+  g_clear_pointer (&self->unattached_sources, g_array_unref);
   g_clear_pointer (&self->hover_element.iter, dfl_time_sequence_iter_free);
   g_clear_pointer (&self->selected_element.iter, dfl_time_sequence_iter_free);
 
@@ -289,6 +460,22 @@ dwl_timeline_dispose (GObject *object)
   G_OBJECT_CLASS (dwl_timeline_parent_class)->dispose (object);
 }
 
+static void
+dwl_timeline_finalize (GObject *object)
+{
+  DwlTimeline *self = DWL_TIMELINE (object);
+
+  /* These are freed here rather than in dispose(), as the widget may still be
+   * unrealized or restyled after it has been disposed. */
+  g_hash_table_unref (self->class_styles);
+  g_hash_table_unref (self->pending_tiles);
+  g_hash_table_unref (self->stale_tiles);
+  g_hash_table_unref (self->tiles);
+
+  /* Chain up to the parent class */
+  G_OBJECT_CLASS (dwl_timeline_parent_class)->finalize (object);
+}
+
 /**
  * dwl_timeline_new:
  * @model: (transfer none): TODO
@@ -314,10 +501,50 @@ dwl_timeline_new (DflModel *model)
   timeline->tasks = dfl_model_dup_tasks (model);
 
   update_cache (timeline);
+  track_model_changes (timeline);
+
+  /* The arrays above are shared with the model, so pick up any new elements
+   * and timestamps when it is updated. */
+  g_signal_connect (model, "updated", (GCallback) model_updated_cb, timeline);
 
   return timeline;
 }
 
+static void
+model_updated_cb (DflModel *model,
+                  gpointer  user_data)
+{
+  DwlTimeline *self = DWL_TIMELINE (user_data);
+  DflTimestamp old_min_timestamp, changed_timestamp;
+  guint old_n_threads;
+  gint changed_y;
+
+  old_min_timestamp = self->min_timestamp;
+  old_n_threads = self->thread_free_timestamps->len;
+  changed_timestamp = get_changed_timestamp (self);
+
+  update_cache (self);
+  track_model_changes (self);
+
+  /* New threads change the column layout, and a new earliest timestamp moves
+   * everything, so redraw everything in those cases. Elements a little before
+   * @changed_timestamp may extend into the changed area, so allow a margin. */
+  if (self->threads->len != old_n_threads ||
+      self->min_timestamp != old_min_timestamp)
+    {
+      invalidate_tiles (self);
+    }
+  else if (changed_timestamp != G_MAXUINT64)
+    {
+      changed_y = timestamp_to_y (self, MAX (changed_timestamp,
+                                             self->min_timestamp) -
+                                        self->min_timestamp) - TILE_MARGIN;
+      invalidate_tiles_from (self, MAX (changed_y, 0) / TILE_HEIGHT);
+    }
+
+  gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
 static void
 add_default_css (GtkStyleContext *context)
 {
@@ -340,18 +567,22 @@ add_default_css (GtkStyleContext *context)
                                      "border: 1px solid #2e3436 }\n"
     "timeline.main_context_dispatch_hover { background-color: #729fcf }\n"
     "timeline.main_context_dispatch_selected { background-color: #729fcf }\n"
+    "timeline.main_context_dispatch_density { color: #3465a4 }\n"
     "timeline.source { background-color: #c17d11 }\n"
     "timeline.source_hover { background-color: #e9b96e }\n"
     "timeline.source_selected { background-color: #73d216 }\n"
     "timeline.source_unattached { background-color: #cc0000 }\n"
+    "timeline.source_density { color: #c17d11 }\n"
     "timeline.source_dispatch { background-color: #73d216; "
                               " border: 1px solid #2e3436 }\n"
     "timeline.source_dispatch_line { color: #555753 }\n"
     "timeline.task_new { background-color: #edd400 }\n"
     "timeline.task_new_hover { background-color: #fce94f }\n"
     "timeline.task_new_selected { background-color: #73d216 }\n"
+    "timeline.task_new_density { color: #edd400 }\n"
     "timeline.task_return_line { color: #555753 }\n"
-    "timeline.task_propagate_line { color: #555753 }\n";
+    "timeline.task_propagate_line { color: #555753 }\n"
+    "timeline.tile_placeholder { background-color: rgba(186, 189, 182, 0.2) }\n";
 
   provider = gtk_css_provider_new ();
   gtk_css_provider_load_from_data (provider, css, -1, &error);
@@ -384,6 +615,92 @@ add_default_css (GtkStyleContext *context)
 #define LEFT_GUTTER_WIDTH 70 /* pixels */
 #define LEFT_GUTTER_RIGHT_PADDING 5 /* pixels */
 #define AUTO_SCROLL_MARGIN 0.1 /* × viewport height */
+#define LOD_MIN_ELEMENT_SPACING 4 /* pixels */
+#define LOD_BUCKET_HEIGHT 2 /* pixels */
+#define LOD_N_SHADES 4
+
+/* Add an element to the column for @thread_index in @columns, keeping it
+ * sorted by timestamp. */
+static void
+column_add (GPtrArray    *columns,
+            guint         thread_index,
+            DflTimestamp  timestamp,
+            guint         index)
+{
+  GArray *column;
+  DwlTimelineColumnEntry entry = { timestamp, index };
+  guint i;
+
+  while (columns->len <= thread_index)
+    g_ptr_array_add (columns,
+                     g_array_new (FALSE, FALSE,
+                                  sizeof (DwlTimelineColumnEntry)));
+
+  column = columns->pdata[thread_index];
+
+  /* Elements are created in timestamp order, so this is almost always an
+   * append. */
+  for (i = column->len;
+       i > 0 &&
+       g_array_index (column, DwlTimelineColumnEntry, i - 1).timestamp > timestamp;
+       i--)
+    ;
+
+  g_array_insert_val (column, i, entry);
+}
+
+/* Find the index of the first element in @column, between @first and @last,
+ * whose timestamp is at least @timestamp. */
+static guint
+column_lower_bound (GArray       *column,
+                    DflTimestamp  timestamp,
+                    guint         first,
+                    guint         last)
+{
+  while (first < last)
+    {
+      guint mid = first + (last - first) / 2;
+
+      if (g_array_index (column, DwlTimelineColumnEntry, mid).timestamp <
+          timestamp)
+        first = mid + 1;
+      else
+        last = mid;
+    }
+
+  return first;
+}
+
+/* Add any sources and tasks which are new since the last update to the
+ * columns used for hit testing. */
+static void
+update_columns (DwlTimeline *self)
+{
+  guint i;
+
+  for (i = self->n_indexed_sources; i < self->sources->len; i++)
+    {
+      DflSource *source = self->sources->pdata[i];
+
+      column_add (self->source_columns,
+                  thread_id_to_index (self,
+                                      dfl_source_get_new_thread_id (source)),
+                  dfl_source_get_new_timestamp (source), i);
+    }
+
+  self->n_indexed_sources = self->sources->len;
+
+  for (i = self->n_indexed_tasks; i < self->tasks->len; i++)
+    {
+      DflTask *task = self->tasks->pdata[i];
+
+      column_add (self->task_columns,
+                  thread_id_to_index (self, dfl_task_get_new_thread_id (task)),
+                  dfl_task_get_new_timestamp (task), i);
+    }
+
+  self->n_indexed_tasks = self->tasks->len;
+}
 
 /* Calculate various values from the data model we have (the threads, main
  * contexts and sources). The calculated values will be used frequently when
@@ -413,6 +730,144 @@ update_cache (DwlTimeline *self)
   self->min_timestamp = min_timestamp;
   self->max_timestamp = max_timestamp;
   self->duration = max_timestamp - min_timestamp;
+
+  update_columns (self);
+}
+
+/* Get the start of the last thread ownership period or dispatch of
+ * @main_context, whichever is earlier, if it has not finished yet; otherwise
+ * return %G_MAXUINT64. Only the last of each can be unfinished. */
+static DflTimestamp
+main_context_get_unfinished_timestamp (DflMainContext *main_context)
+{
+  DflTimeSequenceIter iter;
+  DflTimestamp timestamp, unfinished_timestamp = G_MAXUINT64;
+  DflThreadOwnershipData *ownership_data;
+  DflMainContextDispatchData *dispatch_data;
+
+  /* Each iterator starts at the elements with the last timestamp. */
+  dfl_main_context_thread_ownership_iter (main_context, &iter, G_MAXUINT64);
+
+  while (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                      (gpointer *) &ownership_data))
+    {
+      if (ownership_data->duration < 0)
+        unfinished_timestamp = MIN (unfinished_timestamp, timestamp);
+    }
+
+  dfl_main_context_dispatch_iter (main_context, &iter, G_MAXUINT64);
+
+  while (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                      (gpointer *) &dispatch_data))
+    {
+      if (dispatch_data->duration < 0)
+        unfinished_timestamp = MIN (unfinished_timestamp, timestamp);
+    }
+
+  return unfinished_timestamp;
+}
+
+/* Get the earliest timestamp at which the static layers may differ from how
+ * they were drawn before the model was last updated, using the state saved by
+ * track_model_changes(); or %G_MAXUINT64 if nothing has changed. This must be
+ * called before update_cache(). New elements are only added at the end of the
+ * log, so this is normally close to its end. */
+static DflTimestamp
+get_changed_timestamp (DwlTimeline *self)
+{
+  DflTimestamp changed_timestamp = G_MAXUINT64;
+  guint i;
+
+  /* Every event extends the lifetime of its thread, so if no thread has
+   * changed, nothing else has. The thread lines, and the guide lines and
+   * density summaries at the end of the log, change from there on. */
+  for (i = 0; i < self->thread_free_timestamps->len; i++)
+    {
+      DflTimestamp old_free_timestamp;
+
+      old_free_timestamp = g_array_index (self->thread_free_timestamps,
+                                          DflTimestamp, i);
+
+      if (dfl_thread_get_free_timestamp (self->threads->pdata[i]) !=
+          old_free_timestamp)
+        changed_timestamp = MIN (changed_timestamp, old_free_timestamp);
+    }
+
+  if (changed_timestamp == G_MAXUINT64 &&
+      self->threads->len == self->thread_free_timestamps->len)
+    return G_MAXUINT64;
+
+  /* Elements which had not finished get longer. */
+  changed_timestamp = MIN (changed_timestamp,
+                           self->first_unfinished_timestamp);
+
+  /* Sources are drawn differently once they are attached. */
+  for (i = 0; i < self->unattached_sources->len; i++)
+    {
+      DflSource *source;
+
+      source = self->sources->pdata[g_array_index (self->unattached_sources,
+                                                   guint, i)];
+
+      if (dfl_source_get_attach_main_context_id (source) != DFL_ID_INVALID)
+        changed_timestamp = MIN (changed_timestamp,
+                                 dfl_source_get_new_timestamp (source));
+    }
+
+  /* New sources and tasks, in case the log is not quite in order. */
+  for (i = self->n_indexed_sources; i < self->sources->len; i++)
+    changed_timestamp = MIN (changed_timestamp,
+                             dfl_source_get_new_timestamp (self->sources->pdata[i]));
+
+  for (i = self->n_indexed_tasks; i < self->tasks->len; i++)
+    changed_timestamp = MIN (changed_timestamp,
+                             dfl_task_get_new_timestamp (self->tasks->pdata[i]));
+
+  return changed_timestamp;
+}
+
+/* Save the parts of the model which get_changed_timestamp() compares against
+ * after the next update. This is linear in the number of threads and main
+ * contexts, and in the number of sources which are new or not attached. */
+static void
+track_model_changes (DwlTimeline *self)
+{
+  guint i, j;
+
+  g_array_set_size (self->thread_free_timestamps, self->threads->len);
+
+  for (i = 0; i < self->threads->len; i++)
+    g_array_index (self->thread_free_timestamps, DflTimestamp, i) =
+      dfl_thread_get_free_timestamp (self->threads->pdata[i]);
+
+  self->first_unfinished_timestamp = G_MAXUINT64;
+
+  for (i = 0; i < self->main_contexts->len; i++)
+    self->first_unfinished_timestamp =
+      MIN (self->first_unfinished_timestamp,
+           main_context_get_unfinished_timestamp (self->main_contexts->pdata[i]));
+
+  /* Drop the sources which have been attached since, and add the new ones
+   * which are not. */
+  for (i = 0, j = 0; i < self->unattached_sources->len; i++)
+    {
+      guint index = g_array_index (self->unattached_sources, guint, i);
+
+      if (dfl_source_get_attach_main_context_id (self->sources->pdata[index]) ==
+          DFL_ID_INVALID)
+        g_array_index (self->unattached_sources, guint, j++) = index;
+    }
+
+  g_array_set_size (self->unattached_sources, j);
+
+  for (i = self->n_tracked_sources; i < self->sources->len; i++)
+    {
+      if (dfl_source_get_attach_main_context_id (self->sources->pdata[i]) ==
+          DFL_ID_INVALID)
+        g_array_append_val (self->unattached_sources, i);
+    }
+
+  self->n_tracked_sources = self->sources->len;
 }
 
 static gint
@@ -499,6 +954,9 @@ dwl_timeline_unrealize (GtkWidget *widget)
       self->event_window = NULL;
     }
 
+  /* The widget may be realized again with a different scale factor. */
+  invalidate_tiles (self);
+
   GTK_WIDGET_CLASS (dwl_timeline_parent_class)->unrealize (widget);
 }
 
@@ -530,6 +988,9 @@ dwl_timeline_size_allocate (GtkWidget     *widget,
 {
   DwlTimeline *self = DWL_TIMELINE (widget);
 
+  if (allocation->width != gtk_widget_get_allocated_width (widget))
+    invalidate_tiles (self);
+
   gtk_widget_set_allocation (widget, allocation);
 
   if (gtk_widget_get_realized (widget))
@@ -544,17 +1005,13 @@ static guint
 thread_id_to_index (DwlTimeline *self,
                     DflThreadId  thread_id)
 {
-  guint thread_index, n_threads;
-
-  n_threads = self->threads->len;
+  guint thread_index;
+  gboolean found;
 
-  /* TODO: This should not be so slow. */
-  for (thread_index = 0; thread_index < n_threads; thread_index++)
-    {
-      if (dfl_thread_get_id (self->threads->pdata[thread_index]) == thread_id)
-        break;
-    }
-  g_assert (thread_index < n_threads);
+  /* @self->threads is shared with the model, so the model’s index into it can
+   * be used directly. */
+  found = dfl_model_find_thread (self->model, thread_id, &thread_index);
+  g_assert (found);
 
   return thread_index;
 }
@@ -849,153 +1306,729 @@ draw_source_selected (DwlTimeline *self,
     }
 }
 
-static void
-draw_task_circle (DwlTimeline *self,
-                  cairo_t     *cr,
-                  DflTask     *task,
-                  gboolean     hovering,
-                  gboolean     selected)
+/* Get the style for the space-separated list of style classes in
+ * @class_names, applied on top of the widget’s own style. This is cached until
+ * the style changes, as looking it up is expensive. Only the properties which
+ * are needed to draw the timeline’s elements are resolved: theme features
+ * such as background images are not supported. */
+static const DwlTimelineClassStyle *
+get_class_style (DwlTimeline *self,
+                 const gchar *class_names)
 {
-  gdouble thread_centre, task_x, task_y;
-  guint thread_index;
-  GdkRGBA color;
+  GtkWidget *widget = GTK_WIDGET (self);
   GtkStyleContext *context;
-  DflTimestamp min_timestamp;
-
-  /* New task circle. */
-  min_timestamp = self->min_timestamp;
-  context = gtk_widget_get_style_context (GTK_WIDGET (self));
+  GtkStateFlags state;
+  DwlTimelineClassStyle *style;
+  g_auto (GStrv) classes = NULL;
+  GdkRGBA *background_color = NULL, *border_color = NULL;
+  GtkBorder border;
+  guint i;
 
-  thread_index = thread_id_to_index (self,
-                                     dfl_task_get_new_thread_id (task));
-  thread_centre = thread_index_to_centre (self, thread_index);
+  style = g_hash_table_lookup (self->class_styles, class_names);
 
-  gtk_style_context_add_class (context, "task_new");
+  if (style != NULL)
+    return style;
 
-  if (hovering)
-    gtk_style_context_add_class (context, "task_new_hover");
-  if (selected)
-    gtk_style_context_add_class (context, "task_new_selected");
+  context = gtk_widget_get_style_context (widget);
+  state = gtk_widget_get_state_flags (widget);
+  classes = g_strsplit (class_names, " ", -1);
 
-  cairo_save (cr);
+  for (i = 0; classes[i] != NULL; i++)
+    gtk_style_context_add_class (context, classes[i]);
 
-  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
-  cairo_set_line_width (cr, TASK_BORDER_WIDTH);
-  cairo_new_path (cr);
+  style = g_new0 (DwlTimelineClassStyle, 1);
 
-  task_x = thread_centre + TASK_OFFSET;
-  task_y = timestamp_to_y (self, dfl_task_get_new_timestamp (task) - min_timestamp);
+  gtk_style_context_get_color (context, state, &style->color);
+  gtk_style_context_get (context, state,
+                         GTK_STYLE_PROPERTY_BACKGROUND_COLOR, &background_color,
+                         GTK_STYLE_PROPERTY_BORDER_COLOR, &border_color,
+                         NULL);
+  gtk_style_context_get_border (context, state, &border);
 
-  cairo_arc (cr,
-             task_x,
-             task_y,
-             TASK_WIDTH / 2.0,
-             0.0, 2 * M_PI);
+  style->background_color = *background_color;
+  style->border_color = *border_color;
+  style->border_width = border.top;
 
-  cairo_clip_preserve (cr);
-  gtk_render_background (context, cr,
-                         task_x - TASK_WIDTH / 2.0,
-                         task_y - TASK_WIDTH / 2.0,
-                         TASK_WIDTH,
-                         TASK_WIDTH);
+  gdk_rgba_free (border_color);
+  gdk_rgba_free (background_color);
 
-  gtk_style_context_get_color (context,
-                               gtk_widget_get_state_flags (GTK_WIDGET (self)),
-                               &color);
-  gdk_cairo_set_source_rgba (cr, &color);
-  cairo_stroke (cr);
+  for (i = 0; classes[i] != NULL; i++)
+    gtk_style_context_remove_class (context, classes[i]);
 
-  cairo_restore (cr);
+  g_hash_table_insert (self->class_styles, g_strdup (class_names), style);
 
-  if (selected)
-    gtk_style_context_remove_class (context, "task_new_selected");
-  if (hovering)
-    gtk_style_context_remove_class (context, "task_new_hover");
+  return style;
+}
 
-  gtk_style_context_remove_class (context, "task_new");
+static void
+shape_clear (DwlTimelineShape *shape)
+{
+  g_clear_pointer (&shape->text, g_free);
+}
 
-  /* Plonk labels next to it for its source tag and callback. */
-  if (selected && dfl_task_get_source_tag_name (task) != NULL)
-    {
-      PangoLayout *layout = NULL;
-      PangoRectangle layout_rect;
+/* Create an empty display list, using the widget’s font settings for any
+ * text added to it. */
+static DwlTimelineDisplayList *
+display_list_new (DwlTimeline *self)
+{
+  DwlTimelineDisplayList *display_list = NULL;
+  PangoContext *pango_context;
+  const cairo_font_options_t *font_options;
+
+  pango_context = gtk_widget_get_pango_context (GTK_WIDGET (self));
+  font_options = pango_cairo_context_get_font_options (pango_context);
+
+  display_list = g_new0 (DwlTimelineDisplayList, 1);
+  display_list->shapes = g_array_new (FALSE, TRUE, sizeof (DwlTimelineShape));
+  g_array_set_clear_func (display_list->shapes, (GDestroyNotify) shape_clear);
+  display_list->font = pango_font_description_copy (pango_context_get_font_description (pango_context));
+  display_list->font_options = (font_options != NULL) ?
+                               cairo_font_options_copy (font_options) : NULL;
+  display_list->resolution = pango_cairo_context_get_resolution (pango_context);
+
+  return display_list;
+}
 
-      gtk_style_context_add_class (context, "task_source_tag");
+static void
+display_list_free (DwlTimelineDisplayList *display_list)
+{
+  g_clear_pointer (&display_list->font_options, cairo_font_options_destroy);
+  pango_font_description_free (display_list->font);
+  g_array_unref (display_list->shapes);
+  g_free (display_list);
+}
 
-      layout = gtk_widget_create_pango_layout (GTK_WIDGET (self),
-                                               dfl_task_get_source_tag_name (task));
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (DwlTimelineDisplayList, display_list_free)
 
-      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+/* Add a line of width @line_width from (@x1, @y1) to (@x2, @y2). */
+static void
+display_list_add_line (DwlTimelineDisplayList *display_list,
+                       gdouble                 x1,
+                       gdouble                 y1,
+                       gdouble                 x2,
+                       gdouble                 y2,
+                       const GdkRGBA          *color,
+                       gdouble                 line_width,
+                       cairo_line_cap_t        line_cap)
+{
+  DwlTimelineShape shape = { SHAPE_LINE, };
 
-      gtk_render_layout (context, cr,
-                         task_x + TASK_SOURCE_TAG_OFFSET,
-                         task_y - layout_rect.height / 2.0,
-                         layout);
-      g_object_unref (layout);
+  shape.x = x1;
+  shape.y = y1;
+  shape.width = x2 - x1;
+  shape.height = y2 - y1;
+  shape.stroke = *color;
+  shape.line_width = line_width;
+  shape.line_cap = line_cap;
 
-      gtk_style_context_remove_class (context, "task_source_tag");
-    }
+  g_array_append_val (display_list->shapes, shape);
+}
 
-  if (selected && dfl_task_get_callback_name (task) != NULL)
-    {
-      PangoLayout *layout = NULL;
-      PangoRectangle layout_rect;
-      gdouble task_return_x, task_return_y;
-      gdouble return_thread_centre;
-      guint return_thread_index;
+/* Add a rectangle filled with @fill, with an inset border of width
+ * @border_width in @border_color if @border_width is non-zero. */
+static void
+display_list_add_rectangle (DwlTimelineDisplayList *display_list,
+                            gdouble                 x,
+                            gdouble                 y,
+                            gdouble                 width,
+                            gdouble                 height,
+                            const GdkRGBA          *fill,
+                            const GdkRGBA          *border_color,
+                            gdouble                 border_width)
+{
+  DwlTimelineShape shape = { SHAPE_RECTANGLE, };
 
-      gtk_style_context_add_class (context, "task_callback");
+  shape.x = x;
+  shape.y = y;
+  shape.width = width;
+  shape.height = height;
+  shape.fill = *fill;
+  shape.stroke = *border_color;
+  shape.line_width = border_width;
 
-      layout = gtk_widget_create_pango_layout (GTK_WIDGET (self),
-                                               dfl_task_get_callback_name (task));
+  g_array_append_val (display_list->shapes, shape);
+}
 
-      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+/* Add a circle of diameter @width, centred on (@x, @y), filled with @fill and
+ * with an inset border of width @border_width in @border_color. */
+static void
+display_list_add_circle (DwlTimelineDisplayList *display_list,
+                         gdouble                 x,
+                         gdouble                 y,
+                         gdouble                 width,
+                         const GdkRGBA          *fill,
+                         const GdkRGBA          *border_color,
+                         gdouble                 border_width)
+{
+  DwlTimelineShape shape = { SHAPE_CIRCLE, };
+
+  shape.x = x;
+  shape.y = y;
+  shape.width = width;
+  shape.height = width;
+  shape.fill = *fill;
+  shape.stroke = *border_color;
+  shape.line_width = border_width;
+  shape.line_cap = CAIRO_LINE_CAP_BUTT;
+
+  g_array_append_val (display_list->shapes, shape);
+}
 
-      /* Work out the label position. If the task has returned, put the label
-       * next to the return timestamp. If it hasn't, put it by the
-       * g_task_new(). */
-      if (dfl_task_get_return_thread_id (task) != 0)
-        {
-          return_thread_index = thread_id_to_index (self,
-                                                    dfl_task_get_return_thread_id (task));
-          return_thread_centre = thread_index_to_centre (self,
-                                                         return_thread_index);
+/* Add @text, aligned so that the point (@x_align, @y_align) of its logical
+ * extents is at (@x, @y). */
+static void
+display_list_add_text (DwlTimelineDisplayList *display_list,
+                       gdouble                 x,
+                       gdouble                 y,
+                       gdouble                 x_align,
+                       gdouble                 y_align,
+                       const gchar            *text,
+                       PangoAlignment          alignment,
+                       const GdkRGBA          *color)
+{
+  DwlTimelineShape shape = { SHAPE_TEXT, };
 
-          task_return_x = return_thread_centre + TASK_OFFSET;
-          task_return_y = timestamp_to_y (self, dfl_task_get_return_timestamp (task) - min_timestamp);
-        }
-      else
-        {
-          task_return_x = task_x;
-          task_return_y = task_y + layout_rect.height;
-        }
+  shape.x = x;
+  shape.y = y;
+  shape.x_align = x_align;
+  shape.y_align = y_align;
+  shape.text = g_strdup (text);
+  shape.alignment = alignment;
+  shape.fill = *color;
 
-      gtk_render_layout (context, cr,
-                         task_return_x + TASK_CALLBACK_OFFSET,
-                         task_return_y - layout_rect.height / 2.0,
-                         layout);
-      g_object_unref (layout);
+  g_array_append_val (display_list->shapes, shape);
+}
 
-      gtk_style_context_remove_class (context, "task_callback");
+/* Whether @b can be added to the same cairo path as @a and drawn in the same
+ * operation. This is the case for runs of unbordered rectangles and of lines,
+ * such as density bars and main context ownership. */
+static gboolean
+shapes_can_batch (const DwlTimelineShape *a,
+                  const DwlTimelineShape *b)
+{
+  switch (a->type)
+    {
+    case SHAPE_LINE:
+      return (b->type == SHAPE_LINE &&
+              a->line_width == b->line_width &&
+              a->line_cap == b->line_cap &&
+              gdk_rgba_equal (&a->stroke, &b->stroke));
+    case SHAPE_RECTANGLE:
+      return (b->type == SHAPE_RECTANGLE &&
+              a->line_width == 0.0 && b->line_width == 0.0 &&
+              gdk_rgba_equal (&a->fill, &b->fill));
+    case SHAPE_CIRCLE:
+    case SHAPE_TEXT:
+      return FALSE;
+    default:
+      g_assert_not_reached ();
     }
 }
 
 static void
-draw_task_return_propagate_lines (DwlTimeline *self,
-                                  cairo_t     *cr,
-                                  DflTask     *task)
+set_source_color (cairo_t       *cr,
+                  const GdkRGBA *color)
 {
-  gdouble thread_centre;
-  guint thread_index;
-  GtkStyleContext *context;
-  DflTimestamp min_timestamp;
-  gdouble task_x, task_y;
+  cairo_set_source_rgba (cr, color->red, color->green, color->blue,
+                         color->alpha);
+}
 
-  context = gtk_widget_get_style_context (GTK_WIDGET (self));
-  min_timestamp = self->min_timestamp;
+/* Draw the shapes in @display_list to @cr, in order. This only uses cairo and
+ * pango, so is safe to call from a worker thread. */
+static void
+draw_display_list (cairo_t                *cr,
+                   DwlTimelineDisplayList *display_list)
+{
+  PangoLayout *layout = NULL;
+  guint i;
 
-  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
-  cairo_set_line_width (cr, SOURCE_ATTACH_DESTROY_WIDTH);
+  cairo_save (cr);
+  cairo_new_path (cr);
+
+  for (i = 0; i < display_list->shapes->len; i++)
+    {
+      const DwlTimelineShape *shape, *next_shape;
+
+      shape = &g_array_index (display_list->shapes, DwlTimelineShape, i);
+      next_shape = (i + 1 < display_list->shapes->len) ?
+                   &g_array_index (display_list->shapes, DwlTimelineShape,
+                                   i + 1) : NULL;
+
+      switch (shape->type)
+        {
+        case SHAPE_LINE:
+          cairo_move_to (cr, shape->x, shape->y);
+          cairo_rel_line_to (cr, shape->width, shape->height);
+
+          if (next_shape != NULL && shapes_can_batch (shape, next_shape))
+            break;
+
+          cairo_set_line_width (cr, shape->line_width);
+          cairo_set_line_cap (cr, shape->line_cap);
+          set_source_color (cr, &shape->stroke);
+          cairo_stroke (cr);
+          break;
+        case SHAPE_RECTANGLE:
+          cairo_rectangle (cr, shape->x, shape->y, shape->width,
+                           shape->height);
+
+          if (next_shape != NULL && shapes_can_batch (shape, next_shape))
+            break;
+
+          set_source_color (cr, &shape->fill);
+          cairo_fill (cr);
+
+          if (shape->line_width > 0.0)
+            {
+              cairo_rectangle (cr,
+                               shape->x + shape->line_width / 2.0,
+                               shape->y + shape->line_width / 2.0,
+                               MAX (shape->width - shape->line_width, 0.0),
+                               MAX (shape->height - shape->line_width, 0.0));
+              cairo_set_line_width (cr, shape->line_width);
+              set_source_color (cr, &shape->stroke);
+              cairo_stroke (cr);
+            }
+          break;
+        case SHAPE_CIRCLE:
+          /* Clip to the circle so only the inside half of the border is
+           * drawn. */
+          cairo_save (cr);
+          cairo_arc (cr, shape->x, shape->y, shape->width / 2.0,
+                     0.0, 2 * M_PI);
+          cairo_clip_preserve (cr);
+          set_source_color (cr, &shape->fill);
+          cairo_fill_preserve (cr);
+          cairo_set_line_width (cr, shape->line_width);
+          cairo_set_line_cap (cr, shape->line_cap);
+          set_source_color (cr, &shape->stroke);
+          cairo_stroke (cr);
+          cairo_restore (cr);
+          break;
+        case SHAPE_TEXT:
+          {
+            PangoRectangle layout_rect;
+
+            if (layout == NULL)
+              {
+                PangoContext *pango_context;
+
+                layout = pango_cairo_create_layout (cr);
+                pango_context = pango_layout_get_context (layout);
+                pango_cairo_context_set_resolution (pango_context,
+                                                    display_list->resolution);
+                pango_cairo_context_set_font_options (pango_context,
+                                                      display_list->font_options);
+                pango_layout_context_changed (layout);
+                pango_layout_set_font_description (layout,
+                                                   display_list->font);
+              }
+
+            pango_layout_set_text (layout, shape->text, -1);
+            pango_layout_set_alignment (layout, shape->alignment);
+            pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+
+            cairo_move_to (cr,
+                           shape->x - shape->x_align * layout_rect.width,
+                           shape->y - shape->y_align * layout_rect.height);
+            set_source_color (cr, &shape->fill);
+            pango_cairo_show_layout (cr, layout);
+            cairo_new_path (cr);
+            break;
+          }
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  g_clear_object (&layout);
+  cairo_restore (cr);
+}
+
+static void
+add_main_context_dispatch (DwlTimeline                *self,
+                           DwlTimelineDisplayList     *display_list,
+                           DflTimestamp                timestamp,
+                           DflMainContextDispatchData *data,
+                           gboolean                    hovering,
+                           gboolean                    selected)
+{
+  gdouble thread_centre, dispatch_width, dispatch_height;
+  gint timestamp_y;
+  guint thread_index;
+  const DwlTimelineClassStyle *style;
+  const gchar *class_names;
+
+  thread_index = thread_id_to_index (self, data->thread_id);
+  thread_centre = thread_index_to_centre (self, thread_index);
+  timestamp_y = timestamp_to_y (self, timestamp - self->min_timestamp);
+
+  dispatch_width = MAIN_CONTEXT_DISPATCH_WIDTH;
+  dispatch_height = duration_to_pixels (self, data->duration);
+
+  if (hovering && selected)
+    class_names = "main_context_dispatch main_context_dispatch_hover "
+                  "main_context_dispatch_selected";
+  else if (hovering)
+    class_names = "main_context_dispatch main_context_dispatch_hover";
+  else if (selected)
+    class_names = "main_context_dispatch main_context_dispatch_selected";
+  else
+    class_names = "main_context_dispatch";
+
+  style = get_class_style (self, class_names);
+
+  display_list_add_rectangle (display_list,
+                              thread_centre - dispatch_width / 2.0,
+                              timestamp_y,
+                              dispatch_width,
+                              dispatch_height,
+                              &style->background_color,
+                              &style->border_color,
+                              style->border_width);
+}
+
+/* Add each of @bars as a rectangle in the colour of the style class
+ * @class_name, with an opacity according to its shade. The bars are added in
+ * order of shade, so they are batched into one path per shade when drawn. */
+static void
+add_density_bars (DwlTimeline            *self,
+                  DwlTimelineDisplayList *display_list,
+                  GArray                 *bars,
+                  const gchar            *class_name)
+{
+  const DwlTimelineClassStyle *style;
+  guint shade, i;
+
+  style = get_class_style (self, class_name);
+
+  for (shade = 1; shade <= LOD_N_SHADES; shade++)
+    {
+      GdkRGBA color = style->color;
+
+      color.alpha *= (gdouble) shade / LOD_N_SHADES;
+
+      for (i = 0; i < bars->len; i++)
+        {
+          const DwlTimelineDensityBar *bar;
+
+          bar = &g_array_index (bars, DwlTimelineDensityBar, i);
+
+          if (bar->shade == shade)
+            display_list_add_rectangle (display_list, bar->x, bar->y,
+                                        bar->width, bar->height, &color,
+                                        &color, 0.0);
+        }
+    }
+}
+
+/* A function returning summaries of one of the time sequences of
+ * @main_context, such as dfl_main_context_dup_dispatch_summary(). */
+typedef GArray *(*DwlTimelineSummaryFunc) (DflMainContext *main_context,
+                                           DflTimestamp    start,
+                                           DflTimestamp    end,
+                                           DflDuration     resolution);
+
+/* If the elements of @main_context returned by @dup_summary between @start and
+ * @end are too dense to draw individually, add them to @display_list as
+ * density bars @bar_width wide in the style class @class_name, and return
+ * %TRUE; otherwise return %FALSE. Each bar summarises a few pixels’ worth of
+ * elements, in the column of the thread which was busiest, and is shaded by
+ * the proportion of its time covered by them. The summaries are precalculated
+ * by the main context, so this takes time proportional to the number of
+ * bars. */
+static gboolean
+add_main_context_density (DwlTimeline            *self,
+                          DwlTimelineDisplayList *display_list,
+                          DflMainContext         *main_context,
+                          DwlTimelineSummaryFunc  dup_summary,
+                          gdouble                 bar_width,
+                          const gchar            *class_name,
+                          DflTimestamp            start,
+                          DflTimestamp            end)
+{
+  g_autoptr (GArray) summaries = NULL;
+  g_autoptr (GArray) bars = NULL;
+  guint i, n_elements;
+  gint visible_height;
+
+  /* Estimate the number of visible elements using a coarse summary, which is
+   * cheap to get, before getting one at the resolution of the bars. */
+  visible_height = duration_to_pixels (self, end - start);
+  summaries = dup_summary (main_context, start, end,
+                           MAX ((end - start) / 16, 1));
+
+  for (i = 0, n_elements = 0; i < summaries->len; i++)
+    n_elements += g_array_index (summaries, DflTimeSequenceSummary,
+                                 i).n_elements;
+
+  if (n_elements == 0 ||
+      visible_height / n_elements >= LOD_MIN_ELEMENT_SPACING)
+    return FALSE;
+
+  g_clear_pointer (&summaries, g_array_unref);
+  summaries = dup_summary (main_context, start, end,
+                           MAX (pixels_to_duration (self, LOD_BUCKET_HEIGHT), 1));
+  bars = g_array_sized_new (FALSE, FALSE, sizeof (DwlTimelineDensityBar),
+                            summaries->len);
+
+  for (i = 0; i < summaries->len; i++)
+    {
+      const DflTimeSequenceSummary *summary;
+      DwlTimelineDensityBar bar;
+      DflTimestamp bucket_start;
+      gdouble busy_fraction;
+
+      summary = &g_array_index (summaries, DflTimeSequenceSummary, i);
+
+      if (summary->dominant_thread_id == 0)
+        continue;
+
+      /* The first bucket may start before the log. */
+      bucket_start = MAX (summary->start, self->min_timestamp);
+      busy_fraction = CLAMP ((gdouble) summary->busy_time / summary->duration,
+                             0.0, 1.0);
+
+      bar.x = thread_index_to_centre (self,
+                                      thread_id_to_index (self,
+                                                          summary->dominant_thread_id)) -
+              bar_width / 2.0;
+      bar.y = timestamp_to_y (self, bucket_start - self->min_timestamp);
+      bar.width = bar_width;
+      bar.height = MAX (duration_to_pixels (self, summary->duration), 1);
+      bar.shade = 1 + (guint) (busy_fraction * (LOD_N_SHADES - 1) + 0.5);
+
+      g_array_append_val (bars, bar);
+    }
+
+  add_density_bars (self, display_list, bars, class_name);
+
+  return TRUE;
+}
+
+static void
+add_source_circle (DwlTimeline            *self,
+                   DwlTimelineDisplayList *display_list,
+                   DflSource              *source,
+                   gboolean                hovering,
+                   gboolean                selected)
+{
+  gdouble thread_centre, source_x, source_y;
+  guint thread_index;
+  const DwlTimelineClassStyle *style;
+  g_autofree gchar *class_names = NULL;
+  gboolean unattached;
+
+  unattached = (dfl_source_get_attach_main_context_id (source) ==
+                DFL_ID_INVALID);
+
+  thread_index = thread_id_to_index (self,
+                                     dfl_source_get_new_thread_id (source));
+  thread_centre = thread_index_to_centre (self, thread_index);
+
+  /* Source circle. */
+  class_names = g_strconcat ("source",
+                             hovering ? " source_hover" : "",
+                             selected ? " source_selected" : "",
+                             unattached ? " source_unattached" : "",
+                             NULL);
+  style = get_class_style (self, class_names);
+
+  /* Calculate the centre of the source. */
+  source_x = thread_centre - SOURCE_OFFSET;
+  source_y = timestamp_to_y (self, dfl_source_get_new_timestamp (source) -
+                                   self->min_timestamp);
+
+  display_list_add_circle (display_list, source_x, source_y, SOURCE_WIDTH,
+                           &style->background_color, &style->color,
+                           SOURCE_BORDER_WIDTH);
+}
+
+/* Add the density of elements @first to @last of @column, as bars @bar_width
+ * wide centred on @bar_centre in the style class @class_name. Each bar covers
+ * a few pixels, and is shaded by the number of elements in it. Finding each
+ * bar is a binary search, so this takes time proportional to the number of
+ * bars, not elements. */
+static void
+add_column_density (DwlTimeline            *self,
+                    DwlTimelineDisplayList *display_list,
+                    GArray                 *column,
+                    guint                   first,
+                    guint                   last,
+                    gdouble                 bar_centre,
+                    gdouble                 bar_width,
+                    const gchar            *class_name)
+{
+  g_autoptr (GArray) bars = NULL;
+  DflDuration bucket_duration;
+  guint i, next;
+
+  bucket_duration = MAX (pixels_to_duration (self, LOD_BUCKET_HEIGHT), 1);
+  bars = g_array_new (FALSE, FALSE, sizeof (DwlTimelineDensityBar));
+
+  for (i = first; i < last; i = next)
+    {
+      DflTimestamp timestamp, bucket_start;
+      DwlTimelineDensityBar bar;
+
+      timestamp = g_array_index (column, DwlTimelineColumnEntry, i).timestamp;
+      bucket_start = timestamp -
+                     (timestamp - self->min_timestamp) % bucket_duration;
+      next = column_lower_bound (column, bucket_start + bucket_duration,
+                                 i + 1, last);
+
+      bar.x = bar_centre - bar_width / 2.0;
+      bar.y = timestamp_to_y (self, bucket_start - self->min_timestamp);
+      bar.width = bar_width;
+      bar.height = MAX (duration_to_pixels (self, bucket_duration), 1);
+      bar.shade = MIN (next - i, LOD_N_SHADES);
+
+      g_array_append_val (bars, bar);
+    }
+
+  add_density_bars (self, display_list, bars, class_name);
+}
+
+static void
+add_task_circle (DwlTimeline            *self,
+                 DwlTimelineDisplayList *display_list,
+                 DflTask                *task,
+                 gboolean                hovering,
+                 gboolean                selected)
+{
+  gdouble thread_centre, task_x, task_y;
+  guint thread_index;
+  const DwlTimelineClassStyle *style;
+  const gchar *class_names;
+
+  /* New task circle. */
+  thread_index = thread_id_to_index (self,
+                                     dfl_task_get_new_thread_id (task));
+  thread_centre = thread_index_to_centre (self, thread_index);
+
+  if (hovering && selected)
+    class_names = "task_new task_new_hover task_new_selected";
+  else if (hovering)
+    class_names = "task_new task_new_hover";
+  else if (selected)
+    class_names = "task_new task_new_selected";
+  else
+    class_names = "task_new";
+
+  style = get_class_style (self, class_names);
+
+  task_x = thread_centre + TASK_OFFSET;
+  task_y = timestamp_to_y (self, dfl_task_get_new_timestamp (task) -
+                                 self->min_timestamp);
+
+  display_list_add_circle (display_list, task_x, task_y, TASK_WIDTH,
+                           &style->background_color, &style->color,
+                           TASK_BORDER_WIDTH);
+}
+
+/* Label the selected @task with its source tag and callback. */
+static void
+draw_task_labels (DwlTimeline *self,
+                  cairo_t     *cr,
+                  DflTask     *task)
+{
+  gdouble thread_centre, task_x, task_y;
+  guint thread_index;
+  GtkStyleContext *context;
+  DflTimestamp min_timestamp;
+
+  min_timestamp = self->min_timestamp;
+  context = gtk_widget_get_style_context (GTK_WIDGET (self));
+
+  thread_index = thread_id_to_index (self,
+                                     dfl_task_get_new_thread_id (task));
+  thread_centre = thread_index_to_centre (self, thread_index);
+
+  task_x = thread_centre + TASK_OFFSET;
+  task_y = timestamp_to_y (self, dfl_task_get_new_timestamp (task) - min_timestamp);
+
+  /* Plonk labels next to it for its source tag and callback. */
+  if (dfl_task_get_source_tag_name (task) != NULL)
+    {
+      PangoLayout *layout = NULL;
+      PangoRectangle layout_rect;
+
+      gtk_style_context_add_class (context, "task_source_tag");
+
+      layout = gtk_widget_create_pango_layout (GTK_WIDGET (self),
+                                               dfl_task_get_source_tag_name (task));
+
+      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+
+      gtk_render_layout (context, cr,
+                         task_x + TASK_SOURCE_TAG_OFFSET,
+                         task_y - layout_rect.height / 2.0,
+                         layout);
+      g_object_unref (layout);
+
+      gtk_style_context_remove_class (context, "task_source_tag");
+    }
+
+  if (dfl_task_get_callback_name (task) != NULL)
+    {
+      PangoLayout *layout = NULL;
+      PangoRectangle layout_rect;
+      gdouble task_return_x, task_return_y;
+      gdouble return_thread_centre;
+      guint return_thread_index;
+
+      gtk_style_context_add_class (context, "task_callback");
+
+      layout = gtk_widget_create_pango_layout (GTK_WIDGET (self),
+                                               dfl_task_get_callback_name (task));
+
+      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
+
+      /* Work out the label position. If the task has returned, put the label
+       * next to the return timestamp. If it hasn't, put it by the
+       * g_task_new(). */
+      if (dfl_task_get_return_thread_id (task) != 0)
+        {
+          return_thread_index = thread_id_to_index (self,
+                                                    dfl_task_get_return_thread_id (task));
+          return_thread_centre = thread_index_to_centre (self,
+                                                         return_thread_index);
+
+          task_return_x = return_thread_centre + TASK_OFFSET;
+          task_return_y = timestamp_to_y (self, dfl_task_get_return_timestamp (task) - min_timestamp);
+        }
+      else
+        {
+          task_return_x = task_x;
+          task_return_y = task_y + layout_rect.height;
+        }
+
+      gtk_render_layout (context, cr,
+                         task_return_x + TASK_CALLBACK_OFFSET,
+                         task_return_y - layout_rect.height / 2.0,
+                         layout);
+      g_object_unref (layout);
+
+      gtk_style_context_remove_class (context, "task_callback");
+    }
+}
+
+static void
+draw_task_return_propagate_lines (DwlTimeline *self,
+                                  cairo_t     *cr,
+                                  DflTask     *task)
+{
+  gdouble thread_centre;
+  guint thread_index;
+  GtkStyleContext *context;
+  DflTimestamp min_timestamp;
+  gdouble task_x, task_y;
+
+  context = gtk_widget_get_style_context (GTK_WIDGET (self));
+  min_timestamp = self->min_timestamp;
+
+  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
+  cairo_set_line_width (cr, SOURCE_ATTACH_DESTROY_WIDTH);
 
   thread_index = thread_id_to_index (self,
                                      dfl_task_get_new_thread_id (task));
@@ -1025,20 +2058,670 @@ draw_task_return_propagate_lines (DwlTimeline *self,
   /* Draw the propagate line. */
   if (dfl_task_get_propagate_timestamp (task) != 0)
     {
-      gint propagate_timestamp_y;
+      gint propagate_timestamp_y;
+
+      thread_index = thread_id_to_index (self,
+                                         dfl_task_get_propagate_thread_id (task));
+      thread_centre = thread_index_to_centre (self, thread_index);
+
+      propagate_timestamp_y = timestamp_to_y (self,
+                                              dfl_task_get_propagate_timestamp (task) - min_timestamp);
+
+      gtk_style_context_add_class (context, "task_propagate_line");
+      draw_cornered_line (self, cr,
+                          thread_centre, propagate_timestamp_y,
+                          task_x, task_y);
+      gtk_style_context_remove_class (context, "task_propagate_line");
+    }
+}
+
+/* Add the parts of the timeline which only change when the model or zoom
+ * level change to @display_list, for the elements between
+ * @min_visible_timestamp and @max_visible_timestamp. Hover and selection
+ * highlights are drawn separately, on top. */
+static void
+add_static_layers (DwlTimeline            *self,
+                   DwlTimelineDisplayList *display_list,
+                   DflTimestamp            min_visible_timestamp,
+                   DflTimestamp            max_visible_timestamp)
+{
+  GtkWidget *widget = GTK_WIDGET (self);
+  const DwlTimelineClassStyle *style;
+  gint widget_width;
+  guint i, n_threads;
+  DflTimestamp min_timestamp, max_timestamp, t;
+  DflDuration marker_interval;
+  gint visible_height;
+
+  widget_width = gtk_widget_get_allocated_width (widget);
+
+  n_threads = self->threads->len;
+  min_timestamp = self->min_timestamp;
+  max_timestamp = self->max_timestamp;
+
+  g_assert (min_visible_timestamp <= max_visible_timestamp);
+  g_assert (min_timestamp <= min_visible_timestamp);
+  g_assert (max_visible_timestamp <= max_timestamp);
+
+  /* Draw the 1ms, 10ms and 100ms markers. Only draw the higher frequency
+   * markers if there’s enough space to render them. */
+  marker_interval = (self->zoom <= 0.0011) ? 100000 : ((self->zoom <= 0.01) ? 10000 : 1000);
+
+  for (t = min_timestamp + ((min_visible_timestamp - min_timestamp) / marker_interval) * marker_interval;
+       t <= max_visible_timestamp;
+       t += marker_interval)
+    {
+      const gchar *line_class_name, *label_class_name;
+      gdouble marker_y;
+      g_autofree gchar *text = NULL;
+
+      /* Line. */
+      if ((t - min_timestamp) % 1000000 == 0)
+        {
+          line_class_name = "thousand_millisecond_marker";
+          label_class_name = "thousand_millisecond_marker_label";
+        }
+      else if ((t - min_timestamp) % 100000 == 0)
+        {
+          line_class_name = "hundred_millisecond_marker";
+          label_class_name = "hundred_millisecond_marker_label";
+        }
+      else if ((t - min_timestamp) % 10000 == 0)
+        {
+          line_class_name = "ten_millisecond_marker";
+          label_class_name = "ten_millisecond_marker_label";
+        }
+      else
+        {
+          line_class_name = "millisecond_marker";
+          label_class_name = "millisecond_marker_label";
+        }
+
+      marker_y = timestamp_to_y (self, t - min_timestamp);
+
+      /* Line. */
+      style = get_class_style (self, line_class_name);
+      display_list_add_line (display_list,
+                             LEFT_GUTTER_WIDTH + 0.5,
+                             marker_y + 0.5,
+                             widget_width + 0.5,
+                             marker_y + 0.5,
+                             &style->color, 1.0, CAIRO_LINE_CAP_SQUARE);
+
+      /* Label. */
+      style = get_class_style (self, label_class_name);
+
+      text = g_strdup_printf ("%" G_GINT64_FORMAT " ms",
+                              (t - min_timestamp) / 1000);
+      display_list_add_text (display_list,
+                             LEFT_GUTTER_WIDTH - LEFT_GUTTER_RIGHT_PADDING,
+                             marker_y, 1.0, 0.5, text, PANGO_ALIGN_RIGHT,
+                             &style->color);
+    }
+
+  /* Draw the threads. */
+  for (i = 0; i < n_threads; i++)
+    {
+      DflThread *thread = self->threads->pdata[i];
+      gdouble thread_centre;
+      gchar *text = NULL;
+      const gchar *thread_name;
+
+      thread_centre = thread_index_to_centre (self, i);
+
+      /* Guide line for the entire length of the thread. */
+      style = get_class_style (self, "thread_guide");
+      display_list_add_line (display_list,
+                             thread_centre + 0.5,
+                             timestamp_to_y (self, 0) + 0.5,
+                             thread_centre + 0.5,
+                             timestamp_to_y (self, max_timestamp - min_timestamp) + 0.5,
+                             &style->color, 1.0, CAIRO_LINE_CAP_SQUARE);
+
+      /* Line for the actual live length of the thread, plus its label. */
+      style = get_class_style (self, "thread");
+      display_list_add_line (display_list,
+                             thread_centre + 0.5,
+                             timestamp_to_y (self, dfl_thread_get_new_timestamp (thread) - min_timestamp) + 0.5,
+                             thread_centre + 0.5,
+                             timestamp_to_y (self, dfl_thread_get_free_timestamp (thread) - min_timestamp) + 0.5,
+                             &style->color, 1.0, CAIRO_LINE_CAP_SQUARE);
+
+      /* Thread label. */
+      style = get_class_style (self, "thread_header");
+
+      thread_name = dfl_thread_get_name (thread);
+      text = g_strdup_printf ("Thread %" G_GUINT64_FORMAT "\n%s",
+                              dfl_thread_get_id (thread),
+                              (thread_name != NULL) ? thread_name : "");
+      display_list_add_text (display_list, thread_centre, HEADER_HEIGHT / 2,
+                             0.5, 0.5, text, PANGO_ALIGN_CENTER,
+                             &style->color);
+      g_free (text);
+    }
+
+  /* Draw the main contexts on top. */
+  for (i = 0; i < self->main_contexts->len; i++)
+    {
+      DflMainContext *main_context = self->main_contexts->pdata[i];
+      DflTimeSequenceIter iter;
+      DflTimestamp timestamp;
+
+      /* Iterate through the thread ownership events, unless there are too
+       * many to draw individually, in which case draw their density. The
+       * lines are batched into one path when drawn. */
+      if (!add_main_context_density (self, display_list, main_context,
+                                     dfl_main_context_dup_thread_ownership_summary,
+                                     MAIN_CONTEXT_ACQUIRED_WIDTH,
+                                     "main_context_density",
+                                     min_visible_timestamp,
+                                     max_visible_timestamp))
+        {
+          DflThreadOwnershipData *data;
+
+          style = get_class_style (self, "main_context");
+
+          /* Include ownership periods which started above the visible area
+           * but extend into it. */
+          dfl_main_context_thread_ownership_iter_overlapping (main_context,
+                                                              &iter,
+                                                              min_visible_timestamp,
+                                                              max_visible_timestamp);
+
+          while (dfl_time_sequence_iter_next_overlapping (&iter, &timestamp,
+                                                          (gpointer *) &data))
+            {
+              gdouble thread_centre;
+              gint timestamp_y;
+              guint thread_index;
+
+              thread_index = thread_id_to_index (self, data->thread_id);
+              thread_centre = thread_index_to_centre (self, thread_index);
+              timestamp_y = timestamp_to_y (self, timestamp - min_timestamp);
+
+              display_list_add_line (display_list,
+                                     thread_centre + 0.5,
+                                     timestamp_y + 0.5,
+                                     thread_centre + 0.5,
+                                     timestamp_y +
+                                     duration_to_pixels (self, data->duration) + 0.5,
+                                     &style->color, MAIN_CONTEXT_ACQUIRED_WIDTH,
+                                     CAIRO_LINE_CAP_ROUND);
+            }
+        }
+
+      /* Likewise for the dispatch events. */
+      if (!add_main_context_density (self, display_list, main_context,
+                                     dfl_main_context_dup_dispatch_summary,
+                                     MAIN_CONTEXT_DISPATCH_WIDTH,
+                                     "main_context_dispatch_density",
+                                     min_visible_timestamp,
+                                     max_visible_timestamp))
+        {
+          DflMainContextDispatchData *dispatch_data;
+
+          dfl_main_context_dispatch_iter_overlapping (main_context, &iter,
+                                                      min_visible_timestamp,
+                                                      max_visible_timestamp);
+
+          while (dfl_time_sequence_iter_next_overlapping (&iter, &timestamp,
+                                                          (gpointer *) &dispatch_data))
+            add_main_context_dispatch (self, display_list, timestamp,
+                                       dispatch_data, FALSE, FALSE);
+        }
+    }
+
+  /* Draw the sources either side, one thread’s column at a time. If a column
+   * has too many to draw individually, draw their density instead. */
+  visible_height = duration_to_pixels (self, max_visible_timestamp -
+                                             min_visible_timestamp);
+
+  for (i = 0; i < self->source_columns->len; i++)
+    {
+      GArray *column = self->source_columns->pdata[i];
+      guint first, last, j;
+
+      first = column_lower_bound (column, min_visible_timestamp, 0,
+                                  column->len);
+      last = (max_visible_timestamp < G_MAXUINT64) ?
+             column_lower_bound (column, max_visible_timestamp + 1, first,
+                                 column->len) :
+             column->len;
+
+      if (last > first &&
+          visible_height / (last - first) < LOD_MIN_ELEMENT_SPACING)
+        {
+          add_column_density (self, display_list, column, first, last,
+                              thread_index_to_centre (self, i) - SOURCE_OFFSET,
+                              SOURCE_WIDTH, "source_density");
+          continue;
+        }
+
+      for (j = first; j < last; j++)
+        {
+          guint index = g_array_index (column, DwlTimelineColumnEntry,
+                                       j).index;
+
+          add_source_circle (self, display_list, self->sources->pdata[index],
+                             FALSE, FALSE);
+        }
+    }
+
+  /* Draw the GTasks’ circles in the same way. */
+  for (i = 0; i < self->task_columns->len; i++)
+    {
+      GArray *column = self->task_columns->pdata[i];
+      guint first, last, j;
+
+      first = column_lower_bound (column, min_visible_timestamp, 0,
+                                  column->len);
+      last = (max_visible_timestamp < G_MAXUINT64) ?
+             column_lower_bound (column, max_visible_timestamp + 1, first,
+                                 column->len) :
+             column->len;
+
+      if (last > first &&
+          visible_height / (last - first) < LOD_MIN_ELEMENT_SPACING)
+        {
+          add_column_density (self, display_list, column, first, last,
+                              thread_index_to_centre (self, i) + TASK_OFFSET,
+                              TASK_WIDTH, "task_new_density");
+          continue;
+        }
+
+      for (j = first; j < last; j++)
+        {
+          guint index = g_array_index (column, DwlTimelineColumnEntry,
+                                       j).index;
+
+          add_task_circle (self, display_list, self->tasks->pdata[index],
+                           FALSE, FALSE);
+        }
+    }
+}
+
+/* Cancel any tiles which are being rendered, so their results are discarded
+ * when they arrive. */
+static void
+cancel_pending_tiles (DwlTimeline *self)
+{
+  GHashTableIter iter;
+  DwlTimelineTileJob *job;
+
+  g_hash_table_iter_init (&iter, self->pending_tiles);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &job))
+    g_atomic_int_set (&job->cancelled, TRUE);
+
+  g_hash_table_remove_all (self->pending_tiles);
+}
+
+/* Drop the cached tiles from @first_tile onwards, so they are re-rendered on
+ * the next draw, and cancel rendering of any of them. The dropped tiles are
+ * kept as placeholders until then. Placeholders for the other tiles are kept
+ * too, unless they were drawn at a different zoom level or width from the
+ * dropped tiles. */
+static void
+invalidate_tiles_from (DwlTimeline *self,
+                       guint        first_tile)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean stale_tiles_reset = FALSE;
+
+  g_hash_table_iter_init (&iter, self->pending_tiles);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      DwlTimelineTileJob *job = value;
+
+      if (GPOINTER_TO_UINT (key) >= first_tile)
+        {
+          g_atomic_int_set (&job->cancelled, TRUE);
+          g_hash_table_iter_remove (&iter);
+        }
+    }
+
+  g_hash_table_iter_init (&iter, self->tiles);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (GPOINTER_TO_UINT (key) < first_tile)
+        continue;
+
+      if (!stale_tiles_reset)
+        {
+          if (self->stale_tiles_zoom != self->tiles_zoom ||
+              self->stale_tiles_width != self->tiles_width)
+            g_hash_table_remove_all (self->stale_tiles);
+
+          self->stale_tiles_zoom = self->tiles_zoom;
+          self->stale_tiles_width = self->tiles_width;
+          stale_tiles_reset = TRUE;
+        }
+
+      g_hash_table_iter_steal (&iter);
+      g_hash_table_replace (self->stale_tiles, key, value);
+    }
+}
+
+/* Drop all the cached tiles, so they are re-rendered on the next draw. */
+static void
+invalidate_tiles (DwlTimeline *self)
+{
+  invalidate_tiles_from (self, 0);
+}
+
+/* Drop the cached tiles outside the range [@first_tile, @last_tile], and
+ * cancel rendering of any outside it, to limit memory use to around the
+ * visible area. */
+static void
+evict_tiles (DwlTimeline *self,
+             guint        first_tile,
+             guint        last_tile)
+{
+  GHashTableIter iter;
+  gpointer key;
+  DwlTimelineTileJob *job;
+
+  g_hash_table_iter_init (&iter, self->tiles);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      guint tile = GPOINTER_TO_UINT (key);
+
+      if (tile < first_tile || tile > last_tile)
+        g_hash_table_iter_remove (&iter);
+    }
+
+  g_hash_table_iter_init (&iter, self->pending_tiles);
+
+  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &job))
+    {
+      guint tile = GPOINTER_TO_UINT (key);
+
+      if (tile < first_tile || tile > last_tile)
+        {
+          g_atomic_int_set (&job->cancelled, TRUE);
+          g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+/* Convert @y to a timestamp within the log, clamping it to the start or end
+ * of the log if it is outside it. */
+static DflTimestamp
+y_to_clamped_timestamp (DwlTimeline *self,
+                        gint         y)
+{
+  if (y <= HEADER_HEIGHT)
+    return self->min_timestamp;
+
+  return MIN (self->min_timestamp + y_to_timestamp (self, y),
+              self->max_timestamp);
+}
+
+static void
+tile_job_free (DwlTimelineTileJob *job)
+{
+  g_clear_pointer (&job->surface, cairo_surface_destroy);
+  display_list_free (job->display_list);
+  g_object_unref (job->timeline);
+  g_free (job);
+}
+
+/* Called in the main thread once a tile has been rendered (or skipped).
+ * Cancelled tiles have already been removed from the pending set. */
+static gboolean
+tile_ready_cb (gpointer user_data)
+{
+  DwlTimelineTileJob *job = user_data;
+  DwlTimeline *self = job->timeline;
+
+  if (!g_atomic_int_get (&job->cancelled))
+    {
+      g_assert (job->surface != NULL);
+
+      g_hash_table_remove (self->pending_tiles, GUINT_TO_POINTER (job->tile));
+      g_hash_table_insert (self->tiles, GUINT_TO_POINTER (job->tile),
+                           g_steal_pointer (&job->surface));
+
+      gtk_widget_queue_draw_area (GTK_WIDGET (self), 0,
+                                  job->tile * TILE_HEIGHT, job->width,
+                                  TILE_HEIGHT);
+    }
+
+  tile_job_free (job);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Render a tile’s display list in a worker thread. This must not touch the
+ * widget or the model, which may be changed by the main thread meanwhile. */
+static void
+render_tile_cb (gpointer data,
+                gpointer user_data)
+{
+  DwlTimelineTileJob *job = data;
+
+  if (!g_atomic_int_get (&job->cancelled))
+    {
+      cairo_t *cr;
+
+      job->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                 job->width * job->scale_factor,
+                                                 TILE_HEIGHT * job->scale_factor);
+      cairo_surface_set_device_scale (job->surface, job->scale_factor,
+                                      job->scale_factor);
+
+      cr = cairo_create (job->surface);
+      cairo_translate (cr, 0.0, -((gdouble) job->tile * TILE_HEIGHT));
+      draw_display_list (cr, job->display_list);
+      cairo_destroy (cr);
+    }
+
+  /* Priority is higher than redraws, so the tile is drawn in the next
+   * frame. */
+  g_idle_add_full (G_PRIORITY_HIGH_IDLE, tile_ready_cb, job, NULL);
+}
+
+/* Start rendering the static layers for the given tile, which covers rows
+ * [@tile × TILE_HEIGHT, (@tile + 1) × TILE_HEIGHT) of the widget, at its full
+ * width, unless it is already cached or being rendered. The elements in the
+ * tile are copied into a display list here, in the main thread; only that is
+ * passed to the worker, so the model can continue to be updated while the
+ * tile is rendered. */
+static void
+queue_tile (DwlTimeline *self,
+            guint        tile)
+{
+  GtkWidget *widget = GTK_WIDGET (self);
+  DwlTimelineTileJob *job = NULL;
+  gint top, bottom;
+
+  if (g_hash_table_contains (self->tiles, GUINT_TO_POINTER (tile)) ||
+      g_hash_table_contains (self->pending_tiles, GUINT_TO_POINTER (tile)))
+    return;
+
+  job = g_new0 (DwlTimelineTileJob, 1);
+  job->timeline = g_object_ref (self);
+  job->tile = tile;
+  job->width = gtk_widget_get_allocated_width (widget);
+  job->scale_factor = gtk_widget_get_scale_factor (widget);
+  job->display_list = display_list_new (self);
+
+  /* Elements a little outside the tile may extend into it, so add them too;
+   * they are clipped to the tile. */
+  top = (gint) (tile * TILE_HEIGHT) - TILE_MARGIN;
+  bottom = (gint) ((tile + 1) * TILE_HEIGHT) + TILE_MARGIN;
+
+  add_static_layers (self, job->display_list,
+                     y_to_clamped_timestamp (self, top),
+                     y_to_clamped_timestamp (self, bottom));
+
+  /* All tiles since the last invalidation are at the same zoom and width. */
+  self->tiles_zoom = self->zoom;
+  self->tiles_width = job->width;
+
+  g_hash_table_insert (self->pending_tiles, GUINT_TO_POINTER (tile), job);
+  g_thread_pool_push (self->tile_pool, job, NULL);
+}
+
+/* Draw placeholders for the tiles from @first_tile to @last_tile which are
+ * not ready yet. If the stale tiles from before the last invalidation were
+ * the same width, they are drawn, scaled vertically to the current zoom
+ * level; otherwise the placeholders are blank. */
+static void
+draw_tile_placeholders (DwlTimeline *self,
+                        cairo_t     *cr,
+                        guint        first_tile,
+                        guint        last_tile)
+{
+  GtkWidget *widget = GTK_WIDGET (self);
+  GtkStyleContext *context;
+  gint widget_width;
+  guint tile;
+  gboolean any_pending = FALSE;
+
+  context = gtk_widget_get_style_context (widget);
+  widget_width = gtk_widget_get_allocated_width (widget);
+
+  cairo_save (cr);
+  cairo_new_path (cr);
+
+  for (tile = first_tile; tile <= last_tile; tile++)
+    {
+      if (g_hash_table_contains (self->tiles, GUINT_TO_POINTER (tile)))
+        continue;
+
+      cairo_rectangle (cr, 0, tile * TILE_HEIGHT, widget_width, TILE_HEIGHT);
+      any_pending = TRUE;
+    }
+
+  if (!any_pending)
+    {
+      cairo_restore (cr);
+      return;
+    }
+
+  cairo_clip (cr);
+
+  gtk_style_context_add_class (context, "tile_placeholder");
+  gtk_render_background (context, cr, 0, first_tile * TILE_HEIGHT,
+                         widget_width,
+                         (last_tile - first_tile + 1) * TILE_HEIGHT);
+  gtk_style_context_remove_class (context, "tile_placeholder");
+
+  if (self->stale_tiles_width == widget_width &&
+      g_hash_table_size (self->stale_tiles) > 0)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      cairo_surface_t *surface;
+
+      /* Timestamps are offset from the bottom of the header, so scale about
+       * that. */
+      cairo_translate (cr, 0.0, HEADER_HEIGHT);
+      cairo_scale (cr, 1.0, self->zoom / self->stale_tiles_zoom);
+      cairo_translate (cr, 0.0, -HEADER_HEIGHT);
+
+      g_hash_table_iter_init (&iter, self->stale_tiles);
+
+      while (g_hash_table_iter_next (&iter, &key, (gpointer *) &surface))
+        {
+          cairo_set_source_surface (cr, surface, 0,
+                                    GPOINTER_TO_UINT (key) * TILE_HEIGHT);
+          cairo_paint (cr);
+        }
+    }
+
+  cairo_restore (cr);
+}
+
+/* Draw a single element on top of the static layers, highlighted as being
+ * hovered over and/or selected. */
+static void
+draw_highlighted_element (DwlTimeline         *self,
+                          cairo_t             *cr,
+                          DwlTimelineElement   type,
+                          guint                index,
+                          DflTimeSequenceIter *iter,
+                          gboolean             hovering,
+                          gboolean             selected)
+{
+  g_autoptr (DwlTimelineDisplayList) display_list = NULL;
+
+  display_list = display_list_new (self);
+
+  switch (type)
+    {
+    case ELEMENT_NONE:
+      break;
+    case ELEMENT_SOURCE:
+      add_source_circle (self, display_list, self->sources->pdata[index],
+                         hovering, selected);
+      break;
+    case ELEMENT_CONTEXT_DISPATCH:
+      add_main_context_dispatch (self, display_list,
+                                 dfl_time_sequence_iter_get_timestamp (iter),
+                                 dfl_time_sequence_iter_get_data (iter),
+                                 hovering, selected);
+      break;
+    case ELEMENT_TASK:
+      add_task_circle (self, display_list, self->tasks->pdata[index],
+                       hovering, selected);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  draw_display_list (cr, display_list);
+}
+
+static void
+dwl_timeline_style_updated (GtkWidget *widget)
+{
+  DwlTimeline *self = DWL_TIMELINE (widget);
+
+  GTK_WIDGET_CLASS (dwl_timeline_parent_class)->style_updated (widget);
+
+  g_hash_table_remove_all (self->class_styles);
+  invalidate_tiles (self);
+}
+
+/* Get the rows of the widget which are visible, [@top, @bottom). If it is in
+ * a #GtkScrollable, such as a #GtkViewport, this is the part shown by its
+ * vertical adjustment; otherwise it is the whole of the allocation. */
+static void
+get_visible_rows (DwlTimeline *self,
+                  gint        *top,
+                  gint        *bottom)
+{
+  GtkWidget *parent;
+  gint widget_height;
+
+  parent = gtk_widget_get_parent (GTK_WIDGET (self));
+  widget_height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
+
+  *top = 0;
+  *bottom = widget_height;
+
+  if (GTK_IS_SCROLLABLE (parent))
+    {
+      GtkAdjustment *vadjustment;
+      gdouble value;
 
-      thread_index = thread_id_to_index (self,
-                                         dfl_task_get_propagate_thread_id (task));
-      thread_centre = thread_index_to_centre (self, thread_index);
+      vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (parent));
 
-      propagate_timestamp_y = timestamp_to_y (self,
-                                              dfl_task_get_propagate_timestamp (task) - min_timestamp);
+      if (vadjustment == NULL)
+        return;
 
-      gtk_style_context_add_class (context, "task_propagate_line");
-      draw_cornered_line (self, cr,
-                          thread_centre, propagate_timestamp_y,
-                          task_x, task_y);
-      gtk_style_context_remove_class (context, "task_propagate_line");
+      value = gtk_adjustment_get_value (vadjustment);
+
+      *top = CLAMP ((gint) floor (value), 0, widget_height);
+      *bottom = CLAMP ((gint) ceil (value +
+                                    gtk_adjustment_get_page_size (vadjustment)),
+                       *top, widget_height);
     }
 }
 
@@ -1050,8 +2733,11 @@ dwl_timeline_draw (GtkWidget *widget,
   GtkStyleContext *context;
   gint widget_width, widget_height;
   guint i, n_threads;
-  DflTimestamp min_timestamp, max_timestamp, t;
-  DflTimestamp min_visible_timestamp, max_visible_timestamp;
+  DflTimestamp min_timestamp, max_timestamp;
+  GdkRectangle clip;
+  guint first_tile, last_tile, first_visible_tile, last_visible_tile, tile;
+  gint visible_top, visible_bottom;
+  gboolean hover_is_selected, visible_tiles_ready;
 
   context = gtk_widget_get_style_context (widget);
   widget_width = gtk_widget_get_allocated_width (widget);
@@ -1061,50 +2747,7 @@ dwl_timeline_draw (GtkWidget *widget,
   min_timestamp = self->min_timestamp;
   max_timestamp = self->max_timestamp;
 
-  /* Work out our clipping. Once we implement GtkScrollable, this can be
-   * removed. */
-  min_visible_timestamp = min_timestamp;
-  max_visible_timestamp = max_timestamp;
-
-  if (GTK_IS_SCROLLABLE (gtk_widget_get_parent (widget)))
-    {
-      GtkScrollable *scrollable;
-      GtkAdjustment *vadjustment;
-      gdouble value, lower, upper;
-      gint parent_widget_height;
-      DflTimestamp visible_time, value_timestamp;
-
-      scrollable = GTK_SCROLLABLE (gtk_widget_get_parent (GTK_WIDGET (self)));
-      vadjustment = gtk_scrollable_get_vadjustment (scrollable);
-      parent_widget_height = gtk_widget_get_allocated_height (GTK_WIDGET (scrollable));
-      lower = gtk_adjustment_get_lower (vadjustment);
-      upper = gtk_adjustment_get_upper (vadjustment);
-      value = gtk_adjustment_get_value (vadjustment);
-
-      /* Multiply by two to give some buffer either side of the visible area. */
-      visible_time = (DflTimestamp) pixels_to_duration (self, parent_widget_height) * 2;
-      value_timestamp = min_timestamp +
-                        (max_timestamp - min_timestamp) /
-                        (upper - lower) *
-                        value;
-
-      if (min_timestamp <= G_MAXUINT64 - visible_time &&
-          min_timestamp + visible_time <= value_timestamp)
-        min_visible_timestamp = value_timestamp - visible_time;
-      else
-        min_visible_timestamp = min_timestamp;
-
-      if (max_timestamp >= visible_time &&
-          max_timestamp - visible_time >= value_timestamp)
-        max_visible_timestamp = value_timestamp + visible_time;
-      else
-        max_visible_timestamp = max_timestamp;
-    }
-
   g_assert (min_timestamp <= max_timestamp);
-  g_assert (min_visible_timestamp <= max_visible_timestamp);
-  g_assert (min_timestamp <= min_visible_timestamp);
-  g_assert (max_visible_timestamp <= max_timestamp);
 
   /* Render the background and frame. */
   gtk_render_background (context, cr, 0, 0, widget_width, widget_height);
@@ -1134,316 +2777,86 @@ dwl_timeline_draw (GtkWidget *widget,
       return FALSE;
     }
 
-  /* Draw the 1ms, 10ms and 100ms markers. Only draw the higher frequency
-   * markers if there’s enough space to render them. */
-  for (t = min_timestamp + ((min_visible_timestamp - min_timestamp) / 1000000) * 1000000;
-       t <= max_visible_timestamp;
-       t += (self->zoom <= 0.0011) ? 100000 : ((self->zoom <= 0.01) ? 10000 : 1000))
+  /* Copy the static layers from the tiles covering the area being drawn.
+   * Tiles which are not ready are queued to be rendered in worker threads, and
+   * drawn as placeholders until they arrive. The rest of the visible tiles are
+   * queued too, and then the tiles either side of them, so they are likely to
+   * be ready when scrolled to. Which tiles to keep is decided from the visible
+   * area rather than the area being drawn, as that may be just a tile which
+   * has become ready or an element being highlighted. */
+  if (!gdk_cairo_get_clip_rectangle (cr, &clip))
     {
-      const gchar *line_class_name, *label_class_name;
-      gdouble marker_y;
-      PangoLayout *layout = NULL;
-      g_autofree gchar *text = NULL;
-      PangoRectangle layout_rect;
-
-      /* Line. */
-      if ((t - min_timestamp) % 1000000 == 0)
-        {
-          line_class_name = "thousand_millisecond_marker";
-          label_class_name = "thousand_millisecond_marker_label";
-        }
-      else if ((t - min_timestamp) % 100000 == 0)
-        {
-          line_class_name = "hundred_millisecond_marker";
-          label_class_name = "hundred_millisecond_marker_label";
-        }
-      else if ((t - min_timestamp) % 10000 == 0)
-        {
-          line_class_name = "ten_millisecond_marker";
-          label_class_name = "ten_millisecond_marker_label";
-        }
-      else
-        {
-          line_class_name = "millisecond_marker";
-          label_class_name = "millisecond_marker_label";
-        }
-
-      marker_y = timestamp_to_y (self, t - min_timestamp);
-
-      /* Line. */
-      gtk_style_context_add_class (context, line_class_name);
-      gtk_render_line (context, cr,
-                       LEFT_GUTTER_WIDTH,
-                       marker_y,
-                       widget_width,
-                       marker_y);
-      gtk_style_context_remove_class (context, line_class_name);
-
-      /* Label. */
-      gtk_style_context_add_class (context, label_class_name);
-
-      text = g_strdup_printf ("%" G_GINT64_FORMAT " ms",
-                              (t - min_timestamp) / 1000);
-      layout = gtk_widget_create_pango_layout (widget, text);
-
-      pango_layout_set_alignment (layout, PANGO_ALIGN_RIGHT);
-      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
-
-      gtk_render_layout (context, cr,
-                         LEFT_GUTTER_WIDTH - LEFT_GUTTER_RIGHT_PADDING - layout_rect.width,
-                         marker_y - layout_rect.height / 2,
-                         layout);
-      g_object_unref (layout);
-
-      gtk_style_context_remove_class (context, label_class_name);
+      clip.y = 0;
+      clip.height = widget_height;
     }
 
-  /* Draw the threads. */
-  for (i = 0; i < n_threads; i++)
-    {
-      DflThread *thread = self->threads->pdata[i];
-      gdouble thread_centre;
-      PangoLayout *layout = NULL;
-      gchar *text = NULL;
-      PangoRectangle layout_rect;
-      const gchar *thread_name;
-
-      thread_centre = thread_index_to_centre (self, i);
-
-      /* Guide line for the entire length of the thread. */
-      gtk_style_context_add_class (context, "thread_guide");
-      gtk_render_line (context, cr,
-                       thread_centre,
-                       timestamp_to_y (self, 0),
-                       thread_centre,
-                       timestamp_to_y (self, max_timestamp - min_timestamp));
-      gtk_style_context_remove_class (context, "thread_guide");
-
-      /* Line for the actual live length of the thread, plus its label. */
-      gtk_style_context_add_class (context, "thread");
-      gtk_render_line (context, cr,
-                       thread_centre,
-                       timestamp_to_y (self, dfl_thread_get_new_timestamp (thread) - min_timestamp),
-                       thread_centre,
-                       timestamp_to_y (self, dfl_thread_get_free_timestamp (thread) - min_timestamp));
-      gtk_style_context_remove_class (context, "thread");
-
-      /* Thread label. */
-      gtk_style_context_add_class (context, "thread_header");
-
-      thread_name = dfl_thread_get_name (thread);
-      text = g_strdup_printf ("Thread %" G_GUINT64_FORMAT "\n%s",
-                              dfl_thread_get_id (thread),
-                              (thread_name != NULL) ? thread_name : "");
-      layout = gtk_widget_create_pango_layout (widget, text);
-      g_free (text);
-
-      pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-      pango_layout_get_pixel_extents (layout, NULL, &layout_rect);
-
-      gtk_render_layout (context, cr,
-                         thread_centre - layout_rect.width / 2,
-                         HEADER_HEIGHT / 2 - layout_rect.height / 2,
-                         layout);
-      g_object_unref (layout);
+  first_tile = MAX (clip.y, 0) / TILE_HEIGHT;
+  last_tile = MAX (clip.y + clip.height - 1, 0) / TILE_HEIGHT;
 
-      gtk_style_context_remove_class (context, "thread_header");
-    }
+  get_visible_rows (self, &visible_top, &visible_bottom);
+  first_visible_tile = MIN ((guint) visible_top / TILE_HEIGHT, first_tile);
+  last_visible_tile = MAX ((guint) MAX (visible_bottom - 1, 0) / TILE_HEIGHT,
+                           last_tile);
 
-  /* Draw the main contexts on top. */
-  for (i = 0; i < self->main_contexts->len; i++)
+  for (tile = first_tile; tile <= last_tile; tile++)
     {
-      DflMainContext *main_context = self->main_contexts->pdata[i];
-      DflTimeSequenceIter iter;
-      DflTimestamp timestamp;
-      DflThreadOwnershipData *data;
-      GdkRGBA color;
-
-      /* Iterate through the thread ownership events. */
-      gtk_style_context_add_class (context, "main_context");
-      cairo_save (cr);
-
-      gtk_style_context_get_color (context, gtk_widget_get_state_flags (widget),
-                                   &color);
+      cairo_surface_t *surface;
 
-      cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-      cairo_set_line_width (cr, MAIN_CONTEXT_ACQUIRED_WIDTH);
-      cairo_new_path (cr);
+      surface = g_hash_table_lookup (self->tiles, GUINT_TO_POINTER (tile));
 
-      dfl_main_context_thread_ownership_iter (main_context, &iter,
-                                              min_visible_timestamp);
-
-      while (dfl_time_sequence_iter_next (&iter, &timestamp, (gpointer *) &data) &&
-             timestamp <= max_visible_timestamp)
+      if (surface != NULL)
         {
-          gdouble thread_centre;
-          gint timestamp_y;
-          guint thread_index;
-
-          thread_index = thread_id_to_index (self, data->thread_id);
-          thread_centre = thread_index_to_centre (self, thread_index);
-          timestamp_y = timestamp_to_y (self, timestamp - min_timestamp);
-
-          cairo_move_to (cr,
-                         thread_centre + 0.5,
-                         timestamp_y + 0.5);
-          cairo_line_to (cr,
-                         thread_centre + 0.5,
-                         timestamp_y +
-                         duration_to_pixels (self, data->duration) + 0.5);
+          cairo_set_source_surface (cr, surface, 0, tile * TILE_HEIGHT);
+          cairo_paint (cr);
         }
-
-      gdk_cairo_set_source_rgba (cr, &color);
-      cairo_stroke (cr);
-
-      cairo_restore (cr);
-      gtk_style_context_remove_class (context, "main_context");
-
-      /* Iterate through the dispatch events. */
-      gtk_style_context_add_class (context, "main_context_dispatch");
-
-      dfl_main_context_dispatch_iter (main_context, &iter,
-                                      min_visible_timestamp);
-
-      while (dfl_time_sequence_iter_next (&iter, &timestamp, (gpointer *) &data) &&
-             timestamp <= max_visible_timestamp)
+      else
         {
-          gdouble thread_centre, dispatch_width, dispatch_height;
-          gint timestamp_y;
-          guint thread_index;
-
-          thread_index = thread_id_to_index (self, data->thread_id);
-          thread_centre = thread_index_to_centre (self, thread_index);
-          timestamp_y = timestamp_to_y (self, timestamp - min_timestamp);
-
-          dispatch_width = MAIN_CONTEXT_DISPATCH_WIDTH;
-          dispatch_height = duration_to_pixels (self, data->duration);
-
-          if (self->hover_element.type == ELEMENT_CONTEXT_DISPATCH &&
-              self->hover_element.index == i &&
-              dfl_time_sequence_iter_equal (self->hover_element.iter, &iter))
-            gtk_style_context_add_class (context, "main_context_dispatch_hover");
-          if (self->selected_element.type == ELEMENT_CONTEXT_DISPATCH &&
-              self->selected_element.index == i &&
-              dfl_time_sequence_iter_equal (self->selected_element.iter, &iter))
-            gtk_style_context_add_class (context, "main_context_dispatch_selected");
-
-          gtk_render_background (context, cr,
-                                 thread_centre - dispatch_width / 2.0,
-                                 timestamp_y,
-                                 dispatch_width,
-                                 dispatch_height);
-          gtk_render_frame (context, cr,
-                            thread_centre - dispatch_width / 2.0,
-                            timestamp_y,
-                            dispatch_width,
-                            dispatch_height);
-
-          if (self->selected_element.type == ELEMENT_CONTEXT_DISPATCH &&
-              self->selected_element.index == i &&
-              dfl_time_sequence_iter_equal (self->selected_element.iter, &iter))
-            gtk_style_context_remove_class (context, "main_context_dispatch_selected");
-          if (self->hover_element.type == ELEMENT_CONTEXT_DISPATCH &&
-              self->hover_element.index == i &&
-              dfl_time_sequence_iter_equal (self->hover_element.iter, &iter))
-            gtk_style_context_remove_class (context, "main_context_dispatch_hover");
+          queue_tile (self, tile);
         }
-
-      gtk_style_context_remove_class (context, "main_context_dispatch");
     }
 
-  /* Draw the sources either side. */
-  for (i = 0; i < self->sources->len; i++)
-    {
-      DflSource *source = self->sources->pdata[i];
-      gdouble thread_centre, source_x, source_y;
-      guint thread_index;
-      GdkRGBA color;
-      DflTimestamp new_timestamp;
-
-      new_timestamp = dfl_source_get_new_timestamp (source);
-
-      if (new_timestamp < min_visible_timestamp ||
-          new_timestamp > max_visible_timestamp)
-        continue;
-
-      thread_index = thread_id_to_index (self,
-                                         dfl_source_get_new_thread_id (source));
-      thread_centre = thread_index_to_centre (self, thread_index);
-
-      /* Source circle. */
-      gtk_style_context_add_class (context, "source");
-
-      if (self->hover_element.type == ELEMENT_SOURCE &&
-          self->hover_element.index == i)
-        gtk_style_context_add_class (context, "source_hover");
-      if (self->selected_element.type == ELEMENT_SOURCE &&
-          self->selected_element.index == i)
-        gtk_style_context_add_class (context, "source_selected");
-      if (dfl_source_get_attach_main_context_id (source) == DFL_ID_INVALID)
-        gtk_style_context_add_class (context, "source_unattached");
+  draw_tile_placeholders (self, cr, first_tile, last_tile);
 
-      cairo_save (cr);
+  visible_tiles_ready = TRUE;
 
-      cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
-      cairo_set_line_width (cr, SOURCE_BORDER_WIDTH);
-      cairo_new_path (cr);
-
-      /* Calculate the centre of the source. */
-      source_x = thread_centre - SOURCE_OFFSET;
-      source_y = timestamp_to_y (self, new_timestamp - min_timestamp);
-
-      cairo_arc (cr,
-                 source_x,
-                 source_y,
-                 SOURCE_WIDTH / 2.0,
-                 0.0, 2 * M_PI);
-
-      cairo_clip_preserve (cr);
-      gtk_render_background (context, cr,
-                             source_x - SOURCE_WIDTH / 2.0,
-                             source_y - SOURCE_WIDTH / 2.0,
-                             SOURCE_WIDTH,
-                             SOURCE_WIDTH);
-
-      gtk_style_context_get_color (context, gtk_widget_get_state_flags (widget),
-                                   &color);
-      gdk_cairo_set_source_rgba (cr, &color);
-      cairo_stroke (cr);
-
-      cairo_restore (cr);
+  for (tile = first_visible_tile; tile <= last_visible_tile; tile++)
+    {
+      if (!g_hash_table_contains (self->tiles, GUINT_TO_POINTER (tile)))
+        {
+          queue_tile (self, tile);
+          visible_tiles_ready = FALSE;
+        }
+    }
 
-      if (dfl_source_get_attach_main_context_id (source) == DFL_ID_INVALID)
-        gtk_style_context_remove_class (context, "source_unattached");
-      if (self->selected_element.type == ELEMENT_SOURCE &&
-          self->selected_element.index == i)
-        gtk_style_context_remove_class (context, "source_selected");
-      if (self->hover_element.type == ELEMENT_SOURCE &&
-          self->hover_element.index == i)
-        gtk_style_context_remove_class (context, "source_hover");
+  /* The placeholders are no longer needed once all the visible tiles have
+   * been rendered again. */
+  if (visible_tiles_ready)
+    g_hash_table_remove_all (self->stale_tiles);
 
-      gtk_style_context_remove_class (context, "source");
-    }
+  if (first_visible_tile > 0)
+    queue_tile (self, first_visible_tile - 1);
+  if ((gint) ((last_visible_tile + 1) * TILE_HEIGHT) < widget_height)
+    queue_tile (self, last_visible_tile + 1);
 
-  /* Draw the GTasks. */
-  for (i = 0; i < self->tasks->len; i++)
-    {
-      DflTimestamp new_timestamp, return_timestamp;
-      DflTask *task = self->tasks->pdata[i];
+  evict_tiles (self, (first_visible_tile > 0) ? first_visible_tile - 1 : 0,
+               last_visible_tile + 1);
 
-      new_timestamp = dfl_task_get_new_timestamp (task);
-      return_timestamp = dfl_task_get_return_timestamp (task);
+  /* Highlight the selected and hover elements. */
+  hover_is_selected = (self->hover_element.type == self->selected_element.type &&
+                       self->hover_element.index == self->selected_element.index &&
+                       (self->hover_element.type != ELEMENT_CONTEXT_DISPATCH ||
+                        dfl_time_sequence_iter_equal (self->hover_element.iter,
+                                                      self->selected_element.iter)));
 
-      if (return_timestamp < min_visible_timestamp ||
-          new_timestamp > max_visible_timestamp)
-        continue;
+  draw_highlighted_element (self, cr, self->selected_element.type,
+                            self->selected_element.index,
+                            self->selected_element.iter,
+                            hover_is_selected, TRUE);
 
-      draw_task_circle (self, cr, task,
-                        self->hover_element.type == ELEMENT_TASK &&
-                        self->hover_element.index == i,
-                        self->selected_element.type == ELEMENT_TASK &&
-                        self->selected_element.index == i);
-    }
+  if (!hover_is_selected)
+    draw_highlighted_element (self, cr, self->hover_element.type,
+                              self->hover_element.index,
+                              self->hover_element.iter, TRUE, FALSE);
 
   /* Draw the dispatch lines for the selected source. */
   if (self->selected_element.type == ELEMENT_SOURCE)
@@ -1483,27 +2896,43 @@ dwl_timeline_draw (GtkWidget *widget,
     }
   else if (self->selected_element.type == ELEMENT_CONTEXT_DISPATCH)
     {
-      g_autoptr (DflTimeSequenceIter) main_context_iter = NULL;
-      DflTimestamp main_context_timestamp;
+      g_autoptr (GHashTable) dispatched_sources = NULL;  /* set of unowned DflSource */
+      GHashTableIter dispatched_sources_iter;
+      DflMainContext *main_context;
       DflMainContextDispatchData *main_context_data;
+      const DflDispatch *source_dispatches;
+      guint n_source_dispatches;
+      DflSource *source;
 
       /* For each of the sources in this main context dispatch, highlight them
-       * and draw their dispatch lines. */
-      main_context_iter = dfl_time_sequence_iter_copy (self->selected_element.iter);
-      main_context_timestamp = dfl_time_sequence_iter_get_timestamp (self->selected_element.iter);
+       * and draw their dispatch lines. The model has already linked the
+       * main context dispatch to the source dispatches within it. */
+      main_context = self->main_contexts->pdata[self->selected_element.index];
       main_context_data = dfl_time_sequence_iter_get_data (self->selected_element.iter);
+      dispatched_sources = g_hash_table_new (NULL, NULL);
 
-      /* TODO: Speed this up. Perhaps move the list of dispatched sources into
-       * DflMainContextDispatchData? */
-      for (i = 0; i < self->sources->len; i++)
+      source_dispatches = dfl_main_context_get_source_dispatches (main_context,
+                                                                  main_context_data,
+                                                                  &n_source_dispatches);
+
+      for (i = 0; i < n_source_dispatches; i++)
         {
-          DflSource *source = self->sources->pdata[i];
-          gdouble thread_centre, source_x, source_y;
-          guint thread_index;
+          const DflDispatch *source_dispatch = &source_dispatches[i];
           DflTimeSequenceIter source_iter;
-          DflTimestamp source_timestamp;
           DflSourceDispatchData *source_data;
-          gboolean dispatch_drawn;
+          gdouble thread_centre, source_x, source_y;
+          guint thread_index;
+
+          source = source_dispatch->source;
+
+          /* Look up the rest of the dispatch’s details. */
+          dfl_source_dispatch_iter_range (source, &source_iter,
+                                          source_dispatch->timestamp,
+                                          source_dispatch->timestamp);
+
+          if (!dfl_time_sequence_iter_next (&source_iter, NULL,
+                                            (gpointer *) &source_data))
+            g_assert_not_reached ();
 
           thread_index = thread_id_to_index (self,
                                              dfl_source_get_new_thread_id (source));
@@ -1514,30 +2943,33 @@ dwl_timeline_draw (GtkWidget *widget,
           source_y = timestamp_to_y (self, dfl_source_get_new_timestamp (source) - min_timestamp);
 
           /* Render the source’s dispatches. Each dispatch is rendered as a
-           * horizontal line from the thread where it occurs, across to line up with
-           * the column containing the source, round the corner, then up to where
-           * the source is rendered (the g_source_new()). */
+           * horizontal line from the thread where it occurs, across to line up
+           * with the column containing the source, round the corner, then up
+           * to where the source is rendered (the g_source_new()). */
+          draw_source_dispatch_line (self, cr, source, source_x, source_y,
+                                     source_dispatch->timestamp, source_data);
+
+          g_hash_table_add (dispatched_sources, source);
+        }
 
-          dfl_source_dispatch_iter (source, &source_iter,
-                                    dfl_time_sequence_iter_get_timestamp (main_context_iter));
-          dispatch_drawn = FALSE;
+      /* Re-render the dispatched source circles to make sure they’re on
+       * top. */
+      g_hash_table_iter_init (&dispatched_sources_iter, dispatched_sources);
 
-          while (dfl_time_sequence_iter_next (&source_iter, &source_timestamp,
-                                              (gpointer *) &source_data))
-            {
-              if (source_data->thread_id != main_context_data->thread_id ||
-                  source_timestamp < main_context_timestamp ||
-                  source_timestamp > main_context_timestamp +
-                  main_context_data->duration)
-                continue;
-
-              draw_source_dispatch_line (self, cr, source, source_x, source_y,
-                                         source_timestamp, source_data);
-              dispatch_drawn = TRUE;
-            }
+      while (g_hash_table_iter_next (&dispatched_sources_iter,
+                                     (gpointer *) &source, NULL))
+        {
+          gdouble thread_centre, source_x, source_y;
+          guint thread_index;
+
+          thread_index = thread_id_to_index (self,
+                                             dfl_source_get_new_thread_id (source));
+          thread_centre = thread_index_to_centre (self, thread_index);
+
+          source_x = thread_centre - SOURCE_OFFSET;
+          source_y = timestamp_to_y (self, dfl_source_get_new_timestamp (source) - min_timestamp);
 
-          if (dispatch_drawn)
-            draw_source_selected (self, cr, source, source_x, source_y);
+          draw_source_selected (self, cr, source, source_x, source_y);
         }
     }
   else if (self->selected_element.type == ELEMENT_TASK)
@@ -1548,10 +2980,10 @@ dwl_timeline_draw (GtkWidget *widget,
       draw_task_return_propagate_lines (self, cr, task);
 
       /* Re-render the task new circle to make sure it’s on top. */
-      draw_task_circle (self, cr, task,
-                        self->hover_element.type == ELEMENT_TASK &&
-                        self->hover_element.index == self->selected_element.index,
-                        TRUE);
+      draw_highlighted_element (self, cr, ELEMENT_TASK,
+                                self->selected_element.index, NULL,
+                                hover_is_selected, TRUE);
+      draw_task_labels (self, cr, task);
     }
 
   return FALSE;
@@ -1682,6 +3114,70 @@ dwl_timeline_scroll_event (GtkWidget      *widget,
   return GDK_EVENT_PROPAGATE;
 }
 
+/* Find an element drawn as a square of side @width, centred on @element_x
+ * horizontally and on its timestamp vertically, in the column for
+ * @thread_index in @columns, which contains the point (@x, @y). Return its
+ * index, or %G_MAXUINT if there is none. This is O(log n) in the number of
+ * elements in the column, plus the number which overlap @y. */
+static guint
+column_find (DwlTimeline *self,
+             GPtrArray   *columns,
+             guint        thread_index,
+             gdouble      element_x,
+             gdouble      width,
+             gdouble      x,
+             gdouble      y)
+{
+  GArray *column;
+  guint lower, upper, i;
+
+  if (thread_index >= columns->len ||
+      x < element_x - width / 2.0 ||
+      x > element_x + width / 2.0)
+    return G_MAXUINT;
+
+  column = columns->pdata[thread_index];
+
+  /* Find the first element whose bottom edge is at or below @y. The elements
+   * are sorted by timestamp, so their Y coordinates are monotonic. */
+  lower = 0;
+  upper = column->len;
+
+  while (lower < upper)
+    {
+      guint mid = lower + (upper - lower) / 2;
+      const DwlTimelineColumnEntry *entry;
+
+      entry = &g_array_index (column, DwlTimelineColumnEntry, mid);
+
+      if (timestamp_to_y (self, entry->timestamp - self->min_timestamp) +
+          width / 2.0 < y)
+        lower = mid + 1;
+      else
+        upper = mid;
+    }
+
+  /* Check the elements from there until the first whose top edge is below
+   * @y. */
+  for (i = lower; i < column->len; i++)
+    {
+      const DwlTimelineColumnEntry *entry;
+      gdouble element_y;
+
+      entry = &g_array_index (column, DwlTimelineColumnEntry, i);
+      element_y = timestamp_to_y (self, entry->timestamp - self->min_timestamp);
+
+      if (element_y - width / 2.0 > y)
+        break;
+
+      if (y >= element_y - width / 2.0 &&
+          y <= element_y + width / 2.0)
+        return entry->index;
+    }
+
+  return G_MAXUINT;
+}
+
 static gboolean
 dwl_timeline_motion_notify_event (GtkWidget      *widget,
                                   GdkEventMotion *event)
@@ -1696,6 +3192,7 @@ dwl_timeline_motion_notify_event (GtkWidget      *widget,
   DflTimestamp min_timestamp;
   gdouble thread_width, nearest_thread_centre;
   guint nearest_thread_index;
+  DflTimestamp window_start, window_end;
   DwlTimelineElement new_hover_type = ELEMENT_NONE;
   guint new_hover_index = 0;
   g_autoptr (DflTimeSequenceIter) new_hover_iter = NULL;
@@ -1721,57 +3218,50 @@ dwl_timeline_motion_notify_event (GtkWidget      *widget,
     }
 
   /* Within nearest_thread_index’s column. Search for sources. */
-  for (i = 0; i < self->sources->len; i++)
-    {
-      DflSource *source = self->sources->pdata[i];
-      gdouble thread_centre, source_x, source_y;
-      guint thread_index;
-
-      thread_index = thread_id_to_index (self,
-                                         dfl_source_get_new_thread_id (source));
-
-      if (thread_index != nearest_thread_index)
-        continue;
-
-      thread_centre = thread_index_to_centre (self, thread_index);
-
-      /* Calculate the centre of the source. */
-      source_x = thread_centre - SOURCE_OFFSET;
-      source_y = timestamp_to_y (self, dfl_source_get_new_timestamp (source) - min_timestamp);
+  i = column_find (self, self->source_columns, nearest_thread_index,
+                   nearest_thread_centre - SOURCE_OFFSET, SOURCE_WIDTH,
+                   event->x, event->y);
 
-      /* See if the event was within this source. */
-      if (event->x >= source_x - SOURCE_WIDTH / 2.0 &&
-          event->x <= source_x + SOURCE_WIDTH / 2.0 &&
-          event->y >= source_y - SOURCE_WIDTH / 2.0 &&
-          event->y <= source_y + SOURCE_WIDTH / 2.0)
-        {
-          new_hover_type = ELEMENT_SOURCE;
-          new_hover_index = i;
-          goto done;
-        }
+  if (i != G_MAXUINT)
+    {
+      new_hover_type = ELEMENT_SOURCE;
+      new_hover_index = i;
+      goto done;
     }
 
-  /* What about main context dispatches? */
+  /* What about main context dispatches? Only those which overlap the
+   * timestamps within a couple of pixels of the pointer can contain it. */
+  window_start = min_timestamp +
+                 pixels_to_duration (self,
+                                     MAX (event->y - HEADER_HEIGHT - 2, 0));
+  window_end = min_timestamp +
+               pixels_to_duration (self,
+                                   MAX (event->y - HEADER_HEIGHT + 2, 0));
+
   for (i = 0; i < self->main_contexts->len; i++)
     {
       DflMainContext *main_context = self->main_contexts->pdata[i];
       DflTimeSequenceIter iter;
       DflTimestamp timestamp;
-      DflThreadOwnershipData *data;
+      DflMainContextDispatchData *data;
 
-      /* Iterate through the thread ownership events. */
+      dfl_main_context_dispatch_iter_overlapping (main_context, &iter,
+                                                  window_start, window_end);
 
-      /* TODO: Set the start timestamp according to the clip area */
-      dfl_main_context_dispatch_iter (main_context, &iter, 0);
-
-      while (dfl_time_sequence_iter_next (&iter, &timestamp, (gpointer *) &data))
+      while (dfl_time_sequence_iter_next_overlapping (&iter, &timestamp,
+                                                      (gpointer *) &data))
         {
           gdouble thread_centre, dispatch_width, dispatch_height;
           gdouble dispatch_left, dispatch_right, dispatch_top, dispatch_bottom;
           gint timestamp_y;
           guint thread_index;
+          DflMainContextDispatchData *iter_data;
 
           thread_index = thread_id_to_index (self, data->thread_id);
+
+          if (thread_index != nearest_thread_index)
+            continue;
+
           thread_centre = thread_index_to_centre (self, thread_index);
           timestamp_y = timestamp_to_y (self, timestamp - min_timestamp);
 
@@ -1788,6 +3278,15 @@ dwl_timeline_motion_notify_event (GtkWidget      *widget,
               event->y >= dispatch_bottom &&
               event->y <= dispatch_top)
             {
+              /* Return an iterator over the whole sequence, rather than the
+               * window, so it can be used to move the selection later. */
+              dfl_main_context_dispatch_iter (main_context, &iter, timestamp);
+
+              while (dfl_time_sequence_iter_next (&iter, NULL,
+                                                  (gpointer *) &iter_data) &&
+                     iter_data != data)
+                ;
+
               new_hover_type = ELEMENT_CONTEXT_DISPATCH;
               new_hover_index = i;
               new_hover_iter = dfl_time_sequence_iter_copy (&iter);
@@ -1797,32 +3296,15 @@ dwl_timeline_motion_notify_event (GtkWidget      *widget,
     }
 
   /* Search for tasks. */
-  for (i = 0; i < self->tasks->len; i++)
-    {
-      DflTask *task = self->tasks->pdata[i];
-      gdouble task_x, task_y;
-      guint thread_index;
-
-      thread_index = thread_id_to_index (self,
-                                         dfl_task_get_new_thread_id (task));
-
-      if (thread_index != nearest_thread_index)
-        continue;
-
-      /* Calculate the centre of the task circles. */
-      task_x = thread_index_to_centre (self, thread_index) + TASK_OFFSET;
-      task_y = timestamp_to_y (self, dfl_task_get_new_timestamp (task) - min_timestamp);
+  i = column_find (self, self->task_columns, nearest_thread_index,
+                   nearest_thread_centre + TASK_OFFSET, TASK_WIDTH,
+                   event->x, event->y);
 
-      /* See if the event was within the new circle for this task. */
-      if (event->x >= task_x - TASK_WIDTH / 2.0 &&
-          event->x <= task_x + TASK_WIDTH / 2.0 &&
-          event->y >= task_y - TASK_WIDTH / 2.0 &&
-          event->y <= task_y + TASK_WIDTH / 2.0)
-        {
-          new_hover_type = ELEMENT_TASK;
-          new_hover_index = i;
-          goto done;
-        }
+  if (i != G_MAXUINT)
+    {
+      new_hover_type = ELEMENT_TASK;
+      new_hover_index = i;
+      goto done;
     }
 
   /* No hover element found. */
@@ -2181,6 +3663,7 @@ dwl_timeline_set_zoom (DwlTimeline *self,
   g_debug ("%s: Setting zoom to %f", G_STRFUNC, new_zoom);
 
   self->zoom = new_zoom;
+  invalidate_tiles (self);
   g_object_notify (G_OBJECT (self), "zoom");
   gtk_widget_queue_resize (GTK_WIDGET (self));
 
@@ -0,0 +1,75 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFL_BINARY_LOG_H
+#define DFL_BINARY_LOG_H
+
+#include <glib.h>
+#include <string.h>
+
+G_BEGIN_DECLS
+
+/* Definitions shared between the reader (#DflParser) and writer (#DflWriter)
+ * for version 2.0 of the log format, which is binary. The layout is documented
+ * in the #DflWriter section documentation. All integers are little-endian. */
+
+/* The magic is chosen so that the first line of a binary log looks like the
+ * header of a text log. */
+#define DFL_BINARY_LOG_MAGIC "Dunfell log,2.0\n"
+#define DFL_BINARY_LOG_MAGIC_LENGTH 16
+
+/* magic, initial timestamp, number of events, number of strings, number of
+ * event types */
+#define DFL_BINARY_LOG_HEADER_LENGTH (DFL_BINARY_LOG_MAGIC_LENGTH + 8 + 8 + 4 + 4)
+
+/* name string index, number of parameters, parameter kinds */
+#define DFL_BINARY_LOG_EVENT_TYPE_LENGTH (4 + 4 + 4)
+
+/* timestamp, thread ID, event type index, reserved; followed by 8 bytes for
+ * each parameter */
+#define DFL_BINARY_LOG_EVENT_HEADER_LENGTH (8 + 8 + 4 + 4)
+#define DFL_BINARY_LOG_PARAMETER_LENGTH 8
+
+/* Parameter kinds are stored as a bitmask in the event type table, so this is
+ * limited by the width of the mask. */
+#define DFL_BINARY_LOG_MAX_PARAMETERS 32
+
+G_STATIC_ASSERT (sizeof (DFL_BINARY_LOG_MAGIC) == DFL_BINARY_LOG_MAGIC_LENGTH + 1);
+
+/* The data may not be aligned, so copy it out rather than dereferencing. */
+static inline guint32
+dfl_binary_log_read_uint32 (const guint8 *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof (value));
+  return GUINT32_FROM_LE (value);
+}
+
+static inline guint64
+dfl_binary_log_read_uint64 (const guint8 *data)
+{
+  guint64 value;
+
+  memcpy (&value, data, sizeof (value));
+  return GUINT64_FROM_LE (value);
+}
+
+G_END_DECLS
+
+#endif /* !DFL_BINARY_LOG_H */
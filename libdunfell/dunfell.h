@@ -22,6 +22,7 @@
 /* Core files */
 #include <libdunfell/event.h>
 #include <libdunfell/event-sequence.h>
+#include <libdunfell/histogram.h>
 #include <libdunfell/main-context.h>
 #include <libdunfell/model.h>
 #include <libdunfell/parser.h>
@@ -31,5 +32,6 @@
 #include <libdunfell/time-sequence.h>
 #include <libdunfell/types.h>
 #include <libdunfell/version.h>
+#include <libdunfell/writer.h>
 
 #endif /* !DFL_H */
@@ -0,0 +1,299 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "duration-statistics.h"
+
+
+#define SUB_BUCKET_BITS DFL_DURATION_STATISTICS_SUB_BUCKET_BITS
+#define SUB_BUCKETS DFL_DURATION_STATISTICS_SUB_BUCKETS
+
+static const gdouble standard_quantiles[DFL_DURATION_N_QUANTILES] = {
+  0.5, 0.9, 0.99, 0.999,
+};
+
+/* Index of the most significant set bit of @value, which must be non-zero. */
+static guint
+most_significant_bit (guint64 value)
+{
+  if ((value >> 32) != 0)
+    return 32 + g_bit_storage ((gulong) (value >> 32)) - 1;
+  else
+    return g_bit_storage ((gulong) value) - 1;
+}
+
+/* Durations below 2 × %SUB_BUCKETS each have their own bucket. Above that,
+ * each power of two is split into %SUB_BUCKETS equally sized buckets. */
+static guint
+duration_to_bucket (DflDuration duration)
+{
+  guint64 value = duration;
+  guint shift;
+
+  if (value < 2 * SUB_BUCKETS)
+    return value;
+
+  shift = most_significant_bit (value) - SUB_BUCKET_BITS;
+
+  return (shift + 1) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS;
+}
+
+/* Range of durations counted in @bucket, inclusive. */
+static void
+bucket_to_range (guint        bucket,
+                 DflDuration *lower,
+                 DflDuration *upper)
+{
+  guint shift;
+
+  if (bucket < 2 * SUB_BUCKETS)
+    {
+      *lower = bucket;
+      *upper = bucket;
+      return;
+    }
+
+  shift = bucket / SUB_BUCKETS - 1;
+  *lower = (guint64) (bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+  *upper = *lower + (((guint64) 1 << shift) - 1);
+}
+
+/* Midpoint of the range of durations counted in @bucket. */
+static DflDuration
+bucket_to_duration (guint bucket)
+{
+  DflDuration lower, upper;
+
+  bucket_to_range (bucket, &lower, &upper);
+
+  return lower + (upper - lower) / 2;
+}
+
+/* Ensure the allocated range of buckets covers [@first, @last]. */
+static void
+ensure_buckets (DflDurationStatistics *stats,
+                guint                  first,
+                guint                  last)
+{
+  if (stats->counts == NULL)
+    {
+      stats->counts = g_new0 (guint32, last - first + 1);
+      stats->first_bucket = first;
+      stats->n_buckets = last - first + 1;
+      return;
+    }
+
+  if (first < stats->first_bucket)
+    {
+      guint n_new = stats->first_bucket - first;
+
+      stats->counts = g_renew (guint32, stats->counts,
+                               stats->n_buckets + n_new);
+      memmove (stats->counts + n_new, stats->counts,
+               stats->n_buckets * sizeof (*stats->counts));
+      memset (stats->counts, 0, n_new * sizeof (*stats->counts));
+      stats->first_bucket = first;
+      stats->n_buckets += n_new;
+    }
+
+  if (last >= stats->first_bucket + stats->n_buckets)
+    {
+      guint n_new = last - (stats->first_bucket + stats->n_buckets) + 1;
+
+      stats->counts = g_renew (guint32, stats->counts,
+                               stats->n_buckets + n_new);
+      memset (stats->counts + stats->n_buckets, 0,
+              n_new * sizeof (*stats->counts));
+      stats->n_buckets += n_new;
+    }
+}
+
+void
+_dfl_duration_statistics_init (DflDurationStatistics *stats)
+{
+  memset (stats, 0, sizeof (*stats));
+}
+
+void
+_dfl_duration_statistics_clear (DflDurationStatistics *stats)
+{
+  g_free (stats->counts);
+  _dfl_duration_statistics_init (stats);
+}
+
+/* Add @duration, which must be non-negative. */
+void
+_dfl_duration_statistics_add (DflDurationStatistics *stats,
+                              DflDuration            duration)
+{
+  guint bucket;
+
+  g_return_if_fail (duration >= 0);
+
+  if (stats->n_durations == 0)
+    {
+      stats->min = duration;
+      stats->max = duration;
+    }
+  else
+    {
+      stats->min = MIN (stats->min, duration);
+      stats->max = MAX (stats->max, duration);
+    }
+
+  stats->n_durations++;
+  stats->sum += duration;
+  stats->quantiles_valid = FALSE;
+
+  bucket = duration_to_bucket (duration);
+  ensure_buckets (stats, bucket, bucket);
+  stats->counts[bucket - stats->first_bucket]++;
+}
+
+/* Remove @duration, which must previously have been added. The minimum and
+ * maximum are not updated, as that would need the durations to be kept; this
+ * is only needed to correct durations in malformed logs, so that is not worth
+ * it. */
+void
+_dfl_duration_statistics_remove (DflDurationStatistics *stats,
+                                 DflDuration            duration)
+{
+  guint bucket;
+
+  g_return_if_fail (stats->n_durations > 0);
+
+  bucket = duration_to_bucket (duration);
+  g_return_if_fail (bucket >= stats->first_bucket &&
+                    bucket < stats->first_bucket + stats->n_buckets);
+  g_return_if_fail (stats->counts[bucket - stats->first_bucket] > 0);
+
+  stats->counts[bucket - stats->first_bucket]--;
+  stats->n_durations--;
+  stats->sum -= duration;
+  stats->quantiles_valid = FALSE;
+}
+
+/* Add all the durations from @other to @stats. */
+void
+_dfl_duration_statistics_merge (DflDurationStatistics       *stats,
+                                const DflDurationStatistics *other)
+{
+  guint i, offset;
+
+  if (other->n_durations == 0)
+    return;
+
+  if (stats->n_durations == 0)
+    {
+      stats->min = other->min;
+      stats->max = other->max;
+    }
+  else
+    {
+      stats->min = MIN (stats->min, other->min);
+      stats->max = MAX (stats->max, other->max);
+    }
+
+  stats->n_durations += other->n_durations;
+  stats->sum += other->sum;
+  stats->quantiles_valid = FALSE;
+
+  ensure_buckets (stats, other->first_bucket,
+                  other->first_bucket + other->n_buckets - 1);
+  offset = other->first_bucket - stats->first_bucket;
+
+  for (i = 0; i < other->n_buckets; i++)
+    stats->counts[offset + i] += other->counts[i];
+}
+
+/* Get the range of durations counted by the bucket at @index in the allocated
+ * range of buckets, and how many durations it has counted. */
+void
+_dfl_duration_statistics_get_bucket (const DflDurationStatistics *stats,
+                                     guint                        index,
+                                     DflDuration                 *lower,
+                                     DflDuration                 *upper,
+                                     guint64                     *count)
+{
+  g_return_if_fail (index < stats->n_buckets);
+
+  bucket_to_range (stats->first_bucket + index, lower, upper);
+  *count = stats->counts[index];
+}
+
+/* Calculate the approximate duration at @quantile (between 0 and 1 inclusive)
+ * of the distribution. This walks the histogram, so is linear in the number of
+ * allocated buckets; use _dfl_duration_statistics_get_standard_quantile() for
+ * cached results. Returns 0 if there are no durations. */
+DflDuration
+_dfl_duration_statistics_get_quantile (DflDurationStatistics *stats,
+                                       gdouble                quantile)
+{
+  guint64 rank, cumulative;
+  gdouble exact_rank;
+  guint i;
+
+  g_return_val_if_fail (quantile >= 0.0 && quantile <= 1.0, 0);
+
+  if (stats->n_durations == 0)
+    return 0;
+
+  /* Round the rank up. */
+  exact_rank = quantile * stats->n_durations;
+  rank = (guint64) exact_rank;
+  if ((gdouble) rank < exact_rank)
+    rank++;
+  rank = CLAMP (rank, 1, stats->n_durations);
+  cumulative = 0;
+
+  for (i = 0; i < stats->n_buckets; i++)
+    {
+      cumulative += stats->counts[i];
+
+      if (cumulative >= rank)
+        return CLAMP (bucket_to_duration (stats->first_bucket + i),
+                      stats->min, stats->max);
+    }
+
+  /* The counts must sum to @n_durations. */
+  g_assert_not_reached ();
+  return stats->max;
+}
+
+DflDuration
+_dfl_duration_statistics_get_standard_quantile (DflDurationStatistics *stats,
+                                                DflDurationQuantile    quantile)
+{
+  guint i;
+
+  g_return_val_if_fail (quantile < DFL_DURATION_N_QUANTILES, 0);
+
+  if (!stats->quantiles_valid)
+    {
+      for (i = 0; i < DFL_DURATION_N_QUANTILES; i++)
+        stats->quantiles[i] = _dfl_duration_statistics_get_quantile (stats,
+                                                                     standard_quantiles[i]);
+      stats->quantiles_valid = TRUE;
+    }
+
+  return stats->quantiles[quantile];
+}
@@ -0,0 +1,103 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFL_DURATION_STATISTICS_H
+#define DFL_DURATION_STATISTICS_H
+
+#include <glib.h>
+
+#include "histogram.h"
+#include "source.h"
+#include "types.h"
+
+G_BEGIN_DECLS
+
+/* Internal summary of a set of non-negative durations, maintained
+ * incrementally as durations are added. The count, sum, minimum and maximum
+ * are exact. Quantiles come from a log-bucketed histogram with
+ * %DFL_DURATION_STATISTICS_SUB_BUCKETS buckets per power of two, so are
+ * accurate to within about 2%; durations smaller than twice that are counted
+ * exactly.
+ *
+ * Only the range of buckets which have been used is allocated, so a summary of
+ * a few similar durations is small. The standard quantiles are cached, so
+ * reading them repeatedly is constant time and does not allocate.
+ *
+ * The functions here are prefixed with an underscore so they are not exported
+ * from the library. */
+#define DFL_DURATION_STATISTICS_SUB_BUCKET_BITS 5
+#define DFL_DURATION_STATISTICS_SUB_BUCKETS (1 << DFL_DURATION_STATISTICS_SUB_BUCKET_BITS)
+
+typedef enum
+{
+  DFL_DURATION_QUANTILE_P50 = 0,
+  DFL_DURATION_QUANTILE_P90,
+  DFL_DURATION_QUANTILE_P99,
+  DFL_DURATION_QUANTILE_P999,
+} DflDurationQuantile;
+
+#define DFL_DURATION_N_QUANTILES (DFL_DURATION_QUANTILE_P999 + 1)
+
+typedef struct
+{
+  guint64 n_durations;
+  DflDuration sum;
+  DflDuration min;
+  DflDuration max;
+
+  /* Histogram buckets [@first_bucket, @first_bucket + @n_buckets). */
+  guint32 *counts;  /* owned; nullable */
+  guint first_bucket;
+  guint n_buckets;
+
+  gboolean quantiles_valid;
+  DflDuration quantiles[DFL_DURATION_N_QUANTILES];
+} DflDurationStatistics;
+
+void        _dfl_duration_statistics_init      (DflDurationStatistics *stats);
+void        _dfl_duration_statistics_clear     (DflDurationStatistics *stats);
+
+void        _dfl_duration_statistics_add       (DflDurationStatistics *stats,
+                                                DflDuration            duration);
+void        _dfl_duration_statistics_remove    (DflDurationStatistics *stats,
+                                                DflDuration            duration);
+void        _dfl_duration_statistics_merge     (DflDurationStatistics       *stats,
+                                                const DflDurationStatistics *other);
+
+void        _dfl_duration_statistics_get_bucket (const DflDurationStatistics *stats,
+                                                 guint                        index,
+                                                 DflDuration                 *lower,
+                                                 DflDuration                 *upper,
+                                                 guint64                     *count);
+
+DflDuration _dfl_duration_statistics_get_quantile       (DflDurationStatistics *stats,
+                                                         gdouble                quantile);
+DflDuration _dfl_duration_statistics_get_standard_quantile (DflDurationStatistics *stats,
+                                                            DflDurationQuantile    quantile);
+
+/* Constructor and accessors for the public objects which wrap or maintain a
+ * summary. */
+DflHistogram *_dfl_histogram_new_from_statistics (const DflDurationStatistics *stats);
+void          _dfl_histogram_merge_statistics    (DflHistogram                *self,
+                                                  const DflDurationStatistics *stats);
+
+const DflDurationStatistics *_dfl_source_get_dispatch_durations (DflSource *self);
+
+G_END_DECLS
+
+#endif /* !DFL_DURATION_STATISTICS_H */
@@ -23,20 +23,31 @@
  * @include: libdunfell/event-sequence.h
  *
  * An //event sequence// is a list of #DflEvents, in ascending time order. It
- * uses a moderately compact representation which is optimised for in-order
- * iteration over the sequence (‘walking’ over it from start to finish). It
+ * uses a compact columnar representation which is optimised for in-order
+ * iteration over the sequence (‘walking’ over it from start to finish); the
+ * #DflEvent objects returned by g_list_model_get_item() and passed to walkers
+ * are created on demand, so retrieving the same event twice may return two
+ * different (but equal) objects. It
  * supports matching events to dispatch callbacks ([‘walkers’](#walkers)) for
  * analysing the event sequence.
  *
+ * A sequence which is being loaded by dfl_parser_load_from_stream_async() grows
+ * as batches of events are parsed. Events are only ever appended, and
+ * #GListModel::items-changed is emitted for each batch.
+ *
  * # Walkers # {#walkers}
  *
  * A //walker// is a callback function which is executed for each event out of
  * the #DflEventSequence which matches a set of conditions. Walkers can match on
  * event type or event type and ID. Walking over the event sequence using
  * dfl_event_sequence_walk() will call all installed walkers which match each
- * event, in the order the events are presented in the sequence. There are no
- * guarantees about which order the walkers which match a particular event are
- * called in.
+ * event, in the order the events are presented in the sequence. The walkers
+ * which match a particular event are called in the order they were added.
+ *
+ * Each call to dfl_event_sequence_walk() walks over the whole sequence. (A
+ * #DflModel walks incrementally instead, passing only the events appended to
+ * the sequence since its previous walk to its walkers, so they see each event
+ * exactly once, in order, however the sequence was loaded.)
  *
  * Walkers can be installed on the #DflEventSequence using
  * dfl_event_sequence_add_walker(), which may be called at any time before or
@@ -75,6 +86,7 @@
 
 #include "event.h"
 #include "event-sequence.h"
+#include "event-table.h"
 
 
 static void dfl_event_sequence_list_model_init (GListModelInterface *iface);
@@ -88,20 +100,52 @@ typedef struct
 {
   const gchar *event_type;  /* nullable, unowned, interned */
   DflId id;  /* could be %DFL_ID_INVALID */
-  DflEventWalker walker;
+  DflEventWalker walker;  /* %NULL iff the walker has been removed */
   gpointer user_data;  /* nullable */
   GDestroyNotify destroy_user_data;  /* nullable */
 } DflEventSequenceWalkerClosure;
 
+/* Walkers matching a specific event ID for a given event type. */
+typedef struct
+{
+  GArray/*<guint>*/ *walker_ids;  /* owned */
+} DflEventSequenceIdBucket;
+
+/* Walkers matching a given event type (or all event types, if the bucket is
+ * keyed by %NULL). Walkers which match any ID are in @walker_ids; walkers
+ * which match a specific ID are in the corresponding @id_buckets entry. */
+typedef struct
+{
+  GArray/*<guint>*/ *walker_ids;  /* owned */
+  GHashTable/*<DflId, owned DflEventSequenceIdBucket>*/ *id_buckets;  /* owned */
+} DflEventSequenceTypeBucket;
+
 struct _DflEventSequence
 {
   GObject parent;
 
-  DflEvent **events;  /* owned */
-  guint n_events;
+  DflEventTable *table;  /* owned */
   guint64 initial_timestamp;
-
-  GArray/*<DflEventWalkerClosure>*/ *walkers;  /* owned */
+  guint n_walked_events;  /* number of events passed to walkers by
+                           * _dfl_event_sequence_resume_walk() so far */
+
+  /* Events appended while the sequence is frozen are held here until it is
+   * thawed. See _dfl_event_sequence_freeze(). */
+  guint freeze_count;
+  DflEventTable *frozen_events;  /* owned; nullable */
+
+  /* Walker closures, by walker ID. Walker IDs are allocated in increasing
+   * order from @next_walker_id and never reused. A removed walker leaves a
+   * tombstone (a closure with a %NULL walker) until it is purged from the
+   * @type_buckets index after the event being walked, and is then freed. */
+  GHashTable/*<guint, owned DflEventSequenceWalkerClosure>*/ *walkers;  /* owned */
+  guint next_walker_id;
+  GArray/*<guint>*/ *removed_walker_ids;  /* owned; pending purge */
+
+  /* Index of walker IDs by event type (interned, including %NULL for walkers
+   * which match all event types) and then by event ID. This means that walking
+   * an event only has to consider the walkers which could match it. */
+  GHashTable/*<unowned utf8, owned DflEventSequenceTypeBucket>*/ *type_buckets;  /* owned */
 
   GArray/*<guint>*/ *walker_group;  /* owned; nullable */
 };
@@ -127,45 +171,85 @@ dfl_event_sequence_list_model_init (GListModelInterface *iface)
 }
 
 static void
-walkers_clear_cb (gpointer user_data)
+walker_closure_free (DflEventSequenceWalkerClosure *closure)
 {
-  DflEventSequenceWalkerClosure *closure = user_data;
-
   if (closure->user_data != NULL && closure->destroy_user_data != NULL)
     closure->destroy_user_data (closure->user_data);
 
-  closure->event_type = NULL;
-  closure->id = DFL_ID_INVALID;
-  closure->walker = NULL;
-  closure->user_data = NULL;
-  closure->destroy_user_data = NULL;
+  g_free (closure);
+}
+
+static DflEventSequenceIdBucket *
+id_bucket_new (void)
+{
+  DflEventSequenceIdBucket *bucket = NULL;
+
+  bucket = g_new0 (DflEventSequenceIdBucket, 1);
+  bucket->walker_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return bucket;
+}
+
+static void
+id_bucket_free (DflEventSequenceIdBucket *bucket)
+{
+  g_array_unref (bucket->walker_ids);
+  g_free (bucket);
+}
+
+static DflEventSequenceTypeBucket *
+type_bucket_new (void)
+{
+  DflEventSequenceTypeBucket *bucket = NULL;
+
+  bucket = g_new0 (DflEventSequenceTypeBucket, 1);
+  bucket->walker_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+  /* #DflId is a #guintptr, so can be stored directly in the key pointer. */
+  bucket->id_buckets = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify) id_bucket_free);
+
+  return bucket;
+}
+
+static void
+type_bucket_free (DflEventSequenceTypeBucket *bucket)
+{
+  g_hash_table_unref (bucket->id_buckets);
+  g_array_unref (bucket->walker_ids);
+  g_free (bucket);
 }
 
 static void
 dfl_event_sequence_init (DflEventSequence *self)
 {
-  self->walkers = g_array_new (FALSE, FALSE,
-                               sizeof (DflEventSequenceWalkerClosure));
-  g_array_set_clear_func (self->walkers, walkers_clear_cb);
+  self->walkers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                         (GDestroyNotify) walker_closure_free);
+  self->next_walker_id = 1;
+
+  self->removed_walker_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* Event types are interned, so can be compared by pointer. */
+  self->type_buckets = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify) type_bucket_free);
 }
 
 static void
 dfl_event_sequence_dispose (GObject *object)
 {
   DflEventSequence *self = DFL_EVENT_SEQUENCE (object);
-  guint i;
 
   /* The programmer must have closed any walker groups before disposing the
    * event sequence. */
   g_assert (self->walker_group == NULL);
 
-  for (i = 0; i < self->n_events; i++)
-    g_object_unref (self->events[i]);
-
-  g_clear_pointer (&self->events, g_free);
-  self->n_events = 0;
+  g_clear_pointer (&self->frozen_events, _dfl_event_table_unref);
+  g_clear_pointer (&self->table, _dfl_event_table_unref);
 
-  g_clear_pointer (&self->walkers, g_array_unref);
+  g_clear_pointer (&self->type_buckets, g_hash_table_unref);
+  g_clear_pointer (&self->removed_walker_ids, g_array_unref);
+  g_clear_pointer (&self->walkers, g_hash_table_unref);
 
   /* Chain up to the parent class */
   G_OBJECT_CLASS (dfl_event_sequence_parent_class)->dispose (object);
@@ -182,7 +266,7 @@ dfl_event_sequence_get_n_items (GListModel *list)
 {
   DflEventSequence *self = DFL_EVENT_SEQUENCE (list);
 
-  return self->n_events;
+  return _dfl_event_table_get_n_events (self->table);
 }
 
 static gpointer
@@ -191,10 +275,10 @@ dfl_event_sequence_get_item (GListModel  *list,
 {
   DflEventSequence *self = DFL_EVENT_SEQUENCE (list);
 
-  if (position >= self->n_events)
+  if (position >= _dfl_event_table_get_n_events (self->table))
     return NULL;
 
-  return self->events[position];
+  return _dfl_event_new_from_table (self->table, position);
 }
 
 /**
@@ -204,7 +288,8 @@ dfl_event_sequence_get_item (GListModel  *list,
  * @initial_timestamp: the timestamp of the start of the sequence (before the
  *    first event)
  *
- * TODO
+ * Create a new #DflEventSequence containing a copy of the data from each of
+ * @events. The sequence does not keep a reference to @events.
  *
  * Returns: (transfer full): a new #DflEventSequence
  * Since: 0.1.0
@@ -215,26 +300,161 @@ dfl_event_sequence_new (const DflEvent **events,
                         guint64          initial_timestamp)
 {
   DflEventSequence *obj = NULL;
+  DflEventTable *table = NULL;
+  GArray/*<DflEventParameter>*/ *parameters = NULL;
+  GArray/*<DflEventParameterKind>*/ *kinds = NULL;
   guint i;
 
   g_return_val_if_fail (n_events == 0 || events != NULL, NULL);
-  g_return_val_if_fail (n_events < G_MAXUINT / sizeof (DflEvent *), NULL);
 
-  obj = g_object_new (DFL_TYPE_EVENT_SEQUENCE, NULL);
-  obj->events = g_memdup (events, sizeof (DflEvent *) * n_events);
-  obj->n_events = n_events;
-  obj->initial_timestamp = initial_timestamp;
+  for (i = 0; i < n_events; i++)
+    g_return_val_if_fail (DFL_IS_EVENT ((DflEvent *) events[i]), NULL);
+
+  table = _dfl_event_table_new ();
+  parameters = g_array_new (FALSE, FALSE, sizeof (DflEventParameter));
+  kinds = g_array_new (FALSE, FALSE, sizeof (DflEventParameterKind));
 
-  /* Reference all the events. */
   for (i = 0; i < n_events; i++)
     {
-      g_return_val_if_fail (DFL_IS_EVENT (obj->events[i]), NULL);
-      g_object_ref (obj->events[i]);
+      DflEvent *event = (DflEvent *) events[i];
+      guint j, n_parameters;
+
+      n_parameters = dfl_event_get_n_parameters (event);
+      g_array_set_size (parameters, n_parameters);
+      g_array_set_size (kinds, n_parameters);
+
+      for (j = 0; j < n_parameters; j++)
+        g_array_index (kinds, DflEventParameterKind, j) =
+          _dfl_event_get_parameter (event, j,
+                                    &g_array_index (parameters,
+                                                    DflEventParameter, j));
+
+      _dfl_event_table_append (table, dfl_event_get_event_type (event),
+                               dfl_event_get_timestamp (event),
+                               dfl_event_get_thread_id (event),
+                               (const DflEventParameterKind *) kinds->data,
+                               (const DflEventParameter *) parameters->data,
+                               n_parameters);
     }
 
+  g_array_unref (kinds);
+  g_array_unref (parameters);
+
+  obj = _dfl_event_sequence_new_from_table (table, initial_timestamp);
+  _dfl_event_table_unref (table);
+
   return obj;
 }
 
+/* Create a new #DflEventSequence wrapping @table. The @table must not be
+ * modified afterwards, other than through
+ * _dfl_event_sequence_append_table(). */
+DflEventSequence *
+_dfl_event_sequence_new_from_table (DflEventTable *table,
+                                    DflTimestamp   initial_timestamp)
+{
+  DflEventSequence *obj = NULL;
+
+  obj = g_object_new (DFL_TYPE_EVENT_SEQUENCE, NULL);
+  obj->table = _dfl_event_table_ref (table);
+  obj->initial_timestamp = initial_timestamp;
+
+  return obj;
+}
+
+/* Create a new sequence which shares the events in @self, but has its own set
+ * of walkers and its own position for _dfl_event_sequence_resume_walk(). This
+ * allows several independent sets of walkers to walk the same events in
+ * parallel threads, as long as the events are not modified meanwhile.
+ *
+ * Events appended to @self are visible to the view, but the view does not emit
+ * #GListModel::items-changed for them. */
+DflEventSequence *
+_dfl_event_sequence_new_view (DflEventSequence *self)
+{
+  return _dfl_event_sequence_new_from_table (self->table,
+                                             self->initial_timestamp);
+}
+
+/* Append all the events from @events to the end of the sequence, leaving
+ * @events empty, and emit #GListModel::items-changed for them. The events must
+ * all be later than the existing events in the sequence. This must not be
+ * called while walking the sequence. If the sequence is frozen, the events are
+ * held back until it is thawed. */
+void
+_dfl_event_sequence_append_table (DflEventSequence *self,
+                                  DflEventTable    *events)
+{
+  guint n_events, n_added;
+
+  n_events = _dfl_event_table_get_n_events (self->table);
+  n_added = _dfl_event_table_get_n_events (events);
+
+  if (n_added == 0)
+    return;
+
+  if (self->freeze_count > 0)
+    {
+      if (self->frozen_events == NULL)
+        self->frozen_events = _dfl_event_table_new ();
+
+      _dfl_event_table_append_table (self->frozen_events, events);
+
+      return;
+    }
+
+  _dfl_event_table_append_table (self->table, events);
+
+  g_list_model_items_changed (G_LIST_MODEL (self), n_events, 0, n_added);
+}
+
+/* Stop the sequence’s table from being modified until a matching call to
+ * _dfl_event_sequence_thaw(), so that it can safely be walked in another
+ * thread. Events appended in the meantime are held back. Calls may be
+ * nested. */
+void
+_dfl_event_sequence_freeze (DflEventSequence *self)
+{
+  self->freeze_count++;
+}
+
+/* Undo a call to _dfl_event_sequence_freeze(). Once the sequence is no longer
+ * frozen, any events appended while it was frozen are appended to it, and
+ * #GListModel::items-changed is emitted for them. */
+void
+_dfl_event_sequence_thaw (DflEventSequence *self)
+{
+  DflEventTable *frozen_events = NULL;
+
+  g_assert (self->freeze_count > 0);
+
+  self->freeze_count--;
+
+  if (self->freeze_count > 0 || self->frozen_events == NULL)
+    return;
+
+  frozen_events = g_steal_pointer (&self->frozen_events);
+  _dfl_event_sequence_append_table (self, frozen_events);
+  _dfl_event_table_unref (frozen_events);
+}
+
+/**
+ * dfl_event_sequence_get_initial_timestamp:
+ * @self: a #DflEventSequence
+ *
+ * Get the timestamp of the start of the sequence, before the first event.
+ *
+ * Returns: initial timestamp
+ * Since: UNRELEASED
+ */
+DflTimestamp
+dfl_event_sequence_get_initial_timestamp (DflEventSequence *self)
+{
+  g_return_val_if_fail (DFL_IS_EVENT_SEQUENCE (self), 0);
+
+  return self->initial_timestamp;
+}
+
 /**
  * dfl_event_sequence_start_walker_group:
  * @self: a #DflEventSequence
@@ -264,11 +484,18 @@ remove_walkers_cb (DflEventSequence *sequence,
   GArray/*<guint>*/ *walkers = user_data;  /* owned */
   gsize i, n_walkers;
 
+  /* The walker which calls this callback is itself a member of the group, so
+   * removing it will drop the reference held on @walkers by its closure. Keep
+   * @walkers alive until we’ve finished iterating over it. */
+  g_array_ref (walkers);
+
   for (i = 0, n_walkers = walkers->len; i < n_walkers; i++)
     {
       guint walker_id = g_array_index (walkers, guint, i);
       dfl_event_sequence_remove_walker (sequence, walker_id);
     }
+
+  g_array_unref (walkers);
 }
 
 /**
@@ -296,7 +523,8 @@ dfl_event_sequence_end_walker_group (DflEventSequence *self,
   g_return_if_fail (event_type != NULL);
   g_return_if_fail (self->walker_group != NULL);
 
-  /* Remove the walkers once the next @event_type is seen which matches @id. */
+  /* Remove the walkers once the next @event_type is seen which matches @id.
+   * The removal walker is added to the group too, so it removes itself. */
   if (self->walker_group->len > 0)
     {
       dfl_event_sequence_add_walker (self, event_type, id,
@@ -343,26 +571,66 @@ dfl_event_sequence_add_walker (DflEventSequence *self,
                                gpointer          user_data,
                                GDestroyNotify    destroy_user_data)
 {
-  DflEventSequenceWalkerClosure closure;
+  DflEventSequenceWalkerClosure *closure = NULL;
+  DflEventSequenceTypeBucket *type_bucket;
+  GArray/*<guint>*/ *walker_ids;
+  guint walker_id;
 
   g_return_val_if_fail (DFL_IS_EVENT_SEQUENCE (self), 0);
   g_return_val_if_fail (event_type == NULL || *event_type != '\0', 0);
   g_return_val_if_fail (event_type != NULL || id == DFL_ID_INVALID, 0);
   g_return_val_if_fail (walker != NULL, 0);
 
-  closure.event_type = g_intern_string (event_type);
-  closure.id = id;
-  closure.walker = walker;
-  closure.user_data = user_data;
-  closure.destroy_user_data = destroy_user_data;
+  closure = g_new0 (DflEventSequenceWalkerClosure, 1);
+  closure->event_type = g_intern_string (event_type);
+  closure->id = id;
+  closure->walker = walker;
+  closure->user_data = user_data;
+  closure->destroy_user_data = destroy_user_data;
+
+  /* IDs are allocated in increasing order, so each bucket in the index is
+   * sorted by ID, which is also the order the walkers were added in. */
+  walker_id = self->next_walker_id++;
+  g_hash_table_insert (self->walkers, GUINT_TO_POINTER (walker_id), closure);
+
+  /* Add it to the index. */
+  type_bucket = g_hash_table_lookup (self->type_buckets, closure->event_type);
+
+  if (type_bucket == NULL)
+    {
+      type_bucket = type_bucket_new ();
+      g_hash_table_insert (self->type_buckets, (gpointer) closure->event_type,
+                           type_bucket);
+    }
+
+  if (id == DFL_ID_INVALID)
+    {
+      walker_ids = type_bucket->walker_ids;
+    }
+  else
+    {
+      DflEventSequenceIdBucket *id_bucket;
+
+      id_bucket = g_hash_table_lookup (type_bucket->id_buckets,
+                                       (gpointer) id);
+
+      if (id_bucket == NULL)
+        {
+          id_bucket = id_bucket_new ();
+          g_hash_table_insert (type_bucket->id_buckets, (gpointer) id,
+                               id_bucket);
+        }
+
+      walker_ids = id_bucket->walker_ids;
+    }
 
-  g_array_append_val (self->walkers, closure);
+  g_array_append_val (walker_ids, walker_id);
 
   if (self->walker_group != NULL)
-    g_array_append_val (self->walker_group, self->walkers->len);
+    g_array_append_val (self->walker_group, walker_id);
 
-  g_assert (self->walkers->len != 0);
-  return self->walkers->len;
+  g_assert (walker_id != 0);
+  return walker_id;
 }
 
 /**
@@ -385,60 +653,286 @@ dfl_event_sequence_remove_walker (DflEventSequence *self,
   DflEventSequenceWalkerClosure *closure;
 
   g_return_if_fail (DFL_IS_EVENT_SEQUENCE (self));
-  g_return_if_fail (walker_id != 0 && walker_id <= self->walkers->len);
+  g_return_if_fail (walker_id != 0);
+
+  /* Clear the closure, but don’t free it yet, as it may be in use by
+   * dfl_event_sequence_walk(). */
+  closure = g_hash_table_lookup (self->walkers, GUINT_TO_POINTER (walker_id));
 
-  /* Clear the given element of the walkers array, but don’t remove it so we
-   * don’t muck up the IDs of other walkers. */
-  closure = &g_array_index (self->walkers, DflEventSequenceWalkerClosure,
-                            walker_id - 1);
+  g_return_if_fail (closure != NULL && closure->walker != NULL);
+
+  if (closure->user_data != NULL && closure->destroy_user_data != NULL)
+    closure->destroy_user_data (closure->user_data);
+
+  closure->walker = NULL;
+  closure->user_data = NULL;
+  closure->destroy_user_data = NULL;
 
-  g_return_if_fail (closure->walker != NULL);
-  walkers_clear_cb (closure);
+  /* The walker may be removed while its index bucket is being iterated over
+   * in dfl_event_sequence_walk(), so leave removing it from the index until
+   * it’s safe to do so. The closure keeps its @event_type and @id until then
+   * so the bucket can be found. */
+  g_array_append_val (self->removed_walker_ids, walker_id);
 }
 
-/**
- * dfl_event_sequence_walk:
- * @self: a #DflEventSequence
- *
- * TODO
- *
- * It is allowed to add and remove walkers from callbacks within this function.
- *
- * Since: 0.1.0
- */
-void
-dfl_event_sequence_walk (DflEventSequence *self)
+static void
+remove_walker_id (GArray/*<guint>*/ *walker_ids,
+                  guint              walker_id)
 {
-  guint i, j;
+  guint i;
 
-  g_return_if_fail (DFL_IS_EVENT_SEQUENCE (self));
+  for (i = 0; i < walker_ids->len; i++)
+    {
+      if (g_array_index (walker_ids, guint, i) == walker_id)
+        {
+          g_array_remove_index (walker_ids, i);
+          return;
+        }
+    }
 
-  if (self->walkers->len == 0)
-    return;
+  g_assert_not_reached ();
+}
 
-  for (i = 0; i < self->n_events; i++)
+/* Remove all the walkers which were removed since the last call to this
+ * function from the index, and free their closures. This must not be called
+ * while iterating over any of the buckets in the index. */
+static void
+dfl_event_sequence_purge_removed_walkers (DflEventSequence *self)
+{
+  guint i;
+
+  for (i = 0; i < self->removed_walker_ids->len; i++)
     {
-      DflEvent *event = self->events[i];
+      guint walker_id;
+      DflEventSequenceWalkerClosure *closure;
+      DflEventSequenceTypeBucket *type_bucket;
+
+      walker_id = g_array_index (self->removed_walker_ids, guint, i);
+      closure = g_hash_table_lookup (self->walkers,
+                                     GUINT_TO_POINTER (walker_id));
+      g_assert (closure != NULL && closure->walker == NULL);
+
+      type_bucket = g_hash_table_lookup (self->type_buckets,
+                                         closure->event_type);
+      g_assert (type_bucket != NULL);
 
-      for (j = 0; j < self->walkers->len; j++)
+      if (closure->id == DFL_ID_INVALID)
         {
-          const DflEventSequenceWalkerClosure *closure;
+          remove_walker_id (type_bucket->walker_ids, walker_id);
+        }
+      else
+        {
+          DflEventSequenceIdBucket *id_bucket;
 
-          closure = &g_array_index (self->walkers,
-                                    DflEventSequenceWalkerClosure, j);
+          id_bucket = g_hash_table_lookup (type_bucket->id_buckets,
+                                           (gpointer) closure->id);
+          g_assert (id_bucket != NULL);
 
-          /* Has the walker been removed? */
-          if (closure->walker == NULL)
+          remove_walker_id (id_bucket->walker_ids, walker_id);
+
+          if (id_bucket->walker_ids->len == 0)
+            g_hash_table_remove (type_bucket->id_buckets,
+                                 (gpointer) closure->id);
+        }
+
+      if (type_bucket->walker_ids->len == 0 &&
+          g_hash_table_size (type_bucket->id_buckets) == 0)
+        g_hash_table_remove (self->type_buckets, closure->event_type);
+
+      g_hash_table_remove (self->walkers, GUINT_TO_POINTER (walker_id));
+    }
+
+  g_array_set_size (self->removed_walker_ids, 0);
+}
+
+#define N_DISPATCH_BUCKETS 3
+
+/* Call all the walkers in the @walker_ids arrays (up to the corresponding
+ * @n_walker_ids, so that walkers added during this event are not called until
+ * the next one) which have not been removed. Each array is sorted by walker ID,
+ * so merge them to call the walkers in the order they were added. Any of the
+ * arrays may be %NULL. */
+static void
+dispatch_walkers (DflEventSequence   *self,
+                  DflEvent           *event,
+                  GArray/*<guint>*/ *walker_ids[N_DISPATCH_BUCKETS],
+                  const guint         n_walker_ids[N_DISPATCH_BUCKETS])
+{
+  guint positions[N_DISPATCH_BUCKETS] = { 0, };
+
+  while (TRUE)
+    {
+      const DflEventSequenceWalkerClosure *closure;
+      guint walker_id = 0;
+      guint i, next_bucket = N_DISPATCH_BUCKETS;
+
+      /* Walkers may be appended to the arrays (but not removed from them)
+       * while iterating, so re-index each time. */
+      for (i = 0; i < N_DISPATCH_BUCKETS; i++)
+        {
+          guint candidate_id;
+
+          if (walker_ids[i] == NULL || positions[i] >= n_walker_ids[i])
             continue;
 
+          candidate_id = g_array_index (walker_ids[i], guint, positions[i]);
+
+          if (walker_id == 0 || candidate_id < walker_id)
+            {
+              walker_id = candidate_id;
+              next_bucket = i;
+            }
+        }
+
+      if (next_bucket == N_DISPATCH_BUCKETS)
+        break;
+
+      positions[next_bucket]++;
+
+      /* Removed walkers are only freed between events, so the closure is
+       * still there. */
+      closure = g_hash_table_lookup (self->walkers,
+                                     GUINT_TO_POINTER (walker_id));
+
+      /* Has the walker been removed? */
+      if (closure->walker == NULL)
+        continue;
+
+      closure->walker (self, event, closure->user_data);
+    }
+}
+
+/* Number of events to walk between checks for cancellation in
+ * walk_events(). */
+#define WALK_CANCELLATION_INTERVAL 1024
+
+/* Pass the events from @first_event to the end of the sequence to the
+ * installed walkers, checking @cancellable between events. If it is
+ * cancelled, %FALSE is returned and @error is set. In either case, the index
+ * of the event after the last one walked is returned in @end_event. */
+static gboolean
+walk_events (DflEventSequence  *self,
+             guint              first_event,
+             guint             *end_event,
+             GCancellable      *cancellable,
+             GError           **error)
+{
+  guint i, n_events;
+  gboolean cancelled = FALSE;
+
+  n_events = _dfl_event_table_get_n_events (self->table);
+
+  for (i = first_event; i < n_events; i++)
+    {
+      DflEvent *event = NULL;
+      DflEventSequenceTypeBucket *any_bucket, *type_bucket;
+      DflEventSequenceIdBucket *id_bucket = NULL;
+      GArray/*<guint>*/ *walker_ids[N_DISPATCH_BUCKETS] = { NULL, };
+      guint n_walker_ids[N_DISPATCH_BUCKETS] = { 0, };
+
+      if ((i - first_event) % WALK_CANCELLATION_INTERVAL == 0 &&
+          g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+          cancelled = TRUE;
+          break;
+        }
+
+      /* Walkers removed while handling the previous event can now safely be
+       * dropped from the index. */
+      dfl_event_sequence_purge_removed_walkers (self);
+
+      /* Find all the buckets before calling any walkers, so that walkers added
+       * while handling this event are only matched from the next event. */
+      any_bucket = g_hash_table_lookup (self->type_buckets, NULL);
+      type_bucket = g_hash_table_lookup (self->type_buckets,
+                                         _dfl_event_table_get_event_type (self->table,
+                                                                          i));
+
+      /* Skip events which no walkers are interested in without creating a
+       * #DflEvent for them. */
+      if (any_bucket == NULL && type_bucket == NULL)
+        continue;
+
+      /* Walkers may keep a reference to the event, so it cannot be reused
+       * for the next one. */
+      event = _dfl_event_new_from_table (self->table, i);
+
+      if (any_bucket != NULL)
+        {
+          walker_ids[0] = any_bucket->walker_ids;
+          n_walker_ids[0] = any_bucket->walker_ids->len;
+        }
+
+      if (type_bucket != NULL)
+        {
+          walker_ids[1] = type_bucket->walker_ids;
+          n_walker_ids[1] = type_bucket->walker_ids->len;
+
           /* FIXME: Having the ID hard-coded in index 0 is a bit icky. */
-          if ((closure->event_type == NULL ||
-               closure->event_type == dfl_event_get_event_type (event)) &&
-              (closure->id == DFL_ID_INVALID ||
-               closure->id == dfl_event_get_parameter_id (event, 0)))
+          if (g_hash_table_size (type_bucket->id_buckets) > 0)
             {
-              closure->walker (self, event, closure->user_data);
+              DflId id = dfl_event_get_parameter_id (event, 0);
+              id_bucket = g_hash_table_lookup (type_bucket->id_buckets,
+                                               (gpointer) id);
+            }
+
+          if (id_bucket != NULL)
+            {
+              walker_ids[2] = id_bucket->walker_ids;
+              n_walker_ids[2] = id_bucket->walker_ids->len;
             }
         }
+
+      dispatch_walkers (self, event, walker_ids, n_walker_ids);
+      g_object_unref (event);
     }
+
+  *end_event = i;
+
+  dfl_event_sequence_purge_removed_walkers (self);
+
+  return !cancelled;
+}
+
+/* Resume walking from the end of the previous call to this function, passing
+ * only the events which have been appended since then to the installed
+ * walkers. This is how #DflModel analyses a sequence incrementally as it is
+ * loaded. It checks @cancellable between events; if it is cancelled, %FALSE
+ * is returned and @error is set, and the next call resumes from the event
+ * where the walk stopped.
+ *
+ * If no walkers have been added yet, nothing is walked, so walkers added later
+ * still see every event. */
+gboolean
+_dfl_event_sequence_resume_walk (DflEventSequence  *self,
+                                 GCancellable      *cancellable,
+                                 GError           **error)
+{
+  if (self->next_walker_id == 1)
+    return TRUE;
+
+  return walk_events (self, self->n_walked_events, &self->n_walked_events,
+                      cancellable, error);
+}
+
+/**
+ * dfl_event_sequence_walk:
+ * @self: a #DflEventSequence
+ *
+ * Pass each event in the sequence to the installed walkers which match it, in
+ * order. Every call walks over the whole sequence, including any events which
+ * have been appended since a previous call.
+ *
+ * It is allowed to add and remove walkers from callbacks within this function.
+ *
+ * Since: 0.1.0
+ */
+void
+dfl_event_sequence_walk (DflEventSequence *self)
+{
+  guint end_event;
+
+  g_return_if_fail (DFL_IS_EVENT_SEQUENCE (self));
+
+  walk_events (self, 0, &end_event, NULL, NULL);
 }
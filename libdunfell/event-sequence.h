@@ -41,6 +41,8 @@ DflEventSequence *dfl_event_sequence_new (const DflEvent **events,
                                           guint            n_events,
                                           DflTimestamp     initial_timestamp);
 
+DflTimestamp dfl_event_sequence_get_initial_timestamp (DflEventSequence *self);
+
 /**
  * DflEventWalker:
  * @sequence: a #DflEventSequence
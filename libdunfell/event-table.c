@@ -0,0 +1,230 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "event-table.h"
+
+
+DflEventTable *
+_dfl_event_table_new (void)
+{
+  DflEventTable *table = NULL;
+  gsize zero = 0;
+
+  table = g_new0 (DflEventTable, 1);
+  table->ref_count = 1;
+
+  table->timestamps = g_array_new (FALSE, FALSE, sizeof (DflTimestamp));
+  table->thread_ids = g_array_new (FALSE, FALSE, sizeof (DflThreadId));
+  table->event_types = g_array_new (FALSE, FALSE, sizeof (guint16));
+  table->parameter_offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+  g_array_append_val (table->parameter_offsets, zero);
+  table->parameters = g_array_new (FALSE, FALSE, sizeof (DflEventParameter));
+  table->parameter_kinds = g_array_new (FALSE, FALSE, sizeof (guint8));
+
+  table->event_type_names = g_ptr_array_new ();
+  /* Event types are interned, so can be compared by pointer. */
+  table->event_type_indices = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  table->strings = g_string_chunk_new (4096);
+  table->adopted_strings = g_ptr_array_new_with_free_func ((GDestroyNotify) g_string_chunk_free);
+
+  return table;
+}
+
+DflEventTable *
+_dfl_event_table_ref (DflEventTable *table)
+{
+  g_atomic_int_inc (&table->ref_count);
+
+  return table;
+}
+
+void
+_dfl_event_table_unref (DflEventTable *table)
+{
+  if (!g_atomic_int_dec_and_test (&table->ref_count))
+    return;
+
+  g_ptr_array_unref (table->adopted_strings);
+  g_string_chunk_free (table->strings);
+
+  g_hash_table_unref (table->event_type_indices);
+  g_ptr_array_unref (table->event_type_names);
+
+  g_array_unref (table->parameter_kinds);
+  g_array_unref (table->parameters);
+  g_array_unref (table->parameter_offsets);
+  g_array_unref (table->event_types);
+  g_array_unref (table->thread_ids);
+  g_array_unref (table->timestamps);
+
+  g_free (table);
+}
+
+/* Look up the index of @event_type in the table, adding it if needed.
+ * @event_type must be interned, and may be %NULL. */
+static guint16
+event_type_to_index (DflEventTable *table,
+                     const gchar   *event_type)
+{
+  gpointer value;
+  guint16 index;
+
+  if (g_hash_table_lookup_extended (table->event_type_indices, event_type,
+                                    NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  g_assert (table->event_type_names->len < G_MAXUINT16);
+
+  index = table->event_type_names->len;
+  g_ptr_array_add (table->event_type_names, (gpointer) event_type);
+  g_hash_table_insert (table->event_type_indices, (gpointer) event_type,
+                       GUINT_TO_POINTER (index));
+
+  return index;
+}
+
+/* Append an event to @table. @event_type must be interned (or %NULL). Each of
+ * @parameters is stored as the corresponding kind from @kinds, which the caller
+ * must have already decoded and validated it as. String parameters must be
+ * nul-terminated, and are copied into the table. */
+void
+_dfl_event_table_append (DflEventTable               *table,
+                         const gchar                 *event_type,
+                         DflTimestamp                 timestamp,
+                         DflThreadId                  thread_id,
+                         const DflEventParameterKind *kinds,
+                         const DflEventParameter     *parameters,
+                         guint                        n_parameters)
+{
+  guint16 event_type_index;
+  gsize offset;
+  guint i;
+
+  event_type_index = event_type_to_index (table, event_type);
+
+  g_array_append_val (table->timestamps, timestamp);
+  g_array_append_val (table->thread_ids, thread_id);
+  g_array_append_val (table->event_types, event_type_index);
+
+  for (i = 0; i < n_parameters; i++)
+    {
+      DflEventParameter parameter = parameters[i];
+      guint8 kind = kinds[i];
+
+      switch (kinds[i])
+        {
+        case DFL_EVENT_PARAMETER_SYMBOL:
+          parameter.str = g_string_chunk_insert_const (table->strings,
+                                                       parameter.str);
+          break;
+        case DFL_EVENT_PARAMETER_RAW:
+        case DFL_EVENT_PARAMETER_STRING:
+          parameter.str = g_string_chunk_insert (table->strings,
+                                                 parameter.str);
+          break;
+        case DFL_EVENT_PARAMETER_ID:
+        case DFL_EVENT_PARAMETER_INT64:
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+
+      g_array_append_val (table->parameters, parameter);
+      g_array_append_val (table->parameter_kinds, kind);
+    }
+
+  offset = table->parameters->len;
+  g_array_append_val (table->parameter_offsets, offset);
+}
+
+/* Append all the events from @other to @table, leaving @other empty. The
+ * parameter strings are not copied: @table takes ownership of the string
+ * storage from @other instead. */
+void
+_dfl_event_table_append_table (DflEventTable *table,
+                               DflEventTable *other)
+{
+  guint16 *event_type_map = NULL;
+  guint i, n_events, first_event;
+  gsize parameter_base;
+
+  n_events = other->timestamps->len;
+  first_event = table->timestamps->len;
+  parameter_base = table->parameters->len;
+
+  /* The two tables will have assigned different indices to the event types, so
+   * map between them. */
+  event_type_map = g_new (guint16, other->event_type_names->len);
+
+  for (i = 0; i < other->event_type_names->len; i++)
+    event_type_map[i] = event_type_to_index (table,
+                                             other->event_type_names->pdata[i]);
+
+  g_array_append_vals (table->timestamps, other->timestamps->data, n_events);
+  g_array_append_vals (table->thread_ids, other->thread_ids->data, n_events);
+  g_array_append_vals (table->event_types, other->event_types->data,
+                       n_events);
+
+  for (i = 0; i < n_events; i++)
+    {
+      guint16 *index = &g_array_index (table->event_types, guint16,
+                                        first_event + i);
+      *index = event_type_map[*index];
+    }
+
+  g_free (event_type_map);
+
+  /* Skip the leading zero offset from @other. */
+  for (i = 1; i <= n_events; i++)
+    {
+      gsize offset = parameter_base +
+                     g_array_index (other->parameter_offsets, gsize, i);
+      g_array_append_val (table->parameter_offsets, offset);
+    }
+
+  g_array_append_vals (table->parameters, other->parameters->data,
+                       other->parameters->len);
+  g_array_append_vals (table->parameter_kinds, other->parameter_kinds->data,
+                       other->parameter_kinds->len);
+
+  /* Steal the string storage. */
+  g_ptr_array_add (table->adopted_strings, other->strings);
+  other->strings = g_string_chunk_new (4096);
+
+  for (i = 0; i < other->adopted_strings->len; i++)
+    g_ptr_array_add (table->adopted_strings,
+                     other->adopted_strings->pdata[i]);
+  g_ptr_array_set_free_func (other->adopted_strings, NULL);
+  g_ptr_array_set_size (other->adopted_strings, 0);
+  g_ptr_array_set_free_func (other->adopted_strings,
+                             (GDestroyNotify) g_string_chunk_free);
+
+  /* Empty @other. */
+  g_array_set_size (other->timestamps, 0);
+  g_array_set_size (other->thread_ids, 0);
+  g_array_set_size (other->event_types, 0);
+  g_array_set_size (other->parameter_offsets, 1);
+  g_array_set_size (other->parameters, 0);
+  g_array_set_size (other->parameter_kinds, 0);
+}
@@ -0,0 +1,178 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFL_EVENT_TABLE_H
+#define DFL_EVENT_TABLE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "event.h"
+#include "event-sequence.h"
+#include "types.h"
+
+G_BEGIN_DECLS
+
+/* Internal columnar storage for the events in a #DflEventSequence. Each column
+ * is a contiguous array indexed by event position, so a loaded log costs a few
+ * tens of bytes per event rather than a #GObject and a #GStrv per event.
+ * #DflEvent objects are only created on demand, as views onto a row of the
+ * table.
+ *
+ * Each event’s parameters are stored as a run of #DflEventParameters in
+ * @parameters, starting at @parameter_offsets[i] and ending at
+ * @parameter_offsets[i + 1], with the kind of each parameter in the same
+ * position in @parameter_kinds. Parameters are decoded when they are appended,
+ * so that reading them is a constant time load. String parameters point into
+ * @strings (or one of @adopted_strings); symbol names are deduplicated there.
+ *
+ * A table is not thread safe, but separate tables may be built in separate
+ * threads and then concatenated using _dfl_event_table_append_table().
+ *
+ * The functions here are prefixed with an underscore so they are not exported
+ * from the library. */
+/* How a parameter in a #DflEventTable is stored. Events parsed from a log have
+ * their parameter kinds given by the schema for their event type; events
+ * constructed using the public API have %DFL_EVENT_PARAMETER_RAW
+ * parameters, which are decoded on access, as before. */
+typedef enum
+{
+  DFL_EVENT_PARAMETER_RAW = 0,  /* arbitrary string, not validated */
+  DFL_EVENT_PARAMETER_STRING,  /* validated UTF-8 */
+  DFL_EVENT_PARAMETER_SYMBOL,  /* validated UTF-8, deduplicated */
+  DFL_EVENT_PARAMETER_ID,
+  DFL_EVENT_PARAMETER_INT64,
+} DflEventParameterKind;
+
+typedef union
+{
+  guint64 id;  /* %DFL_EVENT_PARAMETER_ID */
+  gint64 int64;  /* %DFL_EVENT_PARAMETER_INT64 */
+  const gchar *str;  /* all other kinds; unowned */
+} DflEventParameter;
+
+typedef struct
+{
+  gint ref_count;  /* atomic */
+
+  GArray/*<DflTimestamp>*/ *timestamps;  /* owned */
+  GArray/*<DflThreadId>*/ *thread_ids;  /* owned */
+  GArray/*<guint16>*/ *event_types;  /* owned; indices into @event_type_names */
+  GArray/*<gsize>*/ *parameter_offsets;  /* owned; n_events + 1 elements */
+  GArray/*<DflEventParameter>*/ *parameters;  /* owned */
+  GArray/*<guint8>*/ *parameter_kinds;  /* owned; DflEventParameterKind */
+
+  GPtrArray/*<unowned interned utf8>*/ *event_type_names;  /* owned */
+  GHashTable/*<unowned interned utf8, guint>*/ *event_type_indices;  /* owned */
+
+  GStringChunk *strings;  /* owned */
+  GPtrArray/*<owned GStringChunk>*/ *adopted_strings;  /* owned */
+} DflEventTable;
+
+DflEventTable *_dfl_event_table_new    (void);
+DflEventTable *_dfl_event_table_ref    (DflEventTable *table);
+void           _dfl_event_table_unref  (DflEventTable *table);
+
+void           _dfl_event_table_append       (DflEventTable               *table,
+                                              const gchar                 *event_type,
+                                              DflTimestamp                 timestamp,
+                                              DflThreadId                  thread_id,
+                                              const DflEventParameterKind *kinds,
+                                              const DflEventParameter     *parameters,
+                                              guint                        n_parameters);
+void           _dfl_event_table_append_table (DflEventTable               *table,
+                                              DflEventTable               *other);
+
+static inline guint
+_dfl_event_table_get_n_events (DflEventTable *table)
+{
+  return table->timestamps->len;
+}
+
+static inline const gchar *
+_dfl_event_table_get_event_type (DflEventTable *table,
+                                 guint          index)
+{
+  return table->event_type_names->pdata[g_array_index (table->event_types,
+                                                       guint16, index)];
+}
+
+static inline DflTimestamp
+_dfl_event_table_get_timestamp (DflEventTable *table,
+                                guint          index)
+{
+  return g_array_index (table->timestamps, DflTimestamp, index);
+}
+
+static inline DflThreadId
+_dfl_event_table_get_thread_id (DflEventTable *table,
+                                guint          index)
+{
+  return g_array_index (table->thread_ids, DflThreadId, index);
+}
+
+static inline guint
+_dfl_event_table_get_n_parameters (DflEventTable *table,
+                                   guint          index)
+{
+  return g_array_index (table->parameter_offsets, gsize, index + 1) -
+         g_array_index (table->parameter_offsets, gsize, index);
+}
+
+static inline const DflEventParameter *
+_dfl_event_table_get_parameter (DflEventTable *table,
+                                guint          index,
+                                guint          parameter_index)
+{
+  gsize offset = g_array_index (table->parameter_offsets, gsize, index);
+
+  return &g_array_index (table->parameters, DflEventParameter,
+                         offset + parameter_index);
+}
+
+static inline DflEventParameterKind
+_dfl_event_table_get_parameter_kind (DflEventTable *table,
+                                     guint          index,
+                                     guint          parameter_index)
+{
+  gsize offset = g_array_index (table->parameter_offsets, gsize, index);
+
+  return g_array_index (table->parameter_kinds, guint8,
+                        offset + parameter_index);
+}
+
+/* Constructors and accessors for the public objects which wrap a table. */
+DflEvent              *_dfl_event_new_from_table          (DflEventTable     *table,
+                                                           guint              index);
+DflEventParameterKind  _dfl_event_get_parameter           (DflEvent          *self,
+                                                           guint              parameter_index,
+                                                           DflEventParameter *parameter);
+DflEventSequence      *_dfl_event_sequence_new_from_table (DflEventTable     *table,
+                                                           DflTimestamp       initial_timestamp);
+DflEventSequence      *_dfl_event_sequence_new_view       (DflEventSequence  *self);
+void                   _dfl_event_sequence_append_table   (DflEventSequence  *self,
+                                                           DflEventTable     *events);
+void                   _dfl_event_sequence_freeze         (DflEventSequence  *self);
+void                   _dfl_event_sequence_thaw           (DflEventSequence  *self);
+gboolean               _dfl_event_sequence_resume_walk    (DflEventSequence  *self,
+                                                           GCancellable      *cancellable,
+                                                           GError           **error);
+
+G_END_DECLS
+
+#endif /* !DFL_EVENT_TABLE_H */
@@ -35,6 +35,7 @@
 #include <string.h>
 
 #include "event.h"
+#include "event-table.h"
 
 
 static void dfl_event_get_property (GObject      *object,
@@ -54,7 +55,17 @@ struct _DflEvent
   const gchar *event_type;  /* unowned, interned */
   DflTimestamp timestamp;
   DflThreadId thread_id;
-  gchar **parameters;  /* owned, null terminated */
+
+  /* Events are either standalone, with their own @parameters, or are a view
+   * onto row @index of a #DflEventTable. In the latter case, the other fields
+   * above are copied out of the table. */
+  gchar **parameters;  /* owned, null terminated; %NULL if @table is set */
+  DflEventTable *table;  /* owned; nullable */
+  guint index;  /* only valid if @table is set */
+
+  /* Integer parameters from @table formatted as strings, created on demand by
+   * dfl_event_get_parameter_utf8(). */
+  gchar **formatted_parameters;  /* owned; nullable; n_parameters elements */
 };
 
 G_DEFINE_TYPE (DflEvent, dfl_event, G_TYPE_OBJECT)
@@ -167,7 +178,26 @@ dfl_event_get_property (GObject     *object,
       g_value_set_uint64 (value, self->thread_id);
       break;
     case PROP_PARAMETERS:
-      g_value_set_boxed (value, self->parameters);
+      if (self->table != NULL)
+        {
+          GPtrArray/*<owned utf8>*/ *parameters = NULL;
+          guint i, n_parameters;
+
+          n_parameters = _dfl_event_table_get_n_parameters (self->table,
+                                                            self->index);
+          parameters = g_ptr_array_new_full (n_parameters + 1, NULL);
+
+          for (i = 0; i < n_parameters; i++)
+            g_ptr_array_add (parameters,
+                             g_strdup (dfl_event_get_parameter_utf8 (self, i)));
+          g_ptr_array_add (parameters, NULL);
+
+          g_value_take_boxed (value, g_ptr_array_free (parameters, FALSE));
+        }
+      else
+        {
+          g_value_set_boxed (value, self->parameters);
+        }
       break;
     default:
       g_assert_not_reached ();
@@ -207,12 +237,30 @@ dfl_event_set_property (GObject           *object,
     }
 }
 
+static void
+clear_formatted_parameters (DflEvent *self)
+{
+  guint i, n_parameters;
+
+  if (self->formatted_parameters == NULL)
+    return;
+
+  n_parameters = _dfl_event_table_get_n_parameters (self->table, self->index);
+
+  for (i = 0; i < n_parameters; i++)
+    g_free (self->formatted_parameters[i]);
+
+  g_clear_pointer (&self->formatted_parameters, g_free);
+}
+
 static void
 dfl_event_finalize (GObject *object)
 {
   DflEvent *self = DFL_EVENT (object);
 
+  clear_formatted_parameters (self);
   g_strfreev (self->parameters);
+  g_clear_pointer (&self->table, _dfl_event_table_unref);
 
   G_OBJECT_CLASS (dfl_event_parent_class)->finalize (object);
 }
@@ -246,6 +294,49 @@ dfl_event_new (const gchar         *event_type,
                        NULL);
 }
 
+/* Create a new #DflEvent which is a view onto the event at @index in @table.
+ * The @table must not be modified at or before @index while the event is
+ * alive. */
+DflEvent *
+_dfl_event_new_from_table (DflEventTable *table,
+                           guint          index)
+{
+  DflEvent *self = NULL;
+
+  g_assert (index < _dfl_event_table_get_n_events (table));
+
+  self = g_object_new (DFL_TYPE_EVENT, NULL);
+  self->table = _dfl_event_table_ref (table);
+  self->index = index;
+  self->event_type = _dfl_event_table_get_event_type (table, index);
+  self->timestamp = _dfl_event_table_get_timestamp (table, index);
+  self->thread_id = _dfl_event_table_get_thread_id (table, index);
+
+  return self;
+}
+
+/* Get the stored value and kind of parameter @parameter_index, which must be
+ * in range. Parameters of standalone events are always
+ * %DFL_EVENT_PARAMETER_RAW. */
+DflEventParameterKind
+_dfl_event_get_parameter (DflEvent          *self,
+                          guint              parameter_index,
+                          DflEventParameter *parameter)
+{
+  if (self->table != NULL)
+    {
+      *parameter = *_dfl_event_table_get_parameter (self->table, self->index,
+                                                    parameter_index);
+      return _dfl_event_table_get_parameter_kind (self->table, self->index,
+                                                  parameter_index);
+    }
+  else
+    {
+      parameter->str = self->parameters[parameter_index];
+      return DFL_EVENT_PARAMETER_RAW;
+    }
+}
+
 /**
  * dfl_event_get_event_type:
  * @self: a #DflEvent
@@ -299,6 +390,29 @@ dfl_event_get_thread_id (DflEvent *self)
   return self->thread_id;
 }
 
+/**
+ * dfl_event_get_n_parameters:
+ * @self: a #DflEvent
+ *
+ * Get the number of parameters the event has, excluding its type, timestamp
+ * and thread ID.
+ *
+ * Returns: number of parameters
+ * Since: UNRELEASED
+ */
+guint
+dfl_event_get_n_parameters (DflEvent *self)
+{
+  g_return_val_if_fail (DFL_IS_EVENT (self), 0);
+
+  if (self->table != NULL)
+    return _dfl_event_table_get_n_parameters (self->table, self->index);
+  else if (self->parameters == NULL)
+    return 0;
+
+  return g_strv_length (self->parameters);
+}
+
 /**
  * dfl_event_get_parameter_id:
  * @self: a #DflEvent
@@ -313,33 +427,35 @@ DflId
 dfl_event_get_parameter_id (DflEvent *self,
                             guint     parameter_index)
 {
-  gsize i;
+  DflEventParameter parameter;
+  guint64 retval;
+  const gchar *end;
 
   g_return_val_if_fail (DFL_IS_EVENT (self), DFL_ID_INVALID);
+  g_return_val_if_fail (parameter_index < dfl_event_get_n_parameters (self),
+                        DFL_ID_INVALID);
 
-  for (i = 0; self->parameters[i] != NULL; i++)
+  switch (_dfl_event_get_parameter (self, parameter_index, &parameter))
     {
-      if (i == parameter_index)
-        {
-          guint64 retval;
-          const gchar *end;
+    case DFL_EVENT_PARAMETER_ID:
+      return parameter.id;
+    case DFL_EVENT_PARAMETER_INT64:
+      return parameter.int64;
+    case DFL_EVENT_PARAMETER_RAW:
+    case DFL_EVENT_PARAMETER_STRING:
+    case DFL_EVENT_PARAMETER_SYMBOL:
+    default:
+      break;
+    }
 
-          retval = g_ascii_strtoull (self->parameters[i], (gchar **) &end, 10);
+  errno = 0;
+  retval = g_ascii_strtoull (parameter.str, (gchar **) &end, 10);
 
-          if (errno == ERANGE || end == self->parameters[i] || *end != '\0')
-            g_warning ("Event parameter ‘%s’ cannot be interpreted as an ID.",
-                       self->parameters[i]);
+  if (errno == ERANGE || end == parameter.str || *end != '\0')
+    g_warning ("Event parameter ‘%s’ cannot be interpreted as an ID.",
+               parameter.str);
 
-          return retval;
-        }
-    }
-
-  /* Invalid @parameter_index. This check will always be hit if this code is
-   * reached, as the check is actually performed more efficiently in the loop
-   * above. */
-  g_return_val_if_fail (parameter_index < g_strv_length (self->parameters),
-                        DFL_ID_INVALID);
-  return DFL_ID_INVALID;
+  return retval;
 }
 
 /**
@@ -356,31 +472,56 @@ const gchar *
 dfl_event_get_parameter_utf8 (DflEvent *self,
                               guint     parameter_index)
 {
-  gsize i;
+  DflEventParameter parameter;
+  DflEventParameterKind kind;
+  gchar *formatted;
 
   g_return_val_if_fail (DFL_IS_EVENT (self), NULL);
+  g_return_val_if_fail (parameter_index < dfl_event_get_n_parameters (self),
+                        NULL);
+
+  kind = _dfl_event_get_parameter (self, parameter_index, &parameter);
 
-  for (i = 0; self->parameters[i] != NULL; i++)
+  switch (kind)
     {
-      if (i == parameter_index)
+    case DFL_EVENT_PARAMETER_STRING:
+    case DFL_EVENT_PARAMETER_SYMBOL:
+      /* Already validated. */
+      return parameter.str;
+    case DFL_EVENT_PARAMETER_RAW:
+      if (!g_utf8_validate (parameter.str, -1, NULL))
         {
-          if (!g_utf8_validate (self->parameters[i], -1, NULL))
-            {
-              g_warning ("Event parameter %" G_GSIZE_FORMAT " cannot be "
-                         "interpreted as UTF-8.", i);
-              return NULL;
-            }
-
-          return self->parameters[i];
+          g_warning ("Event parameter %u cannot be interpreted as UTF-8.",
+                     parameter_index);
+          return NULL;
         }
+
+      return parameter.str;
+    case DFL_EVENT_PARAMETER_ID:
+    case DFL_EVENT_PARAMETER_INT64:
+    default:
+      break;
     }
 
-  /* Invalid @parameter_index. This check will always be hit if this code is
-   * reached, as the check is actually performed more efficiently in the loop
-   * above. */
-  g_return_val_if_fail (parameter_index < g_strv_length (self->parameters),
-                        NULL);
-  return NULL;
+  /* Integer parameters are only formatted if something asks for them as a
+   * string, and the result is cached for the lifetime of the event. */
+  if (self->formatted_parameters == NULL)
+    self->formatted_parameters = g_new0 (gchar *,
+                                         dfl_event_get_n_parameters (self));
+
+  formatted = self->formatted_parameters[parameter_index];
+
+  if (formatted == NULL)
+    {
+      if (kind == DFL_EVENT_PARAMETER_ID)
+        formatted = g_strdup_printf ("%" G_GUINT64_FORMAT, parameter.id);
+      else
+        formatted = g_strdup_printf ("%" G_GINT64_FORMAT, parameter.int64);
+
+      self->formatted_parameters[parameter_index] = formatted;
+    }
+
+  return formatted;
 }
 
 /**
@@ -397,31 +538,33 @@ gint64
 dfl_event_get_parameter_int64 (DflEvent *self,
                                guint     parameter_index)
 {
-  gsize i;
+  DflEventParameter parameter;
+  gint64 retval;
+  const gchar *end;
 
   g_return_val_if_fail (DFL_IS_EVENT (self), 0);
+  g_return_val_if_fail (parameter_index < dfl_event_get_n_parameters (self),
+                        0);
 
-  for (i = 0; self->parameters[i] != NULL; i++)
+  switch (_dfl_event_get_parameter (self, parameter_index, &parameter))
     {
-      if (i == parameter_index)
-        {
-          gint64 retval;
-          const gchar *end;
-
-          retval = g_ascii_strtoll (self->parameters[i], (gchar **) &end, 10);
+    case DFL_EVENT_PARAMETER_INT64:
+      return parameter.int64;
+    case DFL_EVENT_PARAMETER_ID:
+      return parameter.id;
+    case DFL_EVENT_PARAMETER_RAW:
+    case DFL_EVENT_PARAMETER_STRING:
+    case DFL_EVENT_PARAMETER_SYMBOL:
+    default:
+      break;
+    }
 
-          if (errno == ERANGE || end == self->parameters[i] || *end != '\0')
-            g_warning ("Event parameter ‘%s’ cannot be interpreted as an int64.",
-                       self->parameters[i]);
+  errno = 0;
+  retval = g_ascii_strtoll (parameter.str, (gchar **) &end, 10);
 
-          return retval;
-        }
-    }
+  if (errno == ERANGE || end == parameter.str || *end != '\0')
+    g_warning ("Event parameter ‘%s’ cannot be interpreted as an int64.",
+               parameter.str);
 
-  /* Invalid @parameter_index. This check will always be hit if this code is
-   * reached, as the check is actually performed more efficiently in the loop
-   * above. */
-  g_return_val_if_fail (parameter_index < g_strv_length (self->parameters),
-                        DFL_ID_INVALID);
-  return DFL_ID_INVALID;
+  return retval;
 }
@@ -46,6 +46,8 @@ const gchar *dfl_event_get_event_type   (DflEvent *self);
 DflTimestamp dfl_event_get_timestamp    (DflEvent *self);
 DflThreadId  dfl_event_get_thread_id    (DflEvent *self);
 
+guint        dfl_event_get_n_parameters (DflEvent *self);
+
 DflId        dfl_event_get_parameter_id (DflEvent *self,
                                          guint     parameter_index);
 gint64       dfl_event_get_parameter_int64 (DflEvent *self,
@@ -0,0 +1,64 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFL_FACTORY_PRIVATE_H
+#define DFL_FACTORY_PRIVATE_H
+
+#include <glib.h>
+
+#include "event-sequence.h"
+#include "identity-index.h"
+#include "main-context.h"
+
+G_BEGIN_DECLS
+
+/* Variants of the dfl_*_factory_from_event_sequence() functions which also
+ * return the index each factory builds to look up its objects by ID as it walks
+ * the event sequence. The indices are updated as new objects are added to the
+ * returned arrays, so must only be used while the event sequence is not being
+ * walked.
+ *
+ * The index for threads maps a #DflThreadId (keyed by pointer, using
+ * g_int64_hash()) to the position of the #DflThread in the returned array.
+ * The other indices map to the objects themselves; see #DflIdentityIndex.
+ *
+ * The source factory can also return a set of the #DflSources which have been
+ * attached or dispatched while the event sequence was walked. It is added to
+ * on each walk, and the caller should empty it once it has handled them.
+ *
+ * The functions are prefixed with an underscore so they are not exported from
+ * the library. */
+GPtrArray *_dfl_main_context_factory_from_event_sequence (DflEventSequence  *sequence,
+                                                          DflIdentityIndex **index_out);
+GPtrArray *_dfl_thread_factory_from_event_sequence       (DflEventSequence  *sequence,
+                                                          GHashTable       **index_out);
+GPtrArray *_dfl_source_factory_from_event_sequence       (DflEventSequence  *sequence,
+                                                          DflIdentityIndex **index_out,
+                                                          GHashTable       **changed_sources_out);
+GPtrArray *_dfl_task_factory_from_event_sequence         (DflEventSequence  *sequence,
+                                                          DflIdentityIndex **index_out);
+
+/* Called by #DflModel after each walk to link main context dispatches to the
+ * source dispatches within them, once the sources are known; see
+ * dfl_main_context_get_source_dispatches(). */
+void _dfl_main_context_link_source_dispatches (DflMainContext *self,
+                                               GPtrArray      *changed_sources);
+
+G_END_DECLS
+
+#endif /* !DFL_FACTORY_PRIVATE_H */
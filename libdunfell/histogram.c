@@ -0,0 +1,308 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:histogram
+ * @short_description: distribution of durations
+ * @stability: Unstable
+ * @include: libdunfell/histogram.h
+ *
+ * A histogram of a set of durations, such as the durations of the dispatches of
+ * a #DflSource. It gives the exact number, sum, minimum and maximum of the
+ * durations, and their approximate distribution.
+ *
+ * The durations are counted in logarithmically sized buckets: each power of
+ * two is split into 32 equally sized buckets, so quantiles calculated from the
+ * histogram are accurate to within about 2%, however widely the durations are
+ * spread. Durations below 64µs are counted exactly.
+ *
+ * Histograms may be merged using dfl_histogram_merge(), so the distributions
+ * for several sources, or for all the dispatches of a callback or on a thread,
+ * may be aggregated.
+ *
+ * Since: UNRELEASED
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "duration-statistics.h"
+#include "histogram.h"
+
+
+static void dfl_histogram_finalize (GObject *object);
+
+struct _DflHistogram
+{
+  GObject parent;
+
+  DflDurationStatistics stats;
+};
+
+G_DEFINE_TYPE (DflHistogram, dfl_histogram, G_TYPE_OBJECT)
+
+static void
+dfl_histogram_class_init (DflHistogramClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = dfl_histogram_finalize;
+}
+
+static void
+dfl_histogram_init (DflHistogram *self)
+{
+  _dfl_duration_statistics_init (&self->stats);
+}
+
+static void
+dfl_histogram_finalize (GObject *object)
+{
+  DflHistogram *self = DFL_HISTOGRAM (object);
+
+  _dfl_duration_statistics_clear (&self->stats);
+
+  G_OBJECT_CLASS (dfl_histogram_parent_class)->finalize (object);
+}
+
+/**
+ * dfl_histogram_new:
+ *
+ * Create a new, empty #DflHistogram.
+ *
+ * Returns: (transfer full): a new #DflHistogram
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_histogram_new (void)
+{
+  return g_object_new (DFL_TYPE_HISTOGRAM, NULL);
+}
+
+/* Create a new histogram containing a copy of @stats. */
+DflHistogram *
+_dfl_histogram_new_from_statistics (const DflDurationStatistics *stats)
+{
+  DflHistogram *histogram = NULL;
+
+  histogram = dfl_histogram_new ();
+  _dfl_duration_statistics_merge (&histogram->stats, stats);
+
+  return histogram;
+}
+
+/* Add all the durations summarised by @stats to @self. */
+void
+_dfl_histogram_merge_statistics (DflHistogram                *self,
+                                 const DflDurationStatistics *stats)
+{
+  _dfl_duration_statistics_merge (&self->stats, stats);
+}
+
+/**
+ * dfl_histogram_add:
+ * @self: a #DflHistogram
+ * @duration: duration to add, in microseconds; must be non-negative
+ *
+ * Add @duration to the histogram.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_histogram_add (DflHistogram *self,
+                   DflDuration   duration)
+{
+  g_return_if_fail (DFL_IS_HISTOGRAM (self));
+  g_return_if_fail (duration >= 0);
+
+  _dfl_duration_statistics_add (&self->stats, duration);
+}
+
+/**
+ * dfl_histogram_merge:
+ * @self: a #DflHistogram
+ * @other: another #DflHistogram
+ *
+ * Add all the durations counted by @other to @self. @other is not modified.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_histogram_merge (DflHistogram *self,
+                     DflHistogram *other)
+{
+  g_return_if_fail (DFL_IS_HISTOGRAM (self));
+  g_return_if_fail (DFL_IS_HISTOGRAM (other));
+  g_return_if_fail (self != other);
+
+  _dfl_duration_statistics_merge (&self->stats, &other->stats);
+}
+
+/**
+ * dfl_histogram_get_n_durations:
+ * @self: a #DflHistogram
+ *
+ * Get the number of durations which have been added to the histogram.
+ *
+ * Returns: number of durations
+ * Since: UNRELEASED
+ */
+guint64
+dfl_histogram_get_n_durations (DflHistogram *self)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+
+  return self->stats.n_durations;
+}
+
+/**
+ * dfl_histogram_get_min:
+ * @self: a #DflHistogram
+ *
+ * Get the shortest duration which has been added to the histogram.
+ *
+ * Returns: shortest duration, in microseconds, or 0 if the histogram is empty
+ * Since: UNRELEASED
+ */
+DflDuration
+dfl_histogram_get_min (DflHistogram *self)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+
+  return self->stats.min;
+}
+
+/**
+ * dfl_histogram_get_max:
+ * @self: a #DflHistogram
+ *
+ * Get the longest duration which has been added to the histogram.
+ *
+ * Returns: longest duration, in microseconds, or 0 if the histogram is empty
+ * Since: UNRELEASED
+ */
+DflDuration
+dfl_histogram_get_max (DflHistogram *self)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+
+  return self->stats.max;
+}
+
+/**
+ * dfl_histogram_get_sum:
+ * @self: a #DflHistogram
+ *
+ * Get the sum of the durations which have been added to the histogram.
+ *
+ * Returns: total duration, in microseconds
+ * Since: UNRELEASED
+ */
+DflDuration
+dfl_histogram_get_sum (DflHistogram *self)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+
+  return self->stats.sum;
+}
+
+/**
+ * dfl_histogram_get_quantile:
+ * @self: a #DflHistogram
+ * @quantile: quantile to calculate, between 0 and 1 inclusive
+ *
+ * Calculate the approximate duration at @quantile of the distribution. For
+ * example, a @quantile of 0.99 gives the duration which 99% of the durations
+ * are shorter than or equal to.
+ *
+ * This is linear in dfl_histogram_get_n_buckets().
+ *
+ * Returns: duration at @quantile, in microseconds, or 0 if the histogram is
+ *    empty
+ * Since: UNRELEASED
+ */
+DflDuration
+dfl_histogram_get_quantile (DflHistogram *self,
+                            gdouble       quantile)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+  g_return_val_if_fail (quantile >= 0.0 && quantile <= 1.0, 0);
+
+  return _dfl_duration_statistics_get_quantile (&self->stats, quantile);
+}
+
+/**
+ * dfl_histogram_get_n_buckets:
+ * @self: a #DflHistogram
+ *
+ * Get the number of buckets in the histogram, from the one containing the
+ * shortest duration to the one containing the longest. Some of these buckets
+ * may be empty.
+ *
+ * Returns: number of buckets
+ * Since: UNRELEASED
+ */
+guint
+dfl_histogram_get_n_buckets (DflHistogram *self)
+{
+  g_return_val_if_fail (DFL_IS_HISTOGRAM (self), 0);
+
+  return self->stats.n_buckets;
+}
+
+/**
+ * dfl_histogram_get_bucket:
+ * @self: a #DflHistogram
+ * @index: index of the bucket, less than dfl_histogram_get_n_buckets()
+ * @lower: (out caller-allocates) (optional): return location for the shortest
+ *    duration counted by the bucket, in microseconds
+ * @upper: (out caller-allocates) (optional): return location for the longest
+ *    duration counted by the bucket, in microseconds
+ * @count: (out caller-allocates) (optional): return location for the number of
+ *    durations counted by the bucket
+ *
+ * Get the range of durations counted by the bucket at @index, and how many
+ * durations it has counted. Buckets are in order of increasing duration.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_histogram_get_bucket (DflHistogram *self,
+                          guint         index,
+                          DflDuration  *lower,
+                          DflDuration  *upper,
+                          guint64      *count)
+{
+  DflDuration bucket_lower, bucket_upper;
+  guint64 bucket_count;
+
+  g_return_if_fail (DFL_IS_HISTOGRAM (self));
+  g_return_if_fail (index < self->stats.n_buckets);
+
+  _dfl_duration_statistics_get_bucket (&self->stats, index, &bucket_lower,
+                                       &bucket_upper, &bucket_count);
+
+  if (lower != NULL)
+    *lower = bucket_lower;
+  if (upper != NULL)
+    *upper = bucket_upper;
+  if (count != NULL)
+    *count = bucket_count;
+}
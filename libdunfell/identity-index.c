@@ -0,0 +1,155 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "identity-index.h"
+
+
+typedef struct
+{
+  DflTimestamp new_timestamp;
+  gpointer object;  /* unowned */
+} Generation;
+
+typedef struct
+{
+  DflId id;
+  /* Invariant: ordered by non-decreasing @new_timestamp. */
+  GArray/*<Generation>*/ *generations;  /* owned */
+} Entry;
+
+struct _DflIdentityIndex
+{
+  gint ref_count;  /* atomic */
+
+  /* Keys point to the #Entry.id of the values. */
+  GHashTable/*<unowned DflId*, owned Entry>*/ *entries;  /* owned */
+};
+
+static void
+entry_free (Entry *entry)
+{
+  g_array_unref (entry->generations);
+  g_free (entry);
+}
+
+DflIdentityIndex *
+_dfl_identity_index_new (void)
+{
+  DflIdentityIndex *index = NULL;
+
+  index = g_new0 (DflIdentityIndex, 1);
+  index->ref_count = 1;
+  index->entries = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+                                          (GDestroyNotify) entry_free);
+
+  return index;
+}
+
+DflIdentityIndex *
+_dfl_identity_index_ref (DflIdentityIndex *index)
+{
+  g_atomic_int_inc (&index->ref_count);
+
+  return index;
+}
+
+void
+_dfl_identity_index_unref (DflIdentityIndex *index)
+{
+  if (!g_atomic_int_dec_and_test (&index->ref_count))
+    return;
+
+  g_hash_table_unref (index->entries);
+  g_free (index);
+}
+
+/* Add @object as a new generation of @id, created at @new_timestamp. Each
+ * generation of a given ID must be inserted in the order they were created. */
+void
+_dfl_identity_index_insert (DflIdentityIndex *index,
+                            DflId             id,
+                            DflTimestamp      new_timestamp,
+                            gpointer          object)
+{
+  Entry *entry;
+  Generation generation;
+
+  entry = g_hash_table_lookup (index->entries, &id);
+
+  if (entry == NULL)
+    {
+      entry = g_new0 (Entry, 1);
+      entry->id = id;
+      entry->generations = g_array_sized_new (FALSE, FALSE,
+                                              sizeof (Generation), 1);
+      g_hash_table_insert (index->entries, &entry->id, entry);
+    }
+
+  g_assert (entry->generations->len == 0 ||
+            g_array_index (entry->generations, Generation,
+                           entry->generations->len - 1).new_timestamp <=
+            new_timestamp);
+
+  generation.new_timestamp = new_timestamp;
+  generation.object = object;
+  g_array_append_val (entry->generations, generation);
+}
+
+/* Look up the generation of @id which was live at @timestamp: the most recent
+ * one created at or before @timestamp. Returns %NULL if there is none. */
+gpointer
+_dfl_identity_index_lookup (DflIdentityIndex *index,
+                            DflId             id,
+                            DflTimestamp      timestamp)
+{
+  Entry *entry;
+  const Generation *generations;
+  guint lower, upper;
+
+  entry = g_hash_table_lookup (index->entries, &id);
+
+  if (entry == NULL)
+    return NULL;
+
+  generations = (const Generation *) entry->generations->data;
+  upper = entry->generations->len;
+
+  /* Fast path: lookups made while walking the event sequence are always for
+   * the latest generation. */
+  if (generations[upper - 1].new_timestamp <= timestamp)
+    return generations[upper - 1].object;
+
+  /* Find the first generation created after @timestamp. */
+  lower = 0;
+
+  while (lower < upper)
+    {
+      guint mid = lower + (upper - lower) / 2;
+
+      if (generations[mid].new_timestamp <= timestamp)
+        lower = mid + 1;
+      else
+        upper = mid;
+    }
+
+  return (lower > 0) ? generations[lower - 1].object : NULL;
+}
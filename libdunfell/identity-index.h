@@ -0,0 +1,60 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFL_IDENTITY_INDEX_H
+#define DFL_IDENTITY_INDEX_H
+
+#include <glib.h>
+
+#include "types.h"
+
+G_BEGIN_DECLS
+
+/* Internal index from the #DflId of an object in the traced process to the
+ * object which models it. IDs are derived from heap addresses, so the same ID
+ * may be reused for several objects over the lifetime of the process; each of
+ * these is a separate generation of the ID. Lookups give the generation which
+ * was live at a given timestamp.
+ *
+ * A generation is taken to be live from its creation until the creation of the
+ * next generation with the same ID, since free events are not reliably present
+ * in logs. Lookups at or after the creation of the most recent generation are
+ * constant time; earlier ones are a binary search over the generations of that
+ * ID.
+ *
+ * Objects are not owned by the index. An index is not thread safe.
+ *
+ * The functions here are prefixed with an underscore so they are not exported
+ * from the library. */
+typedef struct _DflIdentityIndex DflIdentityIndex;
+
+DflIdentityIndex *_dfl_identity_index_new    (void);
+DflIdentityIndex *_dfl_identity_index_ref    (DflIdentityIndex *index);
+void              _dfl_identity_index_unref  (DflIdentityIndex *index);
+
+void              _dfl_identity_index_insert (DflIdentityIndex *index,
+                                              DflId             id,
+                                              DflTimestamp      new_timestamp,
+                                              gpointer          object);
+gpointer          _dfl_identity_index_lookup (DflIdentityIndex *index,
+                                              DflId             id,
+                                              DflTimestamp      timestamp);
+
+G_END_DECLS
+
+#endif /* !DFL_IDENTITY_INDEX_H */
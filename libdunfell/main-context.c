@@ -34,6 +34,7 @@
 #include <gio/gio.h>
 #include <string.h>
 
+#include "duration-statistics.h"
 #include "event.h"
 #include "main-context.h"
 #include "time-sequence.h"
@@ -62,6 +63,28 @@ struct _DflMainContext
    * dispatch. A duration of ≥ 0 is valid; < 0 is not. */
   DflTimeSequence/*<DflMainContextDispatchData>*/ dispatch_events;
 
+  /* Summary of the durations of the completed dispatches in
+   * @dispatch_events, updated as each one completes. */
+  DflDurationStatistics dispatch_durations;
+
+  /* The source dispatches which happened within each of @dispatch_events, in
+   * timestamp order. Each #DflMainContextDispatchData refers to a contiguous
+   * range of them. This is built by the model once the sources are known,
+   * using _dfl_main_context_link_source_dispatches(), and extended each time
+   * the model is updated.
+   *
+   * Linking resumes from the last dispatch, as it may not have finished. All
+   * the dispatches before @link_dispatch_iter are finished, and their links
+   * are final: they use the first @n_linked_source_dispatches elements of
+   * @source_dispatches, which are all the source dispatches before
+   * @linked_until. @link_sources are the attached sources which may have
+   * dispatches at or after @linked_until, so have to be merged again. */
+  GArray/*<DflDispatch>*/ *source_dispatches;  /* owned */
+  DflTimeSequenceIter link_dispatch_iter;
+  guint n_linked_source_dispatches;
+  DflTimestamp linked_until;
+  GPtrArray/*<unowned DflSource>*/ *link_sources;  /* owned */
+
   /* TODO */
   DflTimeSequence source_events;
   DflTimeSequence thread_default_events;
@@ -82,10 +105,30 @@ dfl_main_context_init (DflMainContext *self)
 {
   dfl_time_sequence_init (&self->thread_ownership_events,
                           sizeof (DflThreadOwnershipData), NULL, 0);
+  dfl_time_sequence_set_duration_offset (&self->thread_ownership_events,
+                                         G_STRUCT_OFFSET (DflThreadOwnershipData,
+                                                          duration));
+  dfl_time_sequence_set_thread_id_offset (&self->thread_ownership_events,
+                                          G_STRUCT_OFFSET (DflThreadOwnershipData,
+                                                           thread_id));
   dfl_time_sequence_init (&self->thread_acquisition_failure_events,
                           sizeof (DflThreadId), NULL, 0);
   dfl_time_sequence_init (&self->dispatch_events,
                           sizeof (DflMainContextDispatchData), NULL, 0);
+  dfl_time_sequence_set_duration_offset (&self->dispatch_events,
+                                         G_STRUCT_OFFSET (DflMainContextDispatchData,
+                                                          duration));
+  dfl_time_sequence_set_thread_id_offset (&self->dispatch_events,
+                                          G_STRUCT_OFFSET (DflMainContextDispatchData,
+                                                           thread_id));
+  _dfl_duration_statistics_init (&self->dispatch_durations);
+
+  self->source_dispatches = g_array_new (FALSE, FALSE, sizeof (DflDispatch));
+  dfl_time_sequence_iter_init (&self->link_dispatch_iter,
+                               &self->dispatch_events, 0);
+  self->n_linked_source_dispatches = 0;
+  self->linked_until = 0;
+  self->link_sources = g_ptr_array_new ();
 
 #if 0
 TODO
@@ -99,7 +142,10 @@ dfl_main_context_dispose (GObject *object)
 {
   DflMainContext *self = DFL_MAIN_CONTEXT (object);
 
+  g_clear_pointer (&self->source_dispatches, g_array_unref);
+  g_clear_pointer (&self->link_sources, g_ptr_array_unref);
   dfl_time_sequence_clear (&self->dispatch_events);
+  _dfl_duration_statistics_clear (&self->dispatch_durations);
   dfl_time_sequence_clear (&self->thread_default_events);
   dfl_time_sequence_clear (&self->source_events);
   dfl_time_sequence_clear (&self->thread_acquisition_failure_events);
@@ -136,6 +182,7 @@ dfl_main_context_new (DflId        id,
 
 
 #include "event-sequence.h"
+#include "factory-private.h"
 
 static void
 main_context_acquire_release_cb (DflEventSequence *sequence,
@@ -262,6 +309,23 @@ main_context_free_cb (DflEventSequence *sequence,
   main_context->free_timestamp = timestamp;
 }
 
+/* Set the duration of a dispatch, marking it as complete, and update the
+ * statistics. */
+static void
+main_context_finish_dispatch (DflMainContext             *main_context,
+                              DflMainContextDispatchData *dispatch_data,
+                              DflDuration                 duration)
+{
+  /* If the dispatch was already complete (which only happens for malformed
+   * logs), replace its old duration. */
+  if (dispatch_data->duration >= 0)
+    _dfl_duration_statistics_remove (&main_context->dispatch_durations,
+                                     dispatch_data->duration);
+
+  dispatch_data->duration = duration;
+  _dfl_duration_statistics_add (&main_context->dispatch_durations, duration);
+}
+
 static void
 main_context_before_after_dispatch_cb (DflEventSequence *sequence,
                                        DflEvent         *event,
@@ -301,7 +365,8 @@ main_context_before_after_dispatch_cb (DflEventSequence *sequence,
                      "same context with no finish in between.");
 
           /* Fudge it. */
-          last_element->duration = timestamp - last_timestamp;
+          main_context_finish_dispatch (main_context, last_element,
+                                        timestamp - last_timestamp);
         }
 
       /* Start the next element. */
@@ -309,6 +374,8 @@ main_context_before_after_dispatch_cb (DflEventSequence *sequence,
                                                timestamp);
       next_element->thread_id = thread_id;
       next_element->duration = -1;  /* will be set by the paired //after// */
+      next_element->first_source_dispatch = 0;
+      next_element->n_source_dispatches = 0;
     }
   else
     {
@@ -335,6 +402,8 @@ main_context_before_after_dispatch_cb (DflEventSequence *sequence,
           last_timestamp = timestamp;
           last_element->thread_id = thread_id;
           last_element->duration = -1;
+          last_element->first_source_dispatch = 0;
+          last_element->n_source_dispatches = 0;
         }
       else if (last_element->duration >= 0)
         {
@@ -352,26 +421,44 @@ main_context_before_after_dispatch_cb (DflEventSequence *sequence,
                      "both on the same context.");
 
           /* Fudge it. */
-          last_element->duration = timestamp - last_timestamp;
+          main_context_finish_dispatch (main_context, last_element,
+                                        timestamp - last_timestamp);
 
           last_element = dfl_time_sequence_append (&main_context->dispatch_events,
                                                    timestamp);
           last_timestamp = timestamp;
           last_element->thread_id = thread_id;
           last_element->duration = -1;
+          last_element->first_source_dispatch = 0;
+          last_element->n_source_dispatches = 0;
         }
 
       /* Update the element’s duration. */
-      last_element->duration = timestamp - last_timestamp;
+      main_context_finish_dispatch (main_context, last_element,
+                                    timestamp - last_timestamp);
     }
 }
 
+typedef struct
+{
+  GPtrArray/*<owned DflMainContext>*/ *main_contexts;  /* owned */
+  DflIdentityIndex *index;  /* owned */
+} MainContextFactory;
+
+static void
+main_context_factory_free (MainContextFactory *factory)
+{
+  _dfl_identity_index_unref (factory->index);
+  g_ptr_array_unref (factory->main_contexts);
+  g_free (factory);
+}
+
 static void
 main_context_new_cb (DflEventSequence *sequence,
                      DflEvent         *event,
                      gpointer          user_data)
 {
-  GPtrArray/*<owned DflMainContext>*/ *main_contexts = user_data;
+  MainContextFactory *factory = user_data;
   DflMainContext *main_context = NULL;
   DflId main_context_id;
 
@@ -410,7 +497,9 @@ main_context_new_cb (DflEventSequence *sequence,
   dfl_event_sequence_end_walker_group (sequence, "g_main_context_free",
                                        main_context_id);
 
-  g_ptr_array_add (main_contexts, main_context);  /* transfer */
+  _dfl_identity_index_insert (factory->index, main_context_id,
+                              dfl_event_get_timestamp (event), main_context);
+  g_ptr_array_add (factory->main_contexts, main_context);  /* transfer */
 }
 
 /**
@@ -426,15 +515,27 @@ main_context_new_cb (DflEventSequence *sequence,
 GPtrArray *
 dfl_main_context_factory_from_event_sequence (DflEventSequence *sequence)
 {
-  GPtrArray/*<owned DflMainContext>*/ *main_contexts = NULL;
+  return _dfl_main_context_factory_from_event_sequence (sequence, NULL);
+}
+
+GPtrArray *
+_dfl_main_context_factory_from_event_sequence (DflEventSequence  *sequence,
+                                               DflIdentityIndex **index_out)
+{
+  MainContextFactory *factory = NULL;
+
+  factory = g_new0 (MainContextFactory, 1);
+  factory->main_contexts = g_ptr_array_new_with_free_func (g_object_unref);
+  factory->index = _dfl_identity_index_new ();
+
+  if (index_out != NULL)
+    *index_out = _dfl_identity_index_ref (factory->index);
 
-  main_contexts = g_ptr_array_new_with_free_func (g_object_unref);
   dfl_event_sequence_add_walker (sequence, "g_main_context_new", DFL_ID_INVALID,
-                                 main_context_new_cb,
-                                 g_ptr_array_ref (main_contexts),
-                                 (GDestroyNotify) g_ptr_array_unref);
+                                 main_context_new_cb, factory,
+                                 (GDestroyNotify) main_context_factory_free);
 
-  return main_contexts;
+  return g_ptr_array_ref (factory->main_contexts);
 }
 
 /**
@@ -530,6 +631,346 @@ dfl_main_context_dispatch_iter (DflMainContext      *self,
   dfl_time_sequence_iter_init (iter, &self->dispatch_events, start);
 }
 
+/**
+ * dfl_main_context_dispatch_iter_range:
+ * @self: a #DflMainContext
+ * @iter: an uninitialised #DflTimeSequenceIter to use
+ * @start: earliest dispatch timestamp to return, inclusive
+ * @end: latest dispatch timestamp to return, inclusive
+ *
+ * Initialise @iter to iterate over the dispatches of the main context which
+ * started in the range [@start, @end]. See
+ * dfl_time_sequence_iter_init_range().
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_main_context_dispatch_iter_range (DflMainContext      *self,
+                                      DflTimeSequenceIter *iter,
+                                      DflTimestamp         start,
+                                      DflTimestamp         end)
+{
+  g_return_if_fail (DFL_IS_MAIN_CONTEXT (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_iter_init_range (iter, &self->dispatch_events, start, end);
+}
+
+/**
+ * dfl_main_context_thread_ownership_iter_overlapping:
+ * @self: a #DflMainContext
+ * @iter: an uninitialised #DflTimeSequenceIter to use
+ * @start: start of the window, inclusive
+ * @end: end of the window, inclusive
+ *
+ * Initialise @iter to iterate over the periods when the main context was
+ * owned by a thread which overlap the window [@start, @end], including any
+ * which began before @start. Use dfl_time_sequence_iter_next_overlapping() to
+ * advance it.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_main_context_thread_ownership_iter_overlapping (DflMainContext      *self,
+                                                    DflTimeSequenceIter *iter,
+                                                    DflTimestamp         start,
+                                                    DflTimestamp         end)
+{
+  g_return_if_fail (DFL_IS_MAIN_CONTEXT (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_iter_init_overlapping (iter, &self->thread_ownership_events,
+                                           start, end);
+}
+
+/**
+ * dfl_main_context_dispatch_iter_overlapping:
+ * @self: a #DflMainContext
+ * @iter: an uninitialised #DflTimeSequenceIter to use
+ * @start: start of the window, inclusive
+ * @end: end of the window, inclusive
+ *
+ * Initialise @iter to iterate over the dispatches of the main context which
+ * overlap the window [@start, @end], including any which began before
+ * @start. Use dfl_time_sequence_iter_next_overlapping() to advance it.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_main_context_dispatch_iter_overlapping (DflMainContext      *self,
+                                            DflTimeSequenceIter *iter,
+                                            DflTimestamp         start,
+                                            DflTimestamp         end)
+{
+  g_return_if_fail (DFL_IS_MAIN_CONTEXT (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_iter_init_overlapping (iter, &self->dispatch_events,
+                                           start, end);
+}
+
+/* Order sources by when they were created, so they are merged in the same
+ * order however the log was split into batches. */
+static gint
+source_compare_by_creation (gconstpointer a,
+                            gconstpointer b)
+{
+  DflSource *source_a = *((DflSource **) a);
+  DflSource *source_b = *((DflSource **) b);
+  DflTimestamp timestamp_a, timestamp_b;
+
+  timestamp_a = dfl_source_get_new_timestamp (source_a);
+  timestamp_b = dfl_source_get_new_timestamp (source_b);
+
+  if (timestamp_a != timestamp_b)
+    return (timestamp_a < timestamp_b) ? -1 : 1;
+  if (dfl_source_get_id (source_a) != dfl_source_get_id (source_b))
+    return (dfl_source_get_id (source_a) < dfl_source_get_id (source_b)) ? -1 : 1;
+
+  return 0;
+}
+
+/* Link each dispatch of @self to the dispatches of its attached sources which
+ * happened within it, so they can be returned by
+ * dfl_main_context_get_source_dispatches(). @changed_sources must be the
+ * sources attached to @self which have been attached or dispatched since the
+ * previous call, or %NULL if there are none.
+ *
+ * A source dispatch belongs to the last dispatch of @self which started at or
+ * before it, if that was on the same thread and had not finished by then. This
+ * is a single merge of the source dispatches against the main context
+ * dispatches, resuming from the last main context dispatch linked by the
+ * previous call. Only the changed sources, and those which had dispatches
+ * after that, are merged, so calling it after each update to the model is
+ * linear in the number of new dispatches. */
+void
+_dfl_main_context_link_source_dispatches (DflMainContext *self,
+                                          GPtrArray      *changed_sources)
+{
+  g_auto (DflTimeSequenceMergeIter) source_iter = { NULL, };
+  DflTimeSequenceIter dispatch_iter, next_dispatch_iter;
+  DflTimestamp dispatch_timestamp, next_dispatch_timestamp;
+  DflMainContextDispatchData *dispatch_data, *next_dispatch_data;
+  gsize i, j;
+
+  if (changed_sources != NULL)
+    {
+      for (i = 0; i < changed_sources->len; i++)
+        g_ptr_array_add (self->link_sources, changed_sources->pdata[i]);
+
+      /* Drop the sources which were already to be merged. They are adjacent
+       * once sorted. */
+      g_ptr_array_sort (self->link_sources, source_compare_by_creation);
+
+      for (i = 0, j = 0; i < self->link_sources->len; i++)
+        {
+          if (j == 0 ||
+              self->link_sources->pdata[i] != self->link_sources->pdata[j - 1])
+            self->link_sources->pdata[j++] = self->link_sources->pdata[i];
+        }
+
+      g_ptr_array_set_size (self->link_sources, j);
+    }
+
+  if (self->link_sources->len == 0)
+    return;
+
+  dispatch_iter = self->link_dispatch_iter;
+
+  if (!dfl_time_sequence_iter_next (&dispatch_iter, &dispatch_timestamp,
+                                    (gpointer *) &dispatch_data))
+    return;
+
+  /* Discard the links from the unfinished dispatch, and start again from it. */
+  g_array_set_size (self->source_dispatches,
+                    self->n_linked_source_dispatches);
+  dispatch_data->first_source_dispatch = self->source_dispatches->len;
+  dispatch_data->n_source_dispatches = 0;
+
+  dfl_time_sequence_merge_iter_init (&source_iter);
+
+  for (i = 0; i < self->link_sources->len; i++)
+    {
+      DflTimeSequenceIter iter;
+
+      dfl_source_dispatch_iter_range (self->link_sources->pdata[i], &iter,
+                                      self->linked_until, G_MAXUINT64);
+      dfl_time_sequence_merge_iter_add (&source_iter, &iter, 0,
+                                        self->link_sources->pdata[i]);
+    }
+
+  while (TRUE)
+    {
+      DflTimestamp source_timestamp;
+      DflSourceDispatchData *source_data;
+      gpointer source;
+      gboolean have_source;
+      DflDispatch *dispatch;
+
+      have_source = dfl_time_sequence_merge_iter_next (&source_iter,
+                                                       &source_timestamp,
+                                                       (gpointer *) &source_data,
+                                                       &source);
+
+      if (!have_source)
+        source_timestamp = G_MAXUINT64;
+
+      /* Move on to the last main context dispatch which started at or before
+       * the source dispatch. The dispatches before it have finished, so their
+       * links are final. */
+      next_dispatch_iter = dispatch_iter;
+
+      while (dfl_time_sequence_iter_next (&next_dispatch_iter,
+                                          &next_dispatch_timestamp,
+                                          (gpointer *) &next_dispatch_data) &&
+             next_dispatch_timestamp <= source_timestamp)
+        {
+          self->link_dispatch_iter = dispatch_iter;
+          self->n_linked_source_dispatches = self->source_dispatches->len;
+          self->linked_until = next_dispatch_timestamp;
+
+          dispatch_iter = next_dispatch_iter;
+          dispatch_timestamp = next_dispatch_timestamp;
+          dispatch_data = next_dispatch_data;
+          dispatch_data->first_source_dispatch = self->source_dispatches->len;
+          dispatch_data->n_source_dispatches = 0;
+        }
+
+      if (!have_source)
+        break;
+
+      if (source_timestamp < dispatch_timestamp ||
+          source_data->thread_id != dispatch_data->thread_id ||
+          (dispatch_data->duration >= 0 &&
+           source_timestamp > dispatch_timestamp + dispatch_data->duration))
+        continue;
+
+      g_array_set_size (self->source_dispatches,
+                        self->source_dispatches->len + 1);
+      dispatch = &g_array_index (self->source_dispatches, DflDispatch,
+                                 self->source_dispatches->len - 1);
+      dispatch->source = source;
+      dispatch->timestamp = source_timestamp;
+      dispatch->duration = source_data->duration;
+
+      dispatch_data->n_source_dispatches++;
+    }
+
+  /* Only keep the sources which will have to be merged again next time. */
+  for (i = 0, j = 0; i < self->link_sources->len; i++)
+    {
+      DflTimeSequenceIter iter;
+
+      dfl_source_dispatch_iter_range (self->link_sources->pdata[i], &iter,
+                                      self->linked_until, G_MAXUINT64);
+
+      if (dfl_time_sequence_iter_next (&iter, NULL, NULL))
+        self->link_sources->pdata[j++] = self->link_sources->pdata[i];
+    }
+
+  g_ptr_array_set_size (self->link_sources, j);
+}
+
+/**
+ * dfl_main_context_get_source_dispatches:
+ * @self: a #DflMainContext
+ * @dispatch_data: data for one of the dispatches of @self, as returned by a
+ *    #DflTimeSequenceIter from dfl_main_context_dispatch_iter() or similar
+ * @n_source_dispatches: (out): return location for the number of source
+ *    dispatches
+ *
+ * Get the source dispatches which happened within the given dispatch of the
+ * main context, on the same thread, in timestamp order. This is O(1), as the
+ * links are built by #DflModel as it analyses the event sequence; they are
+ * only available for main contexts in a model.
+ *
+ * The returned array is only valid until the model is next updated.
+ *
+ * Returns: (transfer none) (array length=n_source_dispatches) (nullable): the
+ *    source dispatches, or %NULL if there were none
+ * Since: UNRELEASED
+ */
+const DflDispatch *
+dfl_main_context_get_source_dispatches (DflMainContext                   *self,
+                                        const DflMainContextDispatchData *dispatch_data,
+                                        guint                            *n_source_dispatches)
+{
+  g_return_val_if_fail (DFL_IS_MAIN_CONTEXT (self), NULL);
+  g_return_val_if_fail (dispatch_data != NULL, NULL);
+  g_return_val_if_fail (n_source_dispatches != NULL, NULL);
+
+  *n_source_dispatches = dispatch_data->n_source_dispatches;
+
+  if (dispatch_data->n_source_dispatches == 0)
+    return NULL;
+
+  g_return_val_if_fail (dispatch_data->first_source_dispatch +
+                        dispatch_data->n_source_dispatches <=
+                        self->source_dispatches->len, NULL);
+
+  return &g_array_index (self->source_dispatches, DflDispatch,
+                         dispatch_data->first_source_dispatch);
+}
+
+/**
+ * dfl_main_context_dup_thread_ownership_summary:
+ * @self: a #DflMainContext
+ * @start: start of the window to summarise, inclusive
+ * @end: end of the window to summarise, inclusive
+ * @resolution: desired width of each bucket, in microseconds
+ *
+ * Summarise the periods when the main context was owned by a thread, in the
+ * window [@start, @end]. See dfl_time_sequence_dup_summary() for details.
+ *
+ * Returns: (transfer full) (element-type DflTimeSequenceSummary): summaries of
+ *    the non-empty buckets in the window
+ * Since: UNRELEASED
+ */
+GArray *
+dfl_main_context_dup_thread_ownership_summary (DflMainContext *self,
+                                               DflTimestamp    start,
+                                               DflTimestamp    end,
+                                               DflDuration     resolution)
+{
+  g_return_val_if_fail (DFL_IS_MAIN_CONTEXT (self), NULL);
+  g_return_val_if_fail (start <= end, NULL);
+  g_return_val_if_fail (resolution > 0, NULL);
+
+  return dfl_time_sequence_dup_summary (&self->thread_ownership_events,
+                                        start, end, resolution);
+}
+
+/**
+ * dfl_main_context_dup_dispatch_summary:
+ * @self: a #DflMainContext
+ * @start: start of the window to summarise, inclusive
+ * @end: end of the window to summarise, inclusive
+ * @resolution: desired width of each bucket, in microseconds
+ *
+ * Summarise the main context’s dispatches in the window [@start, @end]. See
+ * dfl_time_sequence_dup_summary() for details.
+ *
+ * Returns: (transfer full) (element-type DflTimeSequenceSummary): summaries of
+ *    the non-empty buckets in the window
+ * Since: UNRELEASED
+ */
+GArray *
+dfl_main_context_dup_dispatch_summary (DflMainContext *self,
+                                       DflTimestamp    start,
+                                       DflTimestamp    end,
+                                       DflDuration     resolution)
+{
+  g_return_val_if_fail (DFL_IS_MAIN_CONTEXT (self), NULL);
+  g_return_val_if_fail (start <= end, NULL);
+  g_return_val_if_fail (resolution > 0, NULL);
+
+  return dfl_time_sequence_dup_summary (&self->dispatch_events, start, end,
+                                        resolution);
+}
+
 /**
  * dfl_main_context_get_n_thread_switches:
  * @self: a #DflMainContext
@@ -570,3 +1011,22 @@ dfl_main_context_get_n_thread_switches (DflMainContext *self)
 
   return count;
 }
+
+/**
+ * dfl_main_context_dup_dispatch_histogram:
+ * @self: a #DflMainContext
+ *
+ * Get a histogram of the durations of the main context’s completed
+ * dispatches. The histogram is a copy, so is not updated if more dispatches
+ * are added to the main context.
+ *
+ * Returns: (transfer full): a new histogram of the dispatch durations
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_main_context_dup_dispatch_histogram (DflMainContext *self)
+{
+  g_return_val_if_fail (DFL_IS_MAIN_CONTEXT (self), NULL);
+
+  return _dfl_histogram_new_from_statistics (&self->dispatch_durations);
+}
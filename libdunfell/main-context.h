@@ -23,6 +23,8 @@
 #include <glib-object.h>
 
 #include "event-sequence.h"
+#include "histogram.h"
+#include "source.h"
 #include "time-sequence.h"
 
 G_BEGIN_DECLS
@@ -46,6 +48,11 @@ typedef struct
  * DflMainContextDispatchData:
  * @thread_id: TODO
  * @duration: TODO
+ * @first_source_dispatch: index of the first of the source dispatches which
+ *    happened within this dispatch, in the array returned by
+ *    dfl_main_context_get_source_dispatches()
+ * @n_source_dispatches: number of source dispatches which happened within this
+ *    dispatch
  *
  * TODO
  *
@@ -55,6 +62,8 @@ typedef struct
 {
   DflThreadId thread_id;
   DflDuration duration;
+  guint first_source_dispatch;
+  guint n_source_dispatches;
 } DflMainContextDispatchData;
 
 /**
@@ -82,9 +91,37 @@ void dfl_main_context_thread_ownership_iter (DflMainContext      *self,
 void dfl_main_context_dispatch_iter (DflMainContext      *self,
                                      DflTimeSequenceIter *iter,
                                      DflTimestamp         start);
+void dfl_main_context_dispatch_iter_range (DflMainContext      *self,
+                                           DflTimeSequenceIter *iter,
+                                           DflTimestamp         start,
+                                           DflTimestamp         end);
+
+void dfl_main_context_thread_ownership_iter_overlapping (DflMainContext      *self,
+                                                         DflTimeSequenceIter *iter,
+                                                         DflTimestamp         start,
+                                                         DflTimestamp         end);
+void dfl_main_context_dispatch_iter_overlapping         (DflMainContext      *self,
+                                                         DflTimeSequenceIter *iter,
+                                                         DflTimestamp         start,
+                                                         DflTimestamp         end);
+
+const DflDispatch *dfl_main_context_get_source_dispatches (DflMainContext                   *self,
+                                                          const DflMainContextDispatchData *dispatch_data,
+                                                          guint                            *n_source_dispatches);
+
+GArray *dfl_main_context_dup_thread_ownership_summary (DflMainContext *self,
+                                                       DflTimestamp    start,
+                                                       DflTimestamp    end,
+                                                       DflDuration     resolution);
+GArray *dfl_main_context_dup_dispatch_summary         (DflMainContext *self,
+                                                       DflTimestamp    start,
+                                                       DflTimestamp    end,
+                                                       DflDuration     resolution);
 
 gsize dfl_main_context_get_n_thread_switches (DflMainContext *self);
 
+DflHistogram *dfl_main_context_dup_dispatch_histogram (DflMainContext *self);
+
 G_END_DECLS
 
 #endif /* !DFL_MAIN_CONTEXT_H */
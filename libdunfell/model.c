@@ -26,8 +26,18 @@
  * from a #DflEventSequence. This is the main data model for presenting and
  * analysing statistics from a recorded event sequence.
  *
- * The analysis is performed at construction time and not updated afterwards;
- * the event sequence is immutable.
+ * The analysis is performed at construction time, with the extraction of each
+ * kind of object running in parallel on large event sequences. This may still
+ * take a long time, so dfl_model_new_async() performs it in a worker thread
+ * instead, and can be cancelled part way through.
+ *
+ * If events are appended to the event sequence afterwards (for example, while
+ * it is still being loaded by dfl_parser_load_from_stream_async()), only the
+ * new events are analysed, and #DflModel::updated is emitted. The arrays
+ * returned by dfl_model_dup_main_contexts() and friends are shared with the
+ * model, so gain new elements as it is updated. If analysing some new events
+ * fails, the model stops being updated, and the error is available from
+ * dfl_model_get_update_error().
  *
  * Since: UNRELEASED
  */
@@ -36,8 +46,12 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
+#include "duration-statistics.h"
 #include "event-sequence.h"
+#include "event-table.h"
+#include "factory-private.h"
 #include "main-context.h"
 #include "model.h"
 #include "source.h"
@@ -53,9 +67,59 @@ static void dfl_model_set_property (GObject      *object,
                                     guint         property_id,
                                     const GValue *value,
                                     GParamSpec   *pspec);
-static void dfl_model_constructed  (GObject      *object);
 static void dfl_model_finalize     (GObject      *object);
-static void dfl_model_analyse      (DflModel     *self);
+static void dfl_model_initable_iface_init       (GInitableIface      *iface);
+static void dfl_model_async_initable_iface_init (GAsyncInitableIface *iface);
+static gboolean dfl_model_initable_init         (GInitable           *initable,
+                                                 GCancellable        *cancellable,
+                                                 GError             **error);
+static void     dfl_model_init_async            (GAsyncInitable      *initable,
+                                                 int                  io_priority,
+                                                 GCancellable        *cancellable,
+                                                 GAsyncReadyCallback  callback,
+                                                 gpointer             user_data);
+static gboolean dfl_model_init_finish           (GAsyncInitable      *initable,
+                                                 GAsyncResult        *result,
+                                                 GError             **error);
+static gboolean dfl_model_analyse  (DflModel      *self,
+                                    GCancellable  *cancellable,
+                                    GError       **error);
+static gboolean dfl_model_walk     (DflModel      *self,
+                                    GCancellable  *cancellable,
+                                    GError       **error);
+static void dfl_model_ensure_dispatch_index (DflModel *self);
+static void event_sequence_items_changed_cb (GListModel *list,
+                                             guint       position,
+                                             guint       removed,
+                                             guint       added,
+                                             gpointer    user_data);
+
+/* The factories which extract objects from the event sequence. They share no
+ * state, so each walks its own view of the event sequence, and they are run in
+ * parallel. */
+typedef enum
+{
+  FACTORY_MAIN_CONTEXTS,
+  FACTORY_THREADS,
+  FACTORY_SOURCES,
+  FACTORY_TASKS,
+} DflModelFactory;
+
+#define N_FACTORIES (FACTORY_TASKS + 1)
+
+/* Minimum number of events to analyse before it is worth running the
+ * factories in parallel. This is no more than the number of events in each
+ * batch from dfl_parser_load_from_stream_async(), so that a log which is
+ * being streamed in is analysed in parallel too. */
+#define PARALLEL_ANALYSIS_MIN_EVENTS 16384
+
+/* How far each source’s dispatches have been added to the dispatch indexes. */
+typedef struct
+{
+  guint n_indexed_dispatches;  /* leading completed dispatches indexed */
+  DflThreadId dispatch_thread_id;  /* of its first dispatch; 0 if none yet */
+  gboolean dispatched_on_several_threads;
+} DflIndexedSource;
 
 struct _DflModel
 {
@@ -63,21 +127,65 @@ struct _DflModel
 
   /* Input data. */
   DflEventSequence *event_sequence;  /* (owned) */
+  DflEventSequence *factory_sequences[N_FACTORIES];  /* (owned) */
+  guint n_analysed_events;
+
+  /* Pool for running the factories in parallel. This is not exclusive, so
+   * idle threads are shared with the rest of the process, and it is kept
+   * between walks so that threads are not created for each batch of
+   * events. */
+  GThreadPool *walk_pool;  /* (owned) (nullable) */
+  GMutex walk_lock;
+  GCond walk_cond;
+  guint n_pending_walks;  /* protected by walk_lock */
 
   /* Results of analysis. */
   GPtrArray *main_contexts;  /* (owned) (element-type DflMainContext) */
+  DflIdentityIndex *main_context_index;  /* (owned) */
   GPtrArray *threads;  /* (owned) (element-type DflThread) */
+  GHashTable *thread_index;  /* (owned) (element-type DflThreadId* guint) */
   GPtrArray *sources;  /* (owned) (element-type DflSource) */
+  DflIdentityIndex *source_index;  /* (owned) */
+  /* Sources attached or dispatched in the current walk, whose main contexts
+   * need relinking. Filled in by the source factory. */
+  GHashTable *changed_sources;  /* (owned) (element-type DflSource) */
   GPtrArray *tasks;  /* (owned) (element-type DflTask) */
+  DflIdentityIndex *task_index;  /* (owned) */
+
+  /* All completed source dispatches, longest first, and the indices of the
+   * sources which have dispatched on each thread, in increasing order. Both
+   * are brought up to date on demand after the model is updated, from the
+   * dispatches added since. @indexed_sources is parallel to @sources. */
+  GArray *dispatch_index;  /* (owned) (element-type DflDispatch) */
+  GHashTable *thread_dispatch_sources;  /* (owned) (element-type DflThreadId* GArray<guint>) */
+  GArray *indexed_sources;  /* (owned) (element-type DflIndexedSource) */
+  gboolean dispatch_index_valid;
+
+  gboolean analysed;
+
+  /* Error from analysing events appended after construction. Once set, the
+   * model is no longer updated. */
+  GError *update_error;  /* (owned) (nullable) */
 };
 
-G_DEFINE_TYPE (DflModel, dfl_model, G_TYPE_OBJECT)
+G_DEFINE_TYPE_WITH_CODE (DflModel, dfl_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
+                                                dfl_model_initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
+                                                dfl_model_async_initable_iface_init))
 
 typedef enum
 {
   PROP_EVENT_SEQUENCE = 1,
 } DflModelProperty;
 
+typedef enum
+{
+  SIGNAL_UPDATED,
+} DflModelSignal;
+
+static guint signals[SIGNAL_UPDATED + 1];
+
 static void
 dfl_model_class_init (DflModelClass *klass)
 {
@@ -85,7 +193,6 @@ dfl_model_class_init (DflModelClass *klass)
 
   object_class->get_property = dfl_model_get_property;
   object_class->set_property = dfl_model_set_property;
-  object_class->constructed = dfl_model_constructed;
   object_class->finalize = dfl_model_finalize;
 
   /**
@@ -105,12 +212,52 @@ dfl_model_class_init (DflModelClass *klass)
                                                         G_PARAM_READWRITE |
                                                         G_PARAM_CONSTRUCT_ONLY |
                                                         G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DflModel::updated:
+   * @self: a #DflModel
+   *
+   * Emitted after events which were appended to the #DflModel:event-sequence
+   * have been analysed. Existing objects in the model may have changed, and
+   * new ones may have been added.
+   *
+   * It is also emitted if analysing the events failed, after which
+   * dfl_model_get_update_error() returns the error and the model is not
+   * updated again.
+   *
+   * Since: UNRELEASED
+   */
+  signals[SIGNAL_UPDATED] =
+    g_signal_new ("updated", G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+dfl_model_initable_iface_init (GInitableIface *iface)
+{
+  iface->init = dfl_model_initable_init;
+}
+
+static void
+dfl_model_async_initable_iface_init (GAsyncInitableIface *iface)
+{
+  iface->init_async = dfl_model_init_async;
+  iface->init_finish = dfl_model_init_finish;
 }
 
 static void
 dfl_model_init (DflModel *self)
 {
-  /* Nothing to see here. */
+  g_mutex_init (&self->walk_lock);
+  g_cond_init (&self->walk_cond);
+
+  self->dispatch_index = g_array_new (FALSE, FALSE, sizeof (DflDispatch));
+  self->thread_dispatch_sources = g_hash_table_new_full (g_int64_hash,
+                                                        g_int64_equal, g_free,
+                                                        (GDestroyNotify) g_array_unref);
+  self->indexed_sources = g_array_new (FALSE, TRUE, sizeof (DflIndexedSource));
 }
 
 static void
@@ -151,45 +298,574 @@ dfl_model_set_property (GObject           *object,
     }
 }
 
+static gboolean
+dfl_model_initable_init (GInitable     *initable,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  DflModel *self = DFL_MODEL (initable);
+
+  /* Analyse the model. */
+  if (!dfl_model_analyse (self, cancellable, error))
+    return FALSE;
+
+  g_signal_connect (self->event_sequence, "items-changed",
+                    (GCallback) event_sequence_items_changed_cb, self);
+
+  return TRUE;
+}
+
+/* Analyse the events in the sequence in a worker thread. The first time this
+ * is called, the model is set up and all the events so far are analysed.
+ * Subsequent calls analyse any events appended while the previous call was in
+ * progress. The sequence is frozen throughout. */
 static void
-dfl_model_constructed (GObject *object)
+init_thread_cb (GTask         *task,
+                gpointer       source_object,
+                gpointer       task_data,
+                GCancellable  *cancellable)
 {
-  DflModel *self = DFL_MODEL (object);
+  DflModel *self = DFL_MODEL (source_object);
+  GError *error = NULL;
+  gboolean success;
 
-  /* Chain up first. */
-  G_OBJECT_CLASS (dfl_model_parent_class)->constructed (object);
+  if (!self->analysed)
+    {
+      success = dfl_model_analyse (self, cancellable, &error);
+    }
+  else
+    {
+      success = dfl_model_walk (self, cancellable, &error);
 
-  /* Analyse the model. */
-  dfl_model_analyse (self);
+      if (success)
+        dfl_model_ensure_dispatch_index (self);
+    }
+
+  if (success)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+static void init_walk_cb (GObject      *source_object,
+                          GAsyncResult *result,
+                          gpointer      user_data);
+
+/* Freeze the event sequence and analyse its events in a worker thread, then
+ * continue in init_walk_cb(). @task is the dfl_model_init_async() task. */
+static void
+dfl_model_init_walk_async (DflModel *self,
+                           GTask    *task)
+{
+  GTask *walk_task = NULL;
+
+  /* The event sequence’s table is walked in the worker thread, so it must not
+   * be modified until the walk has finished. Any events appended in the
+   * meantime are held back until it is thawed in init_walk_cb(). */
+  _dfl_event_sequence_freeze (self->event_sequence);
+
+  walk_task = g_task_new (self, g_task_get_cancellable (task), init_walk_cb,
+                          g_object_ref (task));
+  g_task_set_source_tag (walk_task, dfl_model_init_walk_async);
+  g_task_set_priority (walk_task, g_task_get_priority (task));
+  g_task_run_in_thread (walk_task, init_thread_cb);
+  g_object_unref (walk_task);
+}
+
+static void
+init_walk_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  DflModel *self = DFL_MODEL (source_object);
+  g_autoptr (GTask) task = G_TASK (user_data);
+  GError *error = NULL;
+
+  /* Append the events which were held back during the walk. Nothing is
+   * connected to #GListModel::items-changed yet, so this is cheap. */
+  _dfl_event_sequence_thaw (self->event_sequence);
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* If any events were held back, analyse them in the worker thread too,
+   * rather than on the main thread once the model has been returned. Repeat
+   * until the model has caught up with the sequence. */
+  if (g_list_model_get_n_items (G_LIST_MODEL (self->event_sequence)) >
+      self->n_analysed_events)
+    {
+      dfl_model_init_walk_async (self, task);
+      return;
+    }
+
+  g_signal_connect (self->event_sequence, "items-changed",
+                    (GCallback) event_sequence_items_changed_cb, self);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+dfl_model_init_async (GAsyncInitable      *initable,
+                      int                  io_priority,
+                      GCancellable        *cancellable,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+  DflModel *self = DFL_MODEL (initable);
+  GTask *task = NULL;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, dfl_model_init_async);
+  g_task_set_priority (task, io_priority);
+  dfl_model_init_walk_async (self, task);
+  g_object_unref (task);
+}
+
+static gboolean
+dfl_model_init_finish (GAsyncInitable  *initable,
+                       GAsyncResult    *result,
+                       GError         **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 static void
 dfl_model_finalize (GObject *object)
 {
   DflModel *self = DFL_MODEL (object);
+  guint i;
+
+  g_signal_handlers_disconnect_by_func (self->event_sequence,
+                                        event_sequence_items_changed_cb, self);
 
+  /* No walks can be in progress by now. */
+  if (self->walk_pool != NULL)
+    g_thread_pool_free (self->walk_pool, FALSE, TRUE);
+  g_mutex_clear (&self->walk_lock);
+  g_cond_clear (&self->walk_cond);
+
+  g_clear_pointer (&self->main_context_index, _dfl_identity_index_unref);
   g_clear_pointer (&self->main_contexts, g_ptr_array_unref);
+  g_clear_pointer (&self->thread_index, g_hash_table_unref);
   g_clear_pointer (&self->threads, g_ptr_array_unref);
+  g_clear_pointer (&self->source_index, _dfl_identity_index_unref);
+  g_clear_pointer (&self->changed_sources, g_hash_table_unref);
   g_clear_pointer (&self->sources, g_ptr_array_unref);
+  g_clear_pointer (&self->task_index, _dfl_identity_index_unref);
   g_clear_pointer (&self->tasks, g_ptr_array_unref);
+  g_clear_pointer (&self->dispatch_index, g_array_unref);
+  g_clear_pointer (&self->thread_dispatch_sources, g_hash_table_unref);
+  g_clear_pointer (&self->indexed_sources, g_array_unref);
+  g_clear_error (&self->update_error);
 
+  for (i = 0; i < N_FACTORIES; i++)
+    g_clear_object (&self->factory_sequences[i]);
   g_clear_object (&self->event_sequence);
 
   G_OBJECT_CLASS (dfl_model_parent_class)->finalize (object);
 }
 
+/* One factory’s walk over its view of the event sequence. */
+typedef struct
+{
+  DflEventSequence *sequence;  /* unowned */
+  GCancellable *cancellable;  /* unowned; nullable */
+  GError *error;  /* owned; nullable */
+} FactoryWalk;
+
+static void
+factory_walk (FactoryWalk *walk)
+{
+  _dfl_event_sequence_resume_walk (walk->sequence, walk->cancellable,
+                                   &walk->error);
+}
+
+/* Run a walk in the model’s pool, and wake up dfl_model_walk() once all the
+ * walks it pushed to the pool have finished. */
+static void
+factory_walk_cb (gpointer data,
+                 gpointer user_data)
+{
+  FactoryWalk *walk = data;
+  DflModel *self = DFL_MODEL (user_data);
+
+  factory_walk (walk);
+
+  g_mutex_lock (&self->walk_lock);
+  self->n_pending_walks--;
+  if (self->n_pending_walks == 0)
+    g_cond_signal (&self->walk_cond);
+  g_mutex_unlock (&self->walk_lock);
+}
+
+/* Link each main context’s dispatches to the dispatches of the sources
+ * attached to it. This has to be done once all the factories have walked the
+ * new events, as sources and main contexts are built by different factories.
+ * Only the sources which were attached or dispatched in this walk are looked
+ * at, and each main context only re-examines its last dispatch and the events
+ * after it. */
+static void
+dfl_model_link_source_dispatches (DflModel *self)
+{
+  g_autoptr (GHashTable) attached_sources = NULL;  /* DflMainContext → owned GPtrArray<unowned DflSource> */
+  GHashTableIter iter;
+  gpointer key;
+  gsize i;
+
+  attached_sources = g_hash_table_new_full (NULL, NULL, NULL,
+                                            (GDestroyNotify) g_ptr_array_unref);
+
+  g_hash_table_iter_init (&iter, self->changed_sources);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      DflSource *source = key;
+      DflMainContext *main_context;
+      GPtrArray *sources;
+      DflId main_context_id;
+
+      main_context_id = dfl_source_get_attach_main_context_id (source);
+
+      if (main_context_id == DFL_ID_INVALID)
+        continue;
+
+      main_context = dfl_model_get_main_context (self, main_context_id,
+                                                 dfl_source_get_attach_timestamp (source));
+
+      if (main_context == NULL)
+        continue;
+
+      sources = g_hash_table_lookup (attached_sources, main_context);
+
+      if (sources == NULL)
+        {
+          sources = g_ptr_array_new ();
+          g_hash_table_insert (attached_sources, main_context, sources);
+        }
+
+      g_ptr_array_add (sources, source);
+    }
+
+  g_hash_table_remove_all (self->changed_sources);
+
+  for (i = 0; i < self->main_contexts->len; i++)
+    {
+      DflMainContext *main_context = self->main_contexts->pdata[i];
+
+      _dfl_main_context_link_source_dispatches (main_context,
+                                                g_hash_table_lookup (attached_sources,
+                                                                     main_context));
+    }
+}
+
+/* Walk all the factories’ views of the event sequence over the events which
+ * have not been analysed yet. If there are enough of them, the factories are
+ * run in parallel, one in this thread and the others in the model’s pool. */
+static gboolean
+dfl_model_walk (DflModel      *self,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+  FactoryWalk walks[N_FACTORIES];
+  guint i, n_events;
+  GError *child_error = NULL;
+
+  n_events = g_list_model_get_n_items (G_LIST_MODEL (self->event_sequence));
+
+  for (i = 0; i < N_FACTORIES; i++)
+    {
+      walks[i].sequence = self->factory_sequences[i];
+      walks[i].cancellable = cancellable;
+      walks[i].error = NULL;
+    }
+
+  if (n_events - self->n_analysed_events >= PARALLEL_ANALYSIS_MIN_EVENTS)
+    {
+      if (self->walk_pool == NULL)
+        self->walk_pool = g_thread_pool_new (factory_walk_cb, self,
+                                             N_FACTORIES - 1, FALSE, NULL);
+
+      self->n_pending_walks = N_FACTORIES - 1;
+
+      for (i = 1; i < N_FACTORIES; i++)
+        g_thread_pool_push (self->walk_pool, &walks[i], NULL);
+
+      factory_walk (&walks[0]);
+
+      g_mutex_lock (&self->walk_lock);
+      while (self->n_pending_walks > 0)
+        g_cond_wait (&self->walk_cond, &self->walk_lock);
+      g_mutex_unlock (&self->walk_lock);
+    }
+  else
+    {
+      for (i = 0; i < N_FACTORIES; i++)
+        factory_walk (&walks[i]);
+    }
+
+  /* Report the first error. */
+  for (i = 0; i < N_FACTORIES; i++)
+    {
+      if (walks[i].error != NULL && child_error == NULL)
+        child_error = g_steal_pointer (&walks[i].error);
+      g_clear_error (&walks[i].error);
+    }
+
+  if (child_error != NULL)
+    {
+      g_propagate_error (error, child_error);
+      return FALSE;
+    }
+
+  dfl_model_link_source_dispatches (self);
+
+  self->n_analysed_events = n_events;
+  self->dispatch_index_valid = FALSE;
+
+  return TRUE;
+}
+
+static gint
+dispatch_compare_longest_first (gconstpointer a,
+                                gconstpointer b)
+{
+  const DflDispatch *dispatch_a = a, *dispatch_b = b;
+
+  if (dispatch_a->duration != dispatch_b->duration)
+    return (dispatch_a->duration > dispatch_b->duration) ? -1 : 1;
+
+  /* Break ties by putting the earliest dispatch first, so the order is
+   * stable. */
+  if (dispatch_a->timestamp != dispatch_b->timestamp)
+    return (dispatch_a->timestamp < dispatch_b->timestamp) ? -1 : 1;
+
+  return 0;
+}
+
+/* Record that the source at @source_index in the model has dispatched on
+ * @thread_id, keeping the thread’s list of sources sorted. */
+static void
+dfl_model_index_dispatch_thread (DflModel    *self,
+                                 guint        source_index,
+                                 DflThreadId  thread_id)
+{
+  DflIndexedSource *indexed_source;
+  GArray *thread_sources;
+  guint lower, upper;
+
+  indexed_source = &g_array_index (self->indexed_sources, DflIndexedSource,
+                                   source_index);
+
+  if (indexed_source->dispatch_thread_id == thread_id)
+    return;
+
+  if (indexed_source->dispatch_thread_id == 0)
+    indexed_source->dispatch_thread_id = thread_id;
+  else
+    indexed_source->dispatched_on_several_threads = TRUE;
+
+  thread_sources = g_hash_table_lookup (self->thread_dispatch_sources,
+                                        &thread_id);
+
+  if (thread_sources == NULL)
+    {
+      thread_sources = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_hash_table_insert (self->thread_dispatch_sources,
+                           g_memdup (&thread_id, sizeof (thread_id)),
+                           thread_sources);
+    }
+
+  /* Sources are normally indexed in order, so this is usually an append. */
+  lower = 0;
+  upper = thread_sources->len;
+
+  while (lower < upper)
+    {
+      guint mid = lower + (upper - lower) / 2;
+      guint mid_index = g_array_index (thread_sources, guint, mid);
+
+      if (mid_index == source_index)
+        return;
+      else if (mid_index < source_index)
+        lower = mid + 1;
+      else
+        upper = mid;
+    }
+
+  g_array_insert_val (thread_sources, lower, source_index);
+}
+
+/* Bring the index of all completed source dispatches, sorted by decreasing
+ * duration, and the index of the sources dispatched on each thread up to date
+ * if the model has been updated since they were last queried. Only the k
+ * dispatches added since then are looked at. The completed ones are sorted,
+ * and merged into the index from its end; as most dispatches are short, this
+ * normally only moves the tail of the index. The queries on it are O(log n)
+ * or O(k). */
 static void
-dfl_model_analyse (DflModel *self)
+dfl_model_ensure_dispatch_index (DflModel *self)
+{
+  g_autoptr (GArray) new_dispatches = NULL;
+  DflDispatch *dispatches;
+  guint i, j, k;
+
+  if (self->dispatch_index_valid)
+    return;
+
+  new_dispatches = g_array_new (FALSE, FALSE, sizeof (DflDispatch));
+
+  /* Sources are only ever appended, so new ones start with nothing indexed. */
+  g_array_set_size (self->indexed_sources, self->sources->len);
+
+  for (i = 0; i < self->sources->len; i++)
+    {
+      DflSource *source = self->sources->pdata[i];
+      guint *n_indexed = &g_array_index (self->indexed_sources,
+                                         DflIndexedSource,
+                                         i).n_indexed_dispatches;
+      DflTimeSequenceIter iter;
+      DflTimestamp timestamp;
+      DflSourceDispatchData *dispatch_data;
+      gsize n_dispatches, n_completed;
+
+      dfl_source_get_dispatch_statistics (source, &n_dispatches, NULL, NULL,
+                                          NULL);
+
+      if (n_dispatches == *n_indexed)
+        continue;
+
+      /* Walk back from the end of the sequence over the dispatches which are
+       * not indexed yet. Only the last one can still be in progress; it is
+       * left out of the dispatch index until it completes, though its thread
+       * is indexed straight away. */
+      dfl_source_dispatch_iter (source, &iter, G_MAXUINT64);
+      while (dfl_time_sequence_iter_next (&iter, NULL, NULL));
+
+      n_completed = n_dispatches;
+
+      for (j = n_dispatches; j > *n_indexed; j--)
+        {
+          DflDispatch dispatch;
+
+          dfl_time_sequence_iter_previous (&iter, &timestamp,
+                                           (gpointer *) &dispatch_data);
+          dfl_model_index_dispatch_thread (self, i, dispatch_data->thread_id);
+
+          if (dispatch_data->duration < 0)
+            {
+              g_assert (j == n_dispatches);
+              n_completed--;
+              continue;
+            }
+
+          dispatch.source = source;
+          dispatch.timestamp = timestamp;
+          dispatch.duration = dispatch_data->duration;
+          g_array_append_val (new_dispatches, dispatch);
+        }
+
+      *n_indexed = n_completed;
+    }
+
+  g_array_sort (new_dispatches, dispatch_compare_longest_first);
+
+  /* Merge from the end, so each existing dispatch is moved at most once, and
+   * only if it sorts after one of the new ones. */
+  i = self->dispatch_index->len;
+  j = new_dispatches->len;
+  k = i + j;
+
+  g_array_set_size (self->dispatch_index, k);
+  dispatches = (DflDispatch *) self->dispatch_index->data;
+
+  while (j > 0)
+    {
+      const DflDispatch *new_dispatch = &g_array_index (new_dispatches,
+                                                        DflDispatch, j - 1);
+
+      if (i > 0 &&
+          dispatch_compare_longest_first (&dispatches[i - 1], new_dispatch) > 0)
+        {
+          dispatches[--k] = dispatches[--i];
+        }
+      else
+        {
+          dispatches[--k] = *new_dispatch;
+          j--;
+        }
+    }
+
+  self->dispatch_index_valid = TRUE;
+}
+
+/* Analyse the event sequence, checking @cancellable between events. This may
+ * be called in a worker thread. If it is cancelled, the model is left
+ * unusable. */
+static gboolean
+dfl_model_analyse (DflModel      *self,
+                   GCancellable  *cancellable,
+                   GError       **error)
 {
+  guint i;
+
   g_assert (self->event_sequence != NULL);
 
+  if (self->analysed)
+    return TRUE;
+
+  for (i = 0; i < N_FACTORIES; i++)
+    self->factory_sequences[i] = _dfl_event_sequence_new_view (self->event_sequence);
+
   /* Grab various objects out of the event sequence. */
-  self->main_contexts = dfl_main_context_factory_from_event_sequence (self->event_sequence);
-  self->threads = dfl_thread_factory_from_event_sequence (self->event_sequence);
-  self->sources = dfl_source_factory_from_event_sequence (self->event_sequence);
-  self->tasks = dfl_task_factory_from_event_sequence (self->event_sequence);
+  self->main_contexts = _dfl_main_context_factory_from_event_sequence (self->factory_sequences[FACTORY_MAIN_CONTEXTS],
+                                                                       &self->main_context_index);
+  self->threads = _dfl_thread_factory_from_event_sequence (self->factory_sequences[FACTORY_THREADS],
+                                                           &self->thread_index);
+  self->sources = _dfl_source_factory_from_event_sequence (self->factory_sequences[FACTORY_SOURCES],
+                                                           &self->source_index,
+                                                           &self->changed_sources);
+  self->tasks = _dfl_task_factory_from_event_sequence (self->factory_sequences[FACTORY_TASKS],
+                                                       &self->task_index);
+
+  if (!dfl_model_walk (self, cancellable, error))
+    return FALSE;
+
+  /* Build the dispatch index now, so that it is done in the worker thread if
+   * this is being called from dfl_model_new_async(). */
+  dfl_model_ensure_dispatch_index (self);
+
+  self->analysed = TRUE;
 
-  dfl_event_sequence_walk (self->event_sequence);
+  return TRUE;
+}
+
+static void
+event_sequence_items_changed_cb (GListModel *list,
+                                 guint       position,
+                                 guint       removed,
+                                 guint       added,
+                                 gpointer    user_data)
+{
+  DflModel *self = DFL_MODEL (user_data);
+
+  /* Event sequences are append-only. */
+  g_assert (removed == 0);
+
+  /* The walkers installed by dfl_model_analyse() are still in place, so this
+   * continues the analysis from where it left off. The model is in use on
+   * this thread, so it cannot be updated from another one; each batch of
+   * appended events is small enough that this is not a problem. If the walk
+   * fails, the factories are left part way through the new events, so the
+   * model cannot be updated any further. */
+  if (!dfl_model_walk (self, NULL, &self->update_error))
+    g_signal_handlers_disconnect_by_func (self->event_sequence,
+                                          event_sequence_items_changed_cb,
+                                          self);
+
+  g_signal_emit (self, signals[SIGNAL_UPDATED], 0);
 }
 
 /**
@@ -206,9 +882,92 @@ dfl_model_new (DflEventSequence *event_sequence)
 {
   g_return_val_if_fail (DFL_IS_EVENT_SEQUENCE (event_sequence), NULL);
 
-  return g_object_new (DFL_TYPE_MODEL,
-                       "event-sequence", event_sequence,
-                       NULL);
+  /* Without a #GCancellable, initialisation cannot fail. */
+  return g_initable_new (DFL_TYPE_MODEL, NULL, NULL,
+                         "event-sequence", event_sequence,
+                         NULL);
+}
+
+/**
+ * dfl_model_new_async:
+ * @event_sequence: event sequence to analyse
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: callback to call once the model is ready
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of dfl_model_new(). The analysis is performed in a
+ * worker thread, and @cancellable is checked periodically while walking the
+ * events, so that even analysis of a large event sequence can be cancelled
+ * promptly.
+ *
+ * Events may be appended to @event_sequence while the analysis is in progress
+ * (for example, by dfl_parser_load_from_stream_async()); they are held back
+ * until the analysis is finished, then appended and analysed in the worker
+ * thread as well, before @callback is called.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_model_new_async (DflEventSequence    *event_sequence,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+  g_return_if_fail (DFL_IS_EVENT_SEQUENCE (event_sequence));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  g_async_initable_new_async (DFL_TYPE_MODEL, G_PRIORITY_DEFAULT, cancellable,
+                              callback, user_data,
+                              "event-sequence", event_sequence,
+                              NULL);
+}
+
+/**
+ * dfl_model_new_finish:
+ * @result: result of the asynchronous operation
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish function for dfl_model_new_async().
+ *
+ * Returns: (transfer full): a new #DflModel, or %NULL on error
+ * Since: UNRELEASED
+ */
+DflModel *
+dfl_model_new_finish (GAsyncResult  *result,
+                      GError       **error)
+{
+  GObject *source_object = NULL;
+  GObject *model = NULL;
+
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  source_object = g_async_result_get_source_object (result);
+  model = g_async_initable_new_finish (G_ASYNC_INITABLE (source_object),
+                                       result, error);
+  g_object_unref (source_object);
+
+  return (model != NULL) ? DFL_MODEL (model) : NULL;
+}
+
+/**
+ * dfl_model_get_update_error:
+ * @self: a #DflModel
+ *
+ * Get the error from analysing events which were appended to the
+ * #DflModel:event-sequence after the model was constructed, if analysing them
+ * failed. Once this is set, the model is not updated with any further events.
+ *
+ * Returns: (transfer none) (nullable): the error, or %NULL if all the appended
+ *    events have been analysed successfully
+ * Since: UNRELEASED
+ */
+const GError *
+dfl_model_get_update_error (DflModel *self)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  return self->update_error;
 }
 
 /**
@@ -265,6 +1024,96 @@ dfl_model_dup_threads (DflModel *self)
   return g_ptr_array_ref (self->threads);
 }
 
+/**
+ * dfl_model_get_thread:
+ * @self: a #DflModel
+ * @thread_id: ID of the thread to look up
+ *
+ * Look up the #DflThread with the given @thread_id. This is a constant time
+ * operation, so should be used in preference to searching the array returned
+ * by dfl_model_dup_threads().
+ *
+ * Returns: (transfer none) (nullable): the thread, or %NULL if no thread with
+ *    that ID exists in the event sequence
+ * Since: UNRELEASED
+ */
+DflThread *
+dfl_model_get_thread (DflModel    *self,
+                      DflThreadId  thread_id)
+{
+  guint thread_index;
+
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  if (!dfl_model_find_thread (self, thread_id, &thread_index))
+    return NULL;
+
+  return self->threads->pdata[thread_index];
+}
+
+/**
+ * dfl_model_find_thread:
+ * @self: a #DflModel
+ * @thread_id: ID of the thread to look up
+ * @index_: (optional) (out caller-allocates): return location for the index of
+ *    the thread
+ *
+ * Look up the position of the #DflThread with the given @thread_id in the
+ * array returned by dfl_model_dup_threads(). Threads are only ever appended to
+ * the array, so the position remains valid when the model is updated. This is
+ * a constant time operation.
+ *
+ * Returns: %TRUE if the thread was found, %FALSE otherwise
+ * Since: UNRELEASED
+ */
+gboolean
+dfl_model_find_thread (DflModel    *self,
+                       DflThreadId  thread_id,
+                       guint       *index_)
+{
+  gpointer thread_index;
+
+  g_return_val_if_fail (DFL_IS_MODEL (self), FALSE);
+
+  if (!g_hash_table_lookup_extended (self->thread_index, &thread_id, NULL,
+                                     &thread_index))
+    return FALSE;
+
+  if (index_ != NULL)
+    *index_ = GPOINTER_TO_UINT (thread_index);
+
+  return TRUE;
+}
+
+/**
+ * dfl_model_get_main_context:
+ * @self: a #DflModel
+ * @main_context_id: ID of the main context to look up
+ * @timestamp: time at which the main context was live
+ *
+ * Look up the #DflMainContext with the given @main_context_id which was live at
+ * @timestamp. IDs are derived from memory addresses in the traced process, so
+ * several main contexts may have had the same ID at different times.
+ *
+ * A main context is considered live from its creation until the creation of the
+ * next main context with the same ID. Lookups at or after the creation of the
+ * most recent main context with a given ID are constant time.
+ *
+ * Returns: (transfer none) (nullable): the main context, or %NULL if none with
+ *    that ID was live at @timestamp
+ * Since: UNRELEASED
+ */
+DflMainContext *
+dfl_model_get_main_context (DflModel     *self,
+                            DflId         main_context_id,
+                            DflTimestamp  timestamp)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  return _dfl_identity_index_lookup (self->main_context_index,
+                                     main_context_id, timestamp);
+}
+
 /**
  * dfl_model_dup_sources:
  * @self: a #DflModel
@@ -283,6 +1132,29 @@ dfl_model_dup_sources (DflModel *self)
   return g_ptr_array_ref (self->sources);
 }
 
+/**
+ * dfl_model_get_source:
+ * @self: a #DflModel
+ * @source_id: ID of the source to look up
+ * @timestamp: time at which the source was live
+ *
+ * Look up the #DflSource with the given @source_id which was live at
+ * @timestamp. See dfl_model_get_main_context() for details.
+ *
+ * Returns: (transfer none) (nullable): the source, or %NULL if none with that
+ *    ID was live at @timestamp
+ * Since: UNRELEASED
+ */
+DflSource *
+dfl_model_get_source (DflModel     *self,
+                      DflId         source_id,
+                      DflTimestamp  timestamp)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  return _dfl_identity_index_lookup (self->source_index, source_id, timestamp);
+}
+
 /**
  * dfl_model_dup_tasks:
  * @self: a #DflModel
@@ -301,13 +1173,40 @@ dfl_model_dup_tasks (DflModel *self)
   return g_ptr_array_ref (self->tasks);
 }
 
+/**
+ * dfl_model_get_task:
+ * @self: a #DflModel
+ * @task_id: ID of the task to look up
+ * @timestamp: time at which the task was live
+ *
+ * Look up the #DflTask with the given @task_id which was live at @timestamp.
+ * See dfl_model_get_main_context() for details.
+ *
+ * Returns: (transfer none) (nullable): the task, or %NULL if none with that ID
+ *    was live at @timestamp
+ * Since: UNRELEASED
+ */
+DflTask *
+dfl_model_get_task (DflModel     *self,
+                    DflId         task_id,
+                    DflTimestamp  timestamp)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  return _dfl_identity_index_lookup (self->task_index, task_id, timestamp);
+}
+
 /**
  * dfl_model_get_n_long_dispatches:
  * @self: a #DflModel
  * @min_duration: minimum dispatch duration to count (inclusive), in
  *    microseconds
  *
- * TODO
+ * Count the completed source dispatches which took at least @min_duration.
+ * This uses an index of the dispatches sorted by duration, so is O(log n) in
+ * the number of dispatches, and may be called repeatedly with different
+ * values of @min_duration. The index is rebuilt on the first call after the
+ * model is updated.
  *
  * Returns: number of dispatches whose duration is equal to or greater than
  *    @min_duration, over all sources
@@ -317,28 +1216,264 @@ gsize
 dfl_model_get_n_long_dispatches (DflModel    *self,
                                  DflDuration  min_duration)
 {
-  gsize i;
-  gsize total;
+  gsize lower, upper;
 
   g_return_val_if_fail (DFL_IS_MODEL (self), 0);
 
-  total = 0;
+  dfl_model_ensure_dispatch_index (self);
+
+  /* Find the first dispatch which is shorter than @min_duration; all the
+   * dispatches before it are long enough. */
+  lower = 0;
+  upper = self->dispatch_index->len;
+
+  while (lower < upper)
+    {
+      gsize mid = lower + (upper - lower) / 2;
+
+      if (g_array_index (self->dispatch_index, DflDispatch, mid).duration >= min_duration)
+        lower = mid + 1;
+      else
+        upper = mid;
+    }
+
+  return lower;
+}
+
+/**
+ * dfl_model_dup_longest_dispatches:
+ * @self: a #DflModel
+ * @n_dispatches: maximum number of dispatches to return
+ *
+ * Get the @n_dispatches longest completed source dispatches, over all sources,
+ * longest first. Dispatches of equal duration are ordered by timestamp. Fewer
+ * than @n_dispatches are returned if the model does not contain that many.
+ *
+ * This uses the same index as dfl_model_get_n_long_dispatches(), so is O(k)
+ * in @n_dispatches.
+ *
+ * Returns: (transfer full) (element-type DflDispatch): the longest dispatches
+ * Since: UNRELEASED
+ */
+GArray *
+dfl_model_dup_longest_dispatches (DflModel *self,
+                                  guint     n_dispatches)
+{
+  GArray *dispatches = NULL;
+
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  dfl_model_ensure_dispatch_index (self);
+
+  n_dispatches = MIN (n_dispatches, self->dispatch_index->len);
+  dispatches = g_array_sized_new (FALSE, FALSE, sizeof (DflDispatch),
+                                  n_dispatches);
+  g_array_append_vals (dispatches, self->dispatch_index->data, n_dispatches);
+
+  return dispatches;
+}
+
+/**
+ * dfl_model_dispatch_iter:
+ * @self: a #DflModel
+ * @iter: an uninitialised #DflTimeSequenceMergeIter to use
+ * @thread_id: ID of the thread to return dispatches from, or 0 to return
+ *    dispatches from all threads
+ * @start: earliest dispatch timestamp to return, inclusive
+ * @end: latest dispatch timestamp to return, inclusive
+ *
+ * Initialise @iter to iterate over the dispatches of all sources in the model
+ * which started in the range [@start, @end], in timestamp order. Each element
+ * is a #DflSourceDispatchData, and its user data is the #DflSource which was
+ * dispatched. Free @iter using dfl_time_sequence_merge_iter_clear().
+ *
+ * Finding the start of the range is O(s log n) in the number of sources, and
+ * iterating over k dispatches is then O(k log s). If @thread_id is non-zero,
+ * only the sources which have dispatched on that thread are looked at, so s
+ * is the number of those; their dispatches on other threads are skipped over
+ * individually.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_model_dispatch_iter (DflModel                 *self,
+                         DflTimeSequenceMergeIter *iter,
+                         DflThreadId               thread_id,
+                         DflTimestamp              start,
+                         DflTimestamp              end)
+{
+  GArray *thread_sources;
+  gsize i;
+
+  g_return_if_fail (DFL_IS_MODEL (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_merge_iter_init (iter);
+
+  if (thread_id == 0)
+    {
+      for (i = 0; i < self->sources->len; i++)
+        {
+          DflSource *source = self->sources->pdata[i];
+          DflTimeSequenceIter source_iter;
+
+          dfl_source_dispatch_iter_range (source, &source_iter, start, end);
+          dfl_time_sequence_merge_iter_add (iter, &source_iter, 0, source);
+        }
+
+      return;
+    }
+
+  dfl_model_ensure_dispatch_index (self);
+
+  thread_sources = g_hash_table_lookup (self->thread_dispatch_sources,
+                                        &thread_id);
+
+  for (i = 0; thread_sources != NULL && i < thread_sources->len; i++)
+    {
+      guint source_index = g_array_index (thread_sources, guint, i);
+      DflSource *source = self->sources->pdata[source_index];
+      const DflIndexedSource *indexed_source;
+      DflTimeSequenceIter source_iter;
+      DflThreadId filter_thread_id;
+
+      indexed_source = &g_array_index (self->indexed_sources, DflIndexedSource,
+                                       source_index);
+
+      /* Only filter by thread if the source has dispatches on other
+       * threads. */
+      filter_thread_id = indexed_source->dispatched_on_several_threads ?
+                         thread_id : 0;
+
+      dfl_source_dispatch_iter_range (source, &source_iter, start, end);
+      dfl_time_sequence_merge_iter_add (iter, &source_iter, filter_thread_id,
+                                        source);
+    }
+}
+
+/**
+ * dfl_model_dup_dispatch_histogram:
+ * @self: a #DflModel
+ *
+ * Get a histogram of the durations of all completed dispatches of all sources
+ * in the model. This aggregates the histograms maintained by each source, so
+ * is linear in the number of sources rather than the number of dispatches.
+ *
+ * Returns: (transfer full): a new histogram of the dispatch durations
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_model_dup_dispatch_histogram (DflModel *self)
+{
+  DflHistogram *histogram = NULL;
+  gsize i;
+
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+
+  histogram = dfl_histogram_new ();
 
   for (i = 0; i < self->sources->len; i++)
     {
       DflSource *source = self->sources->pdata[i];
-      gsize source_n_dispatches;
 
-      source_n_dispatches = dfl_source_get_n_long_dispatches (source, min_duration);
+      _dfl_histogram_merge_statistics (histogram,
+                                       _dfl_source_get_dispatch_durations (source));
+    }
 
-      /* Bail out on potential overflow. */
-      if (total > G_MAXSIZE - source_n_dispatches)
-        return G_MAXSIZE;
+  return histogram;
+}
 
-      total += source_n_dispatches;
+/* Build a histogram of the completed dispatches, of any source, which match
+ * @thread_id (unless it is zero) and @callback_name (unless it is %NULL). */
+static DflHistogram *
+dfl_model_build_dispatch_histogram (DflModel    *self,
+                                    DflThreadId  thread_id,
+                                    const gchar *callback_name)
+{
+  DflHistogram *histogram = NULL;
+  gsize i;
+
+  histogram = dfl_histogram_new ();
+
+  for (i = 0; i < self->sources->len; i++)
+    {
+      DflSource *source = self->sources->pdata[i];
+      DflTimeSequenceIter iter;
+      DflSourceDispatchData *dispatch_data;
+
+      dfl_source_dispatch_iter (source, &iter, 0);
+
+      while (dfl_time_sequence_iter_next (&iter, NULL,
+                                          (gpointer *) &dispatch_data))
+        {
+          /* Skip dispatches which were still in progress. */
+          if (dispatch_data->duration < 0)
+            continue;
+          if (thread_id != 0 && dispatch_data->thread_id != thread_id)
+            continue;
+          if (callback_name != NULL &&
+              g_strcmp0 (dispatch_data->callback_name, callback_name) != 0)
+            continue;
+
+          dfl_histogram_add (histogram, dispatch_data->duration);
+        }
     }
 
-  return total;
+  return histogram;
+}
+
+/**
+ * dfl_model_dup_thread_dispatch_histogram:
+ * @self: a #DflModel
+ * @thread_id: ID of the thread to aggregate dispatches from
+ *
+ * Get a histogram of the durations of all completed dispatches, of any source,
+ * which happened on the thread with ID @thread_id.
+ *
+ * This is linear in the total number of dispatches in the model.
+ *
+ * Returns: (transfer full) (nullable): a new histogram of the dispatch
+ *    durations, or %NULL if @thread_id is not in the model
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_model_dup_thread_dispatch_histogram (DflModel    *self,
+                                         DflThreadId  thread_id)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+  g_return_val_if_fail (thread_id != 0, NULL);
+
+  if (!dfl_model_find_thread (self, thread_id, NULL))
+    return NULL;
+
+  return dfl_model_build_dispatch_histogram (self, thread_id, NULL);
+}
+
+/**
+ * dfl_model_dup_callback_dispatch_histogram:
+ * @self: a #DflModel
+ * @callback_name: name of the callback function to aggregate dispatches of
+ *
+ * Get a histogram of the durations of all completed dispatches, of any source,
+ * whose callback function was called @callback_name. This aggregates across
+ * all the sources which share a callback, which is typically the most useful
+ * way of finding which callback is slow.
+ *
+ * This is linear in the total number of dispatches in the model.
+ *
+ * Returns: (transfer full): a new histogram of the dispatch durations; this is
+ *    empty if no dispatches used @callback_name
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_model_dup_callback_dispatch_histogram (DflModel    *self,
+                                           const gchar *callback_name)
+{
+  g_return_val_if_fail (DFL_IS_MODEL (self), NULL);
+  g_return_val_if_fail (callback_name != NULL, NULL);
+
+  return dfl_model_build_dispatch_histogram (self, 0, callback_name);
 }
 
 /**
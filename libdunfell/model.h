@@ -21,8 +21,14 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "event-sequence.h"
+#include "histogram.h"
+#include "main-context.h"
+#include "source.h"
+#include "task.h"
+#include "thread.h"
 
 G_BEGIN_DECLS
 
@@ -36,18 +42,55 @@ G_BEGIN_DECLS
 #define DFL_TYPE_MODEL dfl_model_get_type ()
 G_DECLARE_FINAL_TYPE (DflModel, dfl_model, DFL, MODEL, GObject)
 
-DflModel *dfl_model_new (DflEventSequence *event_sequence);
+DflModel *dfl_model_new        (DflEventSequence     *event_sequence);
+void      dfl_model_new_async  (DflEventSequence     *event_sequence,
+                                GCancellable         *cancellable,
+                                GAsyncReadyCallback   callback,
+                                gpointer              user_data);
+DflModel *dfl_model_new_finish (GAsyncResult         *result,
+                                GError              **error);
 
 DflEventSequence *dfl_model_get_event_sequence (DflModel *self);
+const GError     *dfl_model_get_update_error   (DflModel *self);
 
 GPtrArray        *dfl_model_dup_main_contexts  (DflModel *self);
 GPtrArray        *dfl_model_dup_threads        (DflModel *self);
 GPtrArray        *dfl_model_dup_sources        (DflModel *self);
 GPtrArray        *dfl_model_dup_tasks          (DflModel *self);
 
-gsize dfl_model_get_n_long_dispatches              (DflModel    *self,
-                                                    DflDuration  min_duration);
-gsize dfl_model_get_n_main_context_thread_switches (DflModel    *self);
+DflThread *dfl_model_get_thread  (DflModel    *self,
+                                  DflThreadId  thread_id);
+gboolean   dfl_model_find_thread (DflModel    *self,
+                                  DflThreadId  thread_id,
+                                  guint       *index_);
+
+DflMainContext *dfl_model_get_main_context (DflModel     *self,
+                                            DflId         main_context_id,
+                                            DflTimestamp  timestamp);
+DflSource      *dfl_model_get_source       (DflModel     *self,
+                                            DflId         source_id,
+                                            DflTimestamp  timestamp);
+DflTask        *dfl_model_get_task         (DflModel     *self,
+                                            DflId         task_id,
+                                            DflTimestamp  timestamp);
+
+gsize   dfl_model_get_n_long_dispatches              (DflModel    *self,
+                                                      DflDuration  min_duration);
+GArray *dfl_model_dup_longest_dispatches             (DflModel    *self,
+                                                      guint        n_dispatches);
+gsize   dfl_model_get_n_main_context_thread_switches (DflModel    *self);
+
+void dfl_model_dispatch_iter (DflModel                 *self,
+                              DflTimeSequenceMergeIter *iter,
+                              DflThreadId               thread_id,
+                              DflTimestamp              start,
+                              DflTimestamp              end);
+
+DflHistogram *dfl_model_dup_dispatch_histogram          (DflModel    *self);
+DflHistogram *dfl_model_dup_thread_dispatch_histogram   (DflModel    *self,
+                                                         DflThreadId  thread_id);
+DflHistogram *dfl_model_dup_callback_dispatch_histogram (DflModel    *self,
+                                                         const gchar *callback_name);
 
 G_END_DECLS
 
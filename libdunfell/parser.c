@@ -24,6 +24,21 @@
  *
  * TODO
  *
+ * Both version 1.0 (text) and version 2.0 (binary) log files are supported,
+ * and the version is detected automatically. See #DflWriter for details of the
+ * binary format.
+ *
+ * When loading asynchronously with dfl_parser_load_from_stream_async(), events
+ * are made available in batches as they are parsed: #DflParser:event-sequence
+ * is set once the first batch is ready, and grows as later batches arrive.
+ * Progress is reported through #DflParser:bytes-processed. This allows the
+ * start of a long log to be analysed and displayed while the rest loads.
+ *
+ * A log which is still being recorded can be followed using
+ * dfl_parser_follow_stream_async(), which works in the same way, but keeps
+ * appending new events to the event sequence as they are written to the log,
+ * until it is cancelled.
+ *
  * Since: 0.1.0
  */
 
@@ -34,28 +49,84 @@
 #include <gio/gio.h>
 #include <string.h>
 
+#include "binary-log.h"
 #include "event.h"
 #include "event-sequence.h"
+#include "event-table.h"
 #include "parser.h"
 
 
+static void dfl_parser_get_property (GObject    *object,
+                                     guint       property_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec);
 static void dfl_parser_dispose (GObject *object);
+static void intern_event_types (void);
 
 struct _DflParser
 {
   GObject parent;
 
   DflEventSequence *sequence;  /* owned */
+  guint64 bytes_processed;
 };
 
 G_DEFINE_TYPE (DflParser, dfl_parser, G_TYPE_OBJECT)
 
+typedef enum
+{
+  PROP_EVENT_SEQUENCE = 1,
+  PROP_BYTES_PROCESSED,
+} DflParserProperty;
+
 static void
 dfl_parser_class_init (DflParserClass *klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
+  gobject_class->get_property = dfl_parser_get_property;
   gobject_class->dispose = dfl_parser_dispose;
+
+  /**
+   * DflParser:event-sequence:
+   *
+   * The events parsed from the most recently loaded log, or %NULL if no log
+   * has been loaded yet. While a log is being loaded by
+   * dfl_parser_load_from_stream_async(), this is set once the first batch of
+   * events is available, and events are appended to it as they are parsed.
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (gobject_class, PROP_EVENT_SEQUENCE,
+                                   g_param_spec_object ("event-sequence",
+                                                        "Event Sequence",
+                                                        "Events parsed from "
+                                                        "the log.",
+                                                        DFL_TYPE_EVENT_SEQUENCE,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DflParser:bytes-processed:
+   *
+   * Number of bytes of the log parsed so far by
+   * dfl_parser_load_from_stream_async(). This is updated with each batch of
+   * events, and can be compared against the size of the log (if known) to
+   * show progress.
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (gobject_class, PROP_BYTES_PROCESSED,
+                                   g_param_spec_uint64 ("bytes-processed",
+                                                        "Bytes Processed",
+                                                        "Number of bytes of "
+                                                        "the log parsed so "
+                                                        "far.",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_STATIC_STRINGS));
+
+  intern_event_types ();
 }
 
 static void
@@ -64,6 +135,27 @@ dfl_parser_init (DflParser *self)
   /* Nothing to see here. */
 }
 
+static void
+dfl_parser_get_property (GObject    *object,
+                         guint       property_id,
+                         GValue     *value,
+                         GParamSpec *pspec)
+{
+  DflParser *self = DFL_PARSER (object);
+
+  switch ((DflParserProperty) property_id)
+    {
+    case PROP_EVENT_SEQUENCE:
+      g_value_set_object (value, self->sequence);
+      break;
+    case PROP_BYTES_PROCESSED:
+      g_value_set_uint64 (value, self->bytes_processed);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
 static void
 dfl_parser_dispose (GObject *object)
 {
@@ -75,49 +167,1227 @@ dfl_parser_dispose (GObject *object)
   G_OBJECT_CLASS (dfl_parser_parent_class)->dispose (object);
 }
 
+/* Maximum number of parameters for any event type in @event_type_array. */
+#define MAX_N_PARAMETERS 6
+
 typedef struct
 {
   const gchar *event_type;
   guint n_parameters;  /* excluding event type, timestamp and thread ID */
+  /* Schema for the parameters, which are decoded as these kinds when the log
+   * is parsed. */
+  DflEventParameterKind parameter_kinds[MAX_N_PARAMETERS];
 } EventData;
 
+/* Shorthands for the schemas below. */
+#define ID DFL_EVENT_PARAMETER_ID
+#define INT64 DFL_EVENT_PARAMETER_INT64
+#define SYMBOL DFL_EVENT_PARAMETER_SYMBOL
+#define STRING DFL_EVENT_PARAMETER_STRING
+
+/* See record/dunfell-record.stp for the meanings of the parameters. Symbols
+ * are function names (or addresses, if the name could not be resolved). */
 const EventData event_type_array[] =
 {
-  { "g_main_context_new", 1 },
-  { "g_main_context_acquire", 2 },
-  { "g_main_context_release", 1 },
-  { "g_main_context_free", 1 },
-  { "g_main_context_before_dispatch", 1 },
-  { "g_main_context_after_dispatch", 1 },
-  { "g_source_new", 6 },
-  { "g_source_before_free", 3 },
-  { "g_source_before_dispatch", 4 },
-  { "g_source_after_dispatch", 3 },
-  { "g_source_set_name", 2 },
-  { "g_source_add_child_source", 2 },
-  { "g_source_attach", 3 },
-  { "g_source_destroy", 2 },
-  { "g_thread_spawned", 3 },
-  { "g_task_new", 5 },
-  { "g_task_set_source_tag", 2 },
-  { "g_task_before_return", 4 },
-  { "g_task_propagate", 2 },
-  { "g_task_before_run_in_thread", 2 },
-  { "g_task_after_run_in_thread", 2 },
+  { "g_main_context_new", 1, { ID } },
+  { "g_main_context_acquire", 2, { ID, INT64 } },
+  { "g_main_context_release", 1, { ID } },
+  { "g_main_context_free", 1, { ID } },
+  { "g_main_context_before_dispatch", 1, { ID } },
+  { "g_main_context_after_dispatch", 1, { ID } },
+  { "g_source_new", 6, { ID, SYMBOL, SYMBOL, SYMBOL, SYMBOL, INT64 } },
+  { "g_source_before_free", 3, { ID, ID, SYMBOL } },
+  { "g_source_before_dispatch", 4, { ID, SYMBOL, SYMBOL, ID } },
+  { "g_source_after_dispatch", 3, { ID, SYMBOL, INT64 } },
+  { "g_source_set_name", 2, { ID, STRING } },
+  { "g_source_add_child_source", 2, { ID, ID } },
+  { "g_source_attach", 3, { ID, ID, INT64 } },
+  { "g_source_destroy", 2, { ID, ID } },
+  { "g_thread_spawned", 3, { SYMBOL, ID, STRING } },
+  { "g_task_new", 5, { ID, ID, ID, SYMBOL, ID } },
+  { "g_task_set_source_tag", 2, { ID, SYMBOL } },
+  { "g_task_before_return", 4, { ID, ID, SYMBOL, ID } },
+  { "g_task_propagate", 2, { ID, INT64 } },
+  { "g_task_before_run_in_thread", 2, { ID, SYMBOL } },
+  { "g_task_after_run_in_thread", 2, { ID, INT64 } },
 };
 
-static const EventData *
-event_data_from_event_type (const gchar *event_type)
+#undef STRING
+#undef SYMBOL
+#undef INT64
+#undef ID
+
+/* Interned copies of the event types in @event_type_array, in the same order.
+ * These are set up once in dfl_parser_class_init(), so that parsing never has
+ * to take the lock on the global intern table. */
+static const gchar *interned_event_types[G_N_ELEMENTS (event_type_array)];
+
+/* Map an event type to its index in @event_type_array, or return -1 if it is
+ * unknown. This is a hand-written perfect hash on the length of the event type,
+ * plus one character where several event types have the same length; so only
+ * one string comparison is needed. It must be updated whenever
+ * @event_type_array is changed, which intern_event_types() checks. */
+static gint
+event_type_to_index (const gchar *event_type,
+                     gsize        event_type_length)
+{
+  gint i;
+
+  switch (event_type_length)
+    {
+    case 10: i = 15; break;  /* g_task_new */
+    case 12: i = 6; break;  /* g_source_new */
+    case 15: i = 12; break;  /* g_source_attach */
+    case 16:
+      switch (event_type[3])
+        {
+        case 'o': i = 13; break;  /* g_source_destroy */
+        case 'h': i = 14; break;  /* g_thread_spawned */
+        case 'a': i = 18; break;  /* g_task_propagate */
+        default: return -1;
+        }
+      break;
+    case 17: i = 10; break;  /* g_source_set_name */
+    case 18: i = 0; break;  /* g_main_context_new */
+    case 19: i = 3; break;  /* g_main_context_free */
+    case 20:
+      switch (event_type[2])
+        {
+        case 's': i = 7; break;  /* g_source_before_free */
+        case 't': i = 17; break;  /* g_task_before_return */
+        default: return -1;
+        }
+      break;
+    case 21: i = 16; break;  /* g_task_set_source_tag */
+    case 22:
+      switch (event_type[15])
+        {
+        case 'a': i = 1; break;  /* g_main_context_acquire */
+        case 'r': i = 2; break;  /* g_main_context_release */
+        default: return -1;
+        }
+      break;
+    case 23: i = 9; break;  /* g_source_after_dispatch */
+    case 24: i = 8; break;  /* g_source_before_dispatch */
+    case 25: i = 11; break;  /* g_source_add_child_source */
+    case 26: i = 20; break;  /* g_task_after_run_in_thread */
+    case 27: i = 19; break;  /* g_task_before_run_in_thread */
+    case 29: i = 5; break;  /* g_main_context_after_dispatch */
+    case 30: i = 4; break;  /* g_main_context_before_dispatch */
+    default: return -1;
+    }
+
+  if (memcmp (event_type, event_type_array[i].event_type,
+              event_type_length) != 0)
+    return -1;
+
+  return i;
+}
+
+static void
+intern_event_types (void)
 {
   guint i;
 
   for (i = 0; i < G_N_ELEMENTS (event_type_array); i++)
     {
-      if (g_strcmp0 (event_type, event_type_array[i].event_type) == 0)
-        return &event_type_array[i];
+      const gchar *event_type = event_type_array[i].event_type;
+
+      /* Check that event_type_to_index() is up to date. */
+      g_assert (event_type_to_index (event_type, strlen (event_type)) ==
+                (gint) i);
+      g_assert (event_type_array[i].n_parameters <= MAX_N_PARAMETERS);
+
+      interned_event_types[i] = g_intern_static_string (event_type);
+    }
+}
+
+static const EventData *
+event_data_from_event_type (const gchar *event_type,
+                            gsize        event_type_length)
+{
+  gint i = event_type_to_index (event_type, event_type_length);
+
+  return (i >= 0) ? &event_type_array[i] : NULL;
+}
+
+/* Get the interned version of @event_data’s event type, without having to look
+ * it up in the global intern table. */
+static const gchar *
+event_data_get_interned_type (const EventData *event_data)
+{
+  return interned_event_types[event_data - event_type_array];
+}
+
+/* A component of a log line. This points into the line being parsed, and is
+ * not nul-terminated. */
+typedef struct
+{
+  const gchar *str;  /* unowned */
+  gsize length;
+} Component;
+
+static gboolean
+component_equal (const Component *component,
+                 const gchar     *str)
+{
+  return (strncmp (component->str, str, component->length) == 0 &&
+          str[component->length] == '\0');
+}
+
+/* Parse a decimal unsigned integer from @component. Leading whitespace is
+ * ignored, as with g_ascii_strtoull(). Returns %FALSE if the component is empty,
+ * contains anything other than digits, or overflows. */
+static gboolean
+component_to_uint64 (const Component *component,
+                     guint64         *out)
+{
+  const gchar *str = component->str;
+  const gchar *end = component->str + component->length;
+  guint64 retval = 0;
+
+  while (str < end && g_ascii_isspace (*str))
+    str++;
+
+  if (str == end)
+    return FALSE;
+
+  for (; str < end; str++)
+    {
+      guint digit;
+
+      if (!g_ascii_isdigit (*str))
+        return FALSE;
+
+      digit = *str - '0';
+
+      if (retval > (G_MAXUINT64 - digit) / 10)
+        return FALSE;
+
+      retval = retval * 10 + digit;
+    }
+
+  *out = retval;
+
+  return TRUE;
+}
+
+/* Parse a decimal signed integer from @component, in the same way as
+ * component_to_uint64(), allowing a leading minus sign. */
+static gboolean
+component_to_int64 (const Component *component,
+                    gint64          *out)
+{
+  Component digits = *component;
+  gboolean negative = FALSE;
+  guint64 magnitude;
+
+  while (digits.length > 0 && g_ascii_isspace (*digits.str))
+    {
+      digits.str++;
+      digits.length--;
+    }
+
+  if (digits.length > 0 && *digits.str == '-')
+    {
+      negative = TRUE;
+      digits.str++;
+      digits.length--;
+    }
+
+  /* Disallow whitespace after the sign. */
+  if (digits.length > 0 && g_ascii_isspace (*digits.str))
+    return FALSE;
+
+  if (!component_to_uint64 (&digits, &magnitude))
+    return FALSE;
+
+  if (negative && magnitude <= (guint64) G_MAXINT64 + 1)
+    *out = (gint64) -magnitude;
+  else if (!negative && magnitude <= G_MAXINT64)
+    *out = magnitude;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Decode @component as a parameter of the given @kind, storing it in
+ * @parameter. String parameters are copied, nul-terminated, into @scratch, and
+ * their offset within it is stored in @parameter (as the pointer can change
+ * when @scratch grows). Returns %FALSE if the parameter is invalid. */
+static gboolean
+decode_parameter (DflEventParameterKind  kind,
+                  const Component       *component,
+                  GString               *scratch,
+                  DflEventParameter     *parameter,
+                  gsize                 *scratch_offset)
+{
+  switch (kind)
+    {
+    case DFL_EVENT_PARAMETER_ID:
+      return component_to_uint64 (component, &parameter->id);
+    case DFL_EVENT_PARAMETER_INT64:
+      return component_to_int64 (component, &parameter->int64);
+    case DFL_EVENT_PARAMETER_STRING:
+    case DFL_EVENT_PARAMETER_SYMBOL:
+      *scratch_offset = scratch->len;
+      g_string_append_len (scratch, component->str, component->length);
+      g_string_append_c (scratch, '\0');
+      return TRUE;
+    case DFL_EVENT_PARAMETER_RAW:
+    default:
+      g_assert_not_reached ();
+    }
+
+  return FALSE;
+}
+
+/* Fix up the string parameters decoded by decode_parameter() to point into
+ * @scratch, once it has stopped growing. */
+static void
+resolve_string_parameters (const EventData   *event_data,
+                           GString           *scratch,
+                           DflEventParameter *parameters,
+                           const gsize       *scratch_offsets)
+{
+  guint i;
+
+  for (i = 0; i < event_data->n_parameters; i++)
+    {
+      if (event_data->parameter_kinds[i] == DFL_EVENT_PARAMETER_STRING ||
+          event_data->parameter_kinds[i] == DFL_EVENT_PARAMETER_SYMBOL)
+        parameters[i].str = scratch->str + scratch_offsets[i];
     }
+}
+
+/* Split @line at commas into @components, without copying. If there are more
+ * than @max_components components, @max_components + 1 is returned and only
+ * the first @max_components are set. */
+static gsize
+split_components (const gchar *line,
+                  gsize        length,
+                  Component   *components,
+                  gsize        max_components)
+{
+  const gchar *start = line, *line_end = line + length;
+  gsize n_components = 0;
+
+  while (TRUE)
+    {
+      const gchar *comma;
+
+      if (n_components == max_components)
+        return max_components + 1;
+
+      comma = memchr (start, ',', line_end - start);
+
+      components[n_components].str = start;
+      components[n_components].length = ((comma != NULL) ? comma : line_end) -
+                                        start;
+      n_components++;
+
+      if (comma == NULL)
+        break;
+
+      start = comma + 1;
+    }
+
+  return n_components;
+}
+
+/* State which is carried between lines while parsing a log file. */
+typedef struct
+{
+  guint n_comment_lines;
+  guint file_version;
+  guint64 initial_timestamp;
+  GHashTable/*<owned guint64, owned guint64>*/ *highest_timestamps;  /* owned */
+  DflEventTable *events;  /* owned */
 
-  return NULL;
+  /* Lowest timestamp seen for each thread ID. This is only tracked when
+   * parsing a chunk of a file in parallel, so that monotonicity across chunk
+   * boundaries can be checked when merging the chunks. */
+  GHashTable/*<owned guint64, owned guint64>*/ *first_timestamps;  /* owned; nullable */
+
+  /* Scratch buffer for the nul-terminated parameters of the event currently
+   * being parsed. Reused between lines. */
+  GString *parameters;  /* owned */
+} ParseData;
+
+static void
+parse_data_init (ParseData *data)
+{
+  data->n_comment_lines = 0;
+  data->file_version = 0;
+  data->initial_timestamp = 0;
+  data->highest_timestamps = g_hash_table_new_full (g_int64_hash,
+                                                    g_int64_equal,
+                                                    g_free, g_free);
+  data->events = _dfl_event_table_new ();
+  data->parameters = g_string_new (NULL);
+  data->first_timestamps = NULL;
+}
+
+static void
+parse_data_clear (ParseData *data)
+{
+  g_clear_pointer (&data->events, _dfl_event_table_unref);
+  g_clear_pointer (&data->highest_timestamps, g_hash_table_unref);
+  g_clear_pointer (&data->first_timestamps, g_hash_table_unref);
+
+  if (data->parameters != NULL)
+    g_string_free (data->parameters, TRUE);
+  data->parameters = NULL;
+}
+
+/* Check that @timestamp is not lower than the previous timestamp seen for
+ * @thread_id (or the initial timestamp, if this is the first event for the
+ * thread), and record it as the new highest timestamp. Returns %FALSE if the
+ * check fails. */
+static gboolean
+update_highest_timestamp (ParseData *data,
+                          guint64    thread_id,
+                          guint64    timestamp)
+{
+  guint64 *highest_timestamp;
+
+  highest_timestamp = g_hash_table_lookup (data->highest_timestamps,
+                                           (gpointer) &thread_id);
+
+  if ((highest_timestamp == NULL && timestamp < data->initial_timestamp) ||
+      (highest_timestamp != NULL && timestamp < *highest_timestamp))
+    return FALSE;
+
+  if (highest_timestamp != NULL)
+    {
+      *highest_timestamp = timestamp;
+    }
+  else
+    {
+      guint64 *key = NULL;
+
+      highest_timestamp = g_new0 (guint64, 1);
+      *highest_timestamp = timestamp;
+      key = g_new0 (guint64, 1);
+      *key = thread_id;
+
+      g_hash_table_insert (data->highest_timestamps, key, highest_timestamp);
+
+      if (data->first_timestamps != NULL)
+        g_hash_table_insert (data->first_timestamps,
+                             g_memdup (key, sizeof (*key)),
+                             g_memdup (highest_timestamp,
+                                       sizeof (*highest_timestamp)));
+    }
+
+  return TRUE;
+}
+
+/* Parse a single line of a log file into @data. @line does not have to be
+ * nul-terminated, and is not modified. Return %FALSE and set @error on
+ * failure. */
+static gboolean
+parse_line (ParseData    *data,
+            const gchar  *line,
+            gsize         length,
+            guint         line_number,
+            GError      **error)
+{
+  const gchar *end = NULL;
+  Component components[3 + MAX_N_PARAMETERS];
+  gsize n_components;
+
+  /* Note: The line is an arbitrary byte stream. It is not valid UTF-8 and
+   * may contain embedded nuls. Validate that first. */
+  if (!g_utf8_validate (line, length, &end))
+    {
+      /* TODO: Use a proper error code here. */
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                   "Invalid log file line %u — invalid UTF-8 at byte %"
+                   G_GOFFSET_FORMAT,
+                   line_number, (goffset) (end - line));
+      return FALSE;
+    }
+
+  /* Ignore whitespace. */
+  while (length > 0 && g_ascii_isspace (line[0]))
+    {
+      line++;
+      length--;
+    }
+
+  while (length > 0 && g_ascii_isspace (line[length - 1]))
+    length--;
+
+  /* Ignore comment or blank lines. */
+  if (length == 0 || line[0] == '#')
+    {
+      data->n_comment_lines++;
+      return TRUE;
+    }
+
+  /* Split into components. */
+  /* TODO: Formally document log file format. */
+  n_components = split_components (line, length, components,
+                                   G_N_ELEMENTS (components));
+
+  if (component_equal (&components[0], "Dunfell log"))
+    {
+      /* Header line? Looks like:
+       *    Dunfell log,1.0,123456
+       * where 1.0 is the log format version, and 123456 is the starting
+       * timestamp. */
+
+      /* Is this the first line? */
+      if (line_number - data->n_comment_lines != 1)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid log file line %u — %s: %.*s", line_number,
+                       "header must be first non-comment line",
+                       (int) length, line);
+          return FALSE;
+        }
+
+      /* Check the number of components. */
+      if (n_components != 3)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid log file line %u — %s: %.*s", line_number,
+                       "header contains the wrong number of components",
+                       (int) length, line);
+          return FALSE;
+        }
+
+      /* File version check. */
+      if (!component_equal (&components[1], "1.0"))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Unsupported log file version ‘%.*s’ on line %u"
+                       "(versions supported: 1.0)",
+                       (int) components[1].length, components[1].str,
+                       line_number);
+          return FALSE;
+        }
+
+      data->file_version = 1;
+
+      /* Parse the timestamp. */
+      if (!component_to_uint64 (&components[2], &data->initial_timestamp))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid timestamp ‘%.*s’ on line %u",
+                       (int) components[2].length, components[2].str,
+                       line_number);
+          return FALSE;
+        }
+    }
+  else
+    {
+      const EventData *event_data;
+      const Component *timestamp, *tid;
+      guint64 timestamp_int, tid_int;
+      DflEventParameter parameters[MAX_N_PARAMETERS];
+      gsize parameter_offsets[MAX_N_PARAMETERS];
+      gsize i;
+
+      /* Non-header line. Looks like:
+       *    g_idle_dispatch,1449749875412059,8491,140407983871120,12007776,\
+       *    140408421089918,0x7fb36210027e,14614576,0
+       */
+
+      /* Has there been a header? */
+      if (data->file_version == 0)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid log file line %u — %s: %.*s", line_number,
+                       "header must be first non-comment line",
+                       (int) length, line);
+          return FALSE;
+        }
+
+      /* Check the event type. */
+      if (components[0].length == 0)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid log file line %u — %s: %.*s", line_number,
+                       "event type not specified", (int) length, line);
+          return FALSE;
+        }
+
+      /* Match it to an event parser. */
+      event_data = event_data_from_event_type (components[0].str,
+                                               components[0].length);
+
+      if (event_data == NULL)
+        {
+          /* Ignore unknown event types to allow for more probe points to be
+           * added to GLib in future. */
+          g_debug ("%s: Ignoring unrecognised event type ‘%.*s’ on "
+                   "line %u: %.*s", G_STRFUNC,
+                   (int) components[0].length, components[0].str,
+                   line_number, (int) length, line);
+          return TRUE;
+        }
+
+      /* Check the number of components (ignoring the event type, timestamp
+       * and thread ID. */
+      if (n_components < 3 || n_components - 3 != event_data->n_parameters)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid log file line %u — %s: %.*s", line_number,
+                       "event line contains the wrong number of components",
+                       (int) length, line);
+          return FALSE;
+        }
+
+      /* Grab the timestamp and thread ID. */
+      timestamp = &components[1];
+      tid = &components[2];
+
+      if (!component_to_uint64 (timestamp, &timestamp_int))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid timestamp ‘%.*s’ on line %u",
+                       (int) timestamp->length, timestamp->str, line_number);
+          return FALSE;
+        }
+
+      if (!component_to_uint64 (tid, &tid_int))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid thread ID ‘%.*s’ on line %u",
+                       (int) tid->length, tid->str, line_number);
+          return FALSE;
+        }
+
+      /* Check that the timestamps in each thread are monotonically
+       * increasing. */
+      if (!update_highest_timestamp (data, tid_int, timestamp_int))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid timestamp ‘%.*s’ on line %u: timestamps must "
+                       "be monotonically increasing",
+                       (int) timestamp->length, timestamp->str, line_number);
+          return FALSE;
+        }
+
+      /* Decode the parameters according to the event type’s schema, so that
+       * they don’t have to be parsed again each time they are accessed. */
+      g_string_truncate (data->parameters, 0);
+
+      for (i = 0; i < event_data->n_parameters; i++)
+        {
+          const Component *parameter = &components[i + 3];
+
+          if (!decode_parameter (event_data->parameter_kinds[i], parameter,
+                                 data->parameters, &parameters[i],
+                                 &parameter_offsets[i]))
+            {
+              /* TODO: Use a proper error code here. */
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                           "Invalid parameter %" G_GSIZE_FORMAT " ‘%.*s’ on "
+                           "line %u", i, (int) parameter->length,
+                           parameter->str, line_number);
+              return FALSE;
+            }
+        }
+
+      resolve_string_parameters (event_data, data->parameters, parameters,
+                                 parameter_offsets);
+
+      /* Add the event. */
+      _dfl_event_table_append (data->events,
+                               event_data_get_interned_type (event_data),
+                               timestamp_int, tid_int,
+                               event_data->parameter_kinds, parameters,
+                               event_data->n_parameters);
+    }
+
+  return TRUE;
+}
+
+/* Finish parsing, and set the parser’s event sequence from @data if no error
+ * occurred. @child_error is consumed. */
+static void
+dfl_parser_finish_parse (DflParser  *self,
+                         ParseData  *data,
+                         GError     *child_error,
+                         GError    **error)
+{
+  /* Success? */
+  if (child_error == NULL)
+    {
+      g_clear_object (&self->sequence);
+      self->sequence = _dfl_event_sequence_new_from_table (data->events,
+                                                           data->initial_timestamp);
+      g_object_notify (G_OBJECT (self), "event-sequence");
+    }
+  else
+    {
+      g_propagate_error (error, child_error);
+    }
+}
+
+/* Append @value to @str in decimal. */
+static void
+append_uint64 (GString *str,
+               guint64  value)
+{
+  gchar digits[20];
+  gsize n_digits = 0;
+
+  do
+    {
+      digits[n_digits++] = '0' + (value % 10);
+      value /= 10;
+    }
+  while (value > 0);
+
+  while (n_digits > 0)
+    g_string_append_c (str, digits[--n_digits]);
+}
+
+/* An entry in the event type table of a binary log. */
+typedef struct
+{
+  const EventData *event_data;  /* nullable if the event type is unknown */
+  guint32 n_parameters;
+  guint32 string_parameters;  /* bitmask of parameters stored as strings */
+} BinaryEventType;
+
+/* Parse a version 2.0 (binary) log file into @data. See the #DflWriter
+ * documentation for the format. */
+static gboolean
+parse_binary (ParseData     *data,
+              const guint8  *buffer,
+              gsize          length,
+              GError       **error)
+{
+  const guint8 *p, *end;
+  guint64 n_events, i;
+  guint32 n_strings, n_event_types, j;
+  Component *strings = NULL;
+  BinaryEventType *event_types = NULL;
+  const gchar *message = NULL;
+  gboolean success = FALSE;
+
+  end = buffer + length;
+
+  if (length < DFL_BINARY_LOG_HEADER_LENGTH)
+    {
+      message = "header is truncated";
+      goto invalid;
+    }
+
+  p = buffer + DFL_BINARY_LOG_MAGIC_LENGTH;
+  data->initial_timestamp = dfl_binary_log_read_uint64 (p);
+  n_events = dfl_binary_log_read_uint64 (p + 8);
+  n_strings = dfl_binary_log_read_uint32 (p + 16);
+  n_event_types = dfl_binary_log_read_uint32 (p + 20);
+  p += 24;
+
+  data->file_version = 2;
+
+  /* String table. Each string takes at least 4 bytes, which bounds the
+   * allocation. */
+  if ((gsize) (end - p) / 4 < n_strings)
+    {
+      message = "string table is truncated";
+      goto invalid;
+    }
+
+  strings = g_new0 (Component, n_strings);
+
+  for (j = 0; j < n_strings; j++)
+    {
+      guint32 string_length;
+
+      if (end - p < 4)
+        {
+          message = "string table is truncated";
+          goto invalid;
+        }
+
+      string_length = dfl_binary_log_read_uint32 (p);
+      p += 4;
+
+      if ((gsize) (end - p) < string_length)
+        {
+          message = "string table is truncated";
+          goto invalid;
+        }
+
+      if (!g_utf8_validate ((const gchar *) p, string_length, NULL))
+        {
+          message = "string table contains invalid UTF-8";
+          goto invalid;
+        }
+
+      strings[j].str = (const gchar *) p;
+      strings[j].length = string_length;
+      p += string_length;
+    }
+
+  /* Event type table. */
+  if ((gsize) (end - p) / DFL_BINARY_LOG_EVENT_TYPE_LENGTH < n_event_types)
+    {
+      message = "event type table is truncated";
+      goto invalid;
+    }
+
+  event_types = g_new0 (BinaryEventType, n_event_types);
+
+  for (j = 0; j < n_event_types; j++)
+    {
+      BinaryEventType *event_type = &event_types[j];
+      guint32 name_index;
+      const Component *name;
+
+      name_index = dfl_binary_log_read_uint32 (p);
+      event_type->n_parameters = dfl_binary_log_read_uint32 (p + 4);
+      event_type->string_parameters = dfl_binary_log_read_uint32 (p + 8);
+      p += DFL_BINARY_LOG_EVENT_TYPE_LENGTH;
+
+      if (name_index >= n_strings)
+        {
+          message = "event type has an invalid name";
+          goto invalid;
+        }
+
+      name = &strings[name_index];
+
+      if (name->length == 0)
+        {
+          message = "event type not specified";
+          goto invalid;
+        }
+
+      if (event_type->n_parameters > DFL_BINARY_LOG_MAX_PARAMETERS)
+        {
+          message = "event type has too many parameters";
+          goto invalid;
+        }
+
+      event_type->event_data = event_data_from_event_type (name->str,
+                                                           name->length);
+
+      if (event_type->event_data == NULL)
+        {
+          /* Ignore unknown event types to allow for more probe points to be
+           * added to GLib in future. */
+          g_debug ("%s: Ignoring unrecognised event type ‘%.*s’",
+                   G_STRFUNC, (int) name->length, name->str);
+        }
+      else if (event_type->event_data->n_parameters !=
+               event_type->n_parameters)
+        {
+          message = "event type has the wrong number of parameters";
+          goto invalid;
+        }
+    }
+
+  /* Events. */
+  for (i = 0; i < n_events; i++)
+    {
+      const BinaryEventType *event_type;
+      guint64 timestamp, tid;
+      guint32 event_type_index;
+      DflEventParameter parameters[MAX_N_PARAMETERS];
+      gsize parameter_offsets[MAX_N_PARAMETERS];
+
+      if (end - p < DFL_BINARY_LOG_EVENT_HEADER_LENGTH)
+        {
+          message = "events are truncated";
+          goto invalid;
+        }
+
+      timestamp = dfl_binary_log_read_uint64 (p);
+      tid = dfl_binary_log_read_uint64 (p + 8);
+      event_type_index = dfl_binary_log_read_uint32 (p + 16);
+      p += DFL_BINARY_LOG_EVENT_HEADER_LENGTH;
+
+      if (event_type_index >= n_event_types)
+        {
+          message = "event has an invalid event type";
+          goto invalid;
+        }
+
+      event_type = &event_types[event_type_index];
+
+      if ((gsize) (end - p) / DFL_BINARY_LOG_PARAMETER_LENGTH <
+          event_type->n_parameters)
+        {
+          message = "events are truncated";
+          goto invalid;
+        }
+
+      /* Skip unknown event types. */
+      if (event_type->event_data == NULL)
+        {
+          p += event_type->n_parameters * DFL_BINARY_LOG_PARAMETER_LENGTH;
+          continue;
+        }
+
+      /* Check that the timestamps in each thread are monotonically
+       * increasing. */
+      if (!update_highest_timestamp (data, tid, timestamp))
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Invalid timestamp %" G_GUINT64_FORMAT " in event %"
+                       G_GUINT64_FORMAT ": timestamps must be monotonically "
+                       "increasing", timestamp, i);
+          goto done;
+        }
+
+      /* Decode the parameters according to the event type’s schema, as for
+       * text logs. Integers only need formatting if the schema expects a
+       * string. */
+      g_string_truncate (data->parameters, 0);
+
+      for (j = 0; j < event_type->n_parameters; j++)
+        {
+          DflEventParameterKind kind;
+          guint64 value;
+
+          kind = event_type->event_data->parameter_kinds[j];
+          value = dfl_binary_log_read_uint64 (p);
+          p += DFL_BINARY_LOG_PARAMETER_LENGTH;
+
+          if (event_type->string_parameters & (1u << j))
+            {
+              if (value >= n_strings ||
+                  !decode_parameter (kind, &strings[value], data->parameters,
+                                     &parameters[j], &parameter_offsets[j]))
+                {
+                  message = "event has an invalid parameter";
+                  goto invalid;
+                }
+            }
+          else if (kind == DFL_EVENT_PARAMETER_ID)
+            {
+              parameters[j].id = value;
+            }
+          else if (kind == DFL_EVENT_PARAMETER_INT64)
+            {
+              parameters[j].int64 = (gint64) value;
+            }
+          else
+            {
+              parameter_offsets[j] = data->parameters->len;
+              append_uint64 (data->parameters, value);
+              g_string_append_c (data->parameters, '\0');
+            }
+        }
+
+      resolve_string_parameters (event_type->event_data, data->parameters,
+                                 parameters, parameter_offsets);
+
+      _dfl_event_table_append (data->events,
+                               event_data_get_interned_type (event_type->event_data),
+                               timestamp, tid,
+                               event_type->event_data->parameter_kinds,
+                               parameters, event_type->n_parameters);
+    }
+
+  if (p != end)
+    {
+      message = "trailing data after the last event";
+      goto invalid;
+    }
+
+  success = TRUE;
+  goto done;
+
+invalid:
+  /* TODO: Use a proper error code here. */
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+               "Invalid binary log file — %s", message);
+
+done:
+  g_free (event_types);
+  g_free (strings);
+
+  return success;
+}
+
+/* Parse the lines from @start up to @end into @data. If @stop_after_header is
+ * %TRUE, stop after the header line has been parsed. @line_number is updated to
+ * the number of the next line. Returns a pointer to the start of the next line
+ * to parse. */
+static const gchar *
+parse_lines (ParseData    *data,
+             const gchar  *start,
+             const gchar  *end,
+             gboolean      stop_after_header,
+             guint        *line_number,
+             GError      **error)
+{
+  const gchar *line;
+
+  for (line = start; line < end; *line_number = *line_number + 1)
+    {
+      const gchar *line_end;
+
+      line_end = memchr (line, '\n', end - line);
+      if (line_end == NULL)
+        line_end = end;
+
+      if (!parse_line (data, line, line_end - line, *line_number, error))
+        break;
+
+      line = line_end + 1;
+
+      if (stop_after_header && data->file_version != 0)
+        {
+          *line_number = *line_number + 1;
+          break;
+        }
+    }
+
+  return MIN (line, end);
+}
+
+/* Minimum number of bytes of log file to give each thread when parsing in
+ * parallel. Below this, the overhead of spawning threads dominates. */
+#define MIN_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* A chunk of a log file to be parsed on a worker thread. Chunks always start at
+ * the beginning of a line and end after a newline (or at the end of the
+ * file). */
+typedef struct
+{
+  const gchar *start;  /* unowned */
+  const gchar *end;  /* unowned */
+  ParseData data;
+  GError *error;  /* owned; nullable */
+} ParseChunk;
+
+static void
+parse_chunk_cb (gpointer data,
+                gpointer user_data)
+{
+  ParseChunk *chunk = data;
+  guint line_number;
+
+  /* The line numbers are only used for error messages. Errors in chunks are
+   * never reported directly (see parse_chunks()), but line numbers must not
+   * start from 1 so that a stray header line is still an error. */
+  line_number = 2;
+
+  parse_lines (&chunk->data, chunk->start, chunk->end, FALSE, &line_number,
+               &chunk->error);
+}
+
+/* Parse the lines from @start to @end in parallel, appending the results to
+ * @data. @data must already have parsed the header. The per-thread timestamp
+ * monotonicity checks are done within each chunk, and then again across chunk
+ * boundaries when merging the chunks in order.
+ *
+ * Returns %FALSE if parsing in parallel failed for any reason, including the
+ * log being invalid; in that case, @data is in an undefined state, and the
+ * caller should parse the log sequentially to get an accurate error. */
+static gboolean
+parse_chunks (ParseData   *data,
+              const gchar *start,
+              const gchar *end,
+              guint        n_chunks)
+{
+  ParseChunk *chunks = NULL;
+  GThreadPool *pool = NULL;
+  const gchar *chunk_start;
+  guint i;
+  gboolean success = TRUE;
+
+  g_assert (data->file_version != 0);
+  g_assert (n_chunks > 1);
+
+  /* Split into chunks at line boundaries. */
+  chunks = g_new0 (ParseChunk, n_chunks);
+
+  for (i = 0, chunk_start = start; i < n_chunks; i++)
+    {
+      ParseChunk *chunk = &chunks[i];
+      const gchar *chunk_end;
+
+      if (i == n_chunks - 1)
+        {
+          chunk_end = end;
+        }
+      else
+        {
+          /* Advance to the start of the next line. */
+          chunk_end = MAX (chunk_start, start + (end - start) / n_chunks * (i + 1));
+          chunk_end = memchr (chunk_end, '\n', end - chunk_end);
+          chunk_end = (chunk_end != NULL) ? chunk_end + 1 : end;
+        }
+
+      chunk->start = chunk_start;
+      chunk->end = chunk_end;
+
+      parse_data_init (&chunk->data);
+      chunk->data.file_version = data->file_version;
+      chunk->data.initial_timestamp = data->initial_timestamp;
+      chunk->data.first_timestamps = g_hash_table_new_full (g_int64_hash,
+                                                            g_int64_equal,
+                                                            g_free, g_free);
+
+      chunk_start = chunk_end;
+    }
+
+  /* Parse them. g_thread_pool_free() waits for all the chunks to finish. */
+  pool = g_thread_pool_new (parse_chunk_cb, NULL, n_chunks, TRUE, NULL);
+
+  if (pool == NULL)
+    {
+      success = FALSE;
+    }
+  else
+    {
+      for (i = 0; i < n_chunks; i++)
+        g_thread_pool_push (pool, &chunks[i], NULL);
+
+      g_thread_pool_free (pool, FALSE, TRUE);
+    }
+
+  /* Merge the chunks in order. */
+  for (i = 0; success && i < n_chunks; i++)
+    {
+      ParseChunk *chunk = &chunks[i];
+      GHashTableIter iter;
+      gpointer key, value;
+
+      if (chunk->error != NULL)
+        {
+          success = FALSE;
+          break;
+        }
+
+      /* Check that the first timestamp for each thread in this chunk is not
+       * lower than the last one for that thread in the previous chunks. */
+      g_hash_table_iter_init (&iter, chunk->data.first_timestamps);
+
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          const guint64 *highest_timestamp;
+
+          highest_timestamp = g_hash_table_lookup (data->highest_timestamps,
+                                                   key);
+
+          if (highest_timestamp != NULL &&
+              *((const guint64 *) value) < *highest_timestamp)
+            {
+              success = FALSE;
+              break;
+            }
+        }
+
+      if (!success)
+        break;
+
+      /* Update the highest timestamps. */
+      g_hash_table_iter_init (&iter, chunk->data.highest_timestamps);
+
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          g_hash_table_replace (data->highest_timestamps,
+                                g_memdup (key, sizeof (guint64)),
+                                g_memdup (value, sizeof (guint64)));
+        }
+
+      /* Move the events across. */
+      _dfl_event_table_append_table (data->events, chunk->data.events);
+    }
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      parse_data_clear (&chunks[i].data);
+      g_clear_error (&chunks[i].error);
+    }
+
+  g_free (chunks);
+
+  return success;
+}
+
+/* Parse a log file held entirely in memory into @data, splitting it into lines
+ * in place rather than copying each line out. Large files are split into
+ * chunks and parsed in parallel. Binary logs are detected by their magic.
+ * @data must have been freshly initialised. */
+static void
+parse_buffer (ParseData    *data,
+              const gchar  *buffer,
+              gsize         length,
+              GError      **error)
+{
+  const gchar *line, *buffer_end;
+  guint line_number, n_chunks;
+  GError *child_error = NULL;
+
+  if (length >= DFL_BINARY_LOG_MAGIC_LENGTH &&
+      memcmp (buffer, DFL_BINARY_LOG_MAGIC, DFL_BINARY_LOG_MAGIC_LENGTH) == 0)
+    {
+      parse_binary (data, (const guint8 *) buffer, length, error);
+      return;
+    }
+
+  buffer_end = buffer + length;
+  line_number = 1;
+
+  /* Parse the header on this thread. */
+  line = parse_lines (data, buffer, buffer_end, TRUE, &line_number,
+                      &child_error);
+
+  n_chunks = MIN (g_get_num_processors (),
+                  (buffer_end - line) / MIN_CHUNK_SIZE);
+
+  if (child_error == NULL && data->file_version != 0 && n_chunks > 1)
+    {
+      if (!parse_chunks (data, line, buffer_end, n_chunks))
+        {
+          /* Something went wrong. Start again sequentially, which will give
+           * an accurate error message if the log is invalid. */
+          parse_data_clear (data);
+          parse_data_init (data);
+          line_number = 1;
+
+          parse_lines (data, buffer, buffer_end, FALSE, &line_number,
+                       &child_error);
+        }
+    }
+  else if (child_error == NULL)
+    {
+      parse_lines (data, line, buffer_end, FALSE, &line_number, &child_error);
+    }
+
+  if (child_error != NULL)
+    g_propagate_error (error, child_error);
+}
+
+static void
+dfl_parser_load_from_buffer (DflParser    *self,
+                             const gchar  *buffer,
+                             gsize         length,
+                             GError      **error)
+{
+  ParseData data;
+  GError *child_error = NULL;
+
+  parse_data_init (&data);
+  parse_buffer (&data, buffer, length, &child_error);
+  dfl_parser_finish_parse (self, &data, child_error, error);
+  parse_data_clear (&data);
 }
 
 /**
@@ -151,17 +1421,12 @@ dfl_parser_load_from_data (DflParser     *self,
                            gssize         length,
                            GError       **error)
 {
-  GInputStream *stream = NULL;
-
   g_return_if_fail (DFL_IS_PARSER (self));
   g_return_if_fail (data != NULL);
   g_return_if_fail (length > 0);
   g_return_if_fail (error == NULL || *error == NULL);
 
-  /* Load by creating a stream for the data. */
-  stream = g_memory_input_stream_new_from_data (data, length, NULL);
-  dfl_parser_load_from_stream (self, stream, NULL, error);
-  g_object_unref (stream);
+  dfl_parser_load_from_buffer (self, (const gchar *) data, length, error);
 }
 
 /**
@@ -170,7 +1435,10 @@ dfl_parser_load_from_data (DflParser     *self,
  * @filename: path to file to load log from
  * @error: return location for a #GError, or %NULL
  *
- * TODO
+ * Load a log from the given file. Where possible, the file is memory mapped
+ * and parsed in place, which avoids copying it line by line. If the file
+ * cannot be mapped (for example, if it is a pipe), it is read as a stream
+ * instead.
  *
  * Since: 0.1.0
  */
@@ -179,6 +1447,7 @@ dfl_parser_load_from_file (DflParser    *self,
                            const gchar  *filename,
                            GError      **error)
 {
+  GMappedFile *mapped_file = NULL;
   GFile *file = NULL;
   GFileInputStream *stream = NULL;
 
@@ -186,332 +1455,303 @@ dfl_parser_load_from_file (DflParser    *self,
   g_return_if_fail (filename != NULL);
   g_return_if_fail (error == NULL || *error == NULL);
 
-  /* Load by creating a stream for the file. */
-  file = g_file_new_for_path (filename);
-  stream = g_file_read (file, NULL, error);
-  g_object_unref (file);
+  /* Try mapping the file first. The mapping is read-only, and parse_line()
+   * never modifies it. */
+  mapped_file = g_mapped_file_new (filename, FALSE, NULL);
 
-  if (stream == NULL)
-    return;
-
-  dfl_parser_load_from_stream (self, G_INPUT_STREAM (stream), NULL, error);
-
-  g_object_unref (stream);
-}
-
-/**
- * dfl_parser_load_from_stream:
- * @self: a #DflParser
- * @stream: input stream to read log from
- * @cancellable: a #GCancellable, or %NULL
- * @error: return location for a #GError, or %NULL
- *
- * TODO
- *
- * Since: 0.1.0
- */
-void
-dfl_parser_load_from_stream (DflParser     *self,
-                             GInputStream  *stream,
-                             GCancellable  *cancellable,
-                             GError       **error)
-{
-  GDataInputStream *data_stream = NULL;
-  guint8 *line = NULL;
-  gsize length = 0;
-  guint line_number;
-  guint n_comment_lines;
-  guint64 initial_timestamp;
-  GHashTable/*<owned guint64, owned guint64>*/ *highest_timestamps = NULL;
-  guint file_version;
-  GPtrArray/*<owned DflEvent*>*/ *events = NULL;
-  GError *child_error = NULL;
+  if (mapped_file != NULL)
+    {
+      dfl_parser_load_from_buffer (self,
+                                   g_mapped_file_get_contents (mapped_file),
+                                   g_mapped_file_get_length (mapped_file),
+                                   error);
+      g_mapped_file_unref (mapped_file);
 
-  g_return_if_fail (DFL_IS_PARSER (self));
-  g_return_if_fail (G_IS_INPUT_STREAM (stream));
-  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-  g_return_if_fail (error == NULL || *error == NULL);
+      return;
+    }
 
-  /* Wrap in a data input stream and read line by line. */
-  data_stream = g_data_input_stream_new (stream);
-  n_comment_lines = 0;
-  file_version = 0;
-  initial_timestamp = 0;
-  highest_timestamps = g_hash_table_new_full (g_int64_hash, g_int64_equal,
-                                              g_free, g_free);
-  events = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-
-  for (line_number = 1,
-       line = (guint8 *) g_data_input_stream_read_line (data_stream, &length,
-                                                        cancellable,
-                                                        &child_error);
-       line != NULL;
-       line_number++, g_free (line),
-       line = (guint8 *) g_data_input_stream_read_line (data_stream, &length,
-                                                        cancellable,
-                                                        &child_error))
-    {
-      const gchar *end = NULL;
-      gchar **components = NULL;
-
-      /* Note: The line is an arbitrary byte stream. It is not valid UTF-8 and
-       * may contain embedded nuls. Validate that first. */
-      if (!g_utf8_validate ((gchar *) line, length, &end))
-        {
-          /* TODO: Use a proper error code here. */
-          g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                       "Invalid log file line %u — invalid UTF-8 at byte %"
-                       G_GOFFSET_FORMAT,
-                       line_number, (goffset) (((guint8 *) end) - line));
-          break;
-        }
+  /* Fall back to loading by creating a stream for the file. This also gives
+   * the appropriate error if the file doesn’t exist. */
+  file = g_file_new_for_path (filename);
+  stream = g_file_read (file, NULL, error);
+  g_object_unref (file);
 
-      /* Ignore whitespace. */
-      line = (guint8 *) g_strstrip ((gchar *) line);
+  if (stream == NULL)
+    return;
 
-      /* Ignore comment or blank lines. */
-      if (line[0] == '\0' || line[0] == '#')
-        {
-          n_comment_lines++;
-          continue;
-        }
+  dfl_parser_load_from_stream (self, G_INPUT_STREAM (stream), NULL, error);
 
-      g_debug ("%s: Line: %s", G_STRFUNC, line);
+  g_object_unref (stream);
+}
 
-      /* Split into components. */
-      /* TODO: Formally document log file format. */
-      components = g_strsplit ((gchar *) line, ",", -1);
+/* Check whether @stream starts with the binary log magic, without consuming
+ * any of it. On error, %FALSE is returned and @error is set. */
+static gboolean
+stream_is_binary (GBufferedInputStream  *stream,
+                  GCancellable          *cancellable,
+                  GError               **error)
+{
+  gsize available;
+  const guint8 *buffer;
 
-      if (components[0] == NULL)
-        {
-          /* TODO: Use a proper error code here. */
-          g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                       "Invalid log file line %u — %s: %s", line_number,
-                       "not enough components", line);
-          g_strfreev (components);
-          break;
-        }
+  while ((available = g_buffered_input_stream_get_available (stream)) <
+         DFL_BINARY_LOG_MAGIC_LENGTH)
+    {
+      gssize n_read;
 
-      if (g_strcmp0 (components[0], "Dunfell log") == 0)
-        {
-          const gchar *version, *timestamp;
+      n_read = g_buffered_input_stream_fill (stream,
+                                             DFL_BINARY_LOG_MAGIC_LENGTH -
+                                             available,
+                                             cancellable, error);
 
-          /* Header line? Looks like:
-           *    Dunfell log,1.0,123456
-           * where 1.0 is the log format version, and 123456 is the starting
-           * timestamp. */
+      /* Error, or end of stream? */
+      if (n_read <= 0)
+        return FALSE;
+    }
 
-          /* Is this the first line? */
-          if (line_number - n_comment_lines != 1)
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid log file line %u — %s: %s", line_number,
-                           "header must be first non-comment line", line);
-              g_strfreev (components);
-              break;
-            }
+  buffer = g_buffered_input_stream_peek_buffer (stream, &available);
 
-          /* Check the number of components. */
-          if (components[1] == NULL || components[2] == NULL ||
-              components[3] != NULL)
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid log file line %u — %s: %s", line_number,
-                           "header contains the wrong number of components",
-                           line);
-              g_strfreev (components);
-              break;
-            }
+  return (memcmp (buffer, DFL_BINARY_LOG_MAGIC,
+                  DFL_BINARY_LOG_MAGIC_LENGTH) == 0);
+}
 
-          /* Extract the components. */
-          version = components[1];
-          timestamp = components[2];
+/* Read the rest of @stream into memory. */
+static GByteArray *
+read_stream (GInputStream  *stream,
+             GCancellable  *cancellable,
+             GError       **error)
+{
+  GByteArray *data = NULL;
+  gsize chunk_size = 64 * 1024;
 
-          /* File version check. */
-          if (g_strcmp0 (version, "1.0") != 0)
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Unsupported log file version ‘%s’ on line %u"
-                           "(versions supported: 1.0)", version, line_number);
-              g_strfreev (components);
-              break;
-            }
+  data = g_byte_array_new ();
 
-          file_version = 1;
+  while (TRUE)
+    {
+      gssize n_read;
 
-          /* Parse the timestamp. */
-          initial_timestamp = g_ascii_strtoull (timestamp, (gchar **) &end, 10);
+      g_byte_array_set_size (data, data->len + chunk_size);
+      n_read = g_input_stream_read (stream, data->data + data->len - chunk_size,
+                                    chunk_size, cancellable, error);
 
-          if (errno == ERANGE || end == timestamp || *end != '\0')
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid timestamp ‘%s’ on line %u", timestamp,
-                           line_number);
-              g_strfreev (components);
-              break;
-            }
-        }
-      else
+      if (n_read < 0)
         {
-          const EventData *event_data;
-          const gchar *event_type;
-          const gchar *timestamp;
-          const gchar *tid;
-          guint n_components;
-          guint64 timestamp_int, tid_int;
-          guint64 *highest_timestamp;
-          DflEvent *event = NULL;
-
-          /* Non-header line. Looks like:
-           *    g_idle_dispatch,1449749875412059,8491,140407983871120,12007776,\
-           *    140408421089918,0x7fb36210027e,14614576,0
-           */
-
-          /* Has there been a header? */
-          if (file_version == 0)
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid log file line %u — %s: %s", line_number,
-                           "header must be first non-comment line", line);
-              g_strfreev (components);
-              break;
-            }
+          g_byte_array_unref (data);
+          return NULL;
+        }
 
-          /* Extract the event type. */
-          event_type = g_intern_string (components[0]);
+      g_byte_array_set_size (data, data->len - chunk_size + n_read);
 
-          if (*event_type == '\0')
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid log file line %u — %s: %s", line_number,
-                           "event type not specified", line);
-              g_strfreev (components);
-              break;
-            }
+      if (n_read == 0)
+        break;
+    }
 
-          /* Match it to an event parser. */
-          event_data = event_data_from_event_type (event_type);
+  return data;
+}
 
-          if (event_data == NULL)
-            {
-              /* Ignore unknown event types to allow for more probe points to be
-               * added to GLib in future. */
-              g_debug ("%s: Ignoring unrecognised event type ‘%s’ on "
-                       "line %u: %s", G_STRFUNC, event_type, line_number, line);
-              g_strfreev (components);
-              continue;
-            }
+/* Number of events to parse before handing them back to the calling thread
+ * as a batch, when loading with dfl_parser_load_from_stream_async(). */
+#define STREAM_BATCH_N_EVENTS 16384
 
-          /* Check the number of components (ignoring the event type, timestamp
-           * and thread ID. */
-          n_components = g_strv_length (components);
+/* A batch of events parsed by dfl_parser_load_from_stream_async(), on its way
+ * from the parsing thread to the thread which started the load. */
+typedef struct
+{
+  DflParser *parser;  /* owned */
+  DflEventTable *events;  /* owned */
+  DflTimestamp initial_timestamp;
+  guint64 bytes_processed;
+  gboolean is_first;
+} StreamBatch;
 
-          if (n_components < 3 || n_components - 3 != event_data->n_parameters)
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid log file line %u — %s: %s", line_number,
-                           "event line contains the wrong number of components",
-                           line);
-              g_strfreev (components);
-              break;
-            }
+static void
+stream_batch_free (StreamBatch *batch)
+{
+  _dfl_event_table_unref (batch->events);
+  g_object_unref (batch->parser);
+  g_free (batch);
+}
 
-          /* Grab the timestamp and thread ID. */
-          timestamp = components[1];
-          tid = components[2];
+/* Runs in the thread which started the load. The first batch replaces the
+ * parser’s event sequence; subsequent batches are appended to it. */
+static gboolean
+stream_batch_cb (gpointer user_data)
+{
+  StreamBatch *batch = user_data;
+  DflParser *self = batch->parser;
 
-          timestamp_int = g_ascii_strtoull (timestamp, (gchar **) &end, 10);
+  if (batch->is_first)
+    {
+      g_clear_object (&self->sequence);
+      self->sequence = _dfl_event_sequence_new_from_table (batch->events,
+                                                           batch->initial_timestamp);
+      g_object_notify (G_OBJECT (self), "event-sequence");
+    }
+  else
+    {
+      _dfl_event_sequence_append_table (self->sequence, batch->events);
+    }
 
-          if (errno == ERANGE || end == timestamp || *end != '\0')
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid timestamp ‘%s’ on line %u", timestamp,
-                           line_number);
-              g_strfreev (components);
-              break;
-            }
+  self->bytes_processed = batch->bytes_processed;
+  g_object_notify (G_OBJECT (self), "bytes-processed");
 
-          tid_int = g_ascii_strtoull (tid, (gchar **) &end, 10);
+  return G_SOURCE_REMOVE;
+}
 
-          if (errno == ERANGE || end == tid || *end != '\0')
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid thread ID ‘%s’ on line %u", tid,
-                           line_number);
-              g_strfreev (components);
-              break;
-            }
+/* State for streaming batches of events back from the parsing thread. */
+typedef struct
+{
+  DflParser *parser;  /* unowned */
+  GMainContext *context;  /* unowned */
+  guint64 bytes_processed;
+  guint n_batches;
+} StreamState;
+
+/* Hand the events parsed so far in @data to the thread which started the
+ * load, and start a new table in @data for the next batch.
+ *
+ * The batch is dispatched from an idle source at the same priority as the
+ * #GTask’s completion callback; sources of equal priority are dispatched in the
+ * order they were attached, so all batches are delivered before
+ * dfl_parser_load_from_stream_finish() is called. */
+static void
+stream_state_flush (StreamState *stream,
+                    ParseData   *data)
+{
+  StreamBatch *batch = NULL;
+  GSource *source = NULL;
+
+  batch = g_new0 (StreamBatch, 1);
+  batch->parser = g_object_ref (stream->parser);
+  batch->events = data->events;  /* transfer */
+  batch->initial_timestamp = data->initial_timestamp;
+  batch->bytes_processed = stream->bytes_processed;
+  batch->is_first = (stream->n_batches == 0);
+
+  data->events = _dfl_event_table_new ();
+  stream->n_batches++;
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source, stream_batch_cb, batch,
+                         (GDestroyNotify) stream_batch_free);
+  g_source_attach (source, stream->context);
+  g_source_unref (source);
+}
 
-          /* Check that the timestamps in each thread are monotonically
-           * increasing. */
-          highest_timestamp = g_hash_table_lookup (highest_timestamps,
-                                                   (gpointer) &tid_int);
+/* Load a log from @stream. If @stream_state is %NULL, the parser’s event
+ * sequence is set once the whole log has been parsed successfully. Otherwise,
+ * events are handed back to the thread which started the load in batches as
+ * they are parsed, and the parser is not touched from this thread. */
+static void
+load_from_stream (DflParser     *self,
+                  GInputStream  *stream,
+                  StreamState   *stream_state,
+                  GCancellable  *cancellable,
+                  GError       **error)
+{
+  GDataInputStream *data_stream = NULL;
+  gchar *line = NULL;
+  gsize length = 0;
+  guint line_number;
+  ParseData data;
+  GError *child_error = NULL;
 
-          if ((highest_timestamp == NULL && timestamp_int < initial_timestamp) ||
-              (highest_timestamp != NULL && timestamp_int < *highest_timestamp))
-            {
-              /* TODO: Use a proper error code here. */
-              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
-                           "Invalid timestamp ‘%s’ on line %u: timestamps must "
-                           "be monotonically increasing", timestamp,
-                           line_number);
-              g_strfreev (components);
-              break;
-            }
+  data_stream = g_data_input_stream_new (stream);
+  parse_data_init (&data);
 
-          if (highest_timestamp != NULL)
-            {
-              *highest_timestamp = timestamp_int;
-            }
-          else
-            {
-              guint64 *key = NULL;
+  /* Binary logs are parsed from memory, so read the whole stream in. */
+  if (stream_is_binary (G_BUFFERED_INPUT_STREAM (data_stream), cancellable,
+                        &child_error))
+    {
+      GByteArray *contents = NULL;
 
-              highest_timestamp = g_new0 (guint64, 1);
-              *highest_timestamp = timestamp_int;
-              key = g_new0 (guint64, 1);
-              *key = tid_int;
+      contents = read_stream (G_INPUT_STREAM (data_stream), cancellable,
+                              &child_error);
 
-              g_hash_table_insert (highest_timestamps, key, highest_timestamp);
-            }
+      if (contents != NULL)
+        {
+          parse_buffer (&data, (const gchar *) contents->data, contents->len,
+                        &child_error);
 
-          /* Create the event. */
-          event = dfl_event_new (event_type, timestamp_int, tid_int,
-                                 (const gchar * const *) components + 3);
-          g_ptr_array_add (events, event);  /* transfer ownership */
-        }
+          if (stream_state != NULL)
+            stream_state->bytes_processed = contents->len;
 
-      g_strfreev (components);
+          g_byte_array_unref (contents);
+        }
     }
+  else if (child_error == NULL)
+    {
+      /* Otherwise, read line by line. */
+      for (line_number = 1,
+           line = g_data_input_stream_read_line (data_stream, &length,
+                                                 cancellable, &child_error);
+           line != NULL;
+           line_number++, g_free (line),
+           line = g_data_input_stream_read_line (data_stream, &length,
+                                                 cancellable, &child_error))
+        {
+          if (!parse_line (&data, line, length, line_number, &child_error))
+            break;
+
+          if (stream_state != NULL)
+            {
+              /* Include the newline. */
+              stream_state->bytes_processed += length + 1;
 
-  g_free (line);
+              if (_dfl_event_table_get_n_events (data.events) >=
+                  STREAM_BATCH_N_EVENTS)
+                stream_state_flush (stream_state, &data);
+            }
+        }
 
-  /* Success? */
-  if (child_error == NULL)
+      g_free (line);
+    }
+
+  if (stream_state == NULL)
     {
-      g_clear_object (&self->sequence);
-      self->sequence = dfl_event_sequence_new ((const DflEvent **) events->pdata,
-                                               events->len, initial_timestamp);
+      dfl_parser_finish_parse (self, &data, child_error, error);
     }
-  else
+  else if (child_error != NULL)
     {
       g_propagate_error (error, child_error);
     }
+  else
+    {
+      /* Always send a final batch, even if it’s empty, so that the sequence
+       * is created for logs with no events. */
+      stream_state_flush (stream_state, &data);
+    }
 
-  g_clear_pointer (&events, g_ptr_array_unref);
-  g_clear_pointer (&highest_timestamps, g_hash_table_unref);
+  parse_data_clear (&data);
   g_object_unref (data_stream);
 }
 
+/**
+ * dfl_parser_load_from_stream:
+ * @self: a #DflParser
+ * @stream: input stream to read log from
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * TODO
+ *
+ * Since: 0.1.0
+ */
+void
+dfl_parser_load_from_stream (DflParser     *self,
+                             GInputStream  *stream,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  g_return_if_fail (DFL_IS_PARSER (self));
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (error == NULL || *error == NULL);
+
+  load_from_stream (self, stream, NULL, cancellable, error);
+}
+
 static void
 load_from_stream_thread_cb (GTask         *task,
                             gpointer       source_object,
@@ -520,12 +1760,18 @@ load_from_stream_thread_cb (GTask         *task,
 {
   DflParser *self;
   GInputStream *stream;
+  StreamState stream_state;
   GError *error = NULL;
 
   self = DFL_PARSER (source_object);
   stream = G_INPUT_STREAM (task_data);
 
-  dfl_parser_load_from_stream (self, stream, cancellable, &error);
+  stream_state.parser = self;
+  stream_state.context = g_task_get_context (task);
+  stream_state.bytes_processed = 0;
+  stream_state.n_batches = 0;
+
+  load_from_stream (self, stream, &stream_state, cancellable, &error);
 
   if (error != NULL)
     g_task_return_error (task, error);
@@ -543,6 +1789,16 @@ load_from_stream_thread_cb (GTask         *task,
  *
  * Asynchronous version of dfl_parser_load_from_stream().
  *
+ * The log is parsed in a worker thread, and the events are passed back to the
+ * thread-default main context of the caller in batches as they are parsed.
+ * #DflParser:event-sequence is set to a new #DflEventSequence when the first
+ * batch arrives, and subsequent batches are appended to it (emitting
+ * #GListModel::items-changed). #DflParser:bytes-processed is updated with each
+ * batch. All batches have been delivered by the time @callback is called.
+ *
+ * If loading fails, the event sequence contains the events parsed before the
+ * failure.
+ *
  * Since: 0.1.0
  */
 void
@@ -558,6 +1814,12 @@ dfl_parser_load_from_stream_async (DflParser            *self,
   g_return_if_fail (G_IS_INPUT_STREAM (stream));
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
+  if (self->bytes_processed != 0)
+    {
+      self->bytes_processed = 0;
+      g_object_notify (G_OBJECT (self), "bytes-processed");
+    }
+
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, dfl_parser_load_from_stream_async);
   g_task_set_task_data (task, g_object_ref (stream), g_object_unref);
@@ -588,6 +1850,249 @@ dfl_parser_load_from_stream_finish (DflParser     *self,
   g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* Interval between checks for more data at the end of a log which is being
+ * followed by dfl_parser_follow_stream_async(). */
+#define FOLLOW_POLL_INTERVAL_MS 500
+
+/* Number of bytes to read from a followed log at once. */
+#define FOLLOW_READ_SIZE (64 * 1024)
+
+/* Wait for %FOLLOW_POLL_INTERVAL_MS, or until the operation is cancelled.
+ * @pollfd is from g_cancellable_make_pollfd(), or %NULL if the cancellable
+ * does not have a file descriptor. */
+static void
+follow_wait (GPollFD *pollfd)
+{
+  if (pollfd != NULL)
+    g_poll (pollfd, 1, FOLLOW_POLL_INTERVAL_MS);
+  else
+    g_usleep (FOLLOW_POLL_INTERVAL_MS * 1000);
+}
+
+/* Follow a log which is still being written to @stream, parsing each complete
+ * line as it appears and handing the events back to the thread which started
+ * the operation in batches. When the end of @stream is reached, any parsed
+ * events are flushed, and the stream is read again after a short wait. This
+ * continues until @cancellable is cancelled or an error occurs, so @error is
+ * always set on return.
+ *
+ * Lines are parsed in place from a buffer of the data read so far. Only the
+ * trailing partial line (if any) is kept between reads, so the cost of each
+ * poll is a single read() which returns no data. */
+static void
+follow_stream (GInputStream  *stream,
+               StreamState   *stream_state,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+  ParseData data;
+  GByteArray *buffer = NULL;
+  GPollFD cancellable_pollfd;
+  GPollFD *pollfd = NULL;
+  guint line_number = 1;
+  GError *child_error = NULL;
+
+  parse_data_init (&data);
+  buffer = g_byte_array_sized_new (FOLLOW_READ_SIZE);
+
+  if (g_cancellable_make_pollfd (cancellable, &cancellable_pollfd))
+    pollfd = &cancellable_pollfd;
+
+  while (!g_cancellable_set_error_if_cancelled (cancellable, &child_error))
+    {
+      gsize old_length;
+      gssize n_read;
+      const gchar *start, *end;
+
+      old_length = buffer->len;
+      g_byte_array_set_size (buffer, old_length + FOLLOW_READ_SIZE);
+      n_read = g_input_stream_read (stream, buffer->data + old_length,
+                                    FOLLOW_READ_SIZE, cancellable,
+                                    &child_error);
+      g_byte_array_set_size (buffer, old_length + MAX (n_read, 0));
+
+      if (n_read < 0)
+        break;
+
+      if (n_read == 0)
+        {
+          /* Caught up with the writer. Hand over what has been parsed, once
+           * the header has been seen (so that the sequence gets the right
+           * initial timestamp), and wait for more to be written. */
+          if (data.file_version != 0 &&
+              (_dfl_event_table_get_n_events (data.events) > 0 ||
+               stream_state->n_batches == 0))
+            stream_state_flush (stream_state, &data);
+
+          follow_wait (pollfd);
+          continue;
+        }
+
+      /* Find the end of the last complete line. The rest of the buffer is a
+       * partial line, which is kept until the rest of it is written. */
+      start = (const gchar *) buffer->data;
+      end = start + buffer->len;
+
+      while (end > start && *(end - 1) != '\n')
+        end--;
+
+      if (end == start)
+        continue;
+
+      /* Binary logs are written in one go at the end of recording, so cannot
+       * be followed. */
+      if (line_number == 1 &&
+          (gsize) (end - start) >= DFL_BINARY_LOG_MAGIC_LENGTH &&
+          memcmp (start, DFL_BINARY_LOG_MAGIC,
+                  DFL_BINARY_LOG_MAGIC_LENGTH) == 0)
+        {
+          g_set_error_literal (&child_error, G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Binary logs cannot be followed");
+          break;
+        }
+
+      parse_lines (&data, start, end, FALSE, &line_number, &child_error);
+
+      if (child_error != NULL)
+        break;
+
+      stream_state->bytes_processed += end - start;
+      g_byte_array_remove_range (buffer, 0, end - start);
+
+      if (_dfl_event_table_get_n_events (data.events) >= STREAM_BATCH_N_EVENTS)
+        stream_state_flush (stream_state, &data);
+    }
+
+  /* Deliver any events parsed before the operation stopped. */
+  if (data.file_version != 0 &&
+      _dfl_event_table_get_n_events (data.events) > 0)
+    stream_state_flush (stream_state, &data);
+
+  g_propagate_error (error, child_error);
+
+  if (pollfd != NULL)
+    g_cancellable_release_fd (cancellable);
+
+  g_byte_array_unref (buffer);
+  parse_data_clear (&data);
+}
+
+static void
+follow_stream_thread_cb (GTask         *task,
+                         gpointer       source_object,
+                         gpointer       task_data,
+                         GCancellable  *cancellable)
+{
+  GInputStream *stream;
+  StreamState stream_state;
+  GError *error = NULL;
+
+  stream = G_INPUT_STREAM (task_data);
+
+  stream_state.parser = DFL_PARSER (source_object);
+  stream_state.context = g_task_get_context (task);
+  stream_state.bytes_processed = 0;
+  stream_state.n_batches = 0;
+
+  follow_stream (stream, &stream_state, cancellable, &error);
+
+  /* Cancellation is how following is normally stopped, so is not an error. */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      g_task_return_boolean (task, TRUE);
+    }
+  else
+    {
+      g_task_return_error (task, error);
+    }
+}
+
+/**
+ * dfl_parser_follow_stream_async:
+ * @self: a #DflParser
+ * @stream: input stream to read log from, which is still being written
+ * @cancellable: a #GCancellable to stop following with
+ * @callback: callback to call once following stops
+ * @user_data: data to pass to @callback
+ *
+ * Load a log which is still being written (for example, by `dunfell-record`)
+ * and keep loading new events from it as they are written, until @cancellable
+ * is cancelled.
+ *
+ * This works like dfl_parser_load_from_stream_async(): events are passed back
+ * to the thread-default main context of the caller in batches, the first of
+ * which sets #DflParser:event-sequence, and subsequent batches are appended to
+ * it. When the end of @stream is reached, the events parsed so far are
+ * delivered, and @stream is checked again for new data periodically. Partially
+ * written lines are kept until they are complete. The prefix of the log is
+ * never re-parsed.
+ *
+ * @callback is only called once following has stopped, either because
+ * @cancellable was cancelled (which is the normal way to stop following, and
+ * is not treated as an error) or because the log could not be parsed. The
+ * events parsed up to that point remain in the event sequence.
+ *
+ * Only text logs can be followed; binary logs result in a
+ * %G_IO_ERROR_NOT_SUPPORTED error.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_parser_follow_stream_async (DflParser            *self,
+                                GInputStream         *stream,
+                                GCancellable         *cancellable,
+                                GAsyncReadyCallback   callback,
+                                gpointer              user_data)
+{
+  GTask *task = NULL;
+
+  g_return_if_fail (DFL_IS_PARSER (self));
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+  g_return_if_fail (G_IS_CANCELLABLE (cancellable));
+
+  if (self->bytes_processed != 0)
+    {
+      self->bytes_processed = 0;
+      g_object_notify (G_OBJECT (self), "bytes-processed");
+    }
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, dfl_parser_follow_stream_async);
+  /* Cancellation is reported as success; see follow_stream_thread_cb(). */
+  g_task_set_check_cancellable (task, FALSE);
+  g_task_set_task_data (task, g_object_ref (stream), g_object_unref);
+  g_task_run_in_thread (task, follow_stream_thread_cb);
+  g_object_unref (task);
+}
+
+/**
+ * dfl_parser_follow_stream_finish:
+ * @self: a #DflParser
+ * @result: result of the asynchronous operation
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish function for dfl_parser_follow_stream_async(). Following a log only
+ * stops when it is cancelled or fails, so this returns %TRUE if following was
+ * stopped by cancelling the operation, and sets @error otherwise.
+ *
+ * Returns: %TRUE if following was cancelled, %FALSE on error
+ * Since: UNRELEASED
+ */
+gboolean
+dfl_parser_follow_stream_finish (DflParser     *self,
+                                 GAsyncResult  *result,
+                                 GError       **error)
+{
+  g_return_val_if_fail (DFL_IS_PARSER (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /**
  * dfl_parser_get_event_sequence:
  * @self: a #DflParser
@@ -605,6 +2110,23 @@ dfl_parser_get_event_sequence (DflParser *self)
   return self->sequence;
 }
 
+/**
+ * dfl_parser_get_bytes_processed:
+ * @self: a #DflParser
+ *
+ * Get the value of the #DflParser:bytes-processed property.
+ *
+ * Returns: number of bytes of the log parsed so far
+ * Since: UNRELEASED
+ */
+guint64
+dfl_parser_get_bytes_processed (DflParser *self)
+{
+  g_return_val_if_fail (DFL_IS_PARSER (self), 0);
+
+  return self->bytes_processed;
+}
+
 /**
  * dfl_parser_dup_model:
  * @self: a #DflParser
@@ -62,7 +62,17 @@ void dfl_parser_load_from_stream_finish (DflParser *self,
                                          GAsyncResult *result,
                                          GError **error);
 
-DflEventSequence *dfl_parser_get_event_sequence (DflParser *self);
+void     dfl_parser_follow_stream_async  (DflParser *self,
+                                          GInputStream *stream,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data);
+gboolean dfl_parser_follow_stream_finish (DflParser *self,
+                                          GAsyncResult *result,
+                                          GError **error);
+
+DflEventSequence *dfl_parser_get_event_sequence  (DflParser *self);
+guint64           dfl_parser_get_bytes_processed (DflParser *self);
 
 DflModel *dfl_parser_dup_model (DflParser *self);
 
@@ -34,8 +34,10 @@
 #include <gio/gio.h>
 #include <string.h>
 
+#include "duration-statistics.h"
 #include "event.h"
 #include "event-sequence.h"
+#include "factory-private.h"
 #include "source.h"
 #include "time-sequence.h"
 
@@ -69,6 +71,10 @@ struct _DflSource
    * dispatch. A duration of ≥ 0 is valid; < 0 is not. */
   DflTimeSequence/*<DflSourceDispatchData>*/ dispatch_events;
 
+  /* Summary of the durations of the completed dispatches in
+   * @dispatch_events, updated as each one completes. */
+  DflDurationStatistics dispatch_durations;
+
   gchar *name;  /* owned; nullable */
 
   DflId attach_context;
@@ -105,6 +111,8 @@ typedef enum
   PROP_MIN_DISPATCH_DURATION,
   PROP_MEDIAN_DISPATCH_DURATION,
   PROP_MAX_DISPATCH_DURATION,
+  PROP_P90_DISPATCH_DURATION,
+  PROP_P99_DISPATCH_DURATION,
 } DflSourceProperty;
 
 static void
@@ -370,6 +378,42 @@ dfl_source_class_init (DflSourceClass *klass)
                                                        0, G_MAXINT64, 0,
                                                        G_PARAM_READABLE |
                                                        G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DflSource:p90-dispatch-duration:
+   *
+   * Approximate 90th percentile of the durations of the source’s dispatches, in
+   * microseconds. See dfl_source_get_dispatch_quantiles().
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_P90_DISPATCH_DURATION,
+                                   g_param_spec_int64 ("p90-dispatch-duration",
+                                                       "90th Percentile Dispatch Duration",
+                                                       "Approximate 90th "
+                                                       "percentile of the "
+                                                       "dispatch durations.",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_READABLE |
+                                                       G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DflSource:p99-dispatch-duration:
+   *
+   * Approximate 99th percentile of the durations of the source’s dispatches, in
+   * microseconds. See dfl_source_get_dispatch_quantiles().
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_P99_DISPATCH_DURATION,
+                                   g_param_spec_int64 ("p99-dispatch-duration",
+                                                       "99th Percentile Dispatch Duration",
+                                                       "Approximate 99th "
+                                                       "percentile of the "
+                                                       "dispatch durations.",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_READABLE |
+                                                       G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -378,6 +422,14 @@ dfl_source_init (DflSource *self)
   dfl_time_sequence_init (&self->dispatch_events,
                           sizeof (DflSourceDispatchData),
                           (GDestroyNotify) dfl_source_dispatch_data_clear, 0);
+  dfl_time_sequence_set_duration_offset (&self->dispatch_events,
+                                         G_STRUCT_OFFSET (DflSourceDispatchData,
+                                                          duration));
+  dfl_time_sequence_set_thread_id_offset (&self->dispatch_events,
+                                          G_STRUCT_OFFSET (DflSourceDispatchData,
+                                                           thread_id));
+
+  _dfl_duration_statistics_init (&self->dispatch_durations);
 
   self->children = g_ptr_array_new_with_free_func (g_object_unref);
 }
@@ -464,6 +516,24 @@ dfl_source_get_property (GObject     *object,
         g_value_set_int64 (value, max_duration);
         break;
       }
+    case PROP_P90_DISPATCH_DURATION:
+      {
+        DflDuration p90_duration;
+
+        dfl_source_get_dispatch_quantiles (self, NULL, &p90_duration, NULL,
+                                           NULL);
+        g_value_set_int64 (value, p90_duration);
+        break;
+      }
+    case PROP_P99_DISPATCH_DURATION:
+      {
+        DflDuration p99_duration;
+
+        dfl_source_get_dispatch_quantiles (self, NULL, NULL, &p99_duration,
+                                           NULL);
+        g_value_set_int64 (value, p99_duration);
+        break;
+      }
     default:
       g_assert_not_reached ();
     }
@@ -532,6 +602,8 @@ dfl_source_set_property (GObject           *object,
     case PROP_MIN_DISPATCH_DURATION:
     case PROP_MEDIAN_DISPATCH_DURATION:
     case PROP_MAX_DISPATCH_DURATION:
+    case PROP_P90_DISPATCH_DURATION:
+    case PROP_P99_DISPATCH_DURATION:
       /* Read only. */
     default:
       g_assert_not_reached ();
@@ -544,6 +616,7 @@ dfl_source_dispose (GObject *object)
   DflSource *self = DFL_SOURCE (object);
 
   dfl_time_sequence_clear (&self->dispatch_events);
+  _dfl_duration_statistics_clear (&self->dispatch_durations);
   g_clear_pointer (&self->name, g_free);
 
   g_clear_pointer (&self->children, g_ptr_array_unref);
@@ -583,6 +656,23 @@ dfl_source_new (DflId        id,
                        NULL);
 }
 
+/* Set the duration of a dispatch, marking it as complete, and update the
+ * statistics. */
+static void
+source_finish_dispatch (DflSource             *source,
+                        DflSourceDispatchData *dispatch_data,
+                        DflDuration            duration)
+{
+  /* If the dispatch was already complete (which only happens for malformed
+   * logs), replace its old duration. */
+  if (dispatch_data->duration >= 0)
+    _dfl_duration_statistics_remove (&source->dispatch_durations,
+                                     dispatch_data->duration);
+
+  dispatch_data->duration = duration;
+  _dfl_duration_statistics_add (&source->dispatch_durations, duration);
+}
+
 static void
 source_before_after_dispatch_cb (DflEventSequence *sequence,
                                  DflEvent         *event,
@@ -626,7 +716,8 @@ source_before_after_dispatch_cb (DflEventSequence *sequence,
                      "same context with no finish in between.");
 
           /* Fudge it. */
-          last_element->duration = timestamp - last_timestamp;
+          source_finish_dispatch (source, last_element,
+                                  timestamp - last_timestamp);
         }
 
       /* Start the next element. */
@@ -681,7 +772,8 @@ source_before_after_dispatch_cb (DflEventSequence *sequence,
                      "both on the same context.");
 
           /* Fudge it. */
-          last_element->duration = timestamp - last_timestamp;
+          source_finish_dispatch (source, last_element,
+                                  timestamp - last_timestamp);
 
           last_element = dfl_time_sequence_append (&source->dispatch_events,
                                                    timestamp);
@@ -693,7 +785,8 @@ source_before_after_dispatch_cb (DflEventSequence *sequence,
         }
 
       /* Update the element’s duration. */
-      last_element->duration = timestamp - last_timestamp;
+      source_finish_dispatch (source, last_element,
+                              timestamp - last_timestamp);
     }
 }
 
@@ -799,12 +892,26 @@ source_destroy_cb (DflEventSequence *sequence,
   source->destroy_thread_id = dfl_event_get_thread_id (event);
 }
 
+typedef struct
+{
+  GPtrArray/*<owned DflSource>*/ *sources;  /* owned */
+  DflIdentityIndex *index;  /* owned */
+} SourceFactory;
+
+static void
+source_factory_free (SourceFactory *factory)
+{
+  _dfl_identity_index_unref (factory->index);
+  g_ptr_array_unref (factory->sources);
+  g_free (factory);
+}
+
 static void
 source_new_cb (DflEventSequence *sequence,
                DflEvent         *event,
                gpointer          user_data)
 {
-  GPtrArray/*<owned DflSource>*/ *sources = user_data;
+  SourceFactory *factory = user_data;
   DflSource *source = NULL;
   DflId source_id;
 
@@ -849,7 +956,9 @@ source_new_cb (DflEventSequence *sequence,
   dfl_event_sequence_end_walker_group (sequence, "g_source_before_free",
                                        source_id);
 
-  g_ptr_array_add (sources, source);  /* transfer */
+  _dfl_identity_index_insert (factory->index, source_id,
+                              dfl_event_get_timestamp (event), source);
+  g_ptr_array_add (factory->sources, source);  /* transfer */
 }
 
 static void
@@ -857,27 +966,20 @@ source_add_child_source_cb (DflEventSequence *sequence,
                             DflEvent         *event,
                             gpointer          user_data)
 {
-  GPtrArray/*<owned DflSource>*/ *sources = user_data;
+  DflIdentityIndex *index = user_data;
   DflSource *parent_source = NULL, *child_source = NULL;
   DflId parent_source_id, child_source_id;
-  gsize i;
+  DflTimestamp timestamp;
 
   parent_source_id = dfl_event_get_parameter_id (event, 0);
   child_source_id = dfl_event_get_parameter_id (event, 1);
+  timestamp = dfl_event_get_timestamp (event);
 
-  /* Find the two sources. */
-  for (i = 0;
-       i < sources->len && (parent_source == NULL || child_source == NULL);
-       i++)
-    {
-      if (parent_source == NULL &&
-          dfl_source_get_id (sources->pdata[i]) == parent_source_id)
-        parent_source = DFL_SOURCE (sources->pdata[i]);
-
-      if (child_source == NULL &&
-          dfl_source_get_id (sources->pdata[i]) == child_source_id)
-        child_source = DFL_SOURCE (sources->pdata[i]);
-    }
+  /* Find the two sources. Their IDs may have been used by other sources
+   * earlier in the log, so find the ones which are live now. */
+  parent_source = _dfl_identity_index_lookup (index, parent_source_id,
+                                              timestamp);
+  child_source = _dfl_identity_index_lookup (index, child_source_id, timestamp);
 
   if (parent_source == NULL || child_source == NULL)
     {
@@ -896,6 +998,39 @@ source_add_child_source_cb (DflEventSequence *sequence,
   child_source->parent_source = parent_source;
 }
 
+/* Records the sources which are attached or dispatched while the event
+ * sequence is walked, so that the model only has to update its links for
+ * those; see _dfl_source_factory_from_event_sequence(). */
+typedef struct
+{
+  DflIdentityIndex *index;  /* owned */
+  GHashTable/*<unowned DflSource>*/ *changed_sources;  /* owned */
+} SourceChangeTracker;
+
+static void
+source_change_tracker_free (SourceChangeTracker *tracker)
+{
+  g_hash_table_unref (tracker->changed_sources);
+  _dfl_identity_index_unref (tracker->index);
+  g_free (tracker);
+}
+
+static void
+source_changed_cb (DflEventSequence *sequence,
+                   DflEvent         *event,
+                   gpointer          user_data)
+{
+  SourceChangeTracker *tracker = user_data;
+  DflSource *source;
+
+  source = _dfl_identity_index_lookup (tracker->index,
+                                       dfl_event_get_parameter_id (event, 0),
+                                       dfl_event_get_timestamp (event));
+
+  if (source != NULL)
+    g_hash_table_add (tracker->changed_sources, source);
+}
+
 /**
  * dfl_source_factory_from_event_sequence:
  * @sequence: an event sequence to analyse
@@ -909,19 +1044,57 @@ source_add_child_source_cb (DflEventSequence *sequence,
 GPtrArray *
 dfl_source_factory_from_event_sequence (DflEventSequence *sequence)
 {
-  GPtrArray/*<owned DflSource>*/ *sources = NULL;
+  return _dfl_source_factory_from_event_sequence (sequence, NULL, NULL);
+}
+
+GPtrArray *
+_dfl_source_factory_from_event_sequence (DflEventSequence  *sequence,
+                                         DflIdentityIndex **index_out,
+                                         GHashTable       **changed_sources_out)
+{
+  SourceFactory *factory = NULL;
+
+  factory = g_new0 (SourceFactory, 1);
+  factory->sources = g_ptr_array_new_with_free_func (g_object_unref);
+  factory->index = _dfl_identity_index_new ();
+
+  if (index_out != NULL)
+    *index_out = _dfl_identity_index_ref (factory->index);
 
-  sources = g_ptr_array_new_with_free_func (g_object_unref);
   dfl_event_sequence_add_walker (sequence, "g_source_new", DFL_ID_INVALID,
-                                 source_new_cb,
-                                 g_ptr_array_ref (sources),
-                                 (GDestroyNotify) g_ptr_array_unref);
+                                 source_new_cb, factory,
+                                 (GDestroyNotify) source_factory_free);
   dfl_event_sequence_add_walker (sequence, "g_source_add_child_source",
                                  DFL_ID_INVALID, source_add_child_source_cb,
-                                 g_ptr_array_ref (sources),
-                                 (GDestroyNotify) g_ptr_array_unref);
+                                 _dfl_identity_index_ref (factory->index),
+                                 (GDestroyNotify) _dfl_identity_index_unref);
+
+  if (changed_sources_out != NULL)
+    {
+      const gchar *change_event_types[] = {
+        "g_source_attach",
+        "g_source_before_dispatch",
+        "g_source_after_dispatch",
+      };
+      gsize i;
+
+      *changed_sources_out = g_hash_table_new (NULL, NULL);
 
-  return sources;
+      for (i = 0; i < G_N_ELEMENTS (change_event_types); i++)
+        {
+          SourceChangeTracker *tracker = g_new0 (SourceChangeTracker, 1);
+
+          tracker->index = _dfl_identity_index_ref (factory->index);
+          tracker->changed_sources = g_hash_table_ref (*changed_sources_out);
+
+          dfl_event_sequence_add_walker (sequence, change_event_types[i],
+                                         DFL_ID_INVALID, source_changed_cb,
+                                         tracker,
+                                         (GDestroyNotify) source_change_tracker_free);
+        }
+    }
+
+  return g_ptr_array_ref (factory->sources);
 }
 
 /**
@@ -1115,6 +1288,86 @@ dfl_source_dispatch_iter (DflSource           *self,
   dfl_time_sequence_iter_init (iter, &self->dispatch_events, start);
 }
 
+/**
+ * dfl_source_dispatch_iter_range:
+ * @self: a #DflSource
+ * @iter: an uninitialised #DflTimeSequenceIter to use
+ * @start: earliest dispatch timestamp to return, inclusive
+ * @end: latest dispatch timestamp to return, inclusive
+ *
+ * Initialise @iter to iterate over the dispatches of the source which started
+ * in the range [@start, @end]. See dfl_time_sequence_iter_init_range().
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_source_dispatch_iter_range (DflSource           *self,
+                                DflTimeSequenceIter *iter,
+                                DflTimestamp         start,
+                                DflTimestamp         end)
+{
+  g_return_if_fail (DFL_IS_SOURCE (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_iter_init_range (iter, &self->dispatch_events, start, end);
+}
+
+/**
+ * dfl_source_dispatch_iter_overlapping:
+ * @self: a #DflSource
+ * @iter: an uninitialised #DflTimeSequenceIter to use
+ * @start: start of the window, inclusive
+ * @end: end of the window, inclusive
+ *
+ * Initialise @iter to iterate over the dispatches of the source which overlap
+ * the window [@start, @end], including any which began before @start. Use
+ * dfl_time_sequence_iter_next_overlapping() to advance it.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_source_dispatch_iter_overlapping (DflSource           *self,
+                                      DflTimeSequenceIter *iter,
+                                      DflTimestamp         start,
+                                      DflTimestamp         end)
+{
+  g_return_if_fail (DFL_IS_SOURCE (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (start <= end);
+
+  dfl_time_sequence_iter_init_overlapping (iter, &self->dispatch_events,
+                                           start, end);
+}
+
+/**
+ * dfl_source_dup_dispatch_summary:
+ * @self: a #DflSource
+ * @start: start of the window to summarise, inclusive
+ * @end: end of the window to summarise, inclusive
+ * @resolution: desired width of each bucket, in microseconds
+ *
+ * Summarise the source’s dispatches in the window [@start, @end]. See
+ * dfl_time_sequence_dup_summary() for details.
+ *
+ * Returns: (transfer full) (element-type DflTimeSequenceSummary): summaries of
+ *    the non-empty buckets in the window
+ * Since: UNRELEASED
+ */
+GArray *
+dfl_source_dup_dispatch_summary (DflSource    *self,
+                                 DflTimestamp  start,
+                                 DflTimestamp  end,
+                                 DflDuration   resolution)
+{
+  g_return_val_if_fail (DFL_IS_SOURCE (self), NULL);
+  g_return_val_if_fail (start <= end, NULL);
+  g_return_val_if_fail (resolution > 0, NULL);
+
+  return dfl_time_sequence_dup_summary (&self->dispatch_events, start, end,
+                                        resolution);
+}
+
 /**
  * dfl_source_get_n_long_dispatches:
  * @self: a #DflSource
@@ -1154,16 +1407,28 @@ dfl_source_get_n_long_dispatches (DflSource   *self,
   return count;
 }
 
-static gint
-compare_durations (gconstpointer a,
-                   gconstpointer b)
-{
-  const DflDuration *duration_a = a, *duration_b = b;
-
-  return (*duration_a - *duration_b);
-}
-
-/* TODO: Docs */
+/**
+ * dfl_source_get_dispatch_statistics:
+ * @self: a #DflSource
+ * @n_dispatches: (out caller-allocates) (optional): return location for the
+ *    number of dispatches
+ * @min_duration: (out caller-allocates) (optional): return location for the
+ *    shortest dispatch duration, in microseconds
+ * @median_duration: (out caller-allocates) (optional): return location for the
+ *    approximate median dispatch duration, in microseconds
+ * @max_duration: (out caller-allocates) (optional): return location for the
+ *    longest dispatch duration, in microseconds
+ *
+ * Get summary statistics about the durations of the source’s dispatches. The
+ * durations are only those of completed dispatches; @n_dispatches also
+ * includes any dispatch which was still in progress at the end of the log.
+ *
+ * The statistics are maintained as dispatches are added, so this is a constant
+ * time operation. The median is accurate to within about 2%; the minimum and
+ * maximum are exact. All durations are 0 if there are no completed dispatches.
+ *
+ * Since: UNRELEASED
+ */
 void
 dfl_source_get_dispatch_statistics (DflSource   *self,
                                     gsize       *n_dispatches,
@@ -1171,58 +1436,106 @@ dfl_source_get_dispatch_statistics (DflSource   *self,
                                     DflDuration *median_duration,
                                     DflDuration *max_duration)
 {
-  g_autoptr (GArray) durations = NULL;  /* (element-type DflDuration) */
-  DflTimeSequenceIter iter;
-  DflSourceDispatchData *dispatch_data;
-
   g_return_if_fail (DFL_IS_SOURCE (self));
 
   if (n_dispatches != NULL)
     *n_dispatches = dfl_time_sequence_get_n_elements (&self->dispatch_events);
+  if (min_duration != NULL)
+    *min_duration = self->dispatch_durations.min;
+  if (median_duration != NULL)
+    *median_duration = _dfl_duration_statistics_get_standard_quantile (&self->dispatch_durations,
+                                                                       DFL_DURATION_QUANTILE_P50);
+  if (max_duration != NULL)
+    *max_duration = self->dispatch_durations.max;
+}
 
-  /* Fast paths. */
-  if (min_duration == NULL && median_duration == NULL && max_duration == NULL)
-    return;
-
-  if (dfl_time_sequence_get_n_elements (&self->dispatch_events) == 0)
-    {
-      if (min_duration != NULL)
-        *min_duration = 0;
-      if (median_duration != NULL)
-        *median_duration = 0;
-      if (max_duration != NULL)
-        *max_duration = 0;
-
-      return;
-    }
-
-  /* In order to calculate the median, we need to order all the dispatches by
-   * duration. */
-  durations = g_array_sized_new (FALSE, FALSE, sizeof (DflDuration),
-                                 dfl_time_sequence_get_n_elements (&self->dispatch_events));
+/**
+ * dfl_source_get_dispatch_quantiles:
+ * @self: a #DflSource
+ * @p50_duration: (out caller-allocates) (optional): return location for the
+ *    50th percentile dispatch duration, in microseconds
+ * @p90_duration: (out caller-allocates) (optional): return location for the
+ *    90th percentile dispatch duration, in microseconds
+ * @p99_duration: (out caller-allocates) (optional): return location for the
+ *    99th percentile dispatch duration, in microseconds
+ * @p999_duration: (out caller-allocates) (optional): return location for the
+ *    99.9th percentile dispatch duration, in microseconds
+ *
+ * Get the approximate percentiles of the durations of the source’s completed
+ * dispatches, which show how long its slowest dispatches take. They are
+ * calculated from a log-bucketed histogram of the durations, so are accurate
+ * to within about 2%.
+ *
+ * This is a constant time operation. All durations are 0 if there are no
+ * completed dispatches.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_source_get_dispatch_quantiles (DflSource   *self,
+                                   DflDuration *p50_duration,
+                                   DflDuration *p90_duration,
+                                   DflDuration *p99_duration,
+                                   DflDuration *p999_duration)
+{
+  g_return_if_fail (DFL_IS_SOURCE (self));
 
-  dfl_time_sequence_iter_init (&iter, &self->dispatch_events, 0);
+  if (p50_duration != NULL)
+    *p50_duration = _dfl_duration_statistics_get_standard_quantile (&self->dispatch_durations,
+                                                                    DFL_DURATION_QUANTILE_P50);
+  if (p90_duration != NULL)
+    *p90_duration = _dfl_duration_statistics_get_standard_quantile (&self->dispatch_durations,
+                                                                    DFL_DURATION_QUANTILE_P90);
+  if (p99_duration != NULL)
+    *p99_duration = _dfl_duration_statistics_get_standard_quantile (&self->dispatch_durations,
+                                                                    DFL_DURATION_QUANTILE_P99);
+  if (p999_duration != NULL)
+    *p999_duration = _dfl_duration_statistics_get_standard_quantile (&self->dispatch_durations,
+                                                                     DFL_DURATION_QUANTILE_P999);
+}
 
-  while (dfl_time_sequence_iter_next (&iter, NULL, (gpointer *) &dispatch_data))
-    g_array_append_val (durations, dispatch_data->duration);
+/**
+ * dfl_source_dup_dispatch_histogram:
+ * @self: a #DflSource
+ *
+ * Get a histogram of the durations of the source’s completed dispatches. The
+ * histogram is a copy, so is not updated if more dispatches are added to the
+ * source.
+ *
+ * Returns: (transfer full): a new histogram of the dispatch durations
+ * Since: UNRELEASED
+ */
+DflHistogram *
+dfl_source_dup_dispatch_histogram (DflSource *self)
+{
+  g_return_val_if_fail (DFL_IS_SOURCE (self), NULL);
 
-  g_array_sort (durations, compare_durations);
+  return _dfl_histogram_new_from_statistics (&self->dispatch_durations);
+}
 
-  /* Calculate the aggregates. */
-  if (min_duration != NULL)
-    *min_duration = g_array_index (durations, DflDuration, 0);
+/* Get the source’s dispatch duration summary without copying it, so that it
+ * can be aggregated with others. */
+const DflDurationStatistics *
+_dfl_source_get_dispatch_durations (DflSource *self)
+{
+  return &self->dispatch_durations;
+}
 
-  if (max_duration != NULL)
-    *max_duration = g_array_index (durations, DflDuration, durations->len - 1);
+/**
+ * dfl_source_get_total_dispatch_duration:
+ * @self: a #DflSource
+ *
+ * Get the total time spent in the source’s completed dispatches.
+ *
+ * Returns: sum of the dispatch durations, in microseconds
+ * Since: UNRELEASED
+ */
+DflDuration
+dfl_source_get_total_dispatch_duration (DflSource *self)
+{
+  g_return_val_if_fail (DFL_IS_SOURCE (self), 0);
 
-  if (median_duration != NULL)
-    {
-      if ((durations->len % 2) == 0)
-        *median_duration = (g_array_index (durations, DflDuration, durations->len / 2) +
-                            g_array_index (durations, DflDuration, durations->len / 2 + 1)) / 2;
-      else
-        *median_duration = g_array_index (durations, DflDuration, durations->len / 2);
-    }
+  return self->dispatch_durations.sum;
 }
 
 /**
@@ -23,6 +23,7 @@
 #include <glib-object.h>
 
 #include "event-sequence.h"
+#include "histogram.h"
 #include "time-sequence.h"
 
 G_BEGIN_DECLS
@@ -64,6 +65,26 @@ DflSource *dfl_source_new (DflId        id,
 
 GPtrArray *dfl_source_factory_from_event_sequence (DflEventSequence *sequence);
 
+/**
+ * DflDispatch:
+ * @source: (transfer none): the source which was dispatched
+ * @timestamp: time the dispatch started
+ * @duration: duration of the dispatch, in microseconds, or negative if it had
+ *    not finished by the end of the log
+ *
+ * A single dispatch of a #DflSource, as returned by
+ * dfl_model_dup_longest_dispatches() (which only returns completed
+ * dispatches) or dfl_main_context_get_source_dispatches().
+ *
+ * Since: UNRELEASED
+ */
+typedef struct
+{
+  DflSource *source;  /* unowned */
+  DflTimestamp timestamp;
+  DflDuration duration;
+} DflDispatch;
+
 DflId dfl_source_get_id (DflSource *self);
 const gchar *dfl_source_get_name (DflSource *self);
 
@@ -79,9 +100,22 @@ DflId dfl_source_get_attach_main_context_id (DflSource *self);
 
 DflThreadId dfl_source_get_new_thread_id (DflSource *self);
 
-void dfl_source_dispatch_iter (DflSource           *self,
-                               DflTimeSequenceIter *iter,
-                               DflTimestamp         start);
+void dfl_source_dispatch_iter             (DflSource           *self,
+                                           DflTimeSequenceIter *iter,
+                                           DflTimestamp         start);
+void dfl_source_dispatch_iter_range       (DflSource           *self,
+                                           DflTimeSequenceIter *iter,
+                                           DflTimestamp         start,
+                                           DflTimestamp         end);
+void dfl_source_dispatch_iter_overlapping (DflSource           *self,
+                                           DflTimeSequenceIter *iter,
+                                           DflTimestamp         start,
+                                           DflTimestamp         end);
+
+GArray *dfl_source_dup_dispatch_summary (DflSource    *self,
+                                         DflTimestamp  start,
+                                         DflTimestamp  end,
+                                         DflDuration   resolution);
 
 gsize dfl_source_get_n_long_dispatches (DflSource   *self,
                                         DflDuration  min_duration);
@@ -91,6 +125,13 @@ void dfl_source_get_dispatch_statistics (DflSource   *self,
                                          DflDuration *min_duration,
                                          DflDuration *median_duration,
                                          DflDuration *max_duration);
+void dfl_source_get_dispatch_quantiles (DflSource   *self,
+                                        DflDuration *p50_duration,
+                                        DflDuration *p90_duration,
+                                        DflDuration *p99_duration,
+                                        DflDuration *p999_duration);
+DflDuration dfl_source_get_total_dispatch_duration (DflSource *self);
+DflHistogram *dfl_source_dup_dispatch_histogram (DflSource *self);
 
 void dfl_source_get_priority_statistics (DflSource   *self,
                                          gint        *min_priority,
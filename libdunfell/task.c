@@ -641,6 +641,7 @@ dfl_task_new (DflId        id,
 
 
 #include "event-sequence.h"
+#include "factory-private.h"
 
 static void
 task_set_source_tag_cb (DflEventSequence *sequence,
@@ -761,12 +762,26 @@ task_after_run_in_thread_cb (DflEventSequence *sequence,
   task->run_in_thread_cancelled = dfl_event_get_parameter_id (event, 1);
 }
 
+typedef struct
+{
+  GPtrArray/*<owned DflTask>*/ *tasks;  /* owned */
+  DflIdentityIndex *index;  /* owned */
+} TaskFactory;
+
+static void
+task_factory_free (TaskFactory *factory)
+{
+  _dfl_identity_index_unref (factory->index);
+  g_ptr_array_unref (factory->tasks);
+  g_free (factory);
+}
+
 static void
 task_new_cb (DflEventSequence *sequence,
              DflEvent         *event,
              gpointer          user_data)
 {
-  GPtrArray/*<owned DflTask>*/ *tasks = user_data;
+  TaskFactory *factory = user_data;
   DflTask *task = NULL;
   DflId task_id;
 
@@ -809,7 +824,9 @@ task_new_cb (DflEventSequence *sequence,
 
   dfl_event_sequence_end_walker_group (sequence, "g_task_propagate", task_id);
 
-  g_ptr_array_add (tasks, task);  /* transfer */
+  _dfl_identity_index_insert (factory->index, task_id,
+                              dfl_event_get_timestamp (event), task);
+  g_ptr_array_add (factory->tasks, task);  /* transfer */
 }
 
 /**
@@ -825,15 +842,27 @@ task_new_cb (DflEventSequence *sequence,
 GPtrArray *
 dfl_task_factory_from_event_sequence (DflEventSequence *sequence)
 {
-  GPtrArray/*<owned DflTask>*/ *tasks = NULL;
+  return _dfl_task_factory_from_event_sequence (sequence, NULL);
+}
+
+GPtrArray *
+_dfl_task_factory_from_event_sequence (DflEventSequence  *sequence,
+                                       DflIdentityIndex **index_out)
+{
+  TaskFactory *factory = NULL;
+
+  factory = g_new0 (TaskFactory, 1);
+  factory->tasks = g_ptr_array_new_with_free_func (g_object_unref);
+  factory->index = _dfl_identity_index_new ();
+
+  if (index_out != NULL)
+    *index_out = _dfl_identity_index_ref (factory->index);
 
-  tasks = g_ptr_array_new_with_free_func (g_object_unref);
   dfl_event_sequence_add_walker (sequence, "g_task_new", DFL_ID_INVALID,
-                                 task_new_cb,
-                                 g_ptr_array_ref (tasks),
-                                 (GDestroyNotify) g_ptr_array_unref);
+                                 task_new_cb, factory,
+                                 (GDestroyNotify) task_factory_free);
 
-  return tasks;
+  return g_ptr_array_ref (factory->tasks);
 }
 
 /**
@@ -91,17 +91,27 @@ static void
 test_event_sequence_single (void)
 {
   DflEventSequence *sequence = NULL;
-  DflEvent *event = NULL;
+  DflEvent *event = NULL, *item = NULL;
+  const gchar *parameters[] = { "1", "2", NULL };
 
-  event = g_object_new (DFL_TYPE_EVENT, NULL);
+  event = dfl_event_new ("type_a", 123457, 5, parameters);
   sequence = dfl_event_sequence_new ((const DflEvent **) &event, 1, 123456);
   g_object_unref (event);
 
   g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==, 1);
-  g_assert (g_list_model_get_item (G_LIST_MODEL (sequence), 0) == event);
-  g_assert (DFL_IS_EVENT (g_list_model_get_item (G_LIST_MODEL (sequence), 0)));
-  g_assert (g_list_model_get_item (G_LIST_MODEL (sequence), 0) ==
-            g_list_model_get_object (G_LIST_MODEL (sequence), 0));
+
+  /* Events are created on demand, so the item will not be the same object as
+   * the original event, but should be equal to it. */
+  item = g_list_model_get_item (G_LIST_MODEL (sequence), 0);
+  g_assert (DFL_IS_EVENT (item));
+  g_assert (dfl_event_get_event_type (item) == g_intern_static_string ("type_a"));
+  g_assert_cmpuint (dfl_event_get_timestamp (item), ==, 123457);
+  g_assert_cmpuint (dfl_event_get_thread_id (item), ==, 5);
+  g_assert_cmpuint (dfl_event_get_n_parameters (item), ==, 2);
+  g_assert_cmpuint (dfl_event_get_parameter_id (item, 0), ==, 1);
+  g_assert_cmpstr (dfl_event_get_parameter_utf8 (item, 1), ==, "2");
+  g_object_unref (item);
+
   g_assert_null (g_list_model_get_item (G_LIST_MODEL (sequence), 1));
   g_assert_cmpuint (g_list_model_get_item_type (G_LIST_MODEL (sequence)), ==,
                     DFL_TYPE_EVENT);
@@ -294,6 +304,235 @@ test_event_sequence_walk_empty_group (void)
   g_object_unref (sequence);
 }
 
+static void
+walker_add_group (DflEventSequence *sequence,
+                  DflEvent         *event,
+                  gpointer          user_data)
+{
+  DflId id = dfl_event_get_parameter_id (event, 0);
+
+  /* This walker must not match the current event. */
+  dfl_event_sequence_start_walker_group (sequence);
+  dfl_event_sequence_add_walker (sequence, "new", id,
+                                 walker_not_reached, NULL, NULL);
+  dfl_event_sequence_add_walker (sequence, "use", id,
+                                 walker_count, user_data, NULL);
+  dfl_event_sequence_end_walker_group (sequence, "free", id);
+}
+
+/* Test that lots of walker groups can be added and removed during a walk, and
+ * that each group only matches the events between its creation and removal,
+ * even when IDs are reused. */
+static void
+test_event_sequence_walk_many_groups (void)
+{
+  DflEventSequence *sequence = NULL;
+  EventVector *vectors = NULL;
+  const gsize n_objects = 1000;
+  gsize i;
+  guint counter = 0;
+
+  vectors = g_new0 (EventVector, n_objects * 4);
+
+  for (i = 0; i < n_objects; i++)
+    {
+      /* Alternate between two IDs so that they are reused. */
+      DflId id = 1 + (i % 2);
+
+      vectors[i * 4 + 0].event_type = "new";
+      vectors[i * 4 + 0].id = id;
+      vectors[i * 4 + 1].event_type = "use";
+      vectors[i * 4 + 1].id = id;
+      vectors[i * 4 + 2].event_type = "use";
+      vectors[i * 4 + 2].id = id;
+      vectors[i * 4 + 3].event_type = "free";
+      vectors[i * 4 + 3].id = id;
+    }
+
+  sequence = event_sequence_from_vectors (vectors, n_objects * 4);
+  dfl_event_sequence_add_walker (sequence, "new", DFL_ID_INVALID,
+                                 walker_add_group, &counter, NULL);
+  dfl_event_sequence_walk (sequence);
+  g_object_unref (sequence);
+
+  g_assert_cmpuint (counter, ==, n_objects * 2);
+
+  g_free (vectors);
+}
+
+static void
+walker_append_label (DflEventSequence *sequence,
+                     DflEvent         *event,
+                     gpointer          user_data)
+{
+  GString *order = g_object_get_data (G_OBJECT (sequence), "order");
+
+  g_string_append (order, user_data);
+}
+
+/* Test that the walkers matching an event are called in the order they were
+ * added, regardless of whether they match any event, an event type, or an
+ * event type and ID. */
+static void
+test_event_sequence_walk_order (void)
+{
+  DflEventSequence *sequence = NULL;
+  const EventVector vectors[] = {
+    { "type_a", 1 },
+    { "type_b", 1 },
+  };
+  GString *order = NULL;
+
+  sequence = event_sequence_from_vectors (vectors, G_N_ELEMENTS (vectors));
+  order = g_string_new ("");
+  g_object_set_data (G_OBJECT (sequence), "order", order);
+
+  dfl_event_sequence_add_walker (sequence, "type_a", 1,
+                                 walker_append_label, (gpointer) "1", NULL);
+  dfl_event_sequence_add_walker (sequence, NULL, DFL_ID_INVALID,
+                                 walker_append_label, (gpointer) "2", NULL);
+  dfl_event_sequence_add_walker (sequence, "type_a", DFL_ID_INVALID,
+                                 walker_append_label, (gpointer) "3", NULL);
+  dfl_event_sequence_add_walker (sequence, "type_b", DFL_ID_INVALID,
+                                 walker_append_label, (gpointer) "4", NULL);
+  dfl_event_sequence_add_walker (sequence, "type_a", 1,
+                                 walker_append_label, (gpointer) "5", NULL);
+  dfl_event_sequence_add_walker (sequence, NULL, DFL_ID_INVALID,
+                                 walker_append_label, (gpointer) "6", NULL);
+  dfl_event_sequence_walk (sequence);
+
+  g_assert_cmpstr (order->str, ==, "12356" "246");
+
+  g_object_unref (sequence);
+  g_string_free (order, TRUE);
+}
+
+/* Test that walker IDs are not reused after a walker is removed, so removing a
+ * walker by a stale ID cannot remove a different one. */
+static void
+test_event_sequence_walker_ids_unique (void)
+{
+  DflEventSequence *sequence = NULL;
+  const EventVector vectors[] = {
+    { "type_a", 1 },
+  };
+  guint walker_id1, walker_id2;
+  guint counter = 0;
+
+  sequence = event_sequence_from_vectors (vectors, G_N_ELEMENTS (vectors));
+
+  walker_id1 = dfl_event_sequence_add_walker (sequence, "type_a",
+                                              DFL_ID_INVALID,
+                                              walker_not_reached, NULL, NULL);
+  dfl_event_sequence_remove_walker (sequence, walker_id1);
+
+  /* Walk so that the removed walker is purged from the index. */
+  dfl_event_sequence_walk (sequence);
+
+  walker_id2 = dfl_event_sequence_add_walker (sequence, "type_a",
+                                              DFL_ID_INVALID,
+                                              walker_count, &counter, NULL);
+  g_assert_cmpuint (walker_id2, !=, walker_id1);
+
+  g_object_unref (sequence);
+}
+
+typedef struct
+{
+  guint n_used;
+  guint n_destroyed;
+} GroupCounts;
+
+static void
+walker_count_used (DflEventSequence *sequence,
+                   DflEvent         *event,
+                   gpointer          user_data)
+{
+  GroupCounts *counts = user_data;
+
+  counts->n_used++;
+}
+
+static void
+group_counts_destroy (gpointer user_data)
+{
+  GroupCounts *counts = user_data;
+
+  counts->n_destroyed++;
+}
+
+static void
+walker_add_counted_group (DflEventSequence *sequence,
+                          DflEvent         *event,
+                          gpointer          user_data)
+{
+  DflId id = dfl_event_get_parameter_id (event, 0);
+
+  dfl_event_sequence_start_walker_group (sequence);
+  dfl_event_sequence_add_walker (sequence, "use", id,
+                                 walker_count_used, user_data,
+                                 group_counts_destroy);
+  dfl_event_sequence_end_walker_group (sequence, "free", id);
+}
+
+/* Test that the walkers in a group are freed when the group ends, rather than
+ * when the sequence is destroyed. */
+static void
+test_event_sequence_walk_group_freed (void)
+{
+  DflEventSequence *sequence = NULL;
+  const EventVector vectors[] = {
+    { "new", 1 },
+    { "use", 1 },
+    { "free", 1 },
+    { "new", 1 },
+    { "use", 1 },
+    { "free", 1 },
+    { "use", 1 },
+  };
+  GroupCounts counts = { 0, 0 };
+
+  sequence = event_sequence_from_vectors (vectors, G_N_ELEMENTS (vectors));
+  dfl_event_sequence_add_walker (sequence, "new", DFL_ID_INVALID,
+                                 walker_add_counted_group, &counts, NULL);
+  dfl_event_sequence_walk (sequence);
+
+  g_assert_cmpuint (counts.n_used, ==, 2);
+  g_assert_cmpuint (counts.n_destroyed, ==, 2);
+
+  g_object_unref (sequence);
+
+  g_assert_cmpuint (counts.n_destroyed, ==, 2);
+}
+
+/* Test that each walk passes the whole sequence to the walkers, including
+ * walkers which were added after a previous walk. */
+static void
+test_event_sequence_walk_repeated (void)
+{
+  DflEventSequence *sequence = NULL;
+  const EventVector vectors[] = {
+    { "type_a", 1 },
+    { "type_b", 2 },
+  };
+  guint counter1 = 0, counter2 = 0;
+
+  sequence = event_sequence_from_vectors (vectors, G_N_ELEMENTS (vectors));
+  dfl_event_sequence_add_walker (sequence, NULL, DFL_ID_INVALID,
+                                 walker_count, &counter1, NULL);
+  dfl_event_sequence_walk (sequence);
+
+  g_assert_cmpuint (counter1, ==, 2);
+
+  dfl_event_sequence_add_walker (sequence, NULL, DFL_ID_INVALID,
+                                 walker_count, &counter2, NULL);
+  dfl_event_sequence_walk (sequence);
+  g_object_unref (sequence);
+
+  g_assert_cmpuint (counter1, ==, 4);
+  g_assert_cmpuint (counter2, ==, 2);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -317,6 +556,16 @@ main (int argc, char *argv[])
                    test_event_sequence_walk_remove_group_then_id_reuse);
   g_test_add_func ("/event-sequence/walk/empty-group",
                    test_event_sequence_walk_empty_group);
+  g_test_add_func ("/event-sequence/walk/many-groups",
+                   test_event_sequence_walk_many_groups);
+  g_test_add_func ("/event-sequence/walk/group-freed",
+                   test_event_sequence_walk_group_freed);
+  g_test_add_func ("/event-sequence/walk/repeated",
+                   test_event_sequence_walk_repeated);
+  g_test_add_func ("/event-sequence/walk/order",
+                   test_event_sequence_walk_order);
+  g_test_add_func ("/event-sequence/walker-ids-unique",
+                   test_event_sequence_walker_ids_unique);
 
   return g_test_run ();
 }
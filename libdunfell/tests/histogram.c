@@ -0,0 +1,151 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2015 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <locale.h>
+
+#include "histogram.h"
+
+
+/* Test the properties of a newly constructed, empty #DflHistogram. */
+static void
+test_histogram_construction (void)
+{
+  DflHistogram *histogram = NULL;
+
+  histogram = dfl_histogram_new ();
+
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 0);
+  g_assert_cmpint (dfl_histogram_get_min (histogram), ==, 0);
+  g_assert_cmpint (dfl_histogram_get_max (histogram), ==, 0);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram), ==, 0);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.5), ==, 0);
+  g_assert_cmpuint (dfl_histogram_get_n_buckets (histogram), ==, 0);
+
+  g_object_unref (histogram);
+}
+
+/* Test that the buckets of a histogram cover the added durations, in order,
+ * and that quantiles are within the documented error. */
+static void
+test_histogram_buckets (void)
+{
+  DflHistogram *histogram = NULL;
+  DflDuration i, previous_upper;
+  guint j;
+  guint64 total_count;
+
+  histogram = dfl_histogram_new ();
+
+  for (i = 1; i <= 10000; i++)
+    dfl_histogram_add (histogram, i);
+
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 10000);
+  g_assert_cmpint (dfl_histogram_get_min (histogram), ==, 1);
+  g_assert_cmpint (dfl_histogram_get_max (histogram), ==, 10000);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram), ==, 10000 * 10001 / 2);
+
+  /* Small durations are counted exactly. */
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.001), ==, 10);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.5), >=, 4900);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.5), <=, 5100);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.99), >=, 9700);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 0.99), <=, 10000);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram, 1.0), ==, 10000);
+
+  total_count = 0;
+  previous_upper = 0;
+
+  for (j = 0; j < dfl_histogram_get_n_buckets (histogram); j++)
+    {
+      DflDuration lower, upper;
+      guint64 count;
+
+      dfl_histogram_get_bucket (histogram, j, &lower, &upper, &count);
+
+      g_assert_cmpint (lower, <=, upper);
+      g_assert_cmpint (lower, >, previous_upper);
+      /* Each duration was added once, and only the last bucket extends
+       * beyond the longest duration. */
+      if (j + 1 < dfl_histogram_get_n_buckets (histogram))
+        g_assert_cmpuint (count, ==, upper - lower + 1);
+      else
+        g_assert_cmpuint (count, <=, upper - lower + 1);
+
+      total_count += count;
+      previous_upper = upper;
+    }
+
+  g_assert_cmpuint (total_count, ==, 10000);
+
+  g_object_unref (histogram);
+}
+
+/* Test that merging histograms aggregates their durations, and leaves the
+ * merged histogram unchanged. */
+static void
+test_histogram_merge (void)
+{
+  DflHistogram *histogram1 = NULL, *histogram2 = NULL, *empty = NULL;
+
+  histogram1 = dfl_histogram_new ();
+  histogram2 = dfl_histogram_new ();
+  empty = dfl_histogram_new ();
+
+  dfl_histogram_add (histogram1, 5);
+  dfl_histogram_add (histogram1, 10);
+  dfl_histogram_add (histogram2, 100000);
+  dfl_histogram_add (histogram2, 2);
+
+  dfl_histogram_merge (histogram1, histogram2);
+  dfl_histogram_merge (histogram1, empty);
+
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram1), ==, 4);
+  g_assert_cmpint (dfl_histogram_get_min (histogram1), ==, 2);
+  g_assert_cmpint (dfl_histogram_get_max (histogram1), ==, 100000);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram1), ==, 100017);
+  g_assert_cmpint (dfl_histogram_get_quantile (histogram1, 0.5), ==, 5);
+
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram2), ==, 2);
+  g_assert_cmpint (dfl_histogram_get_min (histogram2), ==, 2);
+
+  /* Merging into an empty histogram copies the other. */
+  dfl_histogram_merge (empty, histogram2);
+  g_assert_cmpuint (dfl_histogram_get_n_durations (empty), ==, 2);
+  g_assert_cmpint (dfl_histogram_get_max (empty), ==, 100000);
+  g_assert_cmpuint (dfl_histogram_get_n_buckets (empty), ==,
+                    dfl_histogram_get_n_buckets (histogram2));
+
+  g_object_unref (empty);
+  g_object_unref (histogram2);
+  g_object_unref (histogram1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/histogram/construction", test_histogram_construction);
+  g_test_add_func ("/histogram/buckets", test_histogram_buckets);
+  g_test_add_func ("/histogram/merge", test_histogram_merge);
+
+  return g_test_run ();
+}
@@ -17,10 +17,14 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <locale.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "model.h"
 #include "parser.h"
+#include "thread.h"
 
 
 typedef struct
@@ -64,6 +68,1534 @@ test_parser_log (gconstpointer data)
   g_object_unref (parser);
 }
 
+/* Test that loading the log files using a stream gives the same results. */
+static void
+test_parser_log_stream (gconstpointer data)
+{
+  const LogTestVector *vector = data;
+  DflParser *parser = NULL;
+  GInputStream *stream = NULL;
+  DflEventSequence *sequence;
+  GError *error = NULL;
+
+  parser = dfl_parser_new ();
+  stream = g_memory_input_stream_new_from_data (vector->log, -1, NULL);
+
+  dfl_parser_load_from_stream (parser, stream, NULL, &error);
+  g_assert_no_error (error);
+
+  sequence = dfl_parser_get_event_sequence (parser);
+  g_assert_nonnull (sequence);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==,
+                    vector->n_events_expected);
+
+  g_object_unref (stream);
+  g_object_unref (parser);
+}
+
+/* Test that loading the log files from disk (which maps them) gives the same
+ * results. */
+static void
+test_parser_log_file (gconstpointer data)
+{
+  const LogTestVector *vector = data;
+  DflParser *parser = NULL;
+  DflEventSequence *sequence;
+  gchar *filename = NULL;
+  gint fd;
+  GError *error = NULL;
+
+  fd = g_file_open_tmp ("dunfell-parser-test-XXXXXX.log", &filename, &error);
+  g_assert_no_error (error);
+  close (fd);
+
+  g_file_set_contents (filename, vector->log, -1, &error);
+  g_assert_no_error (error);
+
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_file (parser, filename, &error);
+  g_assert_no_error (error);
+
+  sequence = dfl_parser_get_event_sequence (parser);
+  g_assert_nonnull (sequence);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==,
+                    vector->n_events_expected);
+
+  g_object_unref (parser);
+
+  g_unlink (filename);
+  g_free (filename);
+}
+
+/* The events in each block of a large log, covering every event type. In the
+ * parameters, ‘C’, ‘S’, ‘K’ and ‘T’ are replaced by the IDs of the block’s
+ * main context, source, child source and task. */
+static const struct
+{
+  const gchar *event_type;
+  const gchar *parameters;
+} large_log_block[] = {
+  { "g_main_context_new", "C" },
+  { "g_source_new", "S,a,b,c,d,0" },
+  { "g_source_new", "K,a,b,c,d,0" },
+  { "g_source_set_name", "S,name" },
+  { "g_source_add_child_source", "S,K" },
+  { "g_source_attach", "S,C,0" },
+  { "g_main_context_acquire", "C,1" },
+  { "g_main_context_before_dispatch", "C" },
+  { "g_source_before_dispatch", "S,a,b,1" },
+  { "g_source_after_dispatch", "S,a,1" },
+  { "g_main_context_after_dispatch", "C" },
+  { "g_main_context_release", "C" },
+  { "g_task_new", "T,1,0,callback,0" },
+  { "g_task_set_source_tag", "T,tag" },
+  { "g_task_before_run_in_thread", "T,func" },
+  { "g_task_after_run_in_thread", "T,0" },
+  { "g_task_before_return", "T,1,callback,0" },
+  { "g_task_propagate", "T,0" },
+  { "g_thread_spawned", "func,1,name" },
+  { "g_source_destroy", "S,C" },
+  { "g_source_before_free", "K,C,a" },
+  { "g_source_before_free", "S,C,a" },
+  { "g_main_context_free", "C" },
+};
+
+/* Thread which the @i-th event in a large log happens on. Each block happens
+ * on a single thread, and consecutive blocks are on different threads. */
+static guint
+large_log_thread_id (guint i)
+{
+  return 1 + (i / G_N_ELEMENTS (large_log_block)) % 4;
+}
+
+/* Build a log file large enough to be parsed and analysed in parallel, made of
+ * blocks of events which use every event type, with the blocks spread between
+ * several threads. If @break_monotonicity is %TRUE, the last event goes back
+ * in time for its thread. */
+static gchar *
+build_large_log (guint    n_events,
+                 gboolean break_monotonicity)
+{
+  GString *log = NULL;
+  guint i;
+
+  log = g_string_new ("Dunfell log,1.0,100\n");
+
+  for (i = 0; i < n_events; i++)
+    {
+      guint64 timestamp = 100 + i;
+      guint block = i / G_N_ELEMENTS (large_log_block);
+      gchar **parameters = NULL;
+      guint j;
+
+      if (break_monotonicity && i == n_events - 1)
+        timestamp = 101;
+
+      g_string_append_printf (log, "%s,%" G_GUINT64_FORMAT ",%u",
+                              large_log_block[i % G_N_ELEMENTS (large_log_block)].event_type,
+                              timestamp, large_log_thread_id (i));
+
+      /* Each block has its own IDs, so the objects in different blocks are
+       * independent. */
+      parameters = g_strsplit (large_log_block[i % G_N_ELEMENTS (large_log_block)].parameters,
+                               ",", -1);
+
+      for (j = 0; parameters[j] != NULL; j++)
+        {
+          const gchar *id_types = "CSKT";
+          const gchar *id_type = NULL;
+
+          if (strlen (parameters[j]) == 1)
+            id_type = strchr (id_types, parameters[j][0]);
+
+          if (id_type != NULL)
+            g_string_append_printf (log, ",%u",
+                                    16 * (block + 1) +
+                                    (guint) (id_type - id_types));
+          else
+            g_string_append_printf (log, ",%s", parameters[j]);
+        }
+
+      g_strfreev (parameters);
+      g_string_append_c (log, '\n');
+    }
+
+  return g_string_free (log, FALSE);
+}
+
+/* Test that parsing a large log (which happens in parallel) loads all the
+ * events in order. */
+static void
+test_parser_large (void)
+{
+  DflParser *parser = NULL;
+  DflEventSequence *sequence;
+  gchar *log = NULL;
+  const guint n_events = 200000;
+  guint i;
+  GError *error = NULL;
+
+  log = build_large_log (n_events, FALSE);
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_no_error (error);
+
+  sequence = dfl_parser_get_event_sequence (parser);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==,
+                    n_events);
+
+  for (i = 0; i < n_events; i++)
+    {
+      DflEvent *event;
+
+      event = g_list_model_get_item (G_LIST_MODEL (sequence), i);
+      g_assert_cmpuint (dfl_event_get_timestamp (event), ==, 100 + i);
+      g_assert_cmpuint (dfl_event_get_thread_id (event), ==,
+                        large_log_thread_id (i));
+      g_object_unref (event);
+    }
+
+  g_object_unref (parser);
+  g_free (log);
+}
+
+/* Test that a timestamp going backwards is detected in a large log, even if
+ * the previous event for that thread was parsed in a different chunk. */
+static void
+test_parser_large_non_monotonic (void)
+{
+  DflParser *parser = NULL;
+  gchar *log = NULL;
+  GError *error = NULL;
+
+  log = build_large_log (200000, TRUE);
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN);
+  g_assert_null (dfl_parser_get_event_sequence (parser));
+
+  g_error_free (error);
+  g_object_unref (parser);
+  g_free (log);
+}
+
+/* Parse @log and analyse it into a new model, asserting that both succeed. The
+ * model keeps the event sequence alive, so the parser is not returned. */
+static DflModel *
+load_model_from_bytes (const gchar *log)
+{
+  DflParser *parser = NULL;
+  DflModel *model = NULL;
+  GError *error = NULL;
+
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_no_error (error);
+
+  model = dfl_model_new (dfl_parser_get_event_sequence (parser));
+  g_object_unref (parser);
+
+  return model;
+}
+
+/* Check that two main contexts from equal models have the same dispatches, and
+ * the same source dispatches within each of them. */
+static void
+assert_main_contexts_equal (DflMainContext *main_context1,
+                            DflMainContext *main_context2)
+{
+  DflTimeSequenceIter iter1, iter2;
+  DflTimestamp timestamp1, timestamp2;
+  DflMainContextDispatchData *data1, *data2;
+
+  g_assert_cmpuint (dfl_main_context_get_id (main_context1), ==,
+                    dfl_main_context_get_id (main_context2));
+  g_assert_cmpuint (dfl_main_context_get_new_timestamp (main_context1), ==,
+                    dfl_main_context_get_new_timestamp (main_context2));
+  g_assert_cmpuint (dfl_main_context_get_free_timestamp (main_context1), ==,
+                    dfl_main_context_get_free_timestamp (main_context2));
+  g_assert_cmpuint (dfl_main_context_get_n_thread_switches (main_context1), ==,
+                    dfl_main_context_get_n_thread_switches (main_context2));
+
+  dfl_main_context_dispatch_iter (main_context1, &iter1, 0);
+  dfl_main_context_dispatch_iter (main_context2, &iter2, 0);
+
+  while (dfl_time_sequence_iter_next (&iter1, &timestamp1, (gpointer *) &data1))
+    {
+      const DflDispatch *dispatches1, *dispatches2;
+      guint n_dispatches1, n_dispatches2, i;
+
+      g_assert_true (dfl_time_sequence_iter_next (&iter2, &timestamp2,
+                                                  (gpointer *) &data2));
+      g_assert_cmpuint (timestamp1, ==, timestamp2);
+      g_assert_cmpuint (data1->thread_id, ==, data2->thread_id);
+      g_assert_cmpint (data1->duration, ==, data2->duration);
+
+      dispatches1 = dfl_main_context_get_source_dispatches (main_context1,
+                                                            data1,
+                                                            &n_dispatches1);
+      dispatches2 = dfl_main_context_get_source_dispatches (main_context2,
+                                                            data2,
+                                                            &n_dispatches2);
+      g_assert_cmpuint (n_dispatches1, ==, n_dispatches2);
+
+      for (i = 0; i < n_dispatches1; i++)
+        {
+          g_assert_cmpuint (dfl_source_get_id (dispatches1[i].source), ==,
+                            dfl_source_get_id (dispatches2[i].source));
+          g_assert_cmpuint (dispatches1[i].timestamp, ==,
+                            dispatches2[i].timestamp);
+          g_assert_cmpint (dispatches1[i].duration, ==,
+                           dispatches2[i].duration);
+        }
+    }
+
+  g_assert_false (dfl_time_sequence_iter_next (&iter2, NULL, NULL));
+}
+
+/* Check that two sources from equal models have the same properties and
+ * dispatches. */
+static void
+assert_sources_equal (DflSource *source1,
+                      DflSource *source2)
+{
+  DflTimeSequenceIter iter1, iter2;
+  DflTimestamp timestamp1, timestamp2;
+  DflSourceDispatchData *data1, *data2;
+  gsize n_dispatches1, n_dispatches2;
+  DflDuration min1, min2, median1, median2, max1, max2;
+
+  g_assert_cmpuint (dfl_source_get_id (source1), ==,
+                    dfl_source_get_id (source2));
+  g_assert_cmpstr (dfl_source_get_name (source1), ==,
+                   dfl_source_get_name (source2));
+  g_assert_cmpuint (dfl_source_get_new_timestamp (source1), ==,
+                    dfl_source_get_new_timestamp (source2));
+  g_assert_cmpuint (dfl_source_get_free_timestamp (source1), ==,
+                    dfl_source_get_free_timestamp (source2));
+  g_assert_cmpuint (dfl_source_get_attach_main_context_id (source1), ==,
+                    dfl_source_get_attach_main_context_id (source2));
+  g_assert_cmpuint (dfl_source_get_attach_timestamp (source1), ==,
+                    dfl_source_get_attach_timestamp (source2));
+  g_assert_cmpuint (dfl_source_get_destroy_timestamp (source1), ==,
+                    dfl_source_get_destroy_timestamp (source2));
+  g_assert_cmpuint (dfl_source_get_children (source1)->len, ==,
+                    dfl_source_get_children (source2)->len);
+
+  dfl_source_get_dispatch_statistics (source1, &n_dispatches1, &min1,
+                                      &median1, &max1);
+  dfl_source_get_dispatch_statistics (source2, &n_dispatches2, &min2,
+                                      &median2, &max2);
+  g_assert_cmpuint (n_dispatches1, ==, n_dispatches2);
+  g_assert_cmpint (min1, ==, min2);
+  g_assert_cmpint (median1, ==, median2);
+  g_assert_cmpint (max1, ==, max2);
+
+  dfl_source_dispatch_iter (source1, &iter1, 0);
+  dfl_source_dispatch_iter (source2, &iter2, 0);
+
+  while (dfl_time_sequence_iter_next (&iter1, &timestamp1, (gpointer *) &data1))
+    {
+      g_assert_true (dfl_time_sequence_iter_next (&iter2, &timestamp2,
+                                                  (gpointer *) &data2));
+      g_assert_cmpuint (timestamp1, ==, timestamp2);
+      g_assert_cmpuint (data1->thread_id, ==, data2->thread_id);
+      g_assert_cmpint (data1->duration, ==, data2->duration);
+    }
+
+  g_assert_false (dfl_time_sequence_iter_next (&iter2, NULL, NULL));
+}
+
+/* Check that two tasks from equal models have the same properties. */
+static void
+assert_tasks_equal (DflTask *task1,
+                    DflTask *task2)
+{
+  g_assert_cmpuint (dfl_task_get_id (task1), ==, dfl_task_get_id (task2));
+  g_assert_cmpuint (dfl_task_get_new_timestamp (task1), ==,
+                    dfl_task_get_new_timestamp (task2));
+  g_assert_cmpuint (dfl_task_get_return_timestamp (task1), ==,
+                    dfl_task_get_return_timestamp (task2));
+  g_assert_cmpuint (dfl_task_get_propagate_timestamp (task1), ==,
+                    dfl_task_get_propagate_timestamp (task2));
+  g_assert_cmpuint (dfl_task_get_thread_before_timestamp (task1), ==,
+                    dfl_task_get_thread_before_timestamp (task2));
+  g_assert_cmpuint (dfl_task_get_thread_after_timestamp (task1), ==,
+                    dfl_task_get_thread_after_timestamp (task2));
+  g_assert_cmpstr (dfl_task_get_source_tag_name (task1), ==,
+                   dfl_task_get_source_tag_name (task2));
+}
+
+/* Check that two models built from the same log have the same threads, main
+ * contexts (including their dispatches), sources and tasks. */
+static void
+assert_models_equal (DflModel *model1,
+                     DflModel *model2)
+{
+  GPtrArray/*<DflThread>*/ *threads1 = NULL, *threads2 = NULL;
+  GPtrArray/*<DflMainContext>*/ *main_contexts1 = NULL, *main_contexts2 = NULL;
+  GPtrArray/*<DflSource>*/ *sources1 = NULL, *sources2 = NULL;
+  GPtrArray/*<DflTask>*/ *tasks1 = NULL, *tasks2 = NULL;
+  guint i;
+
+  threads1 = dfl_model_dup_threads (model1);
+  threads2 = dfl_model_dup_threads (model2);
+
+  g_assert_cmpuint (threads1->len, ==, threads2->len);
+
+  for (i = 0; i < threads1->len; i++)
+    {
+      DflThread *thread1 = threads1->pdata[i];
+      DflThread *thread2 = threads2->pdata[i];
+
+      g_assert_cmpuint (dfl_thread_get_id (thread1), ==,
+                        dfl_thread_get_id (thread2));
+      g_assert_cmpuint (dfl_thread_get_new_timestamp (thread1), ==,
+                        dfl_thread_get_new_timestamp (thread2));
+      g_assert_cmpuint (dfl_thread_get_free_timestamp (thread1), ==,
+                        dfl_thread_get_free_timestamp (thread2));
+    }
+
+  main_contexts1 = dfl_model_dup_main_contexts (model1);
+  main_contexts2 = dfl_model_dup_main_contexts (model2);
+
+  g_assert_cmpuint (main_contexts1->len, ==, main_contexts2->len);
+
+  for (i = 0; i < main_contexts1->len; i++)
+    assert_main_contexts_equal (main_contexts1->pdata[i],
+                                main_contexts2->pdata[i]);
+
+  sources1 = dfl_model_dup_sources (model1);
+  sources2 = dfl_model_dup_sources (model2);
+
+  g_assert_cmpuint (sources1->len, ==, sources2->len);
+
+  for (i = 0; i < sources1->len; i++)
+    assert_sources_equal (sources1->pdata[i], sources2->pdata[i]);
+
+  tasks1 = dfl_model_dup_tasks (model1);
+  tasks2 = dfl_model_dup_tasks (model2);
+
+  g_assert_cmpuint (tasks1->len, ==, tasks2->len);
+
+  for (i = 0; i < tasks1->len; i++)
+    assert_tasks_equal (tasks1->pdata[i], tasks2->pdata[i]);
+
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model1, 0), ==,
+                    dfl_model_get_n_long_dispatches (model2, 0));
+
+  g_ptr_array_unref (tasks2);
+  g_ptr_array_unref (tasks1);
+  g_ptr_array_unref (sources2);
+  g_ptr_array_unref (sources1);
+  g_ptr_array_unref (main_contexts2);
+  g_ptr_array_unref (main_contexts1);
+  g_ptr_array_unref (threads2);
+  g_ptr_array_unref (threads1);
+}
+
+typedef struct
+{
+  GAsyncResult *result;  /* owned; nullable */
+  DflModel *model;  /* owned; nullable */
+  guint n_batches;
+  guint n_items;
+  guint n_model_updates;
+  guint64 bytes_processed;
+} StreamAsyncData;
+
+static void
+stream_async_items_changed_cb (GListModel *list,
+                               guint       position,
+                               guint       removed,
+                               guint       added,
+                               gpointer    user_data)
+{
+  StreamAsyncData *data = user_data;
+
+  /* Events must only ever be appended. */
+  g_assert_cmpuint (position, ==, data->n_items);
+  g_assert_cmpuint (removed, ==, 0);
+  g_assert_cmpuint (added, >, 0);
+
+  data->n_items += added;
+  data->n_batches++;
+}
+
+static void
+stream_async_model_updated_cb (DflModel *model,
+                               gpointer  user_data)
+{
+  StreamAsyncData *data = user_data;
+
+  data->n_model_updates++;
+}
+
+static void
+stream_async_notify_event_sequence_cb (GObject    *object,
+                                       GParamSpec *pspec,
+                                       gpointer    user_data)
+{
+  StreamAsyncData *data = user_data;
+  DflEventSequence *sequence;
+
+  /* This should only happen once, when the first batch is available. */
+  g_assert_null (data->model);
+
+  sequence = dfl_parser_get_event_sequence (DFL_PARSER (object));
+  g_assert_nonnull (sequence);
+
+  data->n_items = g_list_model_get_n_items (G_LIST_MODEL (sequence));
+  data->n_batches++;
+
+  data->model = dfl_model_new (sequence);
+  g_signal_connect (sequence, "items-changed",
+                    (GCallback) stream_async_items_changed_cb, data);
+  g_signal_connect (data->model, "updated",
+                    (GCallback) stream_async_model_updated_cb, data);
+}
+
+static void
+stream_async_notify_bytes_processed_cb (GObject    *object,
+                                        GParamSpec *pspec,
+                                        gpointer    user_data)
+{
+  StreamAsyncData *data = user_data;
+  guint64 bytes_processed;
+
+  bytes_processed = dfl_parser_get_bytes_processed (DFL_PARSER (object));
+  g_assert_cmpuint (bytes_processed, >=, data->bytes_processed);
+  data->bytes_processed = bytes_processed;
+}
+
+static void
+stream_async_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  StreamAsyncData *data = user_data;
+
+  data->result = g_object_ref (result);
+}
+
+/* Test that loading a log asynchronously delivers it in batches, and that a
+ * model built from the first batch ends up the same as one built from the
+ * whole log. */
+static void
+test_parser_stream_async (void)
+{
+  DflParser *parser = NULL;
+  DflModel *sync_model = NULL;
+  GInputStream *stream = NULL;
+  gchar *log = NULL;
+  const guint n_events = 50000;
+  StreamAsyncData data = { NULL, };
+  GError *error = NULL;
+
+  log = build_large_log (n_events, FALSE);
+  stream = g_memory_input_stream_new_from_data (log, strlen (log), NULL);
+  parser = dfl_parser_new ();
+
+  g_signal_connect (parser, "notify::event-sequence",
+                    (GCallback) stream_async_notify_event_sequence_cb, &data);
+  g_signal_connect (parser, "notify::bytes-processed",
+                    (GCallback) stream_async_notify_bytes_processed_cb, &data);
+
+  dfl_parser_load_from_stream_async (parser, stream, NULL, stream_async_cb,
+                                     &data);
+
+  while (data.result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  dfl_parser_load_from_stream_finish (parser, data.result, &error);
+  g_assert_no_error (error);
+
+  /* All the batches must have arrived before the callback. */
+  g_assert_nonnull (data.model);
+  g_assert_cmpuint (data.n_batches, >, 1);
+  g_assert_cmpuint (data.n_model_updates, ==, data.n_batches - 1);
+  g_assert_cmpuint (data.n_items, ==, n_events);
+  g_assert_cmpuint (data.bytes_processed, ==, strlen (log));
+  g_assert_cmpuint (dfl_parser_get_bytes_processed (parser), ==,
+                    strlen (log));
+
+  /* Compare against a model built from the whole log in one go. */
+  sync_model = load_model_from_bytes (log);
+  assert_models_equal (data.model, sync_model);
+
+  g_object_unref (sync_model);
+
+  g_object_unref (data.model);
+  g_object_unref (data.result);
+  g_object_unref (parser);
+  g_object_unref (stream);
+  g_free (log);
+}
+
+typedef struct
+{
+  GAsyncResult *load_result;  /* owned; nullable */
+  GAsyncResult *model_result;  /* owned; nullable */
+} ModelAsyncData;
+
+static void
+model_async_load_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  ModelAsyncData *data = user_data;
+
+  data->load_result = g_object_ref (result);
+}
+
+static void
+model_async_model_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  ModelAsyncData *data = user_data;
+
+  data->model_result = g_object_ref (result);
+}
+
+static void
+model_async_notify_event_sequence_cb (GObject    *object,
+                                      GParamSpec *pspec,
+                                      gpointer    user_data)
+{
+  ModelAsyncData *data = user_data;
+
+  dfl_model_new_async (dfl_parser_get_event_sequence (DFL_PARSER (object)),
+                       NULL, model_async_model_cb, data);
+}
+
+/* Test that building a model asynchronously, while more events are still being
+ * appended to the event sequence, gives the same result as building it
+ * synchronously from the whole log. */
+static void
+test_parser_model_async (void)
+{
+  DflParser *parser = NULL;
+  DflModel *model = NULL, *sync_model = NULL;
+  GInputStream *stream = NULL;
+  gchar *log = NULL;
+  const guint n_events = 100000;
+  ModelAsyncData data = { NULL, };
+  GError *error = NULL;
+
+  log = build_large_log (n_events, FALSE);
+  stream = g_memory_input_stream_new_from_data (log, strlen (log), NULL);
+  parser = dfl_parser_new ();
+
+  g_signal_connect (parser, "notify::event-sequence",
+                    (GCallback) model_async_notify_event_sequence_cb, &data);
+
+  dfl_parser_load_from_stream_async (parser, stream, NULL,
+                                     model_async_load_cb, &data);
+
+  while (data.load_result == NULL || data.model_result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  dfl_parser_load_from_stream_finish (parser, data.load_result, &error);
+  g_assert_no_error (error);
+
+  model = dfl_model_new_finish (data.model_result, &error);
+  g_assert_no_error (error);
+  g_assert (DFL_IS_MODEL (model));
+
+  /* Any events appended while the model was being built must have been added
+   * to the sequence, and analysed, by now. */
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (dfl_parser_get_event_sequence (parser))),
+                    ==, n_events);
+  g_assert_null (dfl_model_get_update_error (model));
+
+  sync_model = load_model_from_bytes (log);
+  assert_models_equal (model, sync_model);
+
+  g_object_unref (sync_model);
+  g_object_unref (model);
+  g_object_unref (data.model_result);
+  g_object_unref (data.load_result);
+  g_object_unref (parser);
+  g_object_unref (stream);
+  g_free (log);
+}
+
+/* Test that cancelling an asynchronous model build reports cancellation. */
+static void
+test_parser_model_async_cancelled (void)
+{
+  DflParser *parser = NULL;
+  DflModel *model = NULL;
+  GCancellable *cancellable = NULL;
+  gchar *log = NULL;
+  ModelAsyncData data = { NULL, };
+  GError *error = NULL;
+
+  log = build_large_log (1000, FALSE);
+  parser = dfl_parser_new ();
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_no_error (error);
+
+  cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+
+  dfl_model_new_async (dfl_parser_get_event_sequence (parser), cancellable,
+                       model_async_model_cb, &data);
+
+  while (data.model_result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  model = dfl_model_new_finish (data.model_result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (model);
+  g_clear_error (&error);
+
+  g_object_unref (data.model_result);
+  g_object_unref (cancellable);
+  g_object_unref (parser);
+  g_free (log);
+}
+
+/* Append @str to the log file open as @fd. */
+static void
+write_log (gint         fd,
+           const gchar *str)
+{
+  gsize length = strlen (str);
+
+  g_assert_cmpint (write (fd, str, length), ==, (gssize) length);
+}
+
+#define FOLLOW_EVENT(timestamp) \
+  "g_source_before_dispatch," timestamp ",1,140407983871120,12007776," \
+  "140408421089918,140408421089920"
+
+/* Test that following a log while it is being written picks up new events as
+ * they are appended, without parsing partially written lines early. */
+static void
+test_parser_follow (void)
+{
+  DflParser *parser = NULL;
+  GFile *file = NULL;
+  GFileInputStream *stream = NULL;
+  GCancellable *cancellable = NULL;
+  DflEventSequence *sequence;
+  DflEvent *event = NULL;
+  gchar *filename = NULL;
+  gint fd;
+  StreamAsyncData data = { NULL, };
+  const gchar *log_pieces[] = {
+    "Dunfell log,1.0,100\n" FOLLOW_EVENT ("101") "\n",
+    FOLLOW_EVENT ("102") "\n" "g_source_before_",
+    "dispatch,103,1,140407983871120,12007776,140408421089918,"
+    "140408421089920\n",
+  };
+  gsize log_length = 0;
+  guint i;
+  GError *error = NULL;
+
+  fd = g_file_open_tmp ("dunfell-parser-test-XXXXXX.log", &filename, &error);
+  g_assert_no_error (error);
+
+  file = g_file_new_for_path (filename);
+  stream = g_file_read (file, NULL, &error);
+  g_assert_no_error (error);
+
+  parser = dfl_parser_new ();
+  cancellable = g_cancellable_new ();
+
+  g_signal_connect (parser, "notify::event-sequence",
+                    (GCallback) stream_async_notify_event_sequence_cb, &data);
+  g_signal_connect (parser, "notify::bytes-processed",
+                    (GCallback) stream_async_notify_bytes_processed_cb, &data);
+
+  dfl_parser_follow_stream_async (parser, G_INPUT_STREAM (stream), cancellable,
+                                  stream_async_cb, &data);
+
+  /* Write the log in pieces, waiting for the events from each piece to be
+   * delivered. The second piece ends with a partial line, which must not be
+   * parsed until the third piece completes it. */
+  for (i = 0; i < G_N_ELEMENTS (log_pieces); i++)
+    {
+      write_log (fd, log_pieces[i]);
+      log_length += strlen (log_pieces[i]);
+
+      while (data.n_items < i + 1)
+        g_main_context_iteration (NULL, TRUE);
+
+      g_assert_cmpuint (data.n_items, ==, i + 1);
+      g_assert_null (data.result);
+    }
+
+  /* Check the event which was split between pieces. */
+  sequence = dfl_parser_get_event_sequence (parser);
+  event = g_list_model_get_item (G_LIST_MODEL (sequence), 2);
+  g_assert_cmpstr (dfl_event_get_event_type (event), ==,
+                   "g_source_before_dispatch");
+  g_assert_cmpuint (dfl_event_get_timestamp (event), ==, 103);
+  g_object_unref (event);
+
+  /* The model is updated for each piece after the first. */
+  g_assert_cmpuint (data.n_model_updates, ==, G_N_ELEMENTS (log_pieces) - 1);
+  g_assert_cmpuint (data.bytes_processed, ==, log_length);
+
+  /* Stop following. */
+  g_cancellable_cancel (cancellable);
+
+  while (data.result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (dfl_parser_follow_stream_finish (parser, data.result,
+                                                  &error));
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (data.n_items, ==, G_N_ELEMENTS (log_pieces));
+
+  g_object_unref (data.model);
+  g_object_unref (data.result);
+  g_object_unref (cancellable);
+  g_object_unref (parser);
+  g_object_unref (stream);
+  g_object_unref (file);
+
+  close (fd);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+#undef FOLLOW_EVENT
+
+/* Follow @log as it is written in pieces, each of the number of lines given
+ * by @piece_n_lines, waiting for the events from each piece to be analysed
+ * before writing the next. The first piece includes the header line. Return
+ * the resulting model. */
+static DflModel *
+follow_model_in_pieces (const gchar *log,
+                        const guint *piece_n_lines,
+                        gsize        n_pieces)
+{
+  DflParser *parser = NULL;
+  GFile *file = NULL;
+  GFileInputStream *stream = NULL;
+  GCancellable *cancellable = NULL;
+  gchar *filename = NULL;
+  const gchar *piece_start;
+  gint fd;
+  guint n_events = 0;
+  StreamAsyncData data = { NULL, };
+  gsize i;
+  guint j;
+  GError *error = NULL;
+
+  fd = g_file_open_tmp ("dunfell-parser-test-XXXXXX.log", &filename, &error);
+  g_assert_no_error (error);
+
+  file = g_file_new_for_path (filename);
+  stream = g_file_read (file, NULL, &error);
+  g_assert_no_error (error);
+
+  parser = dfl_parser_new ();
+  cancellable = g_cancellable_new ();
+
+  g_signal_connect (parser, "notify::event-sequence",
+                    (GCallback) stream_async_notify_event_sequence_cb, &data);
+
+  dfl_parser_follow_stream_async (parser, G_INPUT_STREAM (stream),
+                                  cancellable, stream_async_cb, &data);
+
+  piece_start = log;
+
+  for (i = 0; i < n_pieces; i++)
+    {
+      const gchar *piece_end = piece_start;
+      gchar *piece = NULL;
+
+      for (j = 0; j < piece_n_lines[i]; j++)
+        piece_end = strchr (piece_end, '\n') + 1;
+
+      piece = g_strndup (piece_start, piece_end - piece_start);
+      write_log (fd, piece);
+      g_free (piece);
+
+      piece_start = piece_end;
+      n_events += (i == 0) ? piece_n_lines[i] - 1 : piece_n_lines[i];
+
+      while (data.n_items < n_events)
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+  g_assert_cmpstr (piece_start, ==, "");
+  g_assert_cmpuint (data.n_items, ==, n_events);
+
+  g_cancellable_cancel (cancellable);
+
+  while (data.result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (dfl_parser_follow_stream_finish (parser, data.result,
+                                                  &error));
+  g_assert_no_error (error);
+
+  g_object_unref (data.result);
+  g_object_unref (cancellable);
+  g_object_unref (parser);
+  g_object_unref (stream);
+  g_object_unref (file);
+
+  close (fd);
+  g_unlink (filename);
+  g_free (filename);
+
+  return data.model;
+}
+
+/* Test that analysing a log in parallel gives the same model as analysing it
+ * serially. The whole log is more than the 16384 events which are needed for
+ * the factories to be run in parallel, but it is followed as it is written in
+ * pieces which are each smaller than that, so that each batch is analysed
+ * serially. */
+static void
+test_parser_model_parallel (void)
+{
+  DflModel *model = NULL, *follow_model = NULL;
+  gchar *log = NULL;
+  const guint n_events = 24000;
+  const guint piece_n_lines[] = {
+    n_events / 3 + 1,  /* including the header */
+    n_events / 3,
+    n_events / 3,
+  };
+
+  log = build_large_log (n_events, FALSE);
+
+  /* Analyse the whole log at once, and a piece at a time. */
+  model = load_model_from_bytes (log);
+  follow_model = follow_model_in_pieces (log, piece_n_lines,
+                                         G_N_ELEMENTS (piece_n_lines));
+
+  assert_models_equal (model, follow_model);
+
+  g_object_unref (follow_model);
+  g_object_unref (model);
+  g_free (log);
+}
+
+/* Test that every known event type is recognised, and that unknown event types
+ * which look similar are ignored. */
+static void
+test_parser_event_types (void)
+{
+  DflParser *parser = NULL;
+  DflEventSequence *sequence;
+  guint i;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_main_context_new,101,1,1\n"
+    "g_main_context_acquire,101,1,1,1\n"
+    "g_main_context_release,101,1,1\n"
+    "g_main_context_free,101,1,1\n"
+    "g_main_context_before_dispatch,101,1,1\n"
+    "g_main_context_after_dispatch,101,1,1\n"
+    "g_source_new,101,1,1,a,b,c,d,1\n"
+    "g_source_before_free,101,1,1,1,a\n"
+    "g_source_before_dispatch,101,1,1,a,b,1\n"
+    "g_source_after_dispatch,101,1,1,a,1\n"
+    "g_source_set_name,101,1,1,a\n"
+    "g_source_add_child_source,101,1,1,1\n"
+    "g_source_attach,101,1,1,1,1\n"
+    "g_source_destroy,101,1,1,1\n"
+    "g_thread_spawned,101,1,a,1,b\n"
+    "g_task_new,101,1,1,1,1,a,1\n"
+    "g_task_set_source_tag,101,1,1,a\n"
+    "g_task_before_return,101,1,1,1,a,1\n"
+    "g_task_propagate,101,1,1,1\n"
+    "g_task_before_run_in_thread,101,1,1,a\n"
+    "g_task_after_run_in_thread,101,1,1,1\n"
+    /* Unknown event types with the same lengths as known ones. */
+    "g_task_old,101,1,1\n"
+    "g_source_xxxxxxx,101,1,1\n"
+    "g_main_context_xxxxxxx,101,1,1\n"
+    "g_xxxx_before_return,101,1,1\n";
+  const gchar *expected_event_types[] = {
+    "g_main_context_new",
+    "g_main_context_acquire",
+    "g_main_context_release",
+    "g_main_context_free",
+    "g_main_context_before_dispatch",
+    "g_main_context_after_dispatch",
+    "g_source_new",
+    "g_source_before_free",
+    "g_source_before_dispatch",
+    "g_source_after_dispatch",
+    "g_source_set_name",
+    "g_source_add_child_source",
+    "g_source_attach",
+    "g_source_destroy",
+    "g_thread_spawned",
+    "g_task_new",
+    "g_task_set_source_tag",
+    "g_task_before_return",
+    "g_task_propagate",
+    "g_task_before_run_in_thread",
+    "g_task_after_run_in_thread",
+  };
+  GError *error = NULL;
+
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_no_error (error);
+
+  sequence = dfl_parser_get_event_sequence (parser);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==,
+                    G_N_ELEMENTS (expected_event_types));
+
+  for (i = 0; i < G_N_ELEMENTS (expected_event_types); i++)
+    {
+      DflEvent *event;
+
+      event = g_list_model_get_item (G_LIST_MODEL (sequence), i);
+      g_assert (dfl_event_get_event_type (event) ==
+                g_intern_static_string (expected_event_types[i]));
+      g_object_unref (event);
+    }
+
+  g_object_unref (parser);
+}
+
+/* Test that parameters are decoded according to their event type’s schema. */
+static void
+test_parser_parameters (void)
+{
+  DflParser *parser = NULL;
+  DflEventSequence *sequence;
+  DflEvent *event = NULL;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_after_dispatch,101,1,140407983871120,g_idle_dispatch,-1\n"
+    "g_source_set_name,102,1,140407983871120,Some name\n";
+  GError *error = NULL;
+
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_no_error (error);
+
+  sequence = dfl_parser_get_event_sequence (parser);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence)), ==, 2);
+
+  event = g_list_model_get_item (G_LIST_MODEL (sequence), 0);
+  g_assert_cmpuint (dfl_event_get_parameter_id (event, 0), ==,
+                    140407983871120);
+  g_assert_cmpstr (dfl_event_get_parameter_utf8 (event, 0), ==,
+                   "140407983871120");
+  g_assert_cmpstr (dfl_event_get_parameter_utf8 (event, 1), ==,
+                   "g_idle_dispatch");
+  g_assert_cmpint (dfl_event_get_parameter_int64 (event, 2), ==, -1);
+  g_assert_cmpstr (dfl_event_get_parameter_utf8 (event, 2), ==, "-1");
+  g_object_unref (event);
+
+  event = g_list_model_get_item (G_LIST_MODEL (sequence), 1);
+  g_assert_cmpstr (dfl_event_get_parameter_utf8 (event, 1), ==, "Some name");
+  g_object_unref (event);
+
+  g_object_unref (parser);
+}
+
+/* Test that a parameter which does not match its schema is rejected. */
+static void
+test_parser_parameters_invalid (void)
+{
+  DflParser *parser = NULL;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_main_context_acquire,101,1,not-an-id,1\n";
+  GError *error = NULL;
+
+  parser = dfl_parser_new ();
+
+  dfl_parser_load_from_data (parser, (const guint8 *) log, strlen (log),
+                             &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN);
+  g_assert_null (dfl_parser_get_event_sequence (parser));
+
+  g_error_free (error);
+  g_object_unref (parser);
+}
+
+/* Test that threads can be looked up in a model by ID. */
+static void
+test_parser_model_threads (void)
+{
+  DflModel *model = NULL;
+  GPtrArray/*<owned DflThread>*/ *threads = NULL;
+  DflThread *thread;
+  guint i, thread_index;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_main_context_acquire,101,5,1,1\n"
+    "g_thread_spawned,102,7,a,1,worker\n"
+    "g_main_context_release,103,5,1\n"
+    "g_main_context_acquire,104,9,1,1\n"
+    "g_main_context_release,105,7,1\n";
+
+  model = load_model_from_bytes (log);
+  threads = dfl_model_dup_threads (model);
+  g_assert_cmpuint (threads->len, ==, 3);
+
+  /* Every thread’s index must match its position in the array. */
+  for (i = 0; i < threads->len; i++)
+    {
+      DflThreadId thread_id = dfl_thread_get_id (threads->pdata[i]);
+
+      g_assert (dfl_model_find_thread (model, thread_id, &thread_index));
+      g_assert_cmpuint (thread_index, ==, i);
+      g_assert (dfl_model_get_thread (model, thread_id) == threads->pdata[i]);
+    }
+
+  thread = dfl_model_get_thread (model, 7);
+  g_assert_nonnull (thread);
+  g_assert_cmpstr (dfl_thread_get_name (thread), ==, "worker");
+  g_assert_cmpuint (dfl_thread_get_new_timestamp (thread), ==, 102);
+  g_assert_cmpuint (dfl_thread_get_free_timestamp (thread), ==, 105);
+
+  g_assert_null (dfl_model_get_thread (model, 6));
+  g_assert_false (dfl_model_find_thread (model, 6, NULL));
+
+  g_ptr_array_unref (threads);
+  g_object_unref (model);
+}
+
+/* Test that sources are looked up by the generation of their ID which was live
+ * at the time, since IDs are memory addresses which may be reused. */
+static void
+test_parser_model_sources (void)
+{
+  DflModel *model = NULL;
+  DflSource *old_source, *new_source, *child_source;
+  GPtrArray/*<unowned DflSource>*/ *children;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_new,101,1,16,a,b,c,d,0\n"
+    "g_source_before_free,102,1,16,0,a\n"
+    "g_source_new,103,1,16,a,b,c,d,0\n"
+    "g_source_new,104,1,32,a,b,c,d,0\n"
+    "g_source_add_child_source,105,1,16,32\n";
+
+  model = load_model_from_bytes (log);
+
+  old_source = dfl_model_get_source (model, 16, 101);
+  new_source = dfl_model_get_source (model, 16, 103);
+  child_source = dfl_model_get_source (model, 32, 105);
+
+  g_assert_nonnull (old_source);
+  g_assert_nonnull (new_source);
+  g_assert_nonnull (child_source);
+  g_assert (old_source != new_source);
+  g_assert_cmpuint (dfl_source_get_new_timestamp (old_source), ==, 101);
+  g_assert_cmpuint (dfl_source_get_new_timestamp (new_source), ==, 103);
+
+  g_assert (dfl_model_get_source (model, 16, 102) == old_source);
+  g_assert (dfl_model_get_source (model, 16, 1000) == new_source);
+  g_assert_null (dfl_model_get_source (model, 16, 100));
+  g_assert_null (dfl_model_get_source (model, 32, 103));
+  g_assert_null (dfl_model_get_source (model, 48, 103));
+
+  /* The child must be linked to the second generation of the parent ID. */
+  g_assert (dfl_source_get_parent (child_source) == new_source);
+  children = dfl_source_get_children (new_source);
+  g_assert_cmpuint (children->len, ==, 1);
+  g_assert (children->pdata[0] == child_source);
+  g_assert_cmpuint (dfl_source_get_children (old_source)->len, ==, 0);
+
+  g_object_unref (model);
+}
+
+/* Test that a source’s dispatch statistics are calculated as its dispatches
+ * are walked. */
+static void
+test_parser_model_dispatch_statistics (void)
+{
+  DflModel *model = NULL;
+  DflSource *source;
+  gsize n_dispatches;
+  DflDuration min_duration, median_duration, max_duration;
+  DflDuration p50_duration, p90_duration, p99_duration, p999_duration;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_new,100,1,16,a,b,c,d,0\n"
+    "g_source_before_dispatch,200,1,16,a,b,1\n"
+    "g_source_after_dispatch,210,1,16,a,1\n"
+    "g_source_before_dispatch,300,1,16,a,b,1\n"
+    "g_source_after_dispatch,320,1,16,a,1\n"
+    "g_source_before_dispatch,400,1,16,a,b,1\n"
+    "g_source_after_dispatch,430,1,16,a,1\n"
+    "g_source_before_dispatch,500,1,16,a,b,1\n"
+    "g_source_after_dispatch,540,1,16,a,1\n"
+    "g_source_before_dispatch,600,1,16,a,b,1\n"
+    "g_source_after_dispatch,1600,1,16,a,1\n"
+    /* Still in progress at the end of the log. */
+    "g_source_before_dispatch,2000,1,16,a,b,1\n";
+
+  model = load_model_from_bytes (log);
+  source = dfl_model_get_source (model, 16, 100);
+  g_assert_nonnull (source);
+
+  dfl_source_get_dispatch_statistics (source, &n_dispatches, &min_duration,
+                                      &median_duration, &max_duration);
+  g_assert_cmpuint (n_dispatches, ==, 6);
+  g_assert_cmpint (min_duration, ==, 10);
+  g_assert_cmpint (median_duration, ==, 30);
+  g_assert_cmpint (max_duration, ==, 1000);
+  g_assert_cmpint (dfl_source_get_total_dispatch_duration (source), ==, 1100);
+
+  /* Small durations are exact; larger ones are accurate to within 2%. */
+  dfl_source_get_dispatch_quantiles (source, &p50_duration, &p90_duration,
+                                     &p99_duration, &p999_duration);
+  g_assert_cmpint (p50_duration, ==, 30);
+  g_assert_cmpint (p90_duration, >=, 980);
+  g_assert_cmpint (p90_duration, <=, 1000);
+  g_assert_cmpint (p99_duration, ==, p90_duration);
+  g_assert_cmpint (p999_duration, ==, p90_duration);
+
+  g_object_unref (model);
+}
+
+/* Test that dispatch histograms can be aggregated per source, per thread, per
+ * callback and over the whole model. */
+static void
+test_parser_model_dispatch_histograms (void)
+{
+  DflModel *model = NULL;
+  DflHistogram *histogram = NULL;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_new,100,1,16,a,b,c,d,0\n"
+    "g_source_new,100,2,32,a,b,c,d,0\n"
+    "g_source_before_dispatch,200,1,16,dispatch,callback1,1\n"
+    "g_source_after_dispatch,210,1,16,dispatch,1\n"
+    "g_source_before_dispatch,300,1,16,dispatch,callback1,1\n"
+    "g_source_after_dispatch,320,1,16,dispatch,1\n"
+    "g_source_before_dispatch,300,2,32,dispatch,callback2,1\n"
+    "g_source_after_dispatch,340,2,32,dispatch,1\n"
+    "g_source_before_dispatch,400,1,32,dispatch,callback1,1\n"
+    "g_source_after_dispatch,450,1,32,dispatch,1\n"
+    /* Still in progress at the end of the log. */
+    "g_source_before_dispatch,500,1,16,dispatch,callback1,1\n";
+
+  model = load_model_from_bytes (log);
+
+  histogram = dfl_source_dup_dispatch_histogram (dfl_model_get_source (model, 16, 100));
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 2);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram), ==, 30);
+  g_object_unref (histogram);
+
+  histogram = dfl_model_dup_dispatch_histogram (model);
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 4);
+  g_assert_cmpint (dfl_histogram_get_min (histogram), ==, 10);
+  g_assert_cmpint (dfl_histogram_get_max (histogram), ==, 50);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram), ==, 120);
+  g_object_unref (histogram);
+
+  histogram = dfl_model_dup_thread_dispatch_histogram (model, 1);
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 3);
+  g_assert_cmpint (dfl_histogram_get_sum (histogram), ==, 80);
+  g_object_unref (histogram);
+
+  g_assert_null (dfl_model_dup_thread_dispatch_histogram (model, 3));
+
+  histogram = dfl_model_dup_callback_dispatch_histogram (model, "callback1");
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 3);
+  g_assert_cmpint (dfl_histogram_get_max (histogram), ==, 50);
+  g_object_unref (histogram);
+
+  histogram = dfl_model_dup_callback_dispatch_histogram (model, "nonexistent");
+  g_assert_cmpuint (dfl_histogram_get_n_durations (histogram), ==, 0);
+  g_object_unref (histogram);
+
+  g_object_unref (model);
+}
+
+/* Test that long dispatches are counted and listed across all sources. */
+static void
+test_parser_model_long_dispatches (void)
+{
+  DflModel *model = NULL;
+  GArray *dispatches = NULL;
+  const DflDispatch *dispatch;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_new,100,1,16,a,b,c,d,0\n"
+    "g_source_new,100,1,32,a,b,c,d,0\n"
+    "g_source_before_dispatch,200,1,16,a,b,1\n"
+    "g_source_after_dispatch,210,1,16,a,1\n"
+    "g_source_before_dispatch,300,1,32,a,b,1\n"
+    "g_source_after_dispatch,350,1,32,a,1\n"
+    "g_source_before_dispatch,400,1,16,a,b,1\n"
+    "g_source_after_dispatch,450,1,16,a,1\n"
+    "g_source_before_dispatch,500,1,32,a,b,1\n"
+    "g_source_after_dispatch,1500,1,32,a,1\n"
+    /* Still in progress at the end of the log. */
+    "g_source_before_dispatch,2000,1,16,a,b,1\n";
+
+  model = load_model_from_bytes (log);
+
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 0), ==, 4);
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 10), ==, 4);
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 11), ==, 3);
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 50), ==, 3);
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 51), ==, 1);
+  g_assert_cmpuint (dfl_model_get_n_long_dispatches (model, 1001), ==, 0);
+
+  dispatches = dfl_model_dup_longest_dispatches (model, 3);
+  g_assert_cmpuint (dispatches->len, ==, 3);
+
+  dispatch = &g_array_index (dispatches, DflDispatch, 0);
+  g_assert (dispatch->source == dfl_model_get_source (model, 32, 100));
+  g_assert_cmpuint (dispatch->timestamp, ==, 500);
+  g_assert_cmpint (dispatch->duration, ==, 1000);
+
+  /* Equal durations are ordered by timestamp. */
+  dispatch = &g_array_index (dispatches, DflDispatch, 1);
+  g_assert (dispatch->source == dfl_model_get_source (model, 32, 100));
+  g_assert_cmpuint (dispatch->timestamp, ==, 300);
+  g_assert_cmpint (dispatch->duration, ==, 50);
+
+  dispatch = &g_array_index (dispatches, DflDispatch, 2);
+  g_assert (dispatch->source == dfl_model_get_source (model, 16, 100));
+  g_assert_cmpuint (dispatch->timestamp, ==, 400);
+  g_assert_cmpint (dispatch->duration, ==, 50);
+
+  g_array_unref (dispatches);
+
+  dispatches = dfl_model_dup_longest_dispatches (model, 100);
+  g_assert_cmpuint (dispatches->len, ==, 4);
+  g_array_unref (dispatches);
+
+  g_object_unref (model);
+}
+
+/* Test iterating over the dispatches of all sources in timestamp order. */
+static void
+test_parser_model_dispatch_iter (void)
+{
+  DflModel *model = NULL;
+  DflTimeSequenceMergeIter iter;
+  DflTimestamp timestamp;
+  DflSourceDispatchData *data;
+  DflSource *source;
+  const gchar *log =
+    "Dunfell log,1.0,100\n"
+    "g_source_new,100,1,16,a,b,c,d,0\n"
+    "g_source_new,100,2,32,a,b,c,d,0\n"
+    "g_source_before_dispatch,200,1,16,a,b,1\n"
+    "g_source_after_dispatch,210,1,16,a,1\n"
+    "g_source_before_dispatch,250,2,32,a,b,1\n"
+    "g_source_after_dispatch,260,2,32,a,1\n"
+    "g_source_before_dispatch,300,1,32,a,b,1\n"
+    "g_source_after_dispatch,350,1,32,a,1\n"
+    "g_source_before_dispatch,400,1,16,a,b,1\n"
+    "g_source_after_dispatch,450,1,16,a,1\n";
+
+  model = load_model_from_bytes (log);
+
+  /* All threads. */
+  dfl_model_dispatch_iter (model, &iter, 0, 0, G_MAXUINT64);
+
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 200);
+  g_assert (source == dfl_model_get_source (model, 16, 100));
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 250);
+  g_assert_cmpuint (data->thread_id, ==, 2);
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 300);
+  g_assert (source == dfl_model_get_source (model, 32, 100));
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 400);
+  g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL, NULL));
+
+  dfl_time_sequence_merge_iter_clear (&iter);
+
+  /* One thread, in a range. */
+  dfl_model_dispatch_iter (model, &iter, 1, 201, 400);
+
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 300);
+  g_assert_cmpuint (data->thread_id, ==, 1);
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 400);
+  g_assert (source == dfl_model_get_source (model, 16, 100));
+  g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL, NULL));
+
+  dfl_time_sequence_merge_iter_clear (&iter);
+
+  /* A thread which only one of the sources dispatched on. */
+  dfl_model_dispatch_iter (model, &iter, 2, 0, G_MAXUINT64);
+
+  g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                    (gpointer *) &data,
+                                                    (gpointer *) &source));
+  g_assert_cmpuint (timestamp, ==, 250);
+  g_assert (source == dfl_model_get_source (model, 32, 100));
+  g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL, NULL));
+
+  dfl_time_sequence_merge_iter_clear (&iter);
+
+  /* A thread which no sources dispatched on. */
+  dfl_model_dispatch_iter (model, &iter, 3, 0, G_MAXUINT64);
+  g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL, NULL));
+  dfl_time_sequence_merge_iter_clear (&iter);
+
+  g_object_unref (model);
+}
+
+/* Log for the source dispatch link tests. Source 48 is not attached to the
+ * main context, and the last dispatch of the main context has not finished by
+ * the end of the log. */
+static const gchar *source_dispatch_links_log =
+  "Dunfell log,1.0,100\n"
+  "g_main_context_new,100,1,64\n"
+  "g_source_new,100,1,16,a,b,c,d,0\n"
+  "g_source_new,100,1,32,a,b,c,d,0\n"
+  "g_source_new,100,1,48,a,b,c,d,0\n"
+  "g_source_attach,101,1,16,64\n"
+  "g_source_attach,101,1,32,64\n"
+  "g_main_context_before_dispatch,200,1,64\n"
+  "g_source_before_dispatch,200,1,16,a,b,1\n"
+  "g_source_after_dispatch,210,1,16,a,1\n"
+  "g_source_before_dispatch,220,1,32,a,b,1\n"
+  "g_source_after_dispatch,230,1,32,a,1\n"
+  "g_main_context_after_dispatch,240,1,64\n"
+  /* Outside any dispatch of the main context. */
+  "g_source_before_dispatch,250,2,32,a,b,1\n"
+  "g_source_after_dispatch,260,2,32,a,1\n"
+  "g_main_context_before_dispatch,300,1,64\n"
+  /* Not attached to the main context. */
+  "g_source_before_dispatch,300,1,48,a,b,1\n"
+  "g_source_after_dispatch,305,1,48,a,1\n"
+  "g_source_before_dispatch,310,1,16,a,b,1\n"
+  "g_source_after_dispatch,320,1,16,a,1\n"
+  "g_main_context_after_dispatch,330,1,64\n"
+  "g_main_context_before_dispatch,400,1,64\n"
+  "g_main_context_after_dispatch,410,1,64\n"
+  /* Not finished by the end of the log. */
+  "g_main_context_before_dispatch,500,1,64\n"
+  "g_source_before_dispatch,510,1,32,a,b,1\n";
+
+/* Test that each main context dispatch is linked to the dispatches of its
+ * sources which happened within it, on the same thread. */
+static void
+test_parser_model_source_dispatch_links (void)
+{
+  DflModel *model = NULL;
+  DflMainContext *main_context;
+  DflTimeSequenceIter iter;
+  DflTimestamp timestamp;
+  DflMainContextDispatchData *data;
+  const DflDispatch *dispatches;
+  guint n_dispatches;
+
+  model = load_model_from_bytes (source_dispatch_links_log);
+  main_context = dfl_model_get_main_context (model, 64, 100);
+  g_assert (DFL_IS_MAIN_CONTEXT (main_context));
+
+  dfl_main_context_dispatch_iter (main_context, &iter, 0);
+
+  g_assert_true (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                              (gpointer *) &data));
+  g_assert_cmpuint (timestamp, ==, 200);
+  dispatches = dfl_main_context_get_source_dispatches (main_context, data,
+                                                       &n_dispatches);
+  g_assert_cmpuint (n_dispatches, ==, 2);
+  g_assert (dispatches[0].source == dfl_model_get_source (model, 16, 100));
+  g_assert_cmpuint (dispatches[0].timestamp, ==, 200);
+  g_assert_cmpint (dispatches[0].duration, ==, 10);
+  g_assert (dispatches[1].source == dfl_model_get_source (model, 32, 100));
+  g_assert_cmpuint (dispatches[1].timestamp, ==, 220);
+
+  g_assert_true (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                              (gpointer *) &data));
+  g_assert_cmpuint (timestamp, ==, 300);
+  dispatches = dfl_main_context_get_source_dispatches (main_context, data,
+                                                       &n_dispatches);
+  g_assert_cmpuint (n_dispatches, ==, 1);
+  g_assert (dispatches[0].source == dfl_model_get_source (model, 16, 100));
+  g_assert_cmpuint (dispatches[0].timestamp, ==, 310);
+
+  g_assert_true (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                              (gpointer *) &data));
+  g_assert_cmpuint (timestamp, ==, 400);
+  dispatches = dfl_main_context_get_source_dispatches (main_context, data,
+                                                       &n_dispatches);
+  g_assert_cmpuint (n_dispatches, ==, 0);
+  g_assert_null (dispatches);
+
+  g_assert_true (dfl_time_sequence_iter_next (&iter, &timestamp,
+                                              (gpointer *) &data));
+  g_assert_cmpuint (timestamp, ==, 500);
+  dispatches = dfl_main_context_get_source_dispatches (main_context, data,
+                                                       &n_dispatches);
+  g_assert_cmpuint (n_dispatches, ==, 1);
+  g_assert (dispatches[0].source == dfl_model_get_source (model, 32, 100));
+  g_assert_cmpint (dispatches[0].duration, <, 0);
+
+  g_assert_false (dfl_time_sequence_iter_next (&iter, NULL, NULL));
+
+  g_object_unref (model);
+}
+
+/* Test that the links are the same when the log is analysed in batches which
+ * split main context and source dispatches, so each main context has to be
+ * relinked from its unfinished dispatch, including sources which were not
+ * dispatched in the latest batch. */
+static void
+test_parser_model_source_dispatch_links_follow (void)
+{
+  DflModel *model = NULL, *follow_model = NULL;
+  const guint piece_n_lines[] = {
+    5,  /* the header, and the main context and sources being created */
+    4,  /* attaching the sources, and starting the first dispatches */
+    2,  /* finishing the first source dispatch, and starting another */
+    5,  /* finishing both dispatches, and starting the next one */
+    4,  /* source dispatches within it */
+    5,  /* the rest */
+  };
+
+  model = load_model_from_bytes (source_dispatch_links_log);
+  follow_model = follow_model_in_pieces (source_dispatch_links_log,
+                                         piece_n_lines,
+                                         G_N_ELEMENTS (piece_n_lines));
+
+  assert_models_equal (model, follow_model);
+
+  g_object_unref (follow_model);
+  g_object_unref (model);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -107,6 +1639,33 @@ main (int argc, char *argv[])
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/parser/construction", test_parser_construction);
+  g_test_add_func ("/parser/large", test_parser_large);
+  g_test_add_func ("/parser/large/non-monotonic",
+                   test_parser_large_non_monotonic);
+  g_test_add_func ("/parser/stream-async", test_parser_stream_async);
+  g_test_add_func ("/parser/follow", test_parser_follow);
+  g_test_add_func ("/parser/model-async", test_parser_model_async);
+  g_test_add_func ("/parser/model-async/cancelled",
+                   test_parser_model_async_cancelled);
+  g_test_add_func ("/parser/model-parallel", test_parser_model_parallel);
+  g_test_add_func ("/parser/event-types", test_parser_event_types);
+  g_test_add_func ("/parser/parameters", test_parser_parameters);
+  g_test_add_func ("/parser/parameters/invalid",
+                   test_parser_parameters_invalid);
+  g_test_add_func ("/parser/model/threads", test_parser_model_threads);
+  g_test_add_func ("/parser/model/sources", test_parser_model_sources);
+  g_test_add_func ("/parser/model/dispatch-statistics",
+                   test_parser_model_dispatch_statistics);
+  g_test_add_func ("/parser/model/dispatch-histograms",
+                   test_parser_model_dispatch_histograms);
+  g_test_add_func ("/parser/model/long-dispatches",
+                   test_parser_model_long_dispatches);
+  g_test_add_func ("/parser/model/dispatch-iter",
+                   test_parser_model_dispatch_iter);
+  g_test_add_func ("/parser/model/source-dispatch-links",
+                   test_parser_model_source_dispatch_links);
+  g_test_add_func ("/parser/model/source-dispatch-links/follow",
+                   test_parser_model_source_dispatch_links_follow);
 
   for (i = 0; i < G_N_ELEMENTS (test_vectors); i++)
     {
@@ -115,6 +1674,15 @@ main (int argc, char *argv[])
       test_name = g_strdup_printf ("/parser/log/%u", i);
       g_test_add_data_func (test_name, &test_vectors[i], test_parser_log);
       g_free (test_name);
+
+      test_name = g_strdup_printf ("/parser/log-stream/%u", i);
+      g_test_add_data_func (test_name, &test_vectors[i],
+                            test_parser_log_stream);
+      g_free (test_name);
+
+      test_name = g_strdup_printf ("/parser/log-file/%u", i);
+      g_test_add_data_func (test_name, &test_vectors[i], test_parser_log_file);
+      g_free (test_name);
     }
 
   return g_test_run ();
@@ -288,6 +288,591 @@ test_time_sequence_iter_multiple (void)
     }
 }
 
+/* Test that starting iteration from a timestamp finds the first of a run of
+ * elements with the same timestamp, whether or not it matches exactly. */
+static void
+test_time_sequence_iter_duplicates (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  DflTimeSequenceIter iter;
+  const DflTimestamp timestamps[] = { 10, 10, 10, 20, 20, 30, 30, 30, 30 };
+  const struct
+    {
+      DflTimestamp start_timestamp;
+      guint expected_index;
+    } start_timestamps[] = {
+      { 0, 0 },
+      { 10, 0 },
+      { 15, 0 },
+      { 20, 3 },
+      { 29, 3 },
+      { 30, 5 },
+      { 1000, 5 },
+    };
+  gsize i;
+
+  dfl_time_sequence_init (&sequence, sizeof (guint), NULL, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (timestamps); i++)
+    {
+      guint *data;
+
+      data = dfl_time_sequence_append (&sequence, timestamps[i]);
+      *data = (guint) i;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (start_timestamps); i++)
+    {
+      guint *data;
+
+      g_test_message ("i: %" G_GSIZE_FORMAT, i);
+
+      dfl_time_sequence_iter_init (&iter, &sequence,
+                                   start_timestamps[i].start_timestamp);
+
+      g_assert_true (dfl_time_sequence_iter_next (&iter, NULL,
+                                                  (gpointer *) &data));
+      g_assert_cmpuint (*data, ==, start_timestamps[i].expected_index);
+    }
+}
+
+/* Test iterating over the elements in a bounded range of timestamps, in both
+ * directions. */
+static void
+test_time_sequence_iter_range (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  DflTimeSequenceIter iter;
+  const DflTimestamp timestamps[] = { 10, 20, 20, 30, 40, 50 };
+  const struct
+    {
+      DflTimestamp start;
+      DflTimestamp end;
+      guint expected_first_index;
+      guint expected_n_elements;
+    } ranges[] = {
+      { 0, 1000, 0, 6 },
+      { 0, 5, 0, 0 },
+      { 10, 10, 0, 1 },
+      { 15, 30, 1, 3 },
+      { 20, 20, 1, 2 },
+      { 21, 29, 0, 0 },
+      { 45, 1000, 5, 1 },
+      { 51, 1000, 0, 0 },
+    };
+  gsize i, j;
+
+  dfl_time_sequence_init (&sequence, sizeof (guint), NULL, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (timestamps); i++)
+    {
+      guint *data;
+
+      data = dfl_time_sequence_append (&sequence, timestamps[i]);
+      *data = (guint) i;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (ranges); i++)
+    {
+      guint *data;
+
+      g_test_message ("i: %" G_GSIZE_FORMAT, i);
+
+      dfl_time_sequence_iter_init_range (&iter, &sequence, ranges[i].start,
+                                         ranges[i].end);
+
+      for (j = 0; j < ranges[i].expected_n_elements; j++)
+        {
+          g_assert_true (dfl_time_sequence_iter_next (&iter, NULL,
+                                                      (gpointer *) &data));
+          g_assert_cmpuint (*data, ==, ranges[i].expected_first_index + j);
+        }
+
+      g_assert_false (dfl_time_sequence_iter_next (&iter, NULL, NULL));
+
+      /* And back again; this stops at the start of the range. */
+      for (j = ranges[i].expected_n_elements; j > 0; j--)
+        {
+          g_assert_true (dfl_time_sequence_iter_previous (&iter, NULL,
+                                                          (gpointer *) &data));
+          g_assert_cmpuint (*data, ==, ranges[i].expected_first_index + j - 1);
+        }
+
+      g_assert_false (dfl_time_sequence_iter_previous (&iter, NULL, NULL));
+    }
+}
+
+typedef struct
+{
+  guint id;
+  DflThreadId thread_id;
+} MergeData;
+
+/* Test merging several sequences into timestamp order, with and without
+ * filtering by thread. */
+static void
+test_time_sequence_merge_iter (void)
+{
+  DflTimeSequence sequences[3];
+  const struct
+    {
+      guint sequence_index;
+      DflTimestamp timestamp;
+      DflThreadId thread_id;
+    } elements[] = {
+      { 0, 10, 1 },
+      { 0, 40, 2 },
+      { 0, 40, 1 },
+      { 1, 5, 1 },
+      { 1, 40, 1 },
+      { 1, 90, 2 },
+      /* Sequence 2 is empty. */
+    };
+  /* IDs of the elements, in the order they should be returned. Equal
+   * timestamps are ordered by sequence, then by position in the sequence. */
+  const guint expected_all_ids[] = { 3, 0, 1, 2, 4, 5 };
+  const guint expected_thread_ids[] = { 3, 0, 2, 4 };
+  const guint expected_range_ids[] = { 1, 2, 4 };
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (sequences); i++)
+    {
+      dfl_time_sequence_init (&sequences[i], sizeof (MergeData), NULL, 0);
+      dfl_time_sequence_set_thread_id_offset (&sequences[i],
+                                              G_STRUCT_OFFSET (MergeData,
+                                                               thread_id));
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (elements); i++)
+    {
+      MergeData *data;
+
+      data = dfl_time_sequence_append (&sequences[elements[i].sequence_index],
+                                       elements[i].timestamp);
+      data->id = i;
+      data->thread_id = elements[i].thread_id;
+    }
+
+  /* All elements. */
+    {
+      g_auto (DflTimeSequenceMergeIter) iter;
+      DflTimestamp timestamp, last_timestamp = 0;
+      MergeData *data;
+      DflTimeSequence *user_data;
+
+      dfl_time_sequence_merge_iter_init (&iter);
+
+      for (i = 0; i < G_N_ELEMENTS (sequences); i++)
+        {
+          DflTimeSequenceIter sub_iter;
+
+          dfl_time_sequence_iter_init (&sub_iter, &sequences[i], 0);
+          dfl_time_sequence_merge_iter_add (&iter, &sub_iter, 0,
+                                            &sequences[i]);
+        }
+
+      for (i = 0; i < G_N_ELEMENTS (expected_all_ids); i++)
+        {
+          g_assert_true (dfl_time_sequence_merge_iter_next (&iter, &timestamp,
+                                                            (gpointer *) &data,
+                                                            (gpointer *) &user_data));
+          g_assert_cmpuint (data->id, ==, expected_all_ids[i]);
+          g_assert_cmpuint (timestamp, ==, elements[data->id].timestamp);
+          g_assert_cmpuint (timestamp, >=, last_timestamp);
+          g_assert (user_data ==
+                    &sequences[elements[data->id].sequence_index]);
+
+          last_timestamp = timestamp;
+        }
+
+      g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL,
+                                                         NULL));
+    }
+
+  /* Only elements on thread 1. */
+    {
+      g_auto (DflTimeSequenceMergeIter) iter;
+      MergeData *data;
+
+      dfl_time_sequence_merge_iter_init (&iter);
+
+      for (i = 0; i < G_N_ELEMENTS (sequences); i++)
+        {
+          DflTimeSequenceIter sub_iter;
+
+          dfl_time_sequence_iter_init (&sub_iter, &sequences[i], 0);
+          dfl_time_sequence_merge_iter_add (&iter, &sub_iter, 1, NULL);
+        }
+
+      for (i = 0; i < G_N_ELEMENTS (expected_thread_ids); i++)
+        {
+          g_assert_true (dfl_time_sequence_merge_iter_next (&iter, NULL,
+                                                            (gpointer *) &data,
+                                                            NULL));
+          g_assert_cmpuint (data->id, ==, expected_thread_ids[i]);
+        }
+
+      g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL,
+                                                         NULL));
+    }
+
+  /* Only elements in a range. */
+    {
+      g_auto (DflTimeSequenceMergeIter) iter;
+      MergeData *data;
+
+      dfl_time_sequence_merge_iter_init (&iter);
+
+      for (i = 0; i < G_N_ELEMENTS (sequences); i++)
+        {
+          DflTimeSequenceIter sub_iter;
+
+          dfl_time_sequence_iter_init_range (&sub_iter, &sequences[i], 11, 89);
+          dfl_time_sequence_merge_iter_add (&iter, &sub_iter, 0, NULL);
+        }
+
+      for (i = 0; i < G_N_ELEMENTS (expected_range_ids); i++)
+        {
+          g_assert_true (dfl_time_sequence_merge_iter_next (&iter, NULL,
+                                                            (gpointer *) &data,
+                                                            NULL));
+          g_assert_cmpuint (data->id, ==, expected_range_ids[i]);
+        }
+
+      g_assert_false (dfl_time_sequence_merge_iter_next (&iter, NULL, NULL,
+                                                         NULL));
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (sequences); i++)
+    dfl_time_sequence_clear (&sequences[i]);
+}
+
+typedef struct
+{
+  guint id;
+  DflDuration duration;
+} IntervalData;
+
+/* Check that iterating over the elements of @sequence which overlap
+ * [@start, @end] returns exactly those with the IDs in @expected_ids, in
+ * order. */
+static void
+assert_overlapping (DflTimeSequence *sequence,
+                    DflTimestamp     start,
+                    DflTimestamp     end,
+                    const guint     *expected_ids,
+                    gsize            n_expected_ids)
+{
+  DflTimeSequenceIter iter;
+  IntervalData *data;
+  gsize i;
+
+  g_test_message ("Window: [%" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT "]",
+                  start, end);
+
+  dfl_time_sequence_iter_init_overlapping (&iter, sequence, start, end);
+
+  for (i = 0; i < n_expected_ids; i++)
+    {
+      g_assert_true (dfl_time_sequence_iter_next_overlapping (&iter, NULL,
+                                                              (gpointer *) &data));
+      g_assert_cmpuint (data->id, ==, expected_ids[i]);
+      g_assert (dfl_time_sequence_iter_get_data (&iter) == data);
+    }
+
+  g_assert_false (dfl_time_sequence_iter_next_overlapping (&iter, NULL, NULL));
+}
+
+/* Test iterating over the elements which overlap a window, including long
+ * elements which started before it. */
+static void
+test_time_sequence_iter_overlapping (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  const struct
+    {
+      DflTimestamp timestamp;
+      DflDuration duration;
+    } elements[] = {
+      { 10, 5 },  /* [10, 15] */
+      { 20, 1000 },  /* [20, 1020] */
+      { 30, 5 },  /* [30, 35] */
+      { 100, 0 },  /* [100, 100] */
+      { 100, 50 },  /* [100, 150] */
+      { 500, -1 },  /* still in progress, so [500, 500] */
+    };
+  const guint all_ids[] = { 0, 1, 2, 3, 4, 5 };
+  const guint long_ids[] = { 1 };
+  const guint long_short_ids[] = { 1, 2 };
+  const guint long_coincident_ids[] = { 1, 3, 4 };
+  const guint long_last_ids[] = { 1, 5 };
+  const guint late_ids[] = { 5, 6 };
+  gsize i;
+  IntervalData *data;
+
+  dfl_time_sequence_init (&sequence, sizeof (IntervalData), NULL, 0);
+  dfl_time_sequence_set_duration_offset (&sequence,
+                                         G_STRUCT_OFFSET (IntervalData,
+                                                          duration));
+
+  /* Empty sequence. */
+  assert_overlapping (&sequence, 0, 1000, NULL, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (elements); i++)
+    {
+      data = dfl_time_sequence_append (&sequence, elements[i].timestamp);
+      data->id = i;
+      data->duration = elements[i].duration;
+    }
+
+  assert_overlapping (&sequence, 0, G_MAXUINT64, all_ids,
+                      G_N_ELEMENTS (all_ids));
+  assert_overlapping (&sequence, 15, 15, all_ids, 1);
+  assert_overlapping (&sequence, 16, 19, NULL, 0);
+  assert_overlapping (&sequence, 36, 99, long_ids, G_N_ELEMENTS (long_ids));
+  assert_overlapping (&sequence, 35, 35, long_short_ids,
+                      G_N_ELEMENTS (long_short_ids));
+  assert_overlapping (&sequence, 100, 100, long_coincident_ids,
+                      G_N_ELEMENTS (long_coincident_ids));
+  assert_overlapping (&sequence, 151, 600, long_last_ids,
+                      G_N_ELEMENTS (long_last_ids));
+  assert_overlapping (&sequence, 1021, 2000, NULL, 0);
+
+  /* The last element’s duration may change until another is appended. */
+  data = dfl_time_sequence_get_last_element (&sequence, NULL);
+  data->duration = 1000;
+  assert_overlapping (&sequence, 1021, 2000, &all_ids[5], 1);
+
+  data = dfl_time_sequence_append (&sequence, 1600);
+  data->id = 6;
+  data->duration = 1;
+  assert_overlapping (&sequence, 1021, 2000, late_ids, G_N_ELEMENTS (late_ids));
+}
+
+typedef struct
+{
+  DflDuration duration;
+  DflThreadId thread_id;
+} SummaryData;
+
+/* Check that the summary of @sequence over [@start, @end] at @resolution has
+ * exactly the buckets in @expected, in order. */
+static void
+assert_summary (DflTimeSequence              *sequence,
+                DflTimestamp                  start,
+                DflTimestamp                  end,
+                DflDuration                   resolution,
+                const DflTimeSequenceSummary *expected,
+                gsize                         n_expected)
+{
+  g_autoptr (GArray) summaries = NULL;
+  gsize i;
+
+  g_test_message ("Window: [%" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT "], "
+                  "resolution: %" G_GINT64_FORMAT, start, end, resolution);
+
+  summaries = dfl_time_sequence_dup_summary (sequence, start, end, resolution);
+  g_assert_cmpuint (summaries->len, ==, n_expected);
+
+  for (i = 0; i < n_expected; i++)
+    {
+      const DflTimeSequenceSummary *summary;
+
+      summary = &g_array_index (summaries, DflTimeSequenceSummary, i);
+
+      g_assert_cmpuint (summary->start, ==, expected[i].start);
+      g_assert_cmpint (summary->duration, ==, expected[i].duration);
+      g_assert_cmpuint (summary->n_elements, ==, expected[i].n_elements);
+      g_assert_cmpint (summary->busy_time, ==, expected[i].busy_time);
+      g_assert_cmpint (summary->max_duration, ==, expected[i].max_duration);
+      g_assert_cmpuint (summary->dominant_thread_id, ==,
+                        expected[i].dominant_thread_id);
+    }
+}
+
+/* Test summarising a sequence at coarse and fine resolutions. */
+static void
+test_time_sequence_summary (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  const struct
+    {
+      DflTimestamp timestamp;
+      DflDuration duration;
+      DflThreadId thread_id;
+    } elements[] = {
+      { 0, 10, 1 },
+      { 10, 20, 1 },
+      { 40, 4, 2 },
+      { 64, 64, 2 },
+      { 200, 1, 3 },
+      { 300, 0, 3 },
+    };
+  const DflTimeSequenceSummary coarse[] = {
+    { 0, 256, 5, 99, 64, 2 },
+    { 256, 256, 1, 0, 0, 3 },
+  };
+  const DflTimeSequenceSummary fine[] = {
+    { 0, 64, 3, 34, 20, 1 },
+    { 64, 64, 1, 64, 64, 2 },
+    { 192, 64, 1, 1, 1, 3 },
+    { 256, 64, 1, 0, 0, 3 },
+  };
+  const DflTimeSequenceSummary spanning[] = {
+    { 96, 16, 0, 16, 64, 2 },
+    { 112, 16, 0, 16, 64, 2 },
+  };
+  const DflTimeSequenceSummary extended[] = {
+    { 256, 64, 1, 20, 50, 3 },
+    { 320, 64, 0, 30, 50, 3 },
+  };
+  gsize i;
+  SummaryData *data;
+
+  dfl_time_sequence_init (&sequence, sizeof (SummaryData), NULL, 0);
+  dfl_time_sequence_set_duration_offset (&sequence,
+                                         G_STRUCT_OFFSET (SummaryData,
+                                                          duration));
+  dfl_time_sequence_set_thread_id_offset (&sequence,
+                                          G_STRUCT_OFFSET (SummaryData,
+                                                           thread_id));
+
+  /* Empty sequence. */
+  assert_summary (&sequence, 0, G_MAXUINT64, 1, NULL, 0);
+  assert_summary (&sequence, 0, G_MAXUINT64, 1024, NULL, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (elements); i++)
+    {
+      data = dfl_time_sequence_append (&sequence, elements[i].timestamp);
+      data->duration = elements[i].duration;
+      data->thread_id = elements[i].thread_id;
+    }
+
+  /* Resolutions are rounded down to a power of two. */
+  assert_summary (&sequence, 0, G_MAXUINT64, 256, coarse,
+                  G_N_ELEMENTS (coarse));
+  assert_summary (&sequence, 0, G_MAXUINT64, 300, coarse,
+                  G_N_ELEMENTS (coarse));
+  assert_summary (&sequence, 0, G_MAXUINT64, 100, fine, G_N_ELEMENTS (fine));
+  assert_summary (&sequence, 64, 191, 64, &fine[1], 1);
+  assert_summary (&sequence, 100, 150, 16, spanning, G_N_ELEMENTS (spanning));
+  assert_summary (&sequence, 1000, 2000, 16, NULL, 0);
+
+  /* The last element’s duration may change until another is appended. */
+  data = dfl_time_sequence_get_last_element (&sequence, NULL);
+  data->duration = 50;
+  assert_summary (&sequence, 256, 400, 64, extended, G_N_ELEMENTS (extended));
+}
+
+/* Test that summaries of a larger sequence are consistent at all
+ * resolutions, whether they are precalculated or not. */
+static void
+test_time_sequence_summary_consistency (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  const guint n_elements = 1000;
+  guint i;
+  DflDuration resolution;
+
+  dfl_time_sequence_init (&sequence, sizeof (SummaryData), NULL, 0);
+  dfl_time_sequence_set_duration_offset (&sequence,
+                                         G_STRUCT_OFFSET (SummaryData,
+                                                          duration));
+  dfl_time_sequence_set_thread_id_offset (&sequence,
+                                          G_STRUCT_OFFSET (SummaryData,
+                                                           thread_id));
+
+  for (i = 0; i < n_elements; i++)
+    {
+      SummaryData *data;
+
+      data = dfl_time_sequence_append (&sequence, i * 100);
+      data->duration = (i % 7) * 10;
+      data->thread_id = (i % 3 == 0) ? 1 : 2;
+    }
+
+  for (resolution = 1; resolution <= 1 << 16; resolution *= 2)
+    {
+      g_autoptr (GArray) summaries = NULL;
+      guint total_elements = 0;
+      DflDuration total_busy_time = 0;
+      guint j;
+
+      g_test_message ("Resolution: %" G_GINT64_FORMAT, resolution);
+
+      summaries = dfl_time_sequence_dup_summary (&sequence, 0, G_MAXUINT64,
+                                                 resolution);
+
+      for (j = 0; j < summaries->len; j++)
+        {
+          const DflTimeSequenceSummary *summary;
+
+          summary = &g_array_index (summaries, DflTimeSequenceSummary, j);
+
+          g_assert_cmpint (summary->duration, ==, resolution);
+          g_assert_cmpuint (summary->start % resolution, ==, 0);
+          g_assert_cmpint (summary->busy_time, <=, summary->duration);
+          g_assert_cmpint (summary->max_duration, <=, 60);
+
+          if (j > 0)
+            g_assert_cmpuint (summary->start, >,
+                              g_array_index (summaries, DflTimeSequenceSummary,
+                                             j - 1).start);
+
+          total_elements += summary->n_elements;
+          total_busy_time += summary->busy_time;
+        }
+
+      g_assert_cmpuint (total_elements, ==, n_elements);
+      /* Sum of (i % 7) * 10 over all i. */
+      g_assert_cmpint (total_busy_time, ==, 29970);
+    }
+}
+
+/* Benchmark looking up timestamps in a large sequence, with runs of elements
+ * which have the same timestamp. This is only run in performance mode
+ * (`-m perf`). */
+static void
+test_time_sequence_perf_find (void)
+{
+  g_auto (DflTimeSequence) sequence;
+  const gsize n_elements = 1 << 22;
+  const guint n_runs = 4;  /* elements per timestamp */
+  const guint n_lookups = 1 << 20;
+  gsize i;
+  gdouble elapsed;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Performance tests not enabled; use -m perf");
+      return;
+    }
+
+  /* Use a typically sized payload. */
+  dfl_time_sequence_init (&sequence, 64, NULL, n_elements);
+
+  for (i = 0; i < n_elements; i++)
+    dfl_time_sequence_append (&sequence, (i / n_runs) * 10);
+
+  g_test_timer_start ();
+
+  for (i = 0; i < n_lookups; i++)
+    {
+      DflTimeSequenceIter iter;
+      DflTimestamp timestamp, found_timestamp;
+
+      timestamp = g_test_rand_int_range (0, (n_elements / n_runs) * 10);
+      dfl_time_sequence_iter_init (&iter, &sequence, timestamp);
+      g_assert_true (dfl_time_sequence_iter_next (&iter, &found_timestamp,
+                                                  NULL));
+      g_assert_cmpuint (found_timestamp, ==, timestamp - timestamp % 10);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed * 1e9 / n_lookups,
+                           "Lookup time: %.1f ns", elapsed * 1e9 / n_lookups);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -303,6 +888,16 @@ main (int argc, char *argv[])
   g_test_add_func ("/time-sequence/multiple", test_time_sequence_multiple);
   g_test_add_func ("/time-sequence/iter/multiple",
                    test_time_sequence_iter_multiple);
+  g_test_add_func ("/time-sequence/iter/duplicates",
+                   test_time_sequence_iter_duplicates);
+  g_test_add_func ("/time-sequence/iter/range", test_time_sequence_iter_range);
+  g_test_add_func ("/time-sequence/iter/overlapping",
+                   test_time_sequence_iter_overlapping);
+  g_test_add_func ("/time-sequence/merge-iter", test_time_sequence_merge_iter);
+  g_test_add_func ("/time-sequence/summary", test_time_sequence_summary);
+  g_test_add_func ("/time-sequence/summary/consistency",
+                   test_time_sequence_summary_consistency);
+  g_test_add_func ("/time-sequence/perf/find", test_time_sequence_perf_find);
 
   return g_test_run ();
 }
@@ -0,0 +1,272 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include <string.h>
+
+#include "parser.h"
+#include "writer.h"
+
+
+/* A text log containing a mixture of integer, symbol and string parameters,
+ * including some which must be stored as strings even though they look like
+ * integers. */
+static const gchar *test_log =
+  "Dunfell log,1.0,123\n"
+  "g_thread_spawned,124,1,0x7fb36210027e,1,Main thread\n"
+  "g_main_context_acquire,125,1,140407983871120,1\n"
+  "g_source_set_name,126,1,140408421089918,GDBus worker\n"
+  "g_source_set_name,127,2,140408421089919,007\n"
+  "g_main_context_release,128,1,140407983871120\n"
+  "g_main_context_acquire,129,2,140407983871120,18446744073709551615\n";
+
+static DflEventSequence *
+load_sequence (DflParser   *parser,
+               const gchar *data,
+               gsize        length)
+{
+  GError *error = NULL;
+
+  dfl_parser_load_from_data (parser, (const guint8 *) data, length, &error);
+  g_assert_no_error (error);
+
+  return dfl_parser_get_event_sequence (parser);
+}
+
+static GBytes *
+save_sequence (DflEventSequence *sequence)
+{
+  DflWriter *writer = NULL;
+  GOutputStream *stream = NULL;
+  GBytes *bytes = NULL;
+  GError *error = NULL;
+
+  writer = dfl_writer_new ();
+  stream = g_memory_output_stream_new_resizable ();
+
+  dfl_writer_save_to_stream (writer, sequence, stream, NULL, &error);
+  g_assert_no_error (error);
+
+  g_output_stream_close (stream, NULL, &error);
+  g_assert_no_error (error);
+
+  bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+
+  g_object_unref (stream);
+  g_object_unref (writer);
+
+  return bytes;
+}
+
+static void
+assert_sequences_equal (DflEventSequence *sequence1,
+                        DflEventSequence *sequence2)
+{
+  guint i, j, n_events;
+
+  n_events = g_list_model_get_n_items (G_LIST_MODEL (sequence1));
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (sequence2)), ==,
+                    n_events);
+  g_assert_cmpuint (dfl_event_sequence_get_initial_timestamp (sequence1), ==,
+                    dfl_event_sequence_get_initial_timestamp (sequence2));
+
+  for (i = 0; i < n_events; i++)
+    {
+      DflEvent *event1 = NULL, *event2 = NULL;
+
+      event1 = g_list_model_get_item (G_LIST_MODEL (sequence1), i);
+      event2 = g_list_model_get_item (G_LIST_MODEL (sequence2), i);
+
+      g_assert (dfl_event_get_event_type (event1) ==
+                dfl_event_get_event_type (event2));
+      g_assert_cmpuint (dfl_event_get_timestamp (event1), ==,
+                        dfl_event_get_timestamp (event2));
+      g_assert_cmpuint (dfl_event_get_thread_id (event1), ==,
+                        dfl_event_get_thread_id (event2));
+      g_assert_cmpuint (dfl_event_get_n_parameters (event1), ==,
+                        dfl_event_get_n_parameters (event2));
+
+      for (j = 0; j < dfl_event_get_n_parameters (event1); j++)
+        g_assert_cmpstr (dfl_event_get_parameter_utf8 (event1, j), ==,
+                         dfl_event_get_parameter_utf8 (event2, j));
+
+      g_object_unref (event2);
+      g_object_unref (event1);
+    }
+}
+
+/* Test that writing a sequence out in the binary format and reading it back in
+ * gives the same sequence. */
+static void
+test_writer_round_trip (void)
+{
+  DflParser *text_parser = NULL, *binary_parser = NULL;
+  DflEventSequence *text_sequence, *binary_sequence;
+  GBytes *bytes = NULL;
+  gconstpointer data;
+  gsize length;
+
+  text_parser = dfl_parser_new ();
+  text_sequence = load_sequence (text_parser, test_log, strlen (test_log));
+
+  bytes = save_sequence (text_sequence);
+  data = g_bytes_get_data (bytes, &length);
+
+  /* Check it is actually in the binary format. */
+  g_assert_cmpuint (length, >, 16);
+  g_assert (memcmp (data, "Dunfell log,2.0\n", 16) == 0);
+
+  binary_parser = dfl_parser_new ();
+  binary_sequence = load_sequence (binary_parser, data, length);
+
+  assert_sequences_equal (text_sequence, binary_sequence);
+
+  g_bytes_unref (bytes);
+  g_object_unref (binary_parser);
+  g_object_unref (text_parser);
+}
+
+/* Test that binary logs can also be loaded from a stream. */
+static void
+test_writer_round_trip_stream (void)
+{
+  DflParser *text_parser = NULL, *binary_parser = NULL;
+  DflEventSequence *text_sequence;
+  GInputStream *stream = NULL;
+  GBytes *bytes = NULL;
+  GError *error = NULL;
+
+  text_parser = dfl_parser_new ();
+  text_sequence = load_sequence (text_parser, test_log, strlen (test_log));
+
+  bytes = save_sequence (text_sequence);
+  stream = g_memory_input_stream_new_from_bytes (bytes);
+
+  binary_parser = dfl_parser_new ();
+  dfl_parser_load_from_stream (binary_parser, stream, NULL, &error);
+  g_assert_no_error (error);
+
+  assert_sequences_equal (text_sequence,
+                          dfl_parser_get_event_sequence (binary_parser));
+
+  g_object_unref (stream);
+  g_bytes_unref (bytes);
+  g_object_unref (binary_parser);
+  g_object_unref (text_parser);
+}
+
+/* Test that truncated binary logs are rejected. */
+static void
+test_writer_truncated (void)
+{
+  DflParser *text_parser = NULL;
+  DflEventSequence *text_sequence;
+  GBytes *bytes = NULL;
+  const guint8 *data;
+  gsize length, i;
+
+  text_parser = dfl_parser_new ();
+  text_sequence = load_sequence (text_parser, test_log, strlen (test_log));
+
+  bytes = save_sequence (text_sequence);
+  data = g_bytes_get_data (bytes, &length);
+
+  /* Truncations shorter than the magic are parsed as text and fail for other
+   * reasons; test everything after that. */
+  for (i = 16; i < length; i++)
+    {
+      DflParser *parser = NULL;
+      GError *error = NULL;
+
+      parser = dfl_parser_new ();
+      dfl_parser_load_from_data (parser, data, i, &error);
+      g_assert_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN);
+      g_assert_null (dfl_parser_get_event_sequence (parser));
+
+      g_error_free (error);
+      g_object_unref (parser);
+    }
+
+  g_bytes_unref (bytes);
+  g_object_unref (text_parser);
+}
+
+/* Test that an existing file is left unchanged if saving over it fails. Events
+ * of the same type with differing numbers of parameters cannot be saved, and
+ * this is detected before anything is written. */
+static void
+test_writer_save_to_file_error (void)
+{
+  DflEventSequence *sequence = NULL;
+  DflEvent *events[2] = { NULL, };
+  const gchar *parameters1[] = { "1", NULL };
+  const gchar *parameters2[] = { "1", "2", NULL };
+  DflWriter *writer = NULL;
+  const gchar *original = "Not a log\n";
+  gchar *filename = NULL, *contents = NULL;
+  gint fd;
+  GError *error = NULL;
+
+  events[0] = dfl_event_new ("g_thread_spawned", 1, 1, parameters1);
+  events[1] = dfl_event_new ("g_thread_spawned", 2, 1, parameters2);
+  sequence = dfl_event_sequence_new ((const DflEvent **) events,
+                                     G_N_ELEMENTS (events), 0);
+
+  fd = g_file_open_tmp ("dunfell-writer-XXXXXX", &filename, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+
+  g_file_set_contents (filename, original, -1, &error);
+  g_assert_no_error (error);
+
+  writer = dfl_writer_new ();
+  dfl_writer_save_to_file (writer, sequence, filename, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_UNKNOWN);
+  g_clear_error (&error);
+
+  g_file_get_contents (filename, &contents, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (contents, ==, original);
+
+  g_unlink (filename);
+
+  g_free (contents);
+  g_free (filename);
+  g_object_unref (writer);
+  g_object_unref (sequence);
+  g_object_unref (events[1]);
+  g_object_unref (events[0]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/writer/round-trip", test_writer_round_trip);
+  g_test_add_func ("/writer/round-trip/stream", test_writer_round_trip_stream);
+  g_test_add_func ("/writer/truncated", test_writer_truncated);
+  g_test_add_func ("/writer/save-to-file/error",
+                   test_writer_save_to_file_error);
+
+  return g_test_run ();
+}
@@ -36,6 +36,7 @@
 
 #include "event.h"
 #include "event-sequence.h"
+#include "factory-private.h"
 #include "thread.h"
 #include "time-sequence.h"
 
@@ -111,30 +112,41 @@ dfl_thread_new (DflThreadId   id,
   return thread;
 }
 
+typedef struct
+{
+  GPtrArray/*<owned DflThread>*/ *threads;  /* owned */
+  GHashTable/*<unowned DflThreadId*, guint>*/ *index;  /* owned */
+} ThreadFactory;
+
+static void
+thread_factory_free (ThreadFactory *factory)
+{
+  g_hash_table_unref (factory->index);
+  g_ptr_array_unref (factory->threads);
+  g_free (factory);
+}
+
 static void
 event_cb (DflEventSequence *sequence,
           DflEvent         *event,
           gpointer          user_data)
 {
-  GPtrArray/*<owned DflThread>*/ *threads = user_data;
+  ThreadFactory *factory = user_data;
   DflThread *thread = NULL;
   DflThreadId thread_id;
-  guint i;
+  gpointer thread_index;
   const gchar *name = NULL;
 
   thread_id = dfl_event_get_thread_id (event);
 
   /* Check the ID doesn’t already exist. If it does, update its final
    * timestamp. */
-  for (i = 0; i < threads->len; i++)
+  if (g_hash_table_lookup_extended (factory->index, &thread_id, NULL,
+                                    &thread_index))
     {
-      DflThread *t = threads->pdata[i];
-
-      if (t->id == thread_id)
-        {
-          t->free_timestamp = dfl_event_get_timestamp (event);
-          return;
-        }
+      thread = factory->threads->pdata[GPOINTER_TO_UINT (thread_index)];
+      thread->free_timestamp = dfl_event_get_timestamp (event);
+      return;
     }
 
   /* We can know the thread’s nickname if it was detected from a
@@ -144,7 +156,9 @@ event_cb (DflEventSequence *sequence,
     name = dfl_event_get_parameter_utf8 (event, 2);
 
   thread = dfl_thread_new (thread_id, dfl_event_get_timestamp (event), name);
-  g_ptr_array_add (threads, thread);  /* transfer */
+  g_hash_table_insert (factory->index, &thread->id,
+                       GUINT_TO_POINTER (factory->threads->len));
+  g_ptr_array_add (factory->threads, thread);  /* transfer */
 }
 
 /**
@@ -160,14 +174,28 @@ event_cb (DflEventSequence *sequence,
 GPtrArray *
 dfl_thread_factory_from_event_sequence (DflEventSequence *sequence)
 {
-  GPtrArray/*<owned DflThread>*/ *threads = NULL;
+  return _dfl_thread_factory_from_event_sequence (sequence, NULL);
+}
+
+GPtrArray *
+_dfl_thread_factory_from_event_sequence (DflEventSequence  *sequence,
+                                         GHashTable       **index_out)
+{
+  ThreadFactory *factory = NULL;
+
+  factory = g_new0 (ThreadFactory, 1);
+  factory->threads = g_ptr_array_new_with_free_func (g_object_unref);
+  /* Keys point to the #DflThread.id of the threads in the array, so remain
+   * valid as long as the array does. */
+  factory->index = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+  if (index_out != NULL)
+    *index_out = g_hash_table_ref (factory->index);
 
-  threads = g_ptr_array_new_with_free_func (g_object_unref);
   dfl_event_sequence_add_walker (sequence, NULL, DFL_ID_INVALID, event_cb,
-                                 g_ptr_array_ref (threads),
-                                 (GDestroyNotify) g_ptr_array_unref);
+                                 factory, (GDestroyNotify) thread_factory_free);
 
-  return threads;
+  return g_ptr_array_ref (factory->threads);
 }
 
 /**
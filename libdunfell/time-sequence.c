@@ -31,23 +31,27 @@
 
 #include <errno.h>
 #include <glib.h>
+#include <string.h>
 
 #include "time-sequence.h"
 
 
-typedef struct
-{
-  DflTimestamp timestamp;
-  guint8 data[];
-} DflTimeSequenceElement;
-
+/* Iterators refer to elements by index rather than by pointer, so that they
+ * remain valid if more elements are appended to the sequence (which may
+ * reallocate it) while the sequence is growing. */
 typedef struct
 {
   DflTimeSequence *sequence;
   gsize index;
-  DflTimeSequenceElement *last_returned_element;  /* (nullable) (ownership none) */
+  gsize last_returned_index;  /* %NO_ELEMENT if nothing has been returned */
+  /* Window for dfl_time_sequence_iter_init_range() and
+   * dfl_time_sequence_iter_next_overlapping(); inclusive. */
+  DflTimestamp window_start;
+  DflTimestamp window_end;
 } DflTimeSequenceIterReal;
 
+#define NO_ELEMENT G_MAXSIZE
+
 G_STATIC_ASSERT (sizeof (DflTimeSequenceIterReal) ==
                  sizeof (DflTimeSequenceIter));
 
@@ -56,15 +60,87 @@ G_DEFINE_BOXED_TYPE (DflTimeSequenceIter, dfl_time_sequence_iter,
 
 typedef struct
 {
-  gsize element_size;  /* does not include sizeof(DflTimeSequenceElement); in bytes */
+  gsize element_size;  /* in bytes */
   GDestroyNotify element_destroy_notify;
   gsize n_elements_valid;
   gsize n_elements_allocated;
-  gpointer *elements;  /* actually DflTimeSequenceElement+element_size */
+
+  /* The timestamps and data of the elements are stored in parallel arrays,
+   * so that searching by timestamp only touches @timestamps, which is dense
+   * in the cache. */
+  DflTimestamp *timestamps;  /* owned; @n_elements_allocated elements */
+  guint8 *data;  /* owned; @n_elements_allocated × @element_size bytes */
+
+  /* Interval index, used if @duration_offset is non-negative. This is a
+   * segment tree stored as an implicit binary heap: node 1 is the root, node
+   * i has children 2i and 2i + 1, and element i is leaf @n_leaves + i. Each
+   * node stores the latest end timestamp of the elements beneath it.
+   *
+   * Only the first @n_indexed elements are in the tree. It is extended lazily
+   * when queried, and never includes the last element, since that is the only
+   * one whose duration may still change. */
+  gssize duration_offset;  /* in bytes from the start of the element data */
+  DflTimestamp *max_ends;  /* owned; nullable; 2 * @n_leaves elements */
+  gsize n_leaves;
+  gsize n_indexed;
+
+  /* Summary pyramid, used by dfl_time_sequence_dup_summary(). Rebuilt lazily
+   * when the sequence has changed. */
+  gssize thread_id_offset;  /* in bytes from the start of the element data */
+  gpointer pyramid;  /* owned; nullable; actually a SummaryPyramid */
 } DflTimeSequenceReal;
 
 G_STATIC_ASSERT (sizeof (DflTimeSequenceReal) == sizeof (DflTimeSequence));
 
+/* Aggregate of the elements in one bucket of a #SummaryLevel. The dominant
+ * thread is found using a weighted Boyer–Moore majority vote, which can be
+ * merged between buckets without keeping per-thread totals. */
+typedef struct
+{
+  guint n_elements;
+  DflDuration busy_time;
+  DflDuration max_duration;
+  DflThreadId dominant_thread_id;
+  DflDuration dominant_thread_weight;
+} SummaryBucket;
+
+/* Buckets [@first_bucket, @first_bucket + @n_buckets), in units of the level’s
+ * bucket width. */
+typedef struct
+{
+  guint64 first_bucket;
+  gsize n_buckets;
+  SummaryBucket *buckets;  /* owned */
+} SummaryLevel;
+
+/* Level i of the pyramid has buckets 2^(@base_bits + i) microseconds wide,
+ * aligned to multiples of their width. The base width is chosen so that
+ * level 0 has at most about a quarter as many buckets as there are elements;
+ * each level above it has half as many buckets as the one below, up to a
+ * level with a single bucket. Summaries finer than level 0 are calculated
+ * from the elements directly. */
+typedef struct
+{
+  gsize n_elements;  /* number of elements summarised */
+  DflTimestamp last_element_end;  /* end of the last element when summarised */
+  DflTimestamp max_end;  /* latest instant covered by any element */
+  guint base_bits;
+  guint n_levels;
+  SummaryLevel levels[64];
+} SummaryPyramid;
+
+static void
+summary_pyramid_free (gpointer data)
+{
+  SummaryPyramid *pyramid = data;
+  guint i;
+
+  for (i = 0; i < pyramid->n_levels; i++)
+    g_free (pyramid->levels[i].buckets);
+
+  g_free (pyramid);
+}
+
 /**
  * dfl_time_sequence_init:
  * @sequence: an uninitialised #DflTimeSequence
@@ -86,47 +162,67 @@ dfl_time_sequence_init (DflTimeSequence *sequence,
   DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
 
   g_return_if_fail (sequence != NULL);
-  g_return_if_fail (element_size <= G_MAXSIZE - sizeof (DflTimeSequenceElement));
 
   self->element_size = element_size;
   self->element_destroy_notify = element_destroy_notify;
   self->n_elements_valid = 0;
   self->n_elements_allocated = n_elements_preallocated;
-  self->elements = g_malloc_n (n_elements_preallocated,
-                               sizeof (DflTimeSequenceElement) + element_size);
+  self->timestamps = g_new (DflTimestamp, n_elements_preallocated);
+  self->data = g_malloc_n (n_elements_preallocated, element_size);
+
+  self->duration_offset = -1;
+  self->max_ends = NULL;
+  self->n_leaves = 0;
+  self->n_indexed = 0;
+
+  self->thread_id_offset = -1;
+  self->pyramid = NULL;
 }
 
-static gboolean
-dfl_time_sequence_is_valid_element (DflTimeSequence        *sequence,
-                                    DflTimeSequenceElement *element)
+static inline DflTimestamp
+dfl_time_sequence_timestamp (DflTimeSequenceReal *self,
+                             gsize                index)
 {
-  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
-  gsize element_size;  /* size, in bytes, of a single element */
-  gsize elements_length;  /* length, in bytes, of the self->elements allocation */
+  g_assert (index < self->n_elements_valid);
 
-  element_size = sizeof (DflTimeSequenceElement) + self->element_size;
-  elements_length = self->n_elements_valid * element_size;
+  return self->timestamps[index];
+}
+
+static inline gpointer
+dfl_time_sequence_data (DflTimeSequenceReal *self,
+                        gsize                index)
+{
+  g_assert (index < self->n_elements_valid);
 
-  return ((guint8 *) element >= (guint8 *) self->elements &&
-          (guint8 *) element < (guint8 *) self->elements + elements_length &&
-          (((guint8 *) element - (guint8 *) self->elements) % element_size) == 0);
+  return self->data + index * self->element_size;
 }
 
-static DflTimeSequenceElement *
-dfl_time_sequence_index (DflTimeSequence *sequence,
-                         gsize            index)
+/* Find the first of the first @n_elements elements with a timestamp ≥
+ * @timestamp, and return its index; or return @n_elements if there is no such
+ * element. This is O(log n), and only touches the timestamps array. */
+static gsize
+dfl_time_sequence_lower_bound (DflTimeSequenceReal *self,
+                               gsize                n_elements,
+                               DflTimestamp         timestamp)
 {
-  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
-  gpointer element;
+  const DflTimestamp *first = self->timestamps;
 
-  g_assert (index < self->n_elements_valid);
+  while (n_elements > 0)
+    {
+      gsize half = n_elements / 2;
 
-  element = ((guint8 *) self->elements +
-             index * (sizeof (DflTimeSequenceElement) + self->element_size));
+      if (first[half] < timestamp)
+        {
+          first += half + 1;
+          n_elements -= half + 1;
+        }
+      else
+        {
+          n_elements = half;
+        }
+    }
 
-  g_return_val_if_fail (dfl_time_sequence_is_valid_element (sequence, element),
-                        NULL);
-  return (DflTimeSequenceElement *) element;
+  return first - self->timestamps;
 }
 
 /* Find the element with the largest timestamp ≤ @timestamp and return its
@@ -140,88 +236,38 @@ dfl_time_sequence_find_timestamp (DflTimeSequence *sequence,
                                   gsize           *index)
 {
   DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
-  gsize left_index, right_index, middle;
-  DflTimeSequenceElement *element, *prev_element, *next_element;
   gsize _index;
   gboolean valid;
 
-  /* Trivial cases. */
-  if (self->n_elements_valid == 0)
-    {
-      _index = 0;
-      valid = FALSE;
-      goto done;
-    }
+  _index = dfl_time_sequence_lower_bound (self, self->n_elements_valid,
+                                          timestamp);
 
-  if (timestamp == 0)
+  if (_index < self->n_elements_valid && self->timestamps[_index] == timestamp)
     {
-      _index = 0;
+      /* Exact match; @_index is already the first of the equal elements. */
       valid = TRUE;
-      goto done;
-    }
-
-  /* Binary search. */
-  left_index = 0;
-  right_index = self->n_elements_valid - 1;
-
-  do
-    {
-      middle = (left_index + right_index) / 2;  /* truncate */
-      element = dfl_time_sequence_index (sequence, middle);
-
-      if (element->timestamp > timestamp && middle > 0)
-        right_index = middle - 1;
-      else if (element->timestamp < timestamp && middle < G_MAXSIZE)
-        left_index = middle + 1;
-      else
-        break;
-    }
-  while (left_index <= right_index);
-
-  /* Work backwards until we find the first of the matching elements. (Multiple
-   * elements can have the same timestamp.) */
-  prev_element = (middle > 0) ? dfl_time_sequence_index (sequence, middle - 1) : NULL;
-
-  while (middle > 1 &&
-         (prev_element->timestamp >= timestamp ||
-          prev_element->timestamp == element->timestamp))
-    {
-      middle--;
-      element = prev_element;
-      prev_element = dfl_time_sequence_index (sequence, middle - 1);
     }
-
-  if (element->timestamp <= timestamp)
+  else if (_index == 0)
     {
-      _index = middle;
-      valid = TRUE;
+      /* All the elements are after @timestamp. */
+      valid = FALSE;
     }
   else
     {
-      _index = 0;
-      valid = FALSE;
+      /* The element before @_index has the largest timestamp < @timestamp;
+       * find the first element with that timestamp. */
+      _index = dfl_time_sequence_lower_bound (self, _index - 1,
+                                              self->timestamps[_index - 1]);
+      valid = TRUE;
     }
 
-done:
-  element = valid ? dfl_time_sequence_index (sequence, _index) : NULL;
-  prev_element = (_index > 0) ? dfl_time_sequence_index (sequence, _index - 1) : NULL;
-  next_element = (_index + 1 < self->n_elements_valid) ?
-                 dfl_time_sequence_index (sequence, _index + 1) : NULL;
-
   g_assert (valid || _index == 0);
-  g_assert (_index == 0 || element->timestamp <= timestamp);
-  g_assert (_index == 0 || prev_element->timestamp < timestamp);
-  g_assert (_index == 0 || prev_element->timestamp < element->timestamp);
-  g_assert (_index == 0 || _index + 1 == self->n_elements_valid ||
-            next_element->timestamp > timestamp ||
-            next_element->timestamp == element->timestamp);
-
-  if (valid)
-    g_debug ("%s: timestamp: %" G_GUINT64_FORMAT "; returning index: "
-             "%" G_GSIZE_FORMAT, G_STRFUNC, timestamp, _index);
-  else
-    g_debug ("%s: timestamp: %" G_GUINT64_FORMAT "; failure",
-             G_STRFUNC, timestamp);
+  g_assert (!valid || self->timestamps[_index] <= timestamp);
+  g_assert (!valid || _index == 0 ||
+            self->timestamps[_index - 1] < self->timestamps[_index]);
+  g_assert (!valid || _index + 1 == self->n_elements_valid ||
+            self->timestamps[_index + 1] > timestamp ||
+            self->timestamps[_index + 1] == self->timestamps[_index]);
 
   *index = _index;
   return valid;
@@ -246,18 +292,22 @@ dfl_time_sequence_clear (DflTimeSequence *sequence)
   if (self->element_destroy_notify != NULL)
     {
       for (i = 0; i < self->n_elements_valid; i++)
-        {
-          DflTimeSequenceElement *element;
-
-          element = dfl_time_sequence_index (sequence, i);
-          self->element_destroy_notify (element->data);
-        }
+        self->element_destroy_notify (dfl_time_sequence_data (self, i));
     }
 
-  g_free (self->elements);
-  self->elements = NULL;
+  g_free (self->timestamps);
+  self->timestamps = NULL;
+  g_free (self->data);
+  self->data = NULL;
   self->n_elements_valid = 0;
   self->n_elements_allocated = 0;
+
+  g_free (self->max_ends);
+  self->max_ends = NULL;
+  self->n_leaves = 0;
+  self->n_indexed = 0;
+
+  g_clear_pointer (&self->pyramid, summary_pyramid_free);
 }
 
 /**
@@ -306,11 +356,9 @@ dfl_time_sequence_get_last_element (DflTimeSequence *sequence,
     }
   else
     {
-      DflTimeSequenceElement *element;
-
-      element = dfl_time_sequence_index (sequence, self->n_elements_valid - 1);
-      element_data = element->data;
-      element_timestamp = element->timestamp;
+      element_data = dfl_time_sequence_data (self, self->n_elements_valid - 1);
+      element_timestamp = dfl_time_sequence_timestamp (self,
+                                                       self->n_elements_valid - 1);
     }
 
   if (timestamp != NULL)
@@ -341,7 +389,6 @@ dfl_time_sequence_append (DflTimeSequence *sequence,
   DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
   DflTimestamp last_timestamp;
   gpointer last_element;
-  DflTimeSequenceElement *element;
 
   g_return_val_if_fail (sequence != NULL, NULL);
   g_return_val_if_fail (self->n_elements_valid < G_MAXSIZE, NULL);
@@ -356,20 +403,532 @@ dfl_time_sequence_append (DflTimeSequence *sequence,
     {
       self->n_elements_allocated =
         ((gsize) 1 << (g_bit_nth_msf (self->n_elements_allocated, -1) + 1));
-      self->elements = g_realloc_n (self->elements, self->n_elements_allocated,
-                                    sizeof (DflTimeSequenceElement) +
-                                    self->element_size);
+      self->timestamps = g_renew (DflTimestamp, self->timestamps,
+                                  self->n_elements_allocated);
+      self->data = g_realloc_n (self->data, self->n_elements_allocated,
+                                self->element_size);
     }
 
   g_assert (self->n_elements_allocated > self->n_elements_valid);
 
   /* Append the new element. */
+  self->timestamps[self->n_elements_valid] = timestamp;
   self->n_elements_valid++;
 
-  element = dfl_time_sequence_index (sequence, self->n_elements_valid - 1);
-  element->timestamp = timestamp;
+  return dfl_time_sequence_data (self, self->n_elements_valid - 1);
+}
+
+/**
+ * dfl_time_sequence_set_duration_offset:
+ * @sequence: a #DflTimeSequence
+ * @duration_offset: offset of a #DflDuration field in the element data, in
+ *    bytes, as given by G_STRUCT_OFFSET()
+ *
+ * Declare that each element in the sequence is an interval, which starts at
+ * the element’s timestamp and lasts for the #DflDuration stored at
+ * @duration_offset in its data. A negative duration means the element is
+ * still in progress, and it is treated as having zero length.
+ *
+ * This allows dfl_time_sequence_iter_init_overlapping() to be used to find
+ * the elements which overlap a window, including those which started before
+ * it. The duration of an element may only change until the next element is
+ * appended to the sequence.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_set_duration_offset (DflTimeSequence *sequence,
+                                       gssize           duration_offset)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+
+  g_return_if_fail (sequence != NULL);
+  g_return_if_fail (duration_offset >= 0);
+  g_return_if_fail ((gsize) duration_offset + sizeof (DflDuration) <=
+                    self->element_size);
+
+  self->duration_offset = duration_offset;
+
+  /* Rebuild the index and summaries on the next query. */
+  g_clear_pointer (&self->max_ends, g_free);
+  self->n_leaves = 0;
+  self->n_indexed = 0;
+  g_clear_pointer (&self->pyramid, summary_pyramid_free);
+}
+
+/**
+ * dfl_time_sequence_set_thread_id_offset:
+ * @sequence: a #DflTimeSequence
+ * @thread_id_offset: offset of a #DflThreadId field in the element data, in
+ *    bytes, as given by G_STRUCT_OFFSET()
+ *
+ * Declare that each element in the sequence happened on the thread whose
+ * #DflThreadId is stored at @thread_id_offset in its data. This is used to
+ * calculate #DflTimeSequenceSummary.dominant_thread_id.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_set_thread_id_offset (DflTimeSequence *sequence,
+                                        gssize           thread_id_offset)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+
+  g_return_if_fail (sequence != NULL);
+  g_return_if_fail (thread_id_offset >= 0);
+  g_return_if_fail ((gsize) thread_id_offset + sizeof (DflThreadId) <=
+                    self->element_size);
+
+  self->thread_id_offset = thread_id_offset;
+
+  g_clear_pointer (&self->pyramid, summary_pyramid_free);
+}
+
+static DflTimestamp
+dfl_time_sequence_element_end (DflTimeSequenceReal *self,
+                               gsize                index)
+{
+  DflDuration duration;
+
+  memcpy (&duration,
+          (guint8 *) dfl_time_sequence_data (self, index) +
+          self->duration_offset,
+          sizeof (duration));
+
+  return dfl_time_sequence_timestamp (self, index) + MAX (duration, 0);
+}
+
+/* Add any elements which have been appended since the last query to the
+ * interval index, apart from the last element. This is O(log n) per new
+ * element, or O(n) if the tree has to be reallocated. */
+static void
+dfl_time_sequence_ensure_interval_index (DflTimeSequence *sequence)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+  gsize n_to_index, i;
+
+  g_assert (self->duration_offset >= 0);
+
+  n_to_index = (self->n_elements_valid > 0) ? self->n_elements_valid - 1 : 0;
+
+  if (self->n_indexed == n_to_index)
+    return;
+
+  if (n_to_index > self->n_leaves)
+    {
+      /* Grow the tree and rebuild it from scratch. */
+      self->n_leaves = MAX (self->n_leaves, 1);
+      while (self->n_leaves < n_to_index)
+        self->n_leaves *= 2;
+
+      g_free (self->max_ends);
+      self->max_ends = g_new0 (DflTimestamp, 2 * self->n_leaves);
+
+      for (i = 0; i < n_to_index; i++)
+        self->max_ends[self->n_leaves + i] =
+          dfl_time_sequence_element_end (self, i);
+      for (i = self->n_leaves - 1; i > 0; i--)
+        self->max_ends[i] = MAX (self->max_ends[2 * i],
+                                 self->max_ends[2 * i + 1]);
+    }
+  else
+    {
+      for (i = self->n_indexed; i < n_to_index; i++)
+        {
+          gsize node = self->n_leaves + i;
+          DflTimestamp end;
+
+          end = dfl_time_sequence_element_end (self, i);
+          self->max_ends[node] = end;
+
+          for (node /= 2; node > 0 && self->max_ends[node] < end; node /= 2)
+            self->max_ends[node] = end;
+        }
+    }
+
+  self->n_indexed = n_to_index;
+}
+
+/* Find the first indexed element at or after @from_index which ends at or
+ * after @start, and return its index in @index. Return %FALSE if there is no
+ * such element. This is O(log n). */
+static gboolean
+dfl_time_sequence_find_first_ending_after (DflTimeSequence *sequence,
+                                           gsize            from_index,
+                                           DflTimestamp     start,
+                                           gsize           *index)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+  gsize node;
+
+  if (from_index >= self->n_indexed)
+    return FALSE;
+
+  node = self->n_leaves + from_index;
+
+  /* Climb until reaching a subtree, to the right of @from_index, which
+   * contains a matching element. */
+  while (self->max_ends[node] < start)
+    {
+      /* Move up while @node is a right child, then across to the next
+       * subtree. The root is a right child of nothing. */
+      while (node % 2 == 1)
+        {
+          node /= 2;
+
+          if (node == 0)
+            return FALSE;
+        }
+
+      node++;
+    }
+
+  /* Descend to the leftmost matching leaf. */
+  while (node < self->n_leaves)
+    {
+      node *= 2;
+
+      if (self->max_ends[node] < start)
+        node++;
+    }
+
+  /* Unused leaves are zero, so may match; but they are after all the indexed
+   * elements. */
+  if (node - self->n_leaves >= self->n_indexed)
+    return FALSE;
+
+  *index = node - self->n_leaves;
+
+  return TRUE;
+}
+
+static DflThreadId
+dfl_time_sequence_element_thread_id (DflTimeSequenceReal *self,
+                                     gsize                index)
+{
+  DflThreadId thread_id;
+
+  if (self->thread_id_offset < 0)
+    return 0;
+
+  memcpy (&thread_id,
+          (guint8 *) dfl_time_sequence_data (self, index) +
+          self->thread_id_offset,
+          sizeof (thread_id));
+
+  return thread_id;
+}
+
+static void
+summary_bucket_vote (SummaryBucket *bucket,
+                     DflThreadId    thread_id,
+                     DflDuration    weight)
+{
+  if (bucket->dominant_thread_id == thread_id)
+    {
+      bucket->dominant_thread_weight += weight;
+    }
+  else if (bucket->dominant_thread_weight > weight)
+    {
+      bucket->dominant_thread_weight -= weight;
+    }
+  else
+    {
+      bucket->dominant_thread_id = thread_id;
+      bucket->dominant_thread_weight = weight - bucket->dominant_thread_weight;
+    }
+}
+
+static void
+summary_bucket_merge (SummaryBucket       *bucket,
+                      const SummaryBucket *other)
+{
+  bucket->n_elements += other->n_elements;
+  bucket->busy_time += other->busy_time;
+  bucket->max_duration = MAX (bucket->max_duration, other->max_duration);
+  summary_bucket_vote (bucket, other->dominant_thread_id,
+                       other->dominant_thread_weight);
+}
+
+/* Add the element starting at @timestamp to the buckets of width 2^@bits in
+ * @buckets which it overlaps. The element is only counted in
+ * #SummaryBucket.n_elements if it starts within @buckets. */
+static void
+summary_buckets_add_element (SummaryBucket *buckets,
+                             guint64        first_bucket,
+                             gsize          n_buckets,
+                             guint          bits,
+                             DflTimestamp   timestamp,
+                             DflDuration    duration,
+                             DflThreadId    thread_id)
+{
+  guint64 start_bucket, end_bucket, b;
+
+  duration = MAX (duration, 0);
+  start_bucket = timestamp >> bits;
+  end_bucket = (duration > 0) ? (timestamp + duration - 1) >> bits : start_bucket;
+
+  for (b = MAX (start_bucket, first_bucket);
+       b <= end_bucket && b < first_bucket + n_buckets;
+       b++)
+    {
+      SummaryBucket *bucket = &buckets[b - first_bucket];
+      DflTimestamp bucket_start, bucket_end, overlap_start, overlap_end;
+
+      bucket_start = b << bits;
+      bucket_end = (b + 1) << bits;
+      overlap_start = MAX (timestamp, bucket_start);
+      overlap_end = MIN (timestamp + duration, bucket_end);
+
+      if (b == start_bucket)
+        bucket->n_elements++;
+
+      bucket->busy_time += (overlap_end > overlap_start) ? overlap_end - overlap_start : 0;
+      bucket->max_duration = MAX (bucket->max_duration, duration);
+      summary_bucket_vote (bucket, thread_id,
+                           (overlap_end > overlap_start) ? overlap_end - overlap_start : 0);
+    }
+}
+
+/* Rebuild the summary pyramid if any elements have been appended, or the last
+ * element’s duration has changed, since it was last built. This is O(n). */
+static SummaryPyramid *
+dfl_time_sequence_ensure_pyramid (DflTimeSequence *sequence)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+  SummaryPyramid *pyramid = self->pyramid;
+  DflTimestamp last_element_end, first_timestamp, span;
+  SummaryLevel *level;
+  gsize i, target_n_buckets;
+
+  last_element_end = (self->n_elements_valid > 0) ?
+                     dfl_time_sequence_element_end (self,
+                                                    self->n_elements_valid - 1) : 0;
+
+  if (pyramid != NULL &&
+      pyramid->n_elements == self->n_elements_valid &&
+      pyramid->last_element_end == last_element_end)
+    return pyramid;
+
+  g_clear_pointer (&self->pyramid, summary_pyramid_free);
+  self->pyramid = pyramid = g_new0 (SummaryPyramid, 1);
+  pyramid->n_elements = self->n_elements_valid;
+  pyramid->last_element_end = last_element_end;
+
+  if (self->n_elements_valid == 0)
+    return pyramid;
+
+  /* Find the extent of the elements and choose the base bucket width. */
+  first_timestamp = dfl_time_sequence_timestamp (self, 0);
+  pyramid->max_end = first_timestamp;
+
+  for (i = 0; i < self->n_elements_valid; i++)
+    {
+      DflTimestamp end = dfl_time_sequence_element_end (self, i);
+
+      /* Element ends are exclusive here. */
+      if (end > dfl_time_sequence_timestamp (self, i))
+        end--;
+
+      pyramid->max_end = MAX (pyramid->max_end, end);
+    }
+
+  span = pyramid->max_end - first_timestamp + 1;
+  target_n_buckets = MAX (self->n_elements_valid / 4, 1);
+
+  while ((span >> pyramid->base_bits) > target_n_buckets)
+    pyramid->base_bits++;
+
+  /* Build level 0 from the elements. */
+  level = &pyramid->levels[0];
+  level->first_bucket = first_timestamp >> pyramid->base_bits;
+  level->n_buckets = (pyramid->max_end >> pyramid->base_bits) -
+                     level->first_bucket + 1;
+  level->buckets = g_new0 (SummaryBucket, level->n_buckets);
+  pyramid->n_levels = 1;
+
+  for (i = 0; i < self->n_elements_valid; i++)
+    {
+      DflTimestamp timestamp = dfl_time_sequence_timestamp (self, i);
+
+      summary_buckets_add_element (level->buckets, level->first_bucket,
+                                   level->n_buckets, pyramid->base_bits,
+                                   timestamp,
+                                   dfl_time_sequence_element_end (self, i) -
+                                   timestamp,
+                                   dfl_time_sequence_element_thread_id (self, i));
+    }
+
+  /* Build each level above by merging pairs of buckets from the one below. */
+  while (level->n_buckets > 1 &&
+         pyramid->n_levels < G_N_ELEMENTS (pyramid->levels))
+    {
+      SummaryLevel *next_level = &pyramid->levels[pyramid->n_levels];
+
+      next_level->first_bucket = level->first_bucket >> 1;
+      next_level->n_buckets = ((level->first_bucket + level->n_buckets - 1) >> 1) -
+                              next_level->first_bucket + 1;
+      next_level->buckets = g_new0 (SummaryBucket, next_level->n_buckets);
+
+      for (i = 0; i < level->n_buckets; i++)
+        summary_bucket_merge (&next_level->buckets[((level->first_bucket + i) >> 1) -
+                                                   next_level->first_bucket],
+                              &level->buckets[i]);
+
+      level = next_level;
+      pyramid->n_levels++;
+    }
+
+  return pyramid;
+}
+
+static void
+summary_buckets_append_non_empty (GArray              *summaries,
+                                  const SummaryBucket *buckets,
+                                  guint64              first_bucket,
+                                  gsize                n_buckets,
+                                  guint                bits)
+{
+  gsize i;
+
+  for (i = 0; i < n_buckets; i++)
+    {
+      const SummaryBucket *bucket = &buckets[i];
+      DflTimeSequenceSummary summary;
+
+      if (bucket->n_elements == 0 && bucket->busy_time == 0)
+        continue;
+
+      summary.start = (first_bucket + i) << bits;
+      summary.duration = (DflDuration) 1 << bits;
+      summary.n_elements = bucket->n_elements;
+      summary.busy_time = bucket->busy_time;
+      summary.max_duration = bucket->max_duration;
+      summary.dominant_thread_id = bucket->dominant_thread_id;
+
+      g_array_append_val (summaries, summary);
+    }
+}
+
+/**
+ * dfl_time_sequence_dup_summary:
+ * @sequence: a #DflTimeSequence; it must have had
+ *    dfl_time_sequence_set_duration_offset() called on it
+ * @start: start of the window to summarise, inclusive
+ * @end: end of the window to summarise, inclusive
+ * @resolution: desired width of each bucket in the summary, in microseconds
+ *
+ * Summarise the elements of @sequence in the window [@start, @end] by dividing
+ * it into buckets of equal width, and aggregating the elements in each. This
+ * is intended for rendering or analysing large sequences at a coarse
+ * resolution, where there are many elements per bucket.
+ *
+ * The bucket width is the largest power of two which is no greater than
+ * @resolution, and buckets are aligned to multiples of it, so the first and
+ * last buckets may extend beyond the window. Only non-empty buckets are
+ * returned, in order of increasing timestamp.
+ *
+ * Summaries are precalculated at all power of two resolutions coarser than
+ * about the mean spacing of the elements, so this takes time proportional to
+ * the number of buckets in the window. Finer summaries are calculated from
+ * the elements in the window. The precalculated summaries are rebuilt on the
+ * first call after the sequence changes, which is O(n).
+ *
+ * Returns: (transfer full) (element-type DflTimeSequenceSummary): summaries of
+ *    the non-empty buckets in the window
+ * Since: UNRELEASED
+ */
+GArray *
+dfl_time_sequence_dup_summary (DflTimeSequence *sequence,
+                               DflTimestamp     start,
+                               DflTimestamp     end,
+                               DflDuration      resolution)
+{
+  DflTimeSequenceReal *self = (DflTimeSequenceReal *) sequence;
+  SummaryPyramid *pyramid;
+  GArray *summaries = NULL;
+  guint bits;
+
+  g_return_val_if_fail (sequence != NULL, NULL);
+  g_return_val_if_fail (self->duration_offset >= 0, NULL);
+  g_return_val_if_fail (start <= end, NULL);
+  g_return_val_if_fail (resolution > 0, NULL);
+
+  summaries = g_array_new (FALSE, FALSE, sizeof (DflTimeSequenceSummary));
+  pyramid = dfl_time_sequence_ensure_pyramid (sequence);
+  bits = g_bit_nth_msf (resolution, -1);
+
+  if (pyramid->n_levels == 0)
+    return summaries;
+
+  if (bits >= pyramid->base_bits)
+    {
+      const SummaryLevel *level;
+      guint64 first_bucket, last_bucket;
+
+      /* Use the precalculated level. Coarser resolutions than the top level
+       * are clamped to it. */
+      if (bits - pyramid->base_bits >= pyramid->n_levels)
+        bits = pyramid->base_bits + pyramid->n_levels - 1;
+
+      level = &pyramid->levels[bits - pyramid->base_bits];
+      first_bucket = MAX (start >> bits, level->first_bucket);
+      last_bucket = MIN (end >> bits,
+                         level->first_bucket + level->n_buckets - 1);
+
+      if (first_bucket <= last_bucket)
+        summary_buckets_append_non_empty (summaries,
+                                          level->buckets +
+                                          (first_bucket - level->first_bucket),
+                                          first_bucket,
+                                          last_bucket - first_bucket + 1,
+                                          bits);
+    }
+  else
+    {
+      SummaryBucket *buckets = NULL;
+      guint64 first_bucket;
+      gsize n_buckets;
+      DflTimeSequenceIter iter;
+      DflTimestamp timestamp;
+
+      /* Calculate the summary from the elements in the window. Clamp the
+       * window to the elements first, so the number of buckets is
+       * bounded. */
+      end = MIN (end, pyramid->max_end);
+
+      if (start > end)
+        return summaries;
+
+      first_bucket = start >> bits;
+      n_buckets = (end >> bits) - first_bucket + 1;
+      buckets = g_new0 (SummaryBucket, n_buckets);
+
+      /* Include elements which overlap the parts of the first and last
+       * buckets outside the window. */
+      dfl_time_sequence_iter_init_overlapping (&iter, sequence,
+                                               first_bucket << bits,
+                                               ((first_bucket + n_buckets) << bits) - 1);
+
+      while (dfl_time_sequence_iter_next_overlapping (&iter, &timestamp, NULL))
+        {
+          gsize index = ((DflTimeSequenceIterReal *) &iter)->last_returned_index;
+
+          summary_buckets_add_element (buckets, first_bucket, n_buckets, bits,
+                                       timestamp,
+                                       dfl_time_sequence_element_end (self,
+                                                                      index) -
+                                       timestamp,
+                                       dfl_time_sequence_element_thread_id (self,
+                                                                            index));
+        }
+
+      summary_buckets_append_non_empty (summaries, buckets, first_bucket,
+                                        n_buckets, bits);
+      g_free (buckets);
+    }
 
-  return element->data;
+  return summaries;
 }
 
 static gboolean
@@ -381,9 +940,8 @@ dfl_time_sequence_iter_is_valid (DflTimeSequenceIter *iter)
   return (self != NULL &&
           self->sequence != NULL &&
           self->index <= sequence->n_elements_valid &&
-          (self->last_returned_element == NULL ||
-           dfl_time_sequence_is_valid_element (self->sequence,
-                                               self->last_returned_element)));
+          (self->last_returned_index == NO_ELEMENT ||
+           self->last_returned_index < sequence->n_elements_valid));
 }
 
 /**
@@ -407,10 +965,152 @@ dfl_time_sequence_iter_init (DflTimeSequenceIter *iter,
   g_return_if_fail (sequence != NULL);
 
   self->sequence = sequence;
-  self->last_returned_element = NULL;
+  self->last_returned_index = NO_ELEMENT;
+  self->window_start = 0;
+  self->window_end = G_MAXUINT64;
   dfl_time_sequence_find_timestamp (sequence, start, &self->index);
 }
 
+/**
+ * dfl_time_sequence_iter_init_range:
+ * @iter: an uninitialised #DflTimeSequenceIter
+ * @sequence: the #DflTimeSequence to iterate over
+ * @start: earliest timestamp to return, inclusive
+ * @end: latest timestamp to return, inclusive
+ *
+ * Initialise @iter to iterate over the elements of @sequence whose timestamps
+ * are in the range [@start, @end]. dfl_time_sequence_iter_next() will return
+ * the first element at or after @start, and will return %FALSE once it reaches
+ * an element after @end; similarly, dfl_time_sequence_iter_previous() will
+ * return %FALSE once it reaches an element before @start.
+ *
+ * Finding the start of the range is O(log n).
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_iter_init_range (DflTimeSequenceIter *iter,
+                                   DflTimeSequence     *sequence,
+                                   DflTimestamp         start,
+                                   DflTimestamp         end)
+{
+  DflTimeSequenceIterReal *self = (DflTimeSequenceIterReal *) iter;
+  DflTimeSequenceReal *sequence_real = (DflTimeSequenceReal *) sequence;
+
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (sequence != NULL);
+  g_return_if_fail (start <= end);
+
+  self->sequence = sequence;
+  self->last_returned_index = NO_ELEMENT;
+  self->window_start = start;
+  self->window_end = end;
+  self->index = dfl_time_sequence_lower_bound (sequence_real,
+                                               sequence_real->n_elements_valid,
+                                               start);
+}
+
+/**
+ * dfl_time_sequence_iter_init_overlapping:
+ * @iter: an uninitialised #DflTimeSequenceIter
+ * @sequence: the #DflTimeSequence to iterate over; it must have had
+ *    dfl_time_sequence_set_duration_offset() called on it
+ * @start: start of the window, inclusive
+ * @end: end of the window, inclusive
+ *
+ * Initialise @iter to iterate over the elements of @sequence which overlap the
+ * window [@start, @end], using dfl_time_sequence_iter_next_overlapping(). This
+ * includes elements which started before @start and had not finished by then.
+ *
+ * Iterating over all k overlapping elements takes O((k + 1) log n) time, however
+ * long the elements which started before the window are.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_iter_init_overlapping (DflTimeSequenceIter *iter,
+                                         DflTimeSequence     *sequence,
+                                         DflTimestamp         start,
+                                         DflTimestamp         end)
+{
+  DflTimeSequenceIterReal *self = (DflTimeSequenceIterReal *) iter;
+
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (sequence != NULL);
+  g_return_if_fail (((DflTimeSequenceReal *) sequence)->duration_offset >= 0);
+  g_return_if_fail (start <= end);
+
+  self->sequence = sequence;
+  self->index = 0;
+  self->last_returned_index = NO_ELEMENT;
+  self->window_start = start;
+  self->window_end = end;
+}
+
+/**
+ * dfl_time_sequence_iter_next_overlapping:
+ * @iter: a #DflTimeSequenceIter
+ * @timestamp: (out caller-allocates) (optional): return location for the
+ *    start timestamp of the next overlapping element
+ * @data: (out caller-allocates) (optional) (nullable): return location for the
+ *    data of the next overlapping element
+ *
+ * Advance @iter to the next element, in timestamp order, which overlaps the
+ * window given to dfl_time_sequence_iter_init_overlapping(), skipping any
+ * which do not.
+ *
+ * Returns: %TRUE if an element was returned, %FALSE if there are no more
+ *    overlapping elements
+ * Since: UNRELEASED
+ */
+gboolean
+dfl_time_sequence_iter_next_overlapping (DflTimeSequenceIter *iter,
+                                         DflTimestamp        *timestamp,
+                                         gpointer            *data)
+{
+  DflTimeSequenceIterReal *self = (DflTimeSequenceIterReal *) iter;
+  DflTimeSequenceReal *sequence;
+  gsize index;
+
+  g_return_val_if_fail (dfl_time_sequence_iter_is_valid (iter), FALSE);
+
+  sequence = (DflTimeSequenceReal *) self->sequence;
+  g_return_val_if_fail (sequence->duration_offset >= 0, FALSE);
+
+  dfl_time_sequence_ensure_interval_index (self->sequence);
+
+  index = self->index;
+
+  if (index < sequence->n_indexed &&
+      !dfl_time_sequence_find_first_ending_after (self->sequence, index,
+                                                  self->window_start, &index))
+    index = sequence->n_indexed;
+
+  /* Reached the end? The last element is not indexed, so check it directly. */
+  if (index >= sequence->n_elements_valid)
+    goto done;
+
+  if (dfl_time_sequence_timestamp (sequence, index) > self->window_end ||
+      dfl_time_sequence_element_end (sequence, index) < self->window_start)
+    goto done;
+
+  self->last_returned_index = index;
+  self->index = index + 1;
+
+  if (timestamp != NULL)
+    *timestamp = dfl_time_sequence_timestamp (sequence, index);
+  if (data != NULL)
+    *data = dfl_time_sequence_data (sequence, index);
+
+  return TRUE;
+
+done:
+  self->index = sequence->n_elements_valid;
+  self->last_returned_index = NO_ELEMENT;
+
+  return FALSE;
+}
+
 /**
  * dfl_time_sequence_iter_next:
  * @iter: a #DflTimeSequenceIter
@@ -429,27 +1129,26 @@ dfl_time_sequence_iter_next (DflTimeSequenceIter *iter,
 {
   DflTimeSequenceIterReal *self = (DflTimeSequenceIterReal *) iter;
   DflTimeSequenceReal *sequence;
-  DflTimeSequenceElement *element;
 
   g_return_val_if_fail (dfl_time_sequence_iter_is_valid (iter), FALSE);
 
   sequence = (DflTimeSequenceReal *) self->sequence;
 
-  /* Reached the end? */
-  if (self->index >= sequence->n_elements_valid)
+  /* Reached the end, or the end of the range? */
+  if (self->index >= sequence->n_elements_valid ||
+      dfl_time_sequence_timestamp (sequence, self->index) > self->window_end)
     {
-      self->last_returned_element = NULL;
+      self->last_returned_index = NO_ELEMENT;
       return FALSE;
     }
 
   /* Return the next element. */
-  element = dfl_time_sequence_index (self->sequence, self->index);
-  self->last_returned_element = element;
+  self->last_returned_index = self->index;
 
   if (timestamp != NULL)
-    *timestamp = element->timestamp;
+    *timestamp = dfl_time_sequence_timestamp (sequence, self->index);
   if (data != NULL)
-    *data = element->data;
+    *data = dfl_time_sequence_data (sequence, self->index);
 
   self->index++;
 
@@ -473,26 +1172,29 @@ dfl_time_sequence_iter_previous (DflTimeSequenceIter *iter,
                                  gpointer            *data)
 {
   DflTimeSequenceIterReal *self = (DflTimeSequenceIterReal *) iter;
-  DflTimeSequenceElement *element;
+  DflTimeSequenceReal *sequence;
 
   g_return_val_if_fail (dfl_time_sequence_iter_is_valid (iter), FALSE);
 
-  /* Reached the end? */
-  if (self->index == 0)
+  sequence = (DflTimeSequenceReal *) self->sequence;
+
+  /* Reached the start, or the start of the range? */
+  if (self->index == 0 ||
+      dfl_time_sequence_timestamp (sequence, self->index - 1) <
+      self->window_start)
     {
-      self->last_returned_element = NULL;
+      self->last_returned_index = NO_ELEMENT;
       return FALSE;
     }
 
   /* Return the previous element. */
   self->index--;
-  element = dfl_time_sequence_index (self->sequence, self->index);
-  self->last_returned_element = element;
+  self->last_returned_index = self->index;
 
   if (timestamp != NULL)
-    *timestamp = element->timestamp;
+    *timestamp = dfl_time_sequence_timestamp (sequence, self->index);
   if (data != NULL)
-    *data = element->data;
+    *data = dfl_time_sequence_data (sequence, self->index);
 
   return TRUE;
 }
@@ -521,7 +1223,9 @@ dfl_time_sequence_iter_copy (DflTimeSequenceIter *iter)
 
   new_iter_real->sequence = iter_real->sequence;
   new_iter_real->index = iter_real->index;
-  new_iter_real->last_returned_element = iter_real->last_returned_element;
+  new_iter_real->last_returned_index = iter_real->last_returned_index;
+  new_iter_real->window_start = iter_real->window_start;
+  new_iter_real->window_end = iter_real->window_end;
 
   return g_steal_pointer (&new_iter);
 }
@@ -591,10 +1295,11 @@ dfl_time_sequence_iter_get_timestamp (DflTimeSequenceIter *iter)
 
   g_return_val_if_fail (dfl_time_sequence_iter_is_valid (iter), 0);
 
-  if (self->last_returned_element == NULL)
+  if (self->last_returned_index == NO_ELEMENT)
     return 0;
 
-  return self->last_returned_element->timestamp;
+  return dfl_time_sequence_timestamp ((DflTimeSequenceReal *) self->sequence,
+                                      self->last_returned_index);
 }
 
 /**
@@ -615,8 +1320,253 @@ dfl_time_sequence_iter_get_data (DflTimeSequenceIter *iter)
 
   g_return_val_if_fail (dfl_time_sequence_iter_is_valid (iter), NULL);
 
-  if (self->last_returned_element == NULL)
+  if (self->last_returned_index == NO_ELEMENT)
     return NULL;
 
-  return self->last_returned_element->data;
+  return dfl_time_sequence_data ((DflTimeSequenceReal *) self->sequence,
+                                 self->last_returned_index);
+}
+
+/* Each sub-iterator of a merge iterator, along with the next element it will
+ * return. The entries form a binary min-heap, ordered by the timestamp of that
+ * element, then by the order the sub-iterators were added in. */
+typedef struct
+{
+  DflTimeSequenceIterReal iter;
+  gpointer user_data;
+  DflThreadId thread_id;  /* 0 to return elements from all threads */
+  guint order;
+  DflTimestamp timestamp;
+  gpointer data;
+} MergeEntry;
+
+typedef struct
+{
+  GArray/*<MergeEntry>*/ *heap;  /* owned */
+  guint n_added;
+} DflTimeSequenceMergeIterReal;
+
+G_STATIC_ASSERT (sizeof (DflTimeSequenceMergeIterReal) ==
+                 sizeof (DflTimeSequenceMergeIter));
+
+static inline gboolean
+merge_entry_is_before (const MergeEntry *a,
+                       const MergeEntry *b)
+{
+  return (a->timestamp < b->timestamp ||
+          (a->timestamp == b->timestamp && a->order < b->order));
+}
+
+/* Advance @entry’s sub-iterator to its next element which matches its thread
+ * filter. Return %FALSE if it has no more elements. */
+static gboolean
+merge_entry_advance (MergeEntry *entry)
+{
+  DflTimeSequenceReal *sequence = (DflTimeSequenceReal *) entry->iter.sequence;
+
+  while (dfl_time_sequence_iter_next ((DflTimeSequenceIter *) &entry->iter,
+                                      &entry->timestamp, &entry->data))
+    {
+      if (entry->thread_id == 0 ||
+          dfl_time_sequence_element_thread_id (sequence,
+                                               entry->iter.last_returned_index) ==
+          entry->thread_id)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+merge_heap_sift_up (GArray *heap,
+                    guint   index)
+{
+  MergeEntry *entries = (MergeEntry *) heap->data;
+
+  while (index > 0)
+    {
+      guint parent = (index - 1) / 2;
+      MergeEntry tmp;
+
+      if (!merge_entry_is_before (&entries[index], &entries[parent]))
+        break;
+
+      tmp = entries[index];
+      entries[index] = entries[parent];
+      entries[parent] = tmp;
+      index = parent;
+    }
+}
+
+static void
+merge_heap_sift_down (GArray *heap,
+                      guint   index)
+{
+  MergeEntry *entries = (MergeEntry *) heap->data;
+
+  while (TRUE)
+    {
+      guint child = 2 * index + 1;
+      MergeEntry tmp;
+
+      if (child >= heap->len)
+        break;
+      if (child + 1 < heap->len &&
+          merge_entry_is_before (&entries[child + 1], &entries[child]))
+        child++;
+      if (!merge_entry_is_before (&entries[child], &entries[index]))
+        break;
+
+      tmp = entries[index];
+      entries[index] = entries[child];
+      entries[child] = tmp;
+      index = child;
+    }
+}
+
+/**
+ * dfl_time_sequence_merge_iter_init:
+ * @iter: an uninitialised #DflTimeSequenceMergeIter
+ *
+ * Initialise @iter with no sub-iterators. Add them using
+ * dfl_time_sequence_merge_iter_add().
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_merge_iter_init (DflTimeSequenceMergeIter *iter)
+{
+  DflTimeSequenceMergeIterReal *self = (DflTimeSequenceMergeIterReal *) iter;
+
+  g_return_if_fail (iter != NULL);
+
+  self->heap = g_array_new (FALSE, FALSE, sizeof (MergeEntry));
+  self->n_added = 0;
+}
+
+/**
+ * dfl_time_sequence_merge_iter_clear:
+ * @iter: an initialised #DflTimeSequenceMergeIter
+ *
+ * Free the contents of @iter. It may be re-initialised afterwards.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_merge_iter_clear (DflTimeSequenceMergeIter *iter)
+{
+  DflTimeSequenceMergeIterReal *self = (DflTimeSequenceMergeIterReal *) iter;
+
+  g_return_if_fail (iter != NULL);
+
+  g_clear_pointer (&self->heap, g_array_unref);
+}
+
+/**
+ * dfl_time_sequence_merge_iter_add:
+ * @iter: a #DflTimeSequenceMergeIter
+ * @sub_iter: an initialised #DflTimeSequenceIter, such as from
+ *    dfl_time_sequence_iter_init_range(); it is copied
+ * @thread_id: ID of the thread to return elements of @sub_iter from, or 0 to
+ *    return them all
+ * @user_data: (nullable): data to return alongside the elements from
+ *    @sub_iter, such as the object which owns its sequence
+ *
+ * Add the elements which @sub_iter would return from
+ * dfl_time_sequence_iter_next() to @iter. Elements with equal timestamps are
+ * returned in the order their sub-iterators were added.
+ *
+ * If @thread_id is non-zero, only elements whose thread ID equals it are
+ * returned, and the sequence must have had
+ * dfl_time_sequence_set_thread_id_offset() called on it. The elements on other
+ * threads are still stepped over one by one, so callers which only want one
+ * thread should avoid adding sub-iterators which have no elements on it.
+ *
+ * This is O(log k) in the number of sub-iterators. It must not be called after
+ * dfl_time_sequence_merge_iter_next().
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_time_sequence_merge_iter_add (DflTimeSequenceMergeIter *iter,
+                                  DflTimeSequenceIter      *sub_iter,
+                                  DflThreadId               thread_id,
+                                  gpointer                  user_data)
+{
+  DflTimeSequenceMergeIterReal *self = (DflTimeSequenceMergeIterReal *) iter;
+  DflTimeSequenceIterReal *sub_iter_real = (DflTimeSequenceIterReal *) sub_iter;
+  MergeEntry entry;
+
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (dfl_time_sequence_iter_is_valid (sub_iter));
+  g_return_if_fail (thread_id == 0 ||
+                    ((DflTimeSequenceReal *) sub_iter_real->sequence)->thread_id_offset >= 0);
+
+  entry.iter = *sub_iter_real;
+  entry.user_data = user_data;
+  entry.thread_id = thread_id;
+  entry.order = self->n_added++;
+
+  /* Drop sub-iterators which are already exhausted. */
+  if (!merge_entry_advance (&entry))
+    return;
+
+  g_array_append_val (self->heap, entry);
+  merge_heap_sift_up (self->heap, self->heap->len - 1);
+}
+
+/**
+ * dfl_time_sequence_merge_iter_next:
+ * @iter: a #DflTimeSequenceMergeIter
+ * @timestamp: (out caller-allocates) (optional): return location for the
+ *    timestamp of the next element
+ * @data: (out caller-allocates) (optional) (nullable): return location for the
+ *    data of the next element
+ * @user_data: (out caller-allocates) (optional) (nullable): return location
+ *    for the user data passed to dfl_time_sequence_merge_iter_add() with the
+ *    sub-iterator the element came from
+ *
+ * Advance @iter to the next element, in timestamp order, from any of its
+ * sub-iterators. Iterating over all k elements from m sub-iterators takes
+ * O(k log m) time.
+ *
+ * Returns: %TRUE if an element was returned, %FALSE if there are no more
+ *    elements
+ * Since: UNRELEASED
+ */
+gboolean
+dfl_time_sequence_merge_iter_next (DflTimeSequenceMergeIter *iter,
+                                   DflTimestamp             *timestamp,
+                                   gpointer                 *data,
+                                   gpointer                 *user_data)
+{
+  DflTimeSequenceMergeIterReal *self = (DflTimeSequenceMergeIterReal *) iter;
+  MergeEntry *top;
+
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (self->heap != NULL, FALSE);
+
+  if (self->heap->len == 0)
+    return FALSE;
+
+  top = &g_array_index (self->heap, MergeEntry, 0);
+
+  if (timestamp != NULL)
+    *timestamp = top->timestamp;
+  if (data != NULL)
+    *data = top->data;
+  if (user_data != NULL)
+    *user_data = top->user_data;
+
+  /* Replace the top entry’s element with its sub-iterator’s next one, or drop
+   * the sub-iterator if it is exhausted. */
+  if (!merge_entry_advance (top))
+    {
+      *top = g_array_index (self->heap, MergeEntry, self->heap->len - 1);
+      g_array_set_size (self->heap, self->heap->len - 1);
+    }
+
+  merge_heap_sift_down (self->heap, 0);
+
+  return TRUE;
 }
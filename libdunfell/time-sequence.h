@@ -37,7 +37,7 @@ G_BEGIN_DECLS
  */
 typedef struct
 {
-  gpointer dummy[5];
+  gpointer dummy[12];
 } DflTimeSequence;
 
 void dfl_time_sequence_init (DflTimeSequence *sequence,
@@ -52,6 +52,45 @@ gpointer dfl_time_sequence_get_last_element (DflTimeSequence *sequence,
 gpointer dfl_time_sequence_append           (DflTimeSequence *sequence,
                                              DflTimestamp     timestamp);
 
+void     dfl_time_sequence_set_duration_offset  (DflTimeSequence *sequence,
+                                                 gssize           duration_offset);
+void     dfl_time_sequence_set_thread_id_offset (DflTimeSequence *sequence,
+                                                 gssize           thread_id_offset);
+
+/**
+ * DflTimeSequenceSummary:
+ * @start: timestamp of the start of the bucket
+ * @duration: length of the bucket, in microseconds; always a power of two
+ * @n_elements: number of elements which start in the bucket
+ * @busy_time: total time within the bucket covered by elements, in
+ *    microseconds; overlapping elements are counted separately, so this may
+ *    exceed @duration
+ * @max_duration: longest duration of any element which overlaps the bucket, in
+ *    microseconds
+ * @dominant_thread_id: thread which most of @busy_time was spent on, if any
+ *    thread accounts for a majority of it; otherwise one of the busiest
+ *    threads. This is 0 if the sequence has no thread ID offset set.
+ *
+ * Summary of the elements of a #DflTimeSequence in one bucket of time, as
+ * returned by dfl_time_sequence_dup_summary().
+ *
+ * Since: UNRELEASED
+ */
+typedef struct
+{
+  DflTimestamp start;
+  DflDuration duration;
+  guint n_elements;
+  DflDuration busy_time;
+  DflDuration max_duration;
+  DflThreadId dominant_thread_id;
+} DflTimeSequenceSummary;
+
+GArray  *dfl_time_sequence_dup_summary (DflTimeSequence *sequence,
+                                        DflTimestamp     start,
+                                        DflTimestamp     end,
+                                        DflDuration      resolution);
+
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (DflTimeSequence, dfl_time_sequence_clear)
 
 /**
@@ -60,11 +99,14 @@ G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (DflTimeSequence, dfl_time_sequence_clear)
  * All the fields in this structure are private. Use
  * dfl_time_sequence_iter_init() to initialise an already-allocated iterator.
  *
+ * An iterator remains valid if more elements are appended to its sequence.
+ *
  * Since: 0.1.0
  */
 typedef struct
 {
   gpointer dummy[3];
+  guint64 dummy_window[2];
 } DflTimeSequenceIter;
 
 GType dfl_time_sequence_iter_get_type (void);
@@ -79,6 +121,19 @@ gboolean dfl_time_sequence_iter_previous (DflTimeSequenceIter *iter,
                                           DflTimestamp        *timestamp,
                                           gpointer            *data);
 
+void     dfl_time_sequence_iter_init_range (DflTimeSequenceIter *iter,
+                                            DflTimeSequence     *sequence,
+                                            DflTimestamp         start,
+                                            DflTimestamp         end);
+
+void     dfl_time_sequence_iter_init_overlapping (DflTimeSequenceIter *iter,
+                                                  DflTimeSequence     *sequence,
+                                                  DflTimestamp         start,
+                                                  DflTimestamp         end);
+gboolean dfl_time_sequence_iter_next_overlapping (DflTimeSequenceIter *iter,
+                                                  DflTimestamp        *timestamp,
+                                                  gpointer            *data);
+
 DflTimeSequenceIter *dfl_time_sequence_iter_copy          (DflTimeSequenceIter *iter);
 void                 dfl_time_sequence_iter_free          (DflTimeSequenceIter *iter);
 
@@ -90,6 +145,39 @@ gpointer             dfl_time_sequence_iter_get_data      (DflTimeSequenceIter *
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (DflTimeSequenceIter, dfl_time_sequence_iter_free)
 
+/**
+ * DflTimeSequenceMergeIter:
+ *
+ * All the fields in this structure are private. Use
+ * dfl_time_sequence_merge_iter_init() to initialise an already-allocated
+ * iterator, and dfl_time_sequence_merge_iter_clear() to free its contents.
+ *
+ * A merge iterator combines several #DflTimeSequenceIters, potentially over
+ * different sequences, and returns all their elements in timestamp order.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct
+{
+  gpointer dummy;
+  guint dummy_n;
+} DflTimeSequenceMergeIter;
+
+void     dfl_time_sequence_merge_iter_init  (DflTimeSequenceMergeIter *iter);
+void     dfl_time_sequence_merge_iter_clear (DflTimeSequenceMergeIter *iter);
+
+void     dfl_time_sequence_merge_iter_add   (DflTimeSequenceMergeIter *iter,
+                                             DflTimeSequenceIter      *sub_iter,
+                                             DflThreadId               thread_id,
+                                             gpointer                  user_data);
+gboolean dfl_time_sequence_merge_iter_next  (DflTimeSequenceMergeIter *iter,
+                                             DflTimestamp             *timestamp,
+                                             gpointer                 *data,
+                                             gpointer                 *user_data);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (DflTimeSequenceMergeIter,
+                                  dfl_time_sequence_merge_iter_clear)
+
 G_END_DECLS
 
 #endif /* !DFL_TIME_SEQUENCE_H */
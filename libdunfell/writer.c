@@ -0,0 +1,457 @@
+/* vim:set et sw=2 cin cino=t0,f0,(0,{s,>2s,n-s,^-s,e2s: */
+/*
+ * Copyright © Philip Withnall 2016 <philip@tecnocode.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:writer
+ * @short_description: Dunfell binary log file writer
+ * @stability: Unstable
+ * @include: libdunfell/writer.h
+ *
+ * A #DflWriter serialises a #DflEventSequence to version 2.0 of the log
+ * format, which is a compact binary format. Logs in this format can be loaded
+ * using #DflParser, in the same way as text logs.
+ *
+ * # Binary Log Format # {#binary-log-format}
+ *
+ * All integers are little-endian. A binary log consists of, in order:
+ *
+ *  - A 40-byte header: the 16-byte magic `Dunfell log,2.0\n`, then the
+ *    initial timestamp (guint64), the number of events (guint64), the number
+ *    of strings (guint32) and the number of event types (guint32).
+ *  - The string table: for each string, its length in bytes (guint32) followed
+ *    by that many bytes of UTF-8, with no nul terminator or padding.
+ *  - The event type table: for each event type, the index of its name in the
+ *    string table (guint32), its number of parameters (guint32), and a bitmask
+ *    (guint32) which has bit i set if parameter i is stored as a string table
+ *    index rather than as an unsigned integer.
+ *  - The events: for each event, its timestamp (guint64), thread ID (guint64),
+ *    event type index (guint32) and 4 reserved bytes which must be zero,
+ *    followed by a guint64 for each of the event type’s parameters.
+ *
+ * Each event record therefore has a fixed width for its event type. A
+ * parameter is stored as an integer if, for every event of that type, it is a
+ * decimal integer with no leading zeros which fits in a guint64; this
+ * guarantees it can be converted back to exactly the same string.
+ *
+ * Since: UNRELEASED
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#include "binary-log.h"
+#include "event.h"
+#include "event-sequence.h"
+#include "writer.h"
+
+
+struct _DflWriter
+{
+  GObject parent;
+};
+
+G_DEFINE_TYPE (DflWriter, dfl_writer, G_TYPE_OBJECT)
+
+static void
+dfl_writer_class_init (DflWriterClass *klass)
+{
+  /* Nothing to see here. */
+}
+
+static void
+dfl_writer_init (DflWriter *self)
+{
+  /* Nothing to see here. */
+}
+
+/**
+ * dfl_writer_new:
+ *
+ * Create a new #DflWriter.
+ *
+ * Returns: (transfer full): a new #DflWriter
+ * Since: UNRELEASED
+ */
+DflWriter *
+dfl_writer_new (void)
+{
+  return g_object_new (DFL_TYPE_WRITER, NULL);
+}
+
+typedef struct
+{
+  const gchar *event_type;  /* unowned, interned */
+  guint32 index;
+  guint n_parameters;
+  guint32 string_parameters;  /* bitmask of parameters stored as strings */
+} EventTypeData;
+
+/* Whether @str can be stored as an integer and converted back to exactly the
+ * same string. */
+static gboolean
+is_canonical_uint64 (const gchar *str)
+{
+  guint64 value = 0;
+  const gchar *i;
+
+  if (str[0] == '\0' || (str[0] == '0' && str[1] != '\0'))
+    return FALSE;
+
+  for (i = str; *i != '\0'; i++)
+    {
+      guint digit;
+
+      if (!g_ascii_isdigit (*i))
+        return FALSE;
+
+      digit = *i - '0';
+
+      if (value > (G_MAXUINT64 - digit) / 10)
+        return FALSE;
+
+      value = value * 10 + digit;
+    }
+
+  return TRUE;
+}
+
+static void
+append_uint32 (GByteArray *buffer,
+               guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (buffer, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_uint64 (GByteArray *buffer,
+               guint64     value)
+{
+  value = GUINT64_TO_LE (value);
+  g_byte_array_append (buffer, (const guint8 *) &value, sizeof (value));
+}
+
+/* Write out the contents of @buffer if it has grown large enough (or
+ * unconditionally if @force is %TRUE), and empty it. */
+static gboolean
+flush_buffer (GByteArray     *buffer,
+              gboolean        force,
+              GOutputStream  *stream,
+              GCancellable   *cancellable,
+              GError        **error)
+{
+  if (!force && buffer->len < 64 * 1024)
+    return TRUE;
+
+  if (!g_output_stream_write_all (stream, buffer->data, buffer->len, NULL,
+                                  cancellable, error))
+    return FALSE;
+
+  g_byte_array_set_size (buffer, 0);
+
+  return TRUE;
+}
+
+/* Add a copy of @str to the string table if it’s not already there, and return
+ * its index. */
+static guint32
+add_string (GHashTable   *strings,
+            GPtrArray    *string_array,
+            const gchar  *str)
+{
+  gpointer index;
+  gchar *copy = NULL;
+
+  if (g_hash_table_lookup_extended (strings, str, NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  copy = g_strdup (str);
+  g_hash_table_insert (strings, copy, GUINT_TO_POINTER (string_array->len));
+  g_ptr_array_add (string_array, copy);
+
+  return string_array->len - 1;
+}
+
+/**
+ * dfl_writer_save_to_stream:
+ * @self: a #DflWriter
+ * @sequence: event sequence to save
+ * @stream: output stream to write the log to
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Serialise @sequence to @stream in the binary log format. See
+ * [the format documentation](#binary-log-format). The @stream is not closed.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_writer_save_to_stream (DflWriter         *self,
+                           DflEventSequence  *sequence,
+                           GOutputStream     *stream,
+                           GCancellable      *cancellable,
+                           GError           **error)
+{
+  GHashTable/*<unowned utf8, owned EventTypeData>*/ *event_types = NULL;
+  GPtrArray/*<unowned EventTypeData>*/ *event_type_array = NULL;
+  GHashTable/*<owned utf8, guint32>*/ *strings = NULL;
+  GPtrArray/*<unowned utf8>*/ *string_array = NULL;
+  GByteArray *buffer = NULL;
+  guint i, j, n_events;
+  GError *child_error = NULL;
+
+  g_return_if_fail (DFL_IS_WRITER (self));
+  g_return_if_fail (DFL_IS_EVENT_SEQUENCE (sequence));
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (error == NULL || *error == NULL);
+
+  event_types = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                       g_free);
+  event_type_array = g_ptr_array_new ();
+  strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  string_array = g_ptr_array_new ();
+  buffer = g_byte_array_new ();
+
+  n_events = g_list_model_get_n_items (G_LIST_MODEL (sequence));
+
+  /* Work out the event types, and which of their parameters have to be stored
+   * as strings. */
+  for (i = 0; i < n_events; i++)
+    {
+      g_autoptr (DflEvent) event = NULL;
+      const gchar *event_type;
+      EventTypeData *data;
+      guint n_parameters;
+
+      event = g_list_model_get_item (G_LIST_MODEL (sequence), i);
+      event_type = dfl_event_get_event_type (event);
+      n_parameters = dfl_event_get_n_parameters (event);
+
+      data = g_hash_table_lookup (event_types, event_type);
+
+      if (data == NULL)
+        {
+          if (n_parameters > DFL_BINARY_LOG_MAX_PARAMETERS)
+            {
+              /* TODO: Use a proper error code here. */
+              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                           "Event type ‘%s’ has too many parameters (%u) to "
+                           "be written", event_type, n_parameters);
+              goto done;
+            }
+
+          data = g_new0 (EventTypeData, 1);
+          data->event_type = event_type;
+          data->index = event_type_array->len;
+          data->n_parameters = n_parameters;
+          data->string_parameters = 0;
+
+          g_hash_table_insert (event_types, (gpointer) event_type, data);
+          g_ptr_array_add (event_type_array, data);
+        }
+      else if (data->n_parameters != n_parameters)
+        {
+          /* TODO: Use a proper error code here. */
+          g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                       "Events of type ‘%s’ have differing numbers of "
+                       "parameters", event_type);
+          goto done;
+        }
+
+      for (j = 0; j < n_parameters; j++)
+        {
+          const gchar *parameter = dfl_event_get_parameter_utf8 (event, j);
+
+          if (parameter == NULL)
+            {
+              /* TODO: Use a proper error code here. */
+              g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_UNKNOWN,
+                           "Event %u has an invalid parameter", i);
+              goto done;
+            }
+
+          if (!is_canonical_uint64 (parameter))
+            data->string_parameters |= (1u << j);
+        }
+    }
+
+  /* Build the string table. The events are created on demand, and may format
+   * their parameters on demand, so the strings are copied. */
+  for (i = 0; i < event_type_array->len; i++)
+    {
+      const EventTypeData *data = event_type_array->pdata[i];
+      add_string (strings, string_array, data->event_type);
+    }
+
+  for (i = 0; i < n_events; i++)
+    {
+      g_autoptr (DflEvent) event = NULL;
+      const EventTypeData *data;
+
+      event = g_list_model_get_item (G_LIST_MODEL (sequence), i);
+      data = g_hash_table_lookup (event_types,
+                                  dfl_event_get_event_type (event));
+
+      for (j = 0; j < data->n_parameters; j++)
+        {
+          if (data->string_parameters & (1u << j))
+            add_string (strings, string_array,
+                        dfl_event_get_parameter_utf8 (event, j));
+        }
+    }
+
+  /* Header. */
+  g_byte_array_append (buffer, (const guint8 *) DFL_BINARY_LOG_MAGIC,
+                       DFL_BINARY_LOG_MAGIC_LENGTH);
+  append_uint64 (buffer, dfl_event_sequence_get_initial_timestamp (sequence));
+  append_uint64 (buffer, n_events);
+  append_uint32 (buffer, string_array->len);
+  append_uint32 (buffer, event_type_array->len);
+
+  /* String table. */
+  for (i = 0; i < string_array->len; i++)
+    {
+      const gchar *str = string_array->pdata[i];
+      gsize length = strlen (str);
+
+      append_uint32 (buffer, length);
+      g_byte_array_append (buffer, (const guint8 *) str, length);
+
+      if (!flush_buffer (buffer, FALSE, stream, cancellable, &child_error))
+        goto done;
+    }
+
+  /* Event type table. */
+  for (i = 0; i < event_type_array->len; i++)
+    {
+      const EventTypeData *data = event_type_array->pdata[i];
+
+      append_uint32 (buffer, add_string (strings, string_array,
+                                         data->event_type));
+      append_uint32 (buffer, data->n_parameters);
+      append_uint32 (buffer, data->string_parameters);
+    }
+
+  /* Events. */
+  for (i = 0; i < n_events; i++)
+    {
+      g_autoptr (DflEvent) event = NULL;
+      const EventTypeData *data;
+
+      event = g_list_model_get_item (G_LIST_MODEL (sequence), i);
+      data = g_hash_table_lookup (event_types,
+                                  dfl_event_get_event_type (event));
+
+      append_uint64 (buffer, dfl_event_get_timestamp (event));
+      append_uint64 (buffer, dfl_event_get_thread_id (event));
+      append_uint32 (buffer, data->index);
+      append_uint32 (buffer, 0);  /* reserved */
+
+      for (j = 0; j < data->n_parameters; j++)
+        {
+          const gchar *parameter = dfl_event_get_parameter_utf8 (event, j);
+
+          if (data->string_parameters & (1u << j))
+            append_uint64 (buffer, add_string (strings, string_array,
+                                               parameter));
+          else
+            append_uint64 (buffer, g_ascii_strtoull (parameter, NULL, 10));
+        }
+
+      if (!flush_buffer (buffer, FALSE, stream, cancellable, &child_error))
+        goto done;
+    }
+
+  flush_buffer (buffer, TRUE, stream, cancellable, &child_error);
+
+done:
+  if (child_error != NULL)
+    g_propagate_error (error, child_error);
+
+  g_byte_array_unref (buffer);
+  g_ptr_array_unref (string_array);
+  g_hash_table_unref (strings);
+  g_ptr_array_unref (event_type_array);
+  g_hash_table_unref (event_types);
+}
+
+/**
+ * dfl_writer_save_to_file:
+ * @self: a #DflWriter
+ * @sequence: event sequence to save
+ * @filename: path to the file to save the log to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Serialise @sequence to @filename in the binary log format, replacing the
+ * file if it already exists. See dfl_writer_save_to_stream(). If an error
+ * occurs, any existing file is left unchanged.
+ *
+ * Since: UNRELEASED
+ */
+void
+dfl_writer_save_to_file (DflWriter         *self,
+                         DflEventSequence  *sequence,
+                         const gchar       *filename,
+                         GError           **error)
+{
+  GFile *file = NULL;
+  GFileOutputStream *stream = NULL;
+  GError *child_error = NULL;
+
+  g_return_if_fail (DFL_IS_WRITER (self));
+  g_return_if_fail (DFL_IS_EVENT_SEQUENCE (sequence));
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (error == NULL || *error == NULL);
+
+  file = g_file_new_for_path (filename);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION,
+                           NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return;
+
+  dfl_writer_save_to_stream (self, sequence, G_OUTPUT_STREAM (stream), NULL,
+                             &child_error);
+
+  /* Always close the stream, but report the first error. If saving failed,
+   * close it with a cancelled #GCancellable, so that any existing file is
+   * kept rather than replaced with a partial log. */
+  if (child_error == NULL)
+    {
+      g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, &child_error);
+    }
+  else
+    {
+      GCancellable *cancellable = NULL;
+
+      cancellable = g_cancellable_new ();
+      g_cancellable_cancel (cancellable);
+      g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, NULL);
+      g_object_unref (cancellable);
+    }
+
+  if (child_error != NULL)
+    g_propagate_error (error, child_error);
+
+  g_object_unref (stream);
+}
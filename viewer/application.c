@@ -39,6 +39,8 @@
 
 
 static void dfv_application_activate (GApplication *application);
+static gint dfv_application_handle_local_options (GApplication *application,
+                                                  GVariantDict *options);
 static void dfv_application_open (GApplication  *application,
                                   GFile        **files,
                                   gint           n_files,
@@ -59,6 +61,8 @@ static void quit_action_cb (GSimpleAction *action,
 struct _DfvApplication
 {
   GtkApplication parent;
+
+  gboolean follow;  /* whether to follow files opened from the command line */
 };
 
 G_DEFINE_TYPE (DfvApplication, dfv_application, GTK_TYPE_APPLICATION)
@@ -69,6 +73,7 @@ dfv_application_class_init (DfvApplicationClass *klass)
   GApplicationClass *application_class = G_APPLICATION_CLASS (klass);
 
   application_class->activate = dfv_application_activate;
+  application_class->handle_local_options = dfv_application_handle_local_options;
   application_class->open = dfv_application_open;
 }
 
@@ -81,12 +86,35 @@ dfv_application_init (DfvApplication *self)
     { "about", about_action_cb, NULL, NULL, NULL },
     { "quit", quit_action_cb, NULL, NULL, NULL },
   };
+  const GOptionEntry options[] = {
+    { "follow", 'f', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL,
+      N_("Keep loading new events as they are written to the log files"),
+      NULL },
+    { NULL, },
+  };
 
   g_set_application_name (_("Dunfell Viewer"));
 
   /* Set up actions. */
   g_action_map_add_action_entries (G_ACTION_MAP (self), actions,
                                    G_N_ELEMENTS (actions), self);
+
+  /* Set up command line options. */
+  g_application_add_main_option_entries (G_APPLICATION (self), options);
+}
+
+static gint
+dfv_application_handle_local_options (GApplication *application,
+                                      GVariantDict *options)
+{
+  DfvApplication *self = DFV_APPLICATION (application);
+
+  /* This is only used if this process becomes the primary instance; the
+   * option is not forwarded to an existing instance. */
+  self->follow = g_variant_dict_contains (options, "follow");
+
+  /* Continue with the default command line handling. */
+  return -1;
 }
 
 static void
@@ -105,14 +133,20 @@ dfv_application_open (GApplication  *application,
                       gint           n_files,
                       const gchar   *hint)
 {
+  DfvApplication *self = DFV_APPLICATION (application);
   guint i;
 
   for (i = 0; i < (guint) n_files; i++)
     {
       GtkWindow *window = NULL;
 
-      window = GTK_WINDOW (dfv_viewer_window_new_for_file (GTK_APPLICATION (application),
-                                                           files[i]));
+      /* Set #DfvViewerWindow:follow before #DfvViewerWindow:file, as setting
+       * the file starts loading it. */
+      window = g_object_new (DFV_TYPE_VIEWER_WINDOW,
+                             "application", application,
+                             "follow", self->follow,
+                             "file", files[i],
+                             NULL);
       gtk_widget_show (GTK_WIDGET (window));
     }
 }
@@ -91,8 +91,13 @@ struct _DfvViewerWindow
 {
   GtkApplicationWindow parent;
 
-  GCancellable *open_cancellable;  /* owned; non-NULL iff loading a file */
+  GCancellable *open_cancellable;  /* owned; non-NULL iff loading or analysing a file */
   GFile *file;  /* owned; NULL iff no file is loaded */
+  DflParser *parser;  /* owned; non-NULL iff parsing a file */
+  guint64 file_size;  /* in bytes; 0 if unknown */
+  DflModel *model;  /* owned; NULL iff no events have been loaded */
+  gboolean follow;  /* whether to follow files as they are written */
+  guint update_lists_id;  /* source ID of a queued list update; 0 if none */
 
   GtkStack *main_stack;
   GtkWidget *timeline_scrolled_window;
@@ -120,6 +125,10 @@ struct _DfvViewerWindow
   GtkCellRenderer *sources_median_dispatch_duration_renderer;
   GtkTreeViewColumn *sources_max_dispatch_duration_column;
   GtkCellRenderer *sources_max_dispatch_duration_renderer;
+  GtkTreeViewColumn *sources_p90_dispatch_duration_column;
+  GtkCellRenderer *sources_p90_dispatch_duration_renderer;
+  GtkTreeViewColumn *sources_p99_dispatch_duration_column;
+  GtkCellRenderer *sources_p99_dispatch_duration_renderer;
 
   /* Tasks tree view. */
   GtkTreeView *tasks_tree_view;
@@ -138,6 +147,7 @@ G_DEFINE_TYPE (DfvViewerWindow, dfv_viewer_window, GTK_TYPE_APPLICATION_WINDOW)
 typedef enum
 {
   PROP_FILE = 1,
+  PROP_FOLLOW,
 } DfvViewerWindowProperty;
 
 static void
@@ -190,6 +200,14 @@ dfv_viewer_window_class_init (DfvViewerWindowClass *klass)
                                         sources_max_dispatch_duration_column);
   gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
                                         sources_max_dispatch_duration_renderer);
+  gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
+                                        sources_p90_dispatch_duration_column);
+  gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
+                                        sources_p90_dispatch_duration_renderer);
+  gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
+                                        sources_p99_dispatch_duration_column);
+  gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
+                                        sources_p99_dispatch_duration_renderer);
 
   gtk_widget_class_bind_template_child (widget_class, DfvViewerWindow,
                                         tasks_tree_view);
@@ -233,6 +251,25 @@ dfv_viewer_window_class_init (DfvViewerWindowClass *klass)
                                                         G_TYPE_FILE,
                                                         G_PARAM_READWRITE |
                                                         G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DfvViewerWindow:follow:
+   *
+   * Whether to keep loading new events from #DfvViewerWindow:file as they are
+   * written to it, for viewing a log while it is being recorded. Changing
+   * this takes effect the next time a file is loaded.
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_FOLLOW,
+                                   g_param_spec_boolean ("follow",
+                                                         "Follow",
+                                                         "Whether to follow "
+                                                         "the file as it is "
+                                                         "written.",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -307,6 +344,16 @@ dfv_viewer_window_init (DfvViewerWindow *self)
                                            number_renderer_cb,
                                            GINT_TO_POINTER (15)  /* column index */,
                                            NULL);
+  gtk_tree_view_column_set_cell_data_func (self->sources_p90_dispatch_duration_column,
+                                           self->sources_p90_dispatch_duration_renderer,
+                                           number_renderer_cb,
+                                           GINT_TO_POINTER (16)  /* column index */,
+                                           NULL);
+  gtk_tree_view_column_set_cell_data_func (self->sources_p99_dispatch_duration_column,
+                                           self->sources_p99_dispatch_duration_renderer,
+                                           number_renderer_cb,
+                                           GINT_TO_POINTER (17)  /* column index */,
+                                           NULL);
 
   /* Set up the tasks tree view. */
   gtk_tree_view_column_set_cell_data_func (self->tasks_address_column,
@@ -349,6 +396,9 @@ dfv_viewer_window_get_property (GObject     *object,
     case PROP_FILE:
       g_value_set_object (value, self->file);
       break;
+    case PROP_FOLLOW:
+      g_value_set_boolean (value, self->follow);
+      break;
     default:
       g_assert_not_reached ();
     }
@@ -367,6 +417,13 @@ dfv_viewer_window_set_property (GObject           *object,
     case PROP_FILE:
       dfv_viewer_window_set_file (self, g_value_get_object (value));
       break;
+    case PROP_FOLLOW:
+      if (self->follow != g_value_get_boolean (value))
+        {
+          self->follow = g_value_get_boolean (value);
+          g_object_notify_by_pspec (object, pspec);
+        }
+      break;
     default:
       g_assert_not_reached ();
     }
@@ -561,7 +618,7 @@ void
 dfv_viewer_window_open (DfvViewerWindow *self,
                         GFile           *file)
 {
-  GtkWidget *dialog;
+  GtkWidget *dialog, *follow_check_button;
 
   g_return_if_fail (DFV_IS_VIEWER_WINDOW (self));
   g_return_if_fail (file == NULL || G_IS_FILE (file));
@@ -578,10 +635,25 @@ dfv_viewer_window_open (DfvViewerWindow *self,
                                             GTK_RESPONSE_ACCEPT,
                                             NULL);
 
+      follow_check_button = gtk_check_button_new_with_mnemonic (_("_Follow the log as it is recorded"));
+      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (follow_check_button),
+                                    self->follow);
+      gtk_file_chooser_set_extra_widget (GTK_FILE_CHOOSER (dialog),
+                                         follow_check_button);
+
       if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT)
-        file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+        {
+          GtkToggleButton *toggle_button = GTK_TOGGLE_BUTTON (follow_check_button);
+
+          file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+          g_object_set (self,
+                        "follow", gtk_toggle_button_get_active (toggle_button),
+                        NULL);
+        }
       else
-        file = NULL;
+        {
+          file = NULL;
+        }
 
       gtk_widget_destroy (dialog);
     }
@@ -624,7 +696,9 @@ dfv_viewer_window_record (DfvViewerWindow *self)
                                    _("Record an application by running it "
                                      "under dunfell-record, then open the "
                                      "resulting /tmp/dunfell.log log file "
-                                     "here."));
+                                     "here. To view the log while it is "
+                                     "being recorded, select ‘Follow the log "
+                                     "as it is recorded’ when opening it."));
   gtk_dialog_run (GTK_DIALOG (dialog));
   gtk_widget_destroy (dialog);
 }
@@ -668,9 +742,22 @@ static void set_file_cb1 (GObject      *source_object,
 static void set_file_cb2 (GObject      *source_object,
                           GAsyncResult *result,
                           gpointer      user_data);
+static void set_file_follow_cb (GObject      *source_object,
+                                GAsyncResult *result,
+                                gpointer      user_data);
+static void model_new_cb (GObject      *source_object,
+                          GAsyncResult *result,
+                          gpointer      user_data);
 static void set_file_cb_name (GObject      *source_object,
                               GAsyncResult *result,
                               gpointer      user_data);
+static void parser_notify_event_sequence_cb   (GObject    *object,
+                                               GParamSpec *pspec,
+                                               gpointer    user_data);
+static void parser_notify_bytes_processed_cb (GObject    *object,
+                                               GParamSpec *pspec,
+                                               gpointer    user_data);
+static void dfv_viewer_window_update_lists (DfvViewerWindow *self);
 
 static void
 info_bar_response_cb (GtkInfoBar *info_bar,
@@ -686,6 +773,26 @@ info_bar_response_cb (GtkInfoBar *info_bar,
                         GTK_WIDGET (info_bar));
 }
 
+/* Stop following the progress of the parser for the file being loaded, if
+ * any. */
+static void
+dfv_viewer_window_clear_parser (DfvViewerWindow *self)
+{
+  if (self->update_lists_id != 0)
+    {
+      g_source_remove (self->update_lists_id);
+      self->update_lists_id = 0;
+    }
+
+  if (self->parser == NULL)
+    return;
+
+  g_signal_handlers_disconnect_by_data (self->parser, self);
+  g_clear_object (&self->parser);
+
+  gtk_header_bar_set_subtitle (self->header_bar, NULL);
+}
+
 /* If @error is non-%NULL, an error infobar will be shown to indicate what went
  * wrong. */
 static void
@@ -723,6 +830,7 @@ dfv_viewer_window_clear_file (DfvViewerWindow *self,
 
   g_cancellable_cancel (self->open_cancellable);
   g_clear_object (&self->open_cancellable);
+  dfv_viewer_window_clear_parser (self);
 
   g_clear_object (&self->file);
   g_object_notify (G_OBJECT (self), "file");
@@ -733,6 +841,8 @@ dfv_viewer_window_clear_file (DfvViewerWindow *self,
   gtk_stack_set_visible_child_name (self->main_stack, "intro");
 
   g_clear_pointer (&self->timeline, gtk_widget_destroy);
+  g_clear_pointer (&self->statistics_pane, gtk_widget_destroy);
+  g_clear_object (&self->model);
 }
 
 static void
@@ -755,6 +865,8 @@ dfv_viewer_window_set_file (DfvViewerWindow *self,
 
   g_cancellable_cancel (self->open_cancellable);
   g_set_object (&self->open_cancellable, cancellable);
+  dfv_viewer_window_clear_parser (self);
+  self->file_size = 0;
 
   /* Query the file’s name for the window title. */
   g_file_query_info_async (file, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
@@ -777,6 +889,7 @@ set_file_cb1 (GObject      *source_object,
   GFile *file;
   g_autoptr (DflParser) parser = NULL;
   g_autoptr (GFileInputStream) stream = NULL;
+  g_autoptr (GFileInfo) file_info = NULL;
   g_autoptr (GError) error = NULL;
 
   file = G_FILE (source_object);
@@ -790,12 +903,263 @@ set_file_cb1 (GObject      *source_object,
       return;
     }
 
-  /* Parse the log into an event sequence. */
+  /* Find out how big the file is, so loading progress can be shown. This has
+   * to be done before parsing starts, as the stream can only have one
+   * operation pending at once. Failure is not a problem: the progress will be
+   * shown without the total. A file which is being followed has no final
+   * size. */
+  if (!self->follow)
+    {
+      file_info = g_file_input_stream_query_info (stream,
+                                                  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                                  self->open_cancellable,
+                                                  NULL);
+      self->file_size = (file_info != NULL) ?
+                        g_file_info_get_size (file_info) : 0;
+    }
+
+  /* Parse the log into an event sequence. The timeline is shown as soon as the
+   * first batch of events has been parsed, and is updated as the rest of the
+   * log is parsed. */
   parser = dfl_parser_new ();
+  g_set_object (&self->parser, parser);
+
+  g_signal_connect (parser, "notify::event-sequence",
+                    (GCallback) parser_notify_event_sequence_cb, self);
+  g_signal_connect (parser, "notify::bytes-processed",
+                    (GCallback) parser_notify_bytes_processed_cb, self);
+
+  if (self->follow)
+    dfl_parser_follow_stream_async (parser, G_INPUT_STREAM (stream),
+                                    self->open_cancellable,
+                                    set_file_follow_cb, self);
+  else
+    dfl_parser_load_from_stream_async (parser, G_INPUT_STREAM (stream),
+                                       self->open_cancellable,
+                                       set_file_cb2, self);
+}
+
+static void
+add_expanded_row_cb (GtkTreeView *tree_view,
+                     GtkTreePath *path,
+                     gpointer     user_data)
+{
+  GList **expanded_rows = user_data;
+
+  *expanded_rows = g_list_prepend (*expanded_rows, gtk_tree_path_copy (path));
+}
+
+/* Replace the model in @tree_view with @model, keeping the expanded rows,
+ * selection and scroll position. The sources and tasks models only ever have
+ * rows appended to them, so the paths from the old model are still valid in
+ * the new one. */
+static void
+tree_view_replace_model (GtkTreeView  *tree_view,
+                         GtkTreeModel *model)
+{
+  GtkTreeSelection *selection;
+  GList *expanded_rows = NULL;  /* (element-type GtkTreePath) */
+  GList *selected_rows = NULL;  /* (element-type GtkTreePath) */
+  GList *l;
+  GtkTreePath *start_path = NULL;
+
+  selection = gtk_tree_view_get_selection (tree_view);
+
+  if (gtk_tree_view_get_model (tree_view) != NULL)
+    {
+      gtk_tree_view_map_expanded_rows (tree_view, add_expanded_row_cb,
+                                       &expanded_rows);
+      selected_rows = gtk_tree_selection_get_selected_rows (selection, NULL);
+      gtk_tree_view_get_visible_range (tree_view, &start_path, NULL);
+    }
+
+  gtk_tree_view_set_model (tree_view, model);
+
+  for (l = expanded_rows; l != NULL; l = l->next)
+    gtk_tree_view_expand_to_path (tree_view, l->data);
+  for (l = selected_rows; l != NULL; l = l->next)
+    gtk_tree_selection_select_path (selection, l->data);
+  if (start_path != NULL)
+    gtk_tree_view_scroll_to_cell (tree_view, start_path, NULL, TRUE, 0.0, 0.0);
+
+  g_clear_pointer (&start_path, gtk_tree_path_free);
+  g_list_free_full (selected_rows, (GDestroyNotify) gtk_tree_path_free);
+  g_list_free_full (expanded_rows, (GDestroyNotify) gtk_tree_path_free);
+}
+
+/* Populate the sources and tasks lists from the model. */
+static void
+dfv_viewer_window_update_lists (DfvViewerWindow *self)
+{
+  g_autoptr (DwlSourceModel) source_model = NULL;
+  g_autoptr (DwlTaskModel) task_model = NULL;
+  g_autoptr (GPtrArray) sources = NULL;  /* (element-type DflSource) */
+  g_autoptr (GPtrArray) tasks = NULL;  /* (element-type DflTask) */
+
+  sources = dfl_model_dup_sources (self->model);
+  source_model = dwl_source_model_new (sources);
+  tree_view_replace_model (self->sources_tree_view,
+                           GTK_TREE_MODEL (source_model));
+
+  tasks = dfl_model_dup_tasks (self->model);
+  task_model = dwl_task_model_new (tasks);
+  tree_view_replace_model (self->tasks_tree_view,
+                           GTK_TREE_MODEL (task_model));
+}
+
+/* Interval between updates of the sources and tasks lists while following a
+ * file. Rebuilding them is proportional to the size of the whole model, so is
+ * not done for every batch of events. */
+#define FOLLOW_UPDATE_LISTS_INTERVAL_S 5
+
+static gboolean
+update_lists_cb (gpointer user_data)
+{
+  DfvViewerWindow *self = DFV_VIEWER_WINDOW (user_data);
+
+  self->update_lists_id = 0;
+
+  if (self->model != NULL)
+    dfv_viewer_window_update_lists (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Update the sources and tasks lists within the next
+ * %FOLLOW_UPDATE_LISTS_INTERVAL_S, unless an update is already queued. */
+static void
+dfv_viewer_window_queue_update_lists (DfvViewerWindow *self)
+{
+  if (self->update_lists_id != 0)
+    return;
+
+  self->update_lists_id = g_timeout_add_seconds (FOLLOW_UPDATE_LISTS_INTERVAL_S,
+                                                 update_lists_cb, self);
+}
+
+/* Create and show the timeline and statistics widgets for the model. These
+ * update themselves as more events are loaded into the model. */
+static void
+dfv_viewer_window_show_model (DfvViewerWindow *self)
+{
+  g_clear_pointer (&self->timeline, gtk_widget_destroy);
+  g_clear_pointer (&self->statistics_pane, gtk_widget_destroy);
+
+  self->timeline = GTK_WIDGET (dwl_timeline_new (self->model));
+  gtk_container_add (GTK_CONTAINER (self->timeline_scrolled_window),
+                     self->timeline);
+  gtk_widget_show (self->timeline);
+
+  self->statistics_pane = GTK_WIDGET (dwl_statistics_pane_new (self->model));
+  gtk_paned_pack2 (self->main_paned, self->statistics_pane, FALSE, FALSE);
+  gtk_widget_show (self->statistics_pane);
+
+  gtk_stack_set_visible_child_name (self->file_stack, "timeline");
+  gtk_stack_set_visible_child_name (self->main_stack, "file");
+  gtk_widget_grab_focus (self->timeline);
+}
+
+static void
+parser_notify_event_sequence_cb (GObject    *object,
+                                 GParamSpec *pspec,
+                                 gpointer    user_data)
+{
+  DfvViewerWindow *self = DFV_VIEWER_WINDOW (user_data);
+  DflParser *parser = DFL_PARSER (object);
+
+  /* The first batch of events has been parsed. Analyse them in a worker
+   * thread, as this can take a while. Later batches are analysed as they are
+   * added to the model. */
+  g_clear_object (&self->model);
+  dfl_model_new_async (dfl_parser_get_event_sequence (parser),
+                       self->open_cancellable, model_new_cb, self);
+}
+
+static void
+model_new_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  DfvViewerWindow *self;
+  g_autoptr (DflModel) model = NULL;
+  g_autoptr (GError) error = NULL;
 
-  dfl_parser_load_from_stream_async (parser, G_INPUT_STREAM (stream),
-                                     self->open_cancellable,
-                                     set_file_cb2, self);
+  model = dfl_model_new_finish (result, &error);
+
+  /* Cancellation means the file has been closed, or another one opened, so
+   * there is nothing to do. */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  self = DFV_VIEWER_WINDOW (user_data);
+
+  if (error != NULL)
+    {
+      dfv_viewer_window_clear_file (self, error);
+      return;
+    }
+
+  self->model = g_steal_pointer (&model);
+  dfv_viewer_window_show_model (self);
+
+  /* If the file has finished loading already, the analysis is complete. A
+   * followed file never finishes loading, so show what has been loaded so
+   * far; the lists are updated periodically from then on. */
+  if (self->parser == NULL)
+    {
+      g_clear_object (&self->open_cancellable);
+      dfv_viewer_window_update_lists (self);
+    }
+  else if (self->follow)
+    {
+      dfv_viewer_window_update_lists (self);
+    }
+}
+
+static void
+parser_notify_bytes_processed_cb (GObject    *object,
+                                  GParamSpec *pspec,
+                                  gpointer    user_data)
+{
+  DfvViewerWindow *self = DFV_VIEWER_WINDOW (user_data);
+  DflParser *parser = DFL_PARSER (object);
+  guint64 bytes_processed;
+  g_autofree gchar *subtitle = NULL;
+
+  bytes_processed = dfl_parser_get_bytes_processed (parser);
+
+  if (self->follow)
+    {
+      g_autofree gchar *size = NULL;
+
+      /* Each batch of events from a followed file has been added to the model
+       * by now (if it has been created yet), so queue a refresh of the lists
+       * to include any new sources and tasks. */
+      if (self->model != NULL)
+        dfv_viewer_window_queue_update_lists (self);
+
+      size = g_format_size (bytes_processed);
+      /* Translators: The placeholder is an amount of data, like ‘5 MB’. */
+      subtitle = g_strdup_printf (_("Following… %s"), size);
+    }
+  else if (self->file_size > 0)
+    {
+      /* Translators: The placeholder is a percentage. */
+      subtitle = g_strdup_printf (_("Loading… %u%%"),
+                                  (guint) (MIN (bytes_processed,
+                                                self->file_size) * 100 /
+                                           self->file_size));
+    }
+  else
+    {
+      g_autofree gchar *size = NULL;
+
+      size = g_format_size (bytes_processed);
+      /* Translators: The placeholder is an amount of data, like ‘5 MB’. */
+      subtitle = g_strdup_printf (_("Loading… %s"), size);
+    }
+
+  gtk_header_bar_set_subtitle (self->header_bar, subtitle);
 }
 
 static void
@@ -805,12 +1169,6 @@ set_file_cb2 (GObject      *source_object,
 {
   DfvViewerWindow *self;
   DflParser *parser;
-  DflEventSequence *sequence;
-  g_autoptr (DflModel) model = NULL;
-  g_autoptr (DwlSourceModel) source_model = NULL;
-  g_autoptr (DwlTaskModel) task_model = NULL;
-  g_autoptr (GPtrArray) sources = NULL;  /* (element-type DflSource) */
-  g_autoptr (GPtrArray) tasks = NULL;  /* (element-type DflTask) */
   GError *child_error = NULL;
 
   self = DFV_VIEWER_WINDOW (user_data);
@@ -827,9 +1185,6 @@ set_file_cb2 (GObject      *source_object,
       return;
     }
 
-  sequence = dfl_parser_get_event_sequence (parser);
-  model = dfl_model_new (sequence);
-
   /* Done. One last check for cancellation, then. Clear up the loading state. */
   if (g_cancellable_is_cancelled (self->open_cancellable))
     {
@@ -837,31 +1192,37 @@ set_file_cb2 (GObject      *source_object,
       return;
     }
 
-  g_clear_object (&self->open_cancellable);
+  dfv_viewer_window_clear_parser (self);
 
-  /* Create and show the timeline and statistics widgets. */
-  self->timeline = GTK_WIDGET (dwl_timeline_new (model));
-  gtk_container_add (GTK_CONTAINER (self->timeline_scrolled_window),
-                     self->timeline);
-  gtk_widget_show (self->timeline);
+  /* All the batches of events have been delivered by now, but the model may
+   * still be being built from them, in which case model_new_cb() finishes off.
+   * The sources and tasks lists are only populated once loading is
+   * complete. */
+  if (self->model != NULL)
+    {
+      g_clear_object (&self->open_cancellable);
+      dfv_viewer_window_update_lists (self);
+    }
+}
 
-  self->statistics_pane = GTK_WIDGET (dwl_statistics_pane_new (model));
-  gtk_paned_pack2 (self->main_paned, self->statistics_pane, FALSE, FALSE);
-  gtk_widget_show (self->statistics_pane);
+static void
+set_file_follow_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  DfvViewerWindow *self;
+  DflParser *parser;
+  g_autoptr (GError) error = NULL;
 
-  sources = dfl_model_dup_sources (model);
-  source_model = dwl_source_model_new (sources);
-  gtk_tree_view_set_model (self->sources_tree_view,
-                           GTK_TREE_MODEL (source_model));
+  parser = DFL_PARSER (source_object);
 
-  tasks = dfl_model_dup_tasks (model);
-  task_model = dwl_task_model_new (tasks);
-  gtk_tree_view_set_model (self->tasks_tree_view,
-                           GTK_TREE_MODEL (task_model));
+  /* Following only stops on error or cancellation. Cancellation means the
+   * file has been closed, or another one opened, so there is nothing to do. */
+  if (dfl_parser_follow_stream_finish (parser, result, &error))
+    return;
 
-  gtk_stack_set_visible_child_name (self->file_stack, "timeline");
-  gtk_stack_set_visible_child_name (self->main_stack, "file");
-  gtk_widget_grab_focus (self->timeline);
+  self = DFV_VIEWER_WINDOW (user_data);
+  dfv_viewer_window_clear_file (self, error);
 }
 
 static void
@@ -903,3 +1264,4 @@ set_file_cb_name (GObject      *source_object,
       gtk_header_bar_set_title (self->header_bar, filename);
     }
 }
+